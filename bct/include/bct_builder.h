@@ -0,0 +1,125 @@
+/****************************************************************************
+ * Binary Parse Tree builder
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * The builder writes the BPT file in a single pass over the events. Each
+ * node is given its NodeID and space in the file when it is opened, so the
+ * nodes are laid out in the order they are defined, and its record is
+ * written when it is closed, once its children are known. The SiblingNodeID
+ * of each child is patched in when its parent is closed.
+ *
+ * When a node is closed, its chain of children is compared against the
+ * nodes already written, starting from the last sibling. A node with the
+ * same contents, the same children and the same siblings as one already
+ * written is replaced by that node, so identical subtrees, such as common
+ * terminal nodes and option chains, are stored once. Replaced nodes at the
+ * end of the file are cut off, and their NodeIDs reused.
+ */
+#ifndef HDR_BCT_BUILDER_H
+#define HDR_BCT_BUILDER_H
+
+#include <stdint.h>
+
+#include "bct_compile.h"
+
+/** @brief Match counts read from a profile */
+typedef struct bct_profile_s bct_profile_t;
+
+/** @brief Load a profile written by ciscli_stats_write_profile
+ *
+ * Only a hash of each command is kept, not its text.
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int bct_profile_load(const char *path, bct_profile_t **profile);
+
+/** @brief Free a profile and clear the pointer */
+void bct_profile_free(bct_profile_t **profile);
+
+/** @brief Start the key of the commands of a tree */
+uint64_t bct_profile_tree_key(const char *tree);
+
+/** @brief Extend the key of a command with the label of a node
+ *
+ * @param   key     Key of the command leading to the node
+ * @param   first   Non-zero if the node is a child of the root
+ * @param   label   Label of the node, as shown in the help
+ */
+uint64_t bct_profile_node_key(uint64_t key, int first, const char *label);
+
+/** @brief Get the match count of a command, 0 if it is not in the profile */
+uint64_t bct_profile_count(const bct_profile_t *profile, uint64_t key);
+
+/** @brief Builder statistics */
+typedef struct bct_build_stats_s {
+    /** @brief Nodes defined in the input, other than the roots of trees */
+    uint64_t nodes_defined;
+
+    /** @brief Nodes replaced by an identical node already written */
+    uint64_t nodes_shared;
+
+    /** @brief Nodes in the file, from the file header */
+    uint32_t max_nodes;
+
+    /** @brief Trees in the file, from the file header */
+    uint32_t max_modes;
+
+    /** @brief Size of the file */
+    uint64_t size;
+} bct_build_stats_t;
+
+typedef struct bct_builder_s bct_builder_t;
+
+/** @brief Create a builder
+ *
+ * The file is written under a temporary name next to the output, and only
+ * renamed to the output when it is finished.
+ *
+ * @param   output      Path of the BPT file
+ * @param   share_table Number of entries in the table of shared nodes
+ * @param   profile     Profile to lay out children by, or NULL to keep them
+ *                      in the order they are defined
+ * @param   builder     Receives the builder
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int bct_builder_create(const char *output, uint32_t share_table,
+                       const bct_profile_t *profile, bct_builder_t **builder);
+
+/** @brief Add an open, attribute or close event
+ *
+ * @returns 0 on success, negative errno on failure. -EINVAL indicates an
+ *          error in the input, described by \ref bct_builder_error.
+ */
+int bct_builder_event(bct_builder_t *builder, const bct_event_t *ev);
+
+/** @brief Describe the last error in the input */
+const char * bct_builder_error(const bct_builder_t *builder);
+
+/** @brief Write the indexes and move the file into place
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int bct_builder_finish(bct_builder_t *builder, bct_build_stats_t *stats);
+
+/** @brief Free a builder, removing the file unless it was finished */
+void bct_builder_destroy(bct_builder_t **builder);
+
+#endif /* !defined HDR_BCT_BUILDER_H */
@@ -0,0 +1,101 @@
+/****************************************************************************
+ * Binary Parse Tree compiler cache
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * The cache holds the events read from each source file, so that a file
+ * which has not changed since it was last compiled is replayed rather than
+ * parsed again. The events of a file do not include those of its imports,
+ * which have their own entries, only the import itself. A cache file is
+ * private to the machine that wrote it, so it is in host byte order.
+ */
+#ifndef HDR_BCT_CACHE_H
+#define HDR_BCT_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bct_compile.h"
+
+/** @brief What the events of a source file depend on
+ *
+ * The events only stay the same if the file, the include directories and
+ * the definitions made before the file are the same.
+ */
+typedef struct bct_cache_key_s {
+    uint64_t ino;
+    uint64_t size;
+    uint64_t mtime_ns;
+
+    /** @brief Hash of the compiler options that affect the events */
+    uint64_t options;
+
+    /** @brief Hash of the definitions made before the file */
+    uint64_t state;
+} bct_cache_key_t;
+
+/** @brief Cache entry being written */
+typedef struct bct_cache_writer_s bct_cache_writer_t;
+
+/** @brief Open the cache entry of a source file for replay
+ *
+ * @param   dir     Cache directory
+ * @param   path    Resolved path of the source file
+ * @param   key     What the events must have been read with
+ * @param   reader  Receives the entry, positioned at its first event
+ *
+ * @returns 0 on success, -ENOENT if there is no entry or it was read with
+ *          a different key, or negative errno on failure.
+ */
+int bct_cache_open(const char *dir, const char *path, const bct_cache_key_t *key,
+                   FILE **reader);
+
+/** @brief Read the next event of a cache entry
+ *
+ * @returns 1 if an event was read, 0 at the end of the entry, or -EPROTO
+ *          if the entry is damaged.
+ */
+int bct_cache_read(FILE *reader, bct_event_t *ev);
+
+/** @brief Start writing the cache entry of a source file
+ *
+ * The entry replaces the existing one when it is committed.
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int bct_cache_create(const char *dir, const char *path,
+                     const bct_cache_key_t *key, bct_cache_writer_t **writer);
+
+/** @brief Append an event to a cache entry */
+int bct_cache_write(bct_cache_writer_t *writer, const bct_event_t *ev);
+
+/** @brief Append the events between two offsets of an entry being read */
+int bct_cache_copy(bct_cache_writer_t *writer, FILE *reader, long from,
+                   long to);
+
+/** @brief Replace the existing entry with the one written
+ *
+ * The writer is freed, whether or not this succeeds.
+ */
+int bct_cache_commit(bct_cache_writer_t **writer);
+
+/** @brief Discard an entry being written, and free the writer */
+void bct_cache_abort(bct_cache_writer_t **writer);
+
+#endif /* !defined HDR_BCT_CACHE_H */
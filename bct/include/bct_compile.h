@@ -0,0 +1,249 @@
+/****************************************************************************
+ * Binary Parse Tree compiler
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * The compiler translates the language described in docs/compiler-format.md
+ * into a BPT file. It is built as a pipeline of events, so that no stage
+ * holds more than the innermost open blocks of the input:
+ *
+ * - The source reader turns a file into a stream of events, one statement
+ *   at a time.
+ * - The driver follows imports and definitions, and records the events of
+ *   each file in a cache, so that unchanged files can be replayed rather
+ *   than parsed again.
+ * - The builder lays the nodes out in the BPT file as they are closed,
+ *   sharing identical subtrees.
+ */
+#ifndef HDR_BCT_COMPILE_H
+#define HDR_BCT_COMPILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <limits.h>
+
+/** @brief Longest string argument, which also holds resolved import paths */
+#define BCT_TEXT_MAX        PATH_MAX
+
+/** @brief Most arguments taken by any command */
+#define BCT_ARGS_MAX        3
+
+/** @brief Deepest nesting of blocks in a file */
+#define BCT_NEST_MAX        64
+
+/** @brief Deepest nesting of imports */
+#define BCT_IMPORT_MAX      64
+
+/** @brief Default number of entries in the table of shared nodes */
+#define BCT_SHARE_TABLE_DEFAULT (1u << 20)
+
+/** @brief Compiler options */
+typedef struct bct_options_s {
+    /** @brief Directories searched for imports, in order */
+    const char **include_dirs;
+
+    /** @brief Number of include directories */
+    uint32_t include_count;
+
+    /** @brief Profile to lay the nodes out by, or NULL */
+    const char *profile;
+
+    /** @brief Directory holding the cache of parsed files, or NULL */
+    const char *cache_dir;
+
+    /** @brief Path of the BPT file to write */
+    const char *output;
+
+    /** @brief Number of entries in the table of shared nodes, which bounds
+     * the memory used to find identical subtrees. Zero uses the default.
+     */
+    uint32_t share_table;
+
+    /** @brief Print statistics to stderr when done */
+    int verbose;
+} bct_options_t;
+
+/** @brief Kinds of event */
+enum bct_event_kind_e {
+    /** @brief Start a tree or a node */
+    BCT_EVENT_OPEN = 1,
+
+    /** @brief Subcommand applying to the innermost open tree or node */
+    BCT_EVENT_ATTR,
+
+    /** @brief End the innermost open tree or node */
+    BCT_EVENT_CLOSE,
+
+    /** @brief Definition, handled by the driver */
+    BCT_EVENT_DEFINE,
+
+    /** @brief Import, handled by the driver */
+    BCT_EVENT_IMPORT,
+};
+
+/** @brief Commands of the language */
+enum bct_command_e {
+    BCT_CMD_NONE = 0,
+
+    /* Blocks */
+    BCT_CMD_TREE,
+    BCT_CMD_KEYWORD,
+    BCT_CMD_INTEGER,
+    BCT_CMD_NUMBER,
+    BCT_CMD_STRING,
+    BCT_CMD_IP,
+    BCT_CMD_MAC,
+    BCT_CMD_CONSTANT,
+    BCT_CMD_ACTION,
+
+    /* Subcommands */
+    BCT_CMD_SET,
+    BCT_CMD_RANGE,
+    BCT_CMD_PREFIX,
+    BCT_CMD_MINMATCH,
+    BCT_CMD_HELP,
+    BCT_CMD_HIDDEN,
+    BCT_CMD_PRIVILEGE,
+    BCT_CMD_PARENT,
+    BCT_CMD_PROMPT,
+
+    /* Preprocessor */
+    BCT_CMD_IMPORT,
+    BCT_CMD_DEFINE,
+
+    BCT_CMD_MAX
+};
+
+/** @brief Kinds of argument value */
+enum bct_value_kind_e {
+    BCT_VALUE_NONE = 0,
+    BCT_VALUE_INT,
+    BCT_VALUE_NUM,
+    BCT_VALUE_STR,
+
+    /** @brief Bare word, such as MIN or IP4, that names no definition */
+    BCT_VALUE_WORD,
+};
+
+/** @brief Argument value */
+typedef struct bct_value_s {
+    uint8_t kind;
+    int64_t i;
+    double d;
+    char s[BCT_TEXT_MAX];
+} bct_value_t;
+
+/** @brief A statement of the input, with its definitions substituted */
+typedef struct bct_event_s {
+    uint8_t kind;
+    uint8_t command;
+    uint8_t argc;
+
+    /** @brief Line of the statement in its file */
+    uint32_t line;
+
+    bct_value_t argv[BCT_ARGS_MAX];
+
+    /** @brief Imports only: state of the definitions after the import */
+    uint64_t state;
+
+    /** @brief Imports only: file offset just after the statement */
+    uint64_t offset;
+
+    /** @brief Imports only: closing tokens of the enclosing blocks */
+    char nest[BCT_NEST_MAX + 1];
+} bct_event_t;
+
+/** @brief Source reader
+ *
+ * The file is read through stdio, a character at a time, so only the
+ * current token is held in memory. Blocks are tracked on an explicit stack
+ * rather than by recursion, so that reading can resume after any import.
+ */
+typedef struct bct_source_s {
+    FILE *fp;
+    const char *path;
+    uint32_t line;
+
+    /** @brief Offset of the next character to be read */
+    uint64_t offset;
+
+    /** @brief Closing token of each open block, 'e' for end or '}' */
+    char nest[BCT_NEST_MAX + 1];
+    uint32_t depth;
+
+    /** @brief A node without a block was opened, and must be closed */
+    int close_pending;
+
+    /** @brief Look up a definition, returns NULL if there is none */
+    const bct_value_t * (*lookup)(void *context, const char *name);
+    void *context;
+} bct_source_t;
+
+/** @brief Open a source file
+ *
+ * @param   src     Reader to initialize
+ * @param   path    Path of the file
+ * @param   offset  Offset to start reading at, just after an import
+ * @param   line    Line at that offset
+ * @param   nest    Blocks open at that offset, as in \ref bct_event_t
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int bct_source_open(bct_source_t *src, const char *path, uint64_t offset,
+                    uint32_t line, const char *nest);
+
+/** @brief Read the next event from a source file
+ *
+ * Errors are reported on stderr with the file and line.
+ *
+ * @returns 1 if an event was read, 0 at the end of the file, or negative
+ *          errno on error.
+ */
+int bct_source_next(bct_source_t *src, bct_event_t *ev);
+
+/** @brief Close a source file */
+void bct_source_close(bct_source_t *src);
+
+/** @brief Name of a command, for messages */
+const char * bct_command_name(uint8_t command);
+
+/** @brief Fold bytes into a 64-bit FNV-1a hash */
+static inline uint64_t bct_hash(uint64_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--) {
+        h = (h ^ *p++) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+#define BCT_HASH_INIT       0xCBF29CE484222325ull
+
+/** @brief Compile a file into a BPT file
+ *
+ * Errors are reported on stderr with the file and line.
+ *
+ * @returns 0 on success, negative errno on failure. The output file is only
+ *          replaced if the compilation succeeds.
+ */
+int bct_compile(const bct_options_t *opts, const char *input);
+
+#endif /* !defined HDR_BCT_COMPILE_H */
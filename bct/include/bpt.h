@@ -0,0 +1,324 @@
+/****************************************************************************
+ * Binary Parse Tree file definitions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * These structures describe the on-disk layout documented in
+ * docs/tree-file-format.md. All multi-byte fields are big-endian and may be
+ * unaligned, so they are declared as byte arrays and read with the
+ * bpt_be* accessors.
+ */
+#ifndef HDR_BPT_H
+#define HDR_BPT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+
+#include "parser_control.h"
+
+#define BPT_MAGIC               "BPT"
+#define BPT_VERSION_MAJOR       1
+#define BPT_VERSION_MINOR       1
+#define BPT_VERSION             ((BPT_VERSION_MAJOR << 4) | BPT_VERSION_MINOR)
+
+#define BPT_INDEX_MAGIC         "BPTX"
+
+#define BPT_PROMPT_LENGTH       64
+#define BPT_FORMAT_LENGTH       64
+
+/** @brief Node type identifiers used in the BPT file */
+enum bpt_node_type_e {
+    BPT_NODE_TYPE_ROOT = 0,
+    BPT_NODE_TYPE_KEYWORD,
+    BPT_NODE_TYPE_INTEGER,
+    BPT_NODE_TYPE_DOUBLE,
+    BPT_NODE_TYPE_STRING,
+    BPT_NODE_TYPE_ADDRESS,
+    BPT_NODE_TYPE_CONSTANT,
+    BPT_NODE_TYPE_CONDITIONAL,
+    BPT_NODE_TYPE_EOL,
+    BPT_NODE_TYPE_MAX
+};
+
+/** @brief BPT file header */
+typedef struct bpt_file_header_s {
+    char    magic[4];
+    uint8_t version;
+    uint8_t reserved;
+    uint8_t max_modes[2];
+    uint8_t max_nodes[4];
+    char    prompt_command[BPT_PROMPT_LENGTH];
+} bpt_file_header_t;
+
+/** @brief BPT mode header */
+typedef struct bpt_mode_header_s {
+    uint8_t mode_id[2];
+    uint8_t parent_mode_id[2];
+    uint8_t root_node_id[4];
+    char    format_string[BPT_FORMAT_LENGTH];
+} bpt_mode_header_t;
+
+/** @brief BPT command node header */
+typedef struct bpt_node_header_s {
+    uint8_t node_id[4];
+    uint8_t child_id[4];
+    uint8_t sibling_id[4];
+    uint8_t type;
+    uint8_t node_flags;
+    uint8_t flags[2];
+    char    help_text[HELP_TEXT_LENGTH];
+} bpt_node_header_t;
+
+/** @brief BPT keyword node */
+typedef struct bpt_node_keyword_s {
+    bpt_node_header_t header;
+    char    keyword[KEYWORD_LENGTH_MAX];
+    uint8_t minimum_match[4];
+    uint8_t index[4];
+    uint8_t value[8];
+    char    string[STRING_LENGTH_MAX];
+} bpt_node_keyword_t;
+
+/** @brief BPT integer node
+ *
+ * The range is inclusive, and the formats are the INTEGER_FORMAT_* flags.
+ */
+typedef struct bpt_node_integer_s {
+    bpt_node_header_t header;
+    uint8_t minimum[8];
+    uint8_t maximum[8];
+    uint8_t index[4];
+    uint8_t formats[4];
+} bpt_node_integer_t;
+
+/** @brief BPT double node
+ *
+ * The range is inclusive, and held as IEEE 754 double precision values.
+ */
+typedef struct bpt_node_double_s {
+    bpt_node_header_t header;
+    uint8_t minimum[8];
+    uint8_t maximum[8];
+    uint8_t index[4];
+} bpt_node_double_t;
+
+/** @brief BPT string node */
+typedef struct bpt_node_string_s {
+    bpt_node_header_t header;
+    uint8_t index[4];
+} bpt_node_string_t;
+
+/** @brief BPT address node
+ *
+ * The formats are the ADDRESS_FORMAT_* flags.
+ */
+typedef struct bpt_node_address_s {
+    bpt_node_header_t header;
+    uint8_t index[4];
+    uint8_t formats[4];
+} bpt_node_address_t;
+
+#define BPT_ACTION_LENGTH       128
+
+/** @brief Action types of terminal nodes */
+enum bpt_action_type_e {
+    BPT_ACTION_NONE = 0,
+    BPT_ACTION_SYSCALL,
+    BPT_ACTION_LIBCALL,
+    BPT_ACTION_INTERNAL,
+    BPT_ACTION_MAX
+};
+
+/** @brief BPT terminal node */
+typedef struct bpt_node_eol_s {
+    bpt_node_header_t header;
+    uint8_t action_type[4];
+    char    action[BPT_ACTION_LENGTH];
+} bpt_node_eol_t;
+
+/** @brief BPT index trailer
+ *
+ * This occupies the last bytes of a version 1.1 file, and locates the
+ * tables that map mode and node identifiers to file offsets.
+ */
+typedef struct bpt_index_trailer_s {
+    char    magic[4];
+    uint8_t mode_table[4];
+    uint8_t node_table[4];
+    uint8_t reserved[4];
+} bpt_index_trailer_t;
+
+static inline uint16_t bpt_be16(const uint8_t *p)
+{
+    uint16_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return be16toh(v);
+}
+
+static inline uint32_t bpt_be32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return be32toh(v);
+}
+
+static inline uint64_t bpt_be64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return be64toh(v);
+}
+
+static inline double bpt_be_double(const uint8_t *p)
+{
+    uint64_t v = bpt_be64(p);
+    double d;
+
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+/** @brief Size of the record of a command node type
+ *
+ * Types without a data section defined have only the node header.
+ */
+static inline size_t bpt_node_size(uint8_t type)
+{
+    switch (type) {
+    case BPT_NODE_TYPE_KEYWORD:
+        return sizeof(bpt_node_keyword_t);
+
+    case BPT_NODE_TYPE_INTEGER:
+        return sizeof(bpt_node_integer_t);
+
+    case BPT_NODE_TYPE_DOUBLE:
+        return sizeof(bpt_node_double_t);
+
+    case BPT_NODE_TYPE_STRING:
+        return sizeof(bpt_node_string_t);
+
+    case BPT_NODE_TYPE_ADDRESS:
+        return sizeof(bpt_node_address_t);
+
+    case BPT_NODE_TYPE_EOL:
+        return sizeof(bpt_node_eol_t);
+
+    default:
+        return sizeof(bpt_node_header_t);
+    }
+}
+
+/** @brief A mapped BPT file
+ *
+ * The file is mapped read-only and shared, so every process that maps the
+ * same file shares the same physical pages. Nodes are referenced by their
+ * NodeID and located through the index tables, rather than by pointer.
+ */
+typedef struct bpt_image_s {
+    /** Start of the mapping */
+    const uint8_t *base;
+
+    /** Size of the mapping */
+    size_t size;
+
+    /** Number of modes, from the file header */
+    uint32_t max_modes;
+
+    /** Number of nodes, from the file header */
+    uint32_t max_nodes;
+
+    /** Offsets of the mode headers, indexed by ModeID */
+    const uint8_t *mode_table;
+
+    /** Offsets of the command nodes, indexed by NodeID */
+    const uint8_t *node_table;
+} bpt_image_t;
+
+/** @brief Map a BPT file
+ *
+ * This only validates the file header and index trailer, so it takes the
+ * same time regardless of the size of the file. Individual records are
+ * bounds checked as they are accessed.
+ *
+ * @param   path    Path to the BPT file
+ * @param   image   Receives the mapped image on success
+ *
+ * @returns 0 on success, negative errno on failure. -EPROTO indicates a
+ *          malformed file, and -ENOTSUP a file without the index trailer.
+ */
+int bpt_open(const char *path, bpt_image_t **image);
+
+/** @brief Unmap a BPT file and clear the pointer */
+void bpt_close(bpt_image_t **image);
+
+/** @brief Get the prompt command from the file header */
+const char * bpt_get_prompt_command(const bpt_image_t *image);
+
+/** @brief Get a mode header by ModeID
+ *
+ * @returns Pointer into the mapping, or NULL if the mode does not exist.
+ */
+const bpt_mode_header_t * bpt_get_mode(const bpt_image_t *image, uint32_t mode_id);
+
+/** @brief Get a command node by NodeID
+ *
+ * @returns Pointer into the mapping, or NULL if the node does not exist or
+ *          its record does not fit within the file.
+ */
+const bpt_node_header_t * bpt_get_node(const bpt_image_t *image, uint32_t node_id);
+
+/** @brief Get the child of a command node, or NULL if there is none */
+static inline const bpt_node_header_t * bpt_node_child(const bpt_image_t *image,
+                                                       const bpt_node_header_t *node)
+{
+    return bpt_get_node(image, bpt_be32(node->child_id));
+}
+
+/** @brief Get the sibling of a command node, or NULL if there is none */
+static inline const bpt_node_header_t * bpt_node_sibling(const bpt_image_t *image,
+                                                         const bpt_node_header_t *node)
+{
+    return bpt_get_node(image, bpt_be32(node->sibling_id));
+}
+
+/** @brief Parse a command line against a mode of a mapped BPT file
+ *
+ * The nodes are read directly from the mapping. When more than one child
+ * accepts a token, the types are preferred in the same order as the parser
+ * prefers them. Parameters set by matched nodes are saved into the control
+ * structure.
+ *
+ * @param   image   Mapped BPT file
+ * @param   mode_id Mode to parse the command in
+ * @param   ctl     Control structure initialized with the command line.
+ *                  On error, total_parsed is the offset of the input that
+ *                  could not be parsed.
+ * @param   eol_id  Receives the NodeID of the EOL node on success
+ *
+ * @returns One of \ref parser_result_e, or negative errno if the mode does
+ *          not exist or the file is malformed.
+ */
+int bpt_parse(const bpt_image_t *image, uint32_t mode_id, PARSER_CTRL *ctl,
+              uint32_t *eol_id);
+
+#endif /* !defined HDR_BPT_H */
@@ -0,0 +1,117 @@
+/****************************************************************************
+ * Binary Parse Tree snapshots
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * A handle holds the version of a BPT file that sessions currently parse
+ * in. A new version is mapped and published by a single atomic store, and
+ * sessions pick it up before their next command, without locking. A
+ * session that is still parsing a command keeps the version it started
+ * with, which is unmapped once the last session leaves it.
+ */
+#ifndef HDR_BPT_HANDLE_H
+#define HDR_BPT_HANDLE_H
+
+#include <stdint.h>
+
+#include "bpt.h"
+
+/** @brief A published version of a BPT file */
+typedef struct bpt_snapshot_s {
+    /** Mapped BPT file, which does not change while the snapshot is held */
+    const bpt_image_t *image;
+
+    /** Version of the handle, counting from 1 for the first file opened */
+    uint64_t version;
+
+    /** References held by the handle and by readers
+     * @private
+     */
+    uint32_t refs;
+} bpt_snapshot_t;
+
+/** @brief Handle to the current snapshot of a BPT file */
+typedef struct bpt_handle_s bpt_handle_t;
+
+/** @brief Open a BPT file as the first snapshot of a new handle
+ *
+ * @returns 0 on success, negative errno on failure, as \ref bpt_open.
+ */
+int bpt_handle_open(const char *path, bpt_handle_t **handle);
+
+/** @brief Release a handle and clear the pointer
+ *
+ * Snapshots that are still held remain valid until they are released.
+ */
+void bpt_handle_close(bpt_handle_t **handle);
+
+/** @brief Publish a mapped BPT file as the current snapshot
+ *
+ * Readers that acquire a snapshot after this returns get the new one. The
+ * previous snapshot is unmapped when the last reader releases it. Readers
+ * are never blocked; this waits only for readers that are in the middle of
+ * acquiring a snapshot, which takes a few instructions.
+ *
+ * @param   handle  Handle to publish in
+ * @param   image   Mapped BPT file, which the handle takes ownership of
+ *
+ * @returns Version of the new snapshot, or negative errno on failure, in
+ *          which case the image is left to the caller.
+ */
+int64_t bpt_handle_publish(bpt_handle_t *handle, bpt_image_t *image);
+
+/** @brief Map a BPT file and publish it as the current snapshot
+ *
+ * The file is mapped and checked in the calling thread, which is meant to
+ * be a background thread, before it is published. If the file cannot be
+ * mapped, the current snapshot stays in place.
+ *
+ * @returns Version of the new snapshot, or negative errno on failure.
+ */
+int64_t bpt_handle_reload(bpt_handle_t *handle, const char *path);
+
+/** @brief Retrieve the version of the current snapshot */
+uint64_t bpt_handle_version(const bpt_handle_t *handle);
+
+/** @brief Acquire the current snapshot
+ *
+ * This never blocks. The snapshot must be released with
+ * \ref bpt_snapshot_release.
+ */
+const bpt_snapshot_t * bpt_snapshot_acquire(bpt_handle_t *handle);
+
+/** @brief Release a snapshot, unmapping it if it is no longer current */
+void bpt_snapshot_release(const bpt_snapshot_t *snapshot);
+
+/** @brief Switch a held snapshot to the current one
+ *
+ * This is meant to be called by a session before each command. If the
+ * snapshot held is still current, it is returned as is, at the cost of a
+ * single load. Otherwise the current snapshot is acquired and the one held
+ * is released.
+ *
+ * @param   handle      Handle the snapshot was acquired from
+ * @param   snapshot    Snapshot held, or NULL to acquire one
+ *
+ * @returns The current snapshot.
+ */
+const bpt_snapshot_t * bpt_snapshot_refresh(bpt_handle_t *handle,
+                                            const bpt_snapshot_t *snapshot);
+
+#endif /* !defined HDR_BPT_HANDLE_H */
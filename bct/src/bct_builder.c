@@ -0,0 +1,1475 @@
+/****************************************************************************
+ * Binary Parse Tree builder
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bpt.h"
+#include "bct_builder.h"
+#include "parser.h"
+#include "parser_node_keyword.h"
+#include "parser_node_registration.h"
+
+/* The end of the file is buffered, since most writes and patches land there */
+#define BUILDER_BUFFER_SIZE     (1u << 20)
+
+/* Slots probed in the table of shared nodes before giving up */
+#define SHARE_PROBES            8
+
+/* Chunk read at a time when indexing the nodes */
+#define SCAN_CHUNK_SIZE         (64u << 10)
+
+typedef union record_u {
+    bpt_node_header_t header;
+    bpt_node_keyword_t keyword;
+    bpt_node_integer_t integer;
+    bpt_node_double_t number;
+    bpt_node_string_t string;
+    bpt_node_address_t address;
+    bpt_node_eol_t eol;
+    uint8_t bytes[1];
+} record_t;
+
+/* Closed child of an open node */
+typedef struct child_s {
+    uint32_t id;
+    uint32_t offset;
+
+    /* Order in which the child was defined */
+    uint32_t seq;
+
+    uint8_t type;
+
+    /* Replaced by an identical node already written */
+    uint8_t shared;
+
+    /* Match count from the profile */
+    uint64_t count;
+
+    /* Hash of the record, without the NodeID and SiblingNodeID */
+    uint64_t hash;
+
+    /* Hash of the keyword, zero for other types */
+    uint64_t keyword;
+} child_t;
+
+struct tree_s;
+
+/* Open tree or node */
+typedef struct frame_s {
+    record_t record;
+    uint32_t size;
+    uint32_t id;
+    uint32_t offset;
+
+    /* Profile key of the command leading to the node */
+    uint64_t key;
+    int key_valid;
+
+    child_t *children;
+    uint32_t count;
+    uint32_t alloc;
+
+    /* Set for the root of a tree */
+    struct tree_s *tree;
+} frame_t;
+
+/* Tree, whose root stays open until the file is finished */
+typedef struct tree_s {
+    char *name;
+    char *parent;
+    char format[BPT_FORMAT_LENGTH];
+    uint32_t header_offset;
+    frame_t root;
+} tree_t;
+
+typedef struct share_entry_s {
+    uint64_t key;
+    uint32_t id;
+    uint32_t offset;
+} share_entry_t;
+
+struct bct_builder_s {
+    int fd;
+    char *output;
+    char *temp;
+    const bct_profile_t *profile;
+
+    /* Buffered end of the file */
+    uint8_t *buf;
+    uint64_t buf_start;
+    uint32_t buf_len;
+    uint64_t end;
+
+    uint32_t next_id;
+
+    share_entry_t *share;
+    uint32_t share_mask;
+
+    tree_t *trees;
+    uint32_t tree_count;
+    uint32_t tree_alloc;
+
+    /* Open frames, and the node frames kept for reuse at each depth */
+    frame_t **stack;
+    frame_t **pool;
+    uint32_t depth;
+    uint32_t stack_alloc;
+
+    char prompt[BPT_PROMPT_LENGTH];
+    char error[256];
+    int finished;
+    bct_build_stats_t stats;
+};
+
+/* Parser node type of each BPT node type, which also gives its priority */
+static const uint8_t parser_type[BPT_NODE_TYPE_MAX] = {
+    [BPT_NODE_TYPE_ROOT]        = PARSER_NODE_TYPE_ROOT,
+    [BPT_NODE_TYPE_KEYWORD]     = PARSER_NODE_TYPE_KEYWORD,
+    [BPT_NODE_TYPE_INTEGER]     = PARSER_NODE_TYPE_INTEGER,
+    [BPT_NODE_TYPE_DOUBLE]      = PARSER_NODE_TYPE_NUMBER,
+    [BPT_NODE_TYPE_STRING]      = PARSER_NODE_TYPE_STRING,
+    [BPT_NODE_TYPE_ADDRESS]     = PARSER_NODE_TYPE_ADDRESS,
+    [BPT_NODE_TYPE_CONSTANT]    = PARSER_NODE_TYPE_CONSTANT,
+    [BPT_NODE_TYPE_CONDITIONAL] = PARSER_NODE_TYPE_CONDITIONAL,
+    [BPT_NODE_TYPE_EOL]         = PARSER_NODE_TYPE_EOL,
+};
+
+static int builder_error(bct_builder_t *b, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(b->error, sizeof(b->error), fmt, ap);
+    va_end(ap);
+    return -EINVAL;
+}
+
+const char * bct_builder_error(const bct_builder_t *builder)
+{
+    return builder->error;
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    v = htobe16(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    v = htobe32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_be64(uint8_t *p, uint64_t v)
+{
+    v = htobe64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_be_double(uint8_t *p, double d)
+{
+    uint64_t v;
+
+    memcpy(&v, &d, sizeof(v));
+    put_be64(p, v);
+}
+
+/*********************************************************************
+ * File access
+ *********************************************************************/
+static int pwrite_all(int fd, const uint8_t *data, size_t len, uint64_t offset)
+{
+    ssize_t n;
+
+    while (len) {
+        n = pwrite(fd, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int pread_all(int fd, uint8_t *data, size_t len, uint64_t offset)
+{
+    ssize_t n;
+
+    while (len) {
+        n = pread(fd, data, len, offset);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return n < 0 ? -errno : -EIO;
+        }
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int builder_flush(bct_builder_t *b)
+{
+    int retval = pwrite_all(b->fd, b->buf, b->buf_len, b->buf_start);
+
+    if (!retval) {
+        b->buf_start += b->buf_len;
+        b->buf_len = 0;
+    }
+    return retval;
+}
+
+/* Write over space already reserved, in the buffer or the file */
+static int builder_write(bct_builder_t *b, uint64_t offset, const void *data,
+                         size_t len)
+{
+    const uint8_t *p = data;
+    size_t n;
+    int retval;
+
+    if (offset < b->buf_start) {
+        n = len < b->buf_start - offset ? len : b->buf_start - offset;
+        retval = pwrite_all(b->fd, p, n, offset);
+        if (retval) {
+            return retval;
+        }
+        p += n;
+        offset += n;
+        len -= n;
+    }
+
+    memcpy(b->buf + (offset - b->buf_start), p, len);
+    return 0;
+}
+
+static int builder_read(bct_builder_t *b, uint64_t offset, void *data,
+                        size_t len)
+{
+    uint8_t *p = data;
+    size_t n;
+    int retval;
+
+    if (offset + len > b->end) {
+        return -EIO;
+    }
+
+    if (offset < b->buf_start) {
+        n = len < b->buf_start - offset ? len : b->buf_start - offset;
+        retval = pread_all(b->fd, p, n, offset);
+        if (retval) {
+            return retval;
+        }
+        p += n;
+        offset += n;
+        len -= n;
+    }
+
+    memcpy(p, b->buf + (offset - b->buf_start), len);
+    return 0;
+}
+
+/* Reserve zeroed space at the end of the file */
+static int builder_reserve(bct_builder_t *b, size_t len, uint32_t *offset)
+{
+    int retval;
+
+    /* Offsets in the file are 32 bits */
+    if (b->end + len > UINT32_MAX) {
+        return -EFBIG;
+    }
+
+    if (b->buf_len + len > BUILDER_BUFFER_SIZE) {
+        retval = builder_flush(b);
+        if (retval) {
+            return retval;
+        }
+    }
+
+    memset(b->buf + b->buf_len, 0, len);
+    *offset = b->end;
+    b->buf_len += len;
+    b->end += len;
+    return 0;
+}
+
+static int builder_append(bct_builder_t *b, const void *data, size_t len)
+{
+    uint32_t offset;
+    int retval = builder_reserve(b, len, &offset);
+
+    return retval ? retval : builder_write(b, offset, data, len);
+}
+
+/* Cut the file off at a node, whose NodeID is the next to be used */
+static void builder_truncate(bct_builder_t *b, uint32_t offset, uint32_t id)
+{
+    if (offset >= b->buf_start) {
+        b->buf_len = offset - b->buf_start;
+    } else {
+        b->buf_start = offset;
+        b->buf_len = 0;
+    }
+
+    b->end = offset;
+    b->next_id = id;
+}
+
+/*********************************************************************
+ * Shared nodes
+ *********************************************************************/
+static uint64_t record_hash(const record_t *r, uint32_t size)
+{
+    uint64_t h = BCT_HASH_INIT;
+
+    h = bct_hash(h, r->header.child_id, sizeof(r->header.child_id));
+    return bct_hash(h, r->bytes + offsetof(bpt_node_header_t, type),
+                    size - offsetof(bpt_node_header_t, type));
+}
+
+static uint64_t share_key(uint64_t hash, uint32_t sibling)
+{
+    uint64_t key = bct_hash(hash, &sibling, sizeof(sibling));
+
+    return key ? key : 1;
+}
+
+/*
+ * Check whether the node in a table entry can stand in for a child with
+ * the given sibling, by comparing the records in the file.
+ */
+static int share_matches(bct_builder_t *b, const share_entry_t *e,
+                         const child_t *c, uint32_t sibling)
+{
+    record_t shared;
+    record_t node;
+    uint32_t size = bpt_node_size(c->type);
+
+    if (builder_read(b, e->offset, &shared, size) ||
+        builder_read(b, c->offset, &node, size)) {
+        return 0;
+    }
+
+    return bpt_be32(shared.header.node_id) == e->id &&
+           bpt_be32(shared.header.sibling_id) == sibling &&
+           memcmp(shared.header.child_id, node.header.child_id,
+                  sizeof(node.header.child_id)) == 0 &&
+           memcmp(shared.bytes + offsetof(bpt_node_header_t, type),
+                  node.bytes + offsetof(bpt_node_header_t, type),
+                  size - offsetof(bpt_node_header_t, type)) == 0;
+}
+
+static uint32_t share_find(bct_builder_t *b, uint64_t key, const child_t *c,
+                           uint32_t sibling)
+{
+    share_entry_t *e;
+    uint32_t i;
+
+    for (i = 0; i < SHARE_PROBES; i++) {
+        e = &b->share[(key + i) & b->share_mask];
+        if (!e->key) {
+            break;
+        }
+
+        if (e->key == key && share_matches(b, e, c, sibling)) {
+            return e->id;
+        }
+    }
+
+    return 0;
+}
+
+/* The table has a fixed size, so an old entry is dropped when it is full */
+static void share_insert(bct_builder_t *b, uint64_t key, uint32_t id,
+                         uint32_t offset)
+{
+    share_entry_t *e = &b->share[key & b->share_mask];
+    uint32_t i;
+
+    for (i = 0; i < SHARE_PROBES; i++) {
+        if (!b->share[(key + i) & b->share_mask].key) {
+            e = &b->share[(key + i) & b->share_mask];
+            break;
+        }
+    }
+
+    e->key = key;
+    e->id = id;
+    e->offset = offset;
+}
+
+/*********************************************************************
+ * Children
+ *********************************************************************/
+static int child_rank(const child_t *c)
+{
+    return parser_type[c->type];
+}
+
+/* Same order as parser_tree_reorder gives the children at runtime */
+static int child_compare(const void *pa, const void *pb)
+{
+    const child_t *a = pa;
+    const child_t *b = pb;
+    uint64_t ca;
+    uint64_t cb;
+
+    if (child_rank(a) != child_rank(b)) {
+        return child_rank(a) - child_rank(b);
+    }
+
+    ca = child_rank(a) <= PARSER_NODE_TYPE_CONSTANT ? a->count : 0;
+    cb = child_rank(b) <= PARSER_NODE_TYPE_CONSTANT ? b->count : 0;
+    if (ca != cb) {
+        return ca > cb ? -1 : 1;
+    }
+
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+/*
+ * Link the children of a frame into a chain, sharing the longest tail of
+ * the chain that was already written, and return the first child. The
+ * replaced children that were laid out last are cut off the file.
+ */
+static int link_children(bct_builder_t *b, frame_t *f, int cut, uint32_t *first)
+{
+    uint8_t id[4];
+    child_t *c;
+    uint32_t sibling = 0;
+    uint32_t kept = 0;
+    uint32_t tail = UINT32_MAX;
+    uint32_t tail_id = 0;
+    uint32_t shared;
+    uint64_t key;
+    uint32_t i;
+    int sharing = 1;
+    int retval;
+
+    if (b->profile && f->count > 1) {
+        qsort(f->children, f->count, sizeof(*f->children), child_compare);
+    }
+
+    for (i = f->count; i-- > 0; ) {
+        c = &f->children[i];
+        key = share_key(c->hash, sibling);
+        if (sharing && (shared = share_find(b, key, c, sibling))) {
+            c->shared = 1;
+            sibling = shared;
+            b->stats.nodes_shared++;
+            continue;
+        }
+
+        sharing = 0;
+        if (sibling) {
+            put_be32(id, sibling);
+            retval = builder_write(b, c->offset +
+                                   offsetof(bpt_node_header_t, sibling_id),
+                                   id, sizeof(id));
+            if (retval) {
+                return retval;
+            }
+        }
+
+        share_insert(b, key, c->id, c->offset);
+        sibling = c->id;
+        if (c->offset >= kept) {
+            kept = c->offset + 1;
+        }
+    }
+
+    /* Replaced children after the last child kept are not referenced */
+    for (i = 0; cut && i < f->count; i++) {
+        c = &f->children[i];
+        if (c->shared && c->offset >= kept && c->offset < tail) {
+            tail = c->offset;
+            tail_id = c->id;
+        }
+    }
+
+    if (tail != UINT32_MAX) {
+        builder_truncate(b, tail, tail_id);
+    }
+
+    f->count = 0;
+    *first = sibling;
+    return 0;
+}
+
+/* Label of a node as shown in the help, which is how profiles name it */
+static const char * record_label(const record_t *r, char *buf, size_t size)
+{
+    union {
+        parser_node_header_t header;
+        parser_node_keyword_t keyword;
+        parser_node_integer_t integer;
+        parser_node_number_t number;
+        parser_node_address_t address;
+    } node;
+    const PARSER_NODE_REG *reg;
+    const char *label;
+
+    memset(&node, 0, sizeof(node));
+    node.header.type = parser_type[r->header.type];
+    switch (r->header.type) {
+    case BPT_NODE_TYPE_EOL:
+        return PARSER_EOL_TEXT;
+
+    case BPT_NODE_TYPE_KEYWORD:
+        memcpy(node.keyword.keyword, r->keyword.keyword, KEYWORD_LENGTH_MAX);
+        break;
+
+    case BPT_NODE_TYPE_INTEGER:
+        node.integer.min_accepted = (int64_t)bpt_be64(r->integer.minimum);
+        node.integer.max_accepted = (int64_t)bpt_be64(r->integer.maximum);
+        node.integer.formats = bpt_be32(r->integer.formats);
+        break;
+
+    case BPT_NODE_TYPE_DOUBLE:
+        node.number.min_accepted = bpt_be_double(r->number.minimum);
+        node.number.max_accepted = bpt_be_double(r->number.maximum);
+        break;
+
+    case BPT_NODE_TYPE_ADDRESS:
+        node.address.format = bpt_be32(r->address.formats);
+        break;
+    }
+
+    reg = parser_node_get_registration(node.header.type);
+    if (!reg || !reg->alt_text) {
+        snprintf(buf, size, "<type %u>", node.header.type);
+        return buf;
+    }
+
+    /* The label may point into the node, which is about to go away */
+    label = reg->alt_text((PARSER_NODE *)&node, buf, size);
+    if (label != buf) {
+        snprintf(buf, size, "%s", label);
+    }
+    return buf;
+}
+
+static uint64_t frame_key(bct_builder_t *b, uint32_t depth)
+{
+    frame_t *f = b->stack[depth];
+    char buf[PARSER_ALT_TEXT_MAX];
+
+    if (!f->key_valid) {
+        f->key = bct_profile_node_key(frame_key(b, depth - 1),
+                                      b->stack[depth - 1]->tree != NULL,
+                                      record_label(&f->record, buf, sizeof(buf)));
+        f->key_valid = 1;
+    }
+    return f->key;
+}
+
+static int add_child(bct_builder_t *b, frame_t *parent, const frame_t *f,
+                     uint64_t count)
+{
+    const char *kw = f->record.keyword.keyword;
+    uint64_t keyword = 0;
+    record_t other;
+    child_t *children;
+    child_t *c;
+    uint32_t alloc;
+    uint32_t i;
+
+    /* The parser could never choose between two identical keywords */
+    if (f->record.header.type == BPT_NODE_TYPE_KEYWORD) {
+        keyword = bct_hash(BCT_HASH_INIT, kw, strnlen(kw, KEYWORD_LENGTH_MAX));
+        for (i = 0; i < parent->count; i++) {
+            if (parent->children[i].keyword == keyword &&
+                !builder_read(b, parent->children[i].offset, &other,
+                              sizeof(other.keyword)) &&
+                strncmp(other.keyword.keyword, kw, KEYWORD_LENGTH_MAX) == 0) {
+                return builder_error(b, "keyword \"%.*s\" is already defined "
+                                     "here, its commands must be defined in "
+                                     "one block", KEYWORD_LENGTH_MAX, kw);
+            }
+        }
+    }
+
+    if (parent->count == parent->alloc) {
+        alloc = parent->alloc ? parent->alloc * 2 : 16;
+        children = realloc(parent->children, alloc * sizeof(*children));
+        if (!children) {
+            return -ENOMEM;
+        }
+        parent->children = children;
+        parent->alloc = alloc;
+    }
+
+    c = &parent->children[parent->count];
+    c->id = f->id;
+    c->offset = f->offset;
+    c->seq = parent->count++;
+    c->type = f->record.header.type;
+    c->shared = 0;
+    c->count = count;
+    c->hash = record_hash(&f->record, f->size);
+    c->keyword = keyword;
+    return 0;
+}
+
+/*********************************************************************
+ * Events
+ *********************************************************************/
+static int push_frame(bct_builder_t *b, frame_t *f)
+{
+    frame_t **stack;
+    frame_t **pool;
+    uint32_t alloc;
+
+    if (b->depth == b->stack_alloc) {
+        alloc = b->stack_alloc ? b->stack_alloc * 2 : 16;
+        stack = realloc(b->stack, alloc * sizeof(*stack));
+        if (!stack) {
+            return -ENOMEM;
+        }
+        b->stack = stack;
+
+        pool = realloc(b->pool, alloc * sizeof(*pool));
+        if (!pool) {
+            return -ENOMEM;
+        }
+        memset(pool + b->stack_alloc, 0,
+               (alloc - b->stack_alloc) * sizeof(*pool));
+        b->pool = pool;
+        b->stack_alloc = alloc;
+    }
+
+    if (!f) {
+        if (!b->pool[b->depth]) {
+            b->pool[b->depth] = calloc(1, sizeof(frame_t));
+            if (!b->pool[b->depth]) {
+                return -ENOMEM;
+            }
+        }
+        f = b->pool[b->depth];
+    }
+
+    b->stack[b->depth++] = f;
+    return 0;
+}
+
+static int new_node(bct_builder_t *b, frame_t *f, uint8_t type)
+{
+    int retval;
+
+    if (b->next_id == UINT32_MAX) {
+        return -EFBIG;
+    }
+
+    memset(&f->record, 0, sizeof(f->record));
+    f->record.header.type = type;
+    f->size = bpt_node_size(type);
+    f->id = b->next_id;
+    f->key_valid = 0;
+    f->count = 0;
+    f->tree = NULL;
+
+    retval = builder_reserve(b, f->size, &f->offset);
+    if (retval) {
+        return retval;
+    }
+
+    b->next_id++;
+    put_be32(f->record.header.node_id, f->id);
+    return 0;
+}
+
+static int open_tree(bct_builder_t *b, const bct_event_t *ev)
+{
+    const char *name = ev->argv[0].s;
+    tree_t *trees;
+    tree_t *t;
+    uint32_t alloc;
+    uint32_t i;
+    int retval;
+
+    if (b->depth) {
+        return builder_error(b, "trees cannot be nested");
+    }
+
+    if (ev->argv[0].kind != BCT_VALUE_STR || !name[0]) {
+        return builder_error(b, "tree name must be a string");
+    }
+
+    /* A tree may be continued in any number of blocks */
+    for (i = 0; i < b->tree_count; i++) {
+        if (strcmp(b->trees[i].name, name) == 0) {
+            return push_frame(b, &b->trees[i].root);
+        }
+    }
+
+    if (b->tree_count == UINT16_MAX) {
+        return builder_error(b, "too many trees");
+    }
+
+    if (b->tree_count == b->tree_alloc) {
+        alloc = b->tree_alloc ? b->tree_alloc * 2 : 8;
+        trees = realloc(b->trees, alloc * sizeof(*trees));
+        if (!trees) {
+            return -ENOMEM;
+        }
+
+        /* The root frames moved, and no tree is open */
+        b->trees = trees;
+        b->tree_alloc = alloc;
+    }
+
+    t = &b->trees[b->tree_count];
+    memset(t, 0, sizeof(*t));
+    t->name = strdup(name);
+    if (!t->name) {
+        return -ENOMEM;
+    }
+
+    retval = builder_reserve(b, sizeof(bpt_mode_header_t), &t->header_offset);
+    if (!retval) {
+        retval = new_node(b, &t->root, BPT_NODE_TYPE_ROOT);
+    }
+    if (retval) {
+        free(t->name);
+        return retval;
+    }
+
+    b->tree_count++;
+    t->root.tree = t;
+    t->root.key = bct_profile_tree_key(name);
+    t->root.key_valid = 1;
+    return push_frame(b, &t->root);
+}
+
+static int check_index(bct_builder_t *b, const bct_value_t *v, uint8_t *index)
+{
+    if (v->kind != BCT_VALUE_INT || v->i < 0 || v->i >= PARSER_MAX_PARAMS) {
+        return builder_error(b, "position must be an integer from 0 to %d",
+                             PARSER_MAX_PARAMS - 1);
+    }
+
+    put_be32(index, v->i);
+    return 0;
+}
+
+static int open_node(bct_builder_t *b, const bct_event_t *ev)
+{
+    const bct_value_t *argv = ev->argv;
+    frame_t *parent;
+    frame_t *f;
+    uint32_t formats;
+    uint32_t action;
+    size_t len;
+    int retval;
+
+    if (!b->depth) {
+        return builder_error(b, "%s must be inside a tree",
+                             bct_command_name(ev->command));
+    }
+
+    parent = b->stack[b->depth - 1];
+    if (parent->record.header.type == BPT_NODE_TYPE_EOL) {
+        return builder_error(b, "action nodes cannot have children");
+    }
+
+    retval = push_frame(b, NULL);
+    if (retval) {
+        return retval;
+    }
+    f = b->stack[b->depth - 1];
+    b->stats.nodes_defined++;
+
+    switch (ev->command) {
+    case BCT_CMD_KEYWORD:
+        len = strlen(argv[0].s);
+        if (argv[0].kind != BCT_VALUE_STR || len == 0 ||
+            len >= KEYWORD_LENGTH_MAX || strpbrk(argv[0].s, " \t\n")) {
+            return builder_error(b, "keyword must be a string of 1 to %d "
+                                 "characters without spaces",
+                                 KEYWORD_LENGTH_MAX - 1);
+        }
+
+        retval = new_node(b, f, BPT_NODE_TYPE_KEYWORD);
+        if (!retval) {
+            memcpy(f->record.keyword.keyword, argv[0].s, len);
+        }
+        return retval;
+
+    case BCT_CMD_INTEGER:
+        retval = new_node(b, f, BPT_NODE_TYPE_INTEGER);
+        if (!retval) {
+            put_be64(f->record.integer.minimum, (uint64_t)INT64_MIN);
+            put_be64(f->record.integer.maximum, INT64_MAX);
+            put_be32(f->record.integer.formats, INTEGER_FORMAT_DEC |
+                     INTEGER_FORMAT_HEX | INTEGER_FORMAT_OCT);
+            retval = check_index(b, &argv[0], f->record.integer.index);
+        }
+        return retval;
+
+    case BCT_CMD_NUMBER:
+        retval = new_node(b, f, BPT_NODE_TYPE_DOUBLE);
+        if (!retval) {
+            put_be_double(f->record.number.minimum, -DBL_MAX);
+            put_be_double(f->record.number.maximum, DBL_MAX);
+            retval = check_index(b, &argv[0], f->record.number.index);
+        }
+        return retval;
+
+    case BCT_CMD_STRING:
+        retval = new_node(b, f, BPT_NODE_TYPE_STRING);
+        return retval ? retval : check_index(b, &argv[0],
+                                             f->record.string.index);
+
+    case BCT_CMD_IP:
+    case BCT_CMD_MAC:
+        formats = ADDRESS_FORMAT_MAC;
+        if (ev->command == BCT_CMD_IP) {
+            if (argv[0].kind == BCT_VALUE_WORD && !strcmp(argv[0].s, "IP4")) {
+                formats = ADDRESS_FORMAT_IPV4;
+            } else if (argv[0].kind == BCT_VALUE_WORD &&
+                       !strcmp(argv[0].s, "IP6")) {
+                formats = ADDRESS_FORMAT_IPV6;
+            } else if (argv[0].kind == BCT_VALUE_WORD &&
+                       !strcmp(argv[0].s, "IP")) {
+                formats = ADDRESS_FORMAT_IPV4 | ADDRESS_FORMAT_IPV6;
+            } else {
+                return builder_error(b, "address family must be IP4, IP6 "
+                                     "or IP");
+            }
+            argv++;
+        }
+
+        retval = new_node(b, f, BPT_NODE_TYPE_ADDRESS);
+        if (!retval) {
+            put_be32(f->record.address.formats, formats);
+            retval = check_index(b, &argv[0], f->record.address.index);
+        }
+        return retval;
+
+    case BCT_CMD_ACTION:
+        if (argv[0].kind == BCT_VALUE_WORD && !strcmp(argv[0].s, "SYSCALL")) {
+            action = BPT_ACTION_SYSCALL;
+        } else if (argv[0].kind == BCT_VALUE_WORD &&
+                   !strcmp(argv[0].s, "LIBCALL")) {
+            action = BPT_ACTION_LIBCALL;
+        } else if (argv[0].kind == BCT_VALUE_WORD &&
+                   !strcmp(argv[0].s, "INTERNAL")) {
+            action = BPT_ACTION_INTERNAL;
+        } else {
+            return builder_error(b, "action type must be SYSCALL, LIBCALL "
+                                 "or INTERNAL");
+        }
+
+        if (argv[1].kind != BCT_VALUE_STR ||
+            strlen(argv[1].s) >= BPT_ACTION_LENGTH) {
+            return builder_error(b, "action must be a string of less than %d "
+                                 "characters", BPT_ACTION_LENGTH);
+        }
+
+        retval = new_node(b, f, BPT_NODE_TYPE_EOL);
+        if (!retval) {
+            put_be32(f->record.eol.action_type, action);
+            strcpy(f->record.eol.action, argv[1].s);
+        }
+        return retval;
+
+    default:
+        return builder_error(b, "%s nodes are not supported yet",
+                             bct_command_name(ev->command));
+    }
+}
+
+static int set_range(bct_builder_t *b, frame_t *f, const bct_value_t *argv)
+{
+    int64_t imin = INT64_MIN;
+    int64_t imax = INT64_MAX;
+    double dmin = -DBL_MAX;
+    double dmax = DBL_MAX;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (argv[i].kind == BCT_VALUE_WORD &&
+            !strcmp(argv[i].s, i ? "MAX" : "MIN")) {
+            continue;
+        }
+
+        if (argv[i].kind == BCT_VALUE_INT) {
+            *(i ? &imax : &imin) = argv[i].i;
+            *(i ? &dmax : &dmin) = argv[i].d;
+        } else if (argv[i].kind == BCT_VALUE_NUM &&
+                   f->record.header.type == BPT_NODE_TYPE_DOUBLE) {
+            *(i ? &dmax : &dmin) = argv[i].d;
+        } else {
+            return builder_error(b, "range %s must be a %s or %s",
+                                 i ? "maximum" : "minimum",
+                                 f->record.header.type == BPT_NODE_TYPE_DOUBLE ?
+                                 "number" : "integer", i ? "MAX" : "MIN");
+        }
+    }
+
+    if (f->record.header.type == BPT_NODE_TYPE_INTEGER) {
+        if (imin > imax) {
+            return builder_error(b, "range minimum exceeds the maximum");
+        }
+        put_be64(f->record.integer.minimum, (uint64_t)imin);
+        put_be64(f->record.integer.maximum, (uint64_t)imax);
+    } else {
+        if (dmin > dmax) {
+            return builder_error(b, "range minimum exceeds the maximum");
+        }
+        put_be_double(f->record.number.minimum, dmin);
+        put_be_double(f->record.number.maximum, dmax);
+    }
+    return 0;
+}
+
+static int set_value(bct_builder_t *b, frame_t *f, const bct_value_t *argv)
+{
+    bpt_node_keyword_t *kw = &f->record.keyword;
+    uint8_t flags = PARSER_NODE_KW_FLAG_SET_VALUE;
+    int retval;
+
+    if (kw->header.node_flags & PARSER_NODE_KW_FLAG_SET_VALUE) {
+        return builder_error(b, "keyword already sets a value");
+    }
+
+    if (argv[0].kind != BCT_VALUE_WORD) {
+        return builder_error(b, "set type must be BIT, INT or STR");
+    }
+
+    retval = check_index(b, &argv[1], kw->index);
+    if (retval) {
+        return retval;
+    }
+
+    if (!strcmp(argv[0].s, "BIT")) {
+        if (argv[2].kind != BCT_VALUE_INT || argv[2].i < 0 || argv[2].i > 63) {
+            return builder_error(b, "bit must be an integer from 0 to 63");
+        }
+        flags |= PARSER_NODE_KW_FLAG_SET_BIT;
+        put_be64(kw->value, argv[2].i);
+    } else if (!strcmp(argv[0].s, "INT")) {
+        if (argv[2].kind != BCT_VALUE_INT) {
+            return builder_error(b, "value must be an integer");
+        }
+        put_be64(kw->value, (uint64_t)argv[2].i);
+    } else if (!strcmp(argv[0].s, "STR")) {
+        if (argv[2].kind != BCT_VALUE_STR ||
+            strlen(argv[2].s) >= STRING_LENGTH_MAX) {
+            return builder_error(b, "value must be a string of less than %d "
+                                 "characters", STRING_LENGTH_MAX);
+        }
+        flags |= PARSER_NODE_KW_FLAG_SET_STRING;
+        strcpy(kw->string, argv[2].s);
+    } else {
+        /* Keyword nodes have nowhere to hold the other types */
+        return builder_error(b, "set %s is not supported by keyword nodes",
+                             argv[0].s);
+    }
+
+    kw->header.node_flags |= flags;
+    return 0;
+}
+
+static int set_string(bct_builder_t *b, const bct_value_t *v, char *field,
+                      size_t size, const char *what)
+{
+    if (v->kind != BCT_VALUE_STR || strlen(v->s) >= size) {
+        return builder_error(b, "%s must be a string of less than %zu "
+                             "characters", what, size);
+    }
+
+    strncpy(field, v->s, size);
+    return 0;
+}
+
+static int set_tree_attr(bct_builder_t *b, tree_t *t, const bct_event_t *ev)
+{
+    const bct_value_t *v = &ev->argv[0];
+
+    switch (ev->command) {
+    case BCT_CMD_PROMPT:
+        return set_string(b, v, t->format, sizeof(t->format), "prompt");
+
+    case BCT_CMD_PARENT:
+        if (v->kind != BCT_VALUE_STR || !strcmp(v->s, t->name)) {
+            return builder_error(b, "parent must name another tree");
+        }
+        if (t->parent && strcmp(t->parent, v->s)) {
+            return builder_error(b, "tree \"%s\" already has parent \"%s\"",
+                                 t->name, t->parent);
+        }
+        if (!t->parent && !(t->parent = strdup(v->s))) {
+            return -ENOMEM;
+        }
+        return 0;
+
+    default:
+        return builder_error(b, "%s is not valid in a tree",
+                             bct_command_name(ev->command));
+    }
+}
+
+static int set_attr(bct_builder_t *b, const bct_event_t *ev)
+{
+    const bct_value_t *argv = ev->argv;
+    bpt_node_header_t *hdr;
+    frame_t *f;
+    uint16_t flags;
+    uint8_t type;
+
+    if (!b->depth) {
+        if (ev->command != BCT_CMD_PROMPT) {
+            return builder_error(b, "%s must be inside a node",
+                                 bct_command_name(ev->command));
+        }
+        return set_string(b, &argv[0], b->prompt, sizeof(b->prompt),
+                          "prompt command");
+    }
+
+    f = b->stack[b->depth - 1];
+    if (f->tree) {
+        return set_tree_attr(b, f->tree, ev);
+    }
+
+    hdr = &f->record.header;
+    type = hdr->type;
+    flags = bpt_be16(hdr->flags);
+    switch (ev->command) {
+    case BCT_CMD_HELP:
+        return set_string(b, &argv[0], hdr->help_text, HELP_TEXT_LENGTH,
+                          "help");
+
+    case BCT_CMD_HIDDEN:
+        put_be16(hdr->flags, flags | PARSER_NODE_FLAG_HIDDEN);
+        return 0;
+
+    case BCT_CMD_PRIVILEGE:
+        if (argv[0].kind != BCT_VALUE_INT || argv[0].i < 0 ||
+            argv[0].i > PARSER_NODE_FLAG_PRIVILEGE_MASK) {
+            return builder_error(b, "privilege must be an integer from 0 "
+                                 "to %d", PARSER_NODE_FLAG_PRIVILEGE_MASK);
+        }
+        flags &= ~PARSER_NODE_FLAG_PRIVILEGE_MASK;
+        put_be16(hdr->flags, flags | argv[0].i);
+        return 0;
+
+    case BCT_CMD_SET:
+        if (type != BPT_NODE_TYPE_KEYWORD) {
+            break;
+        }
+        return set_value(b, f, argv);
+
+    case BCT_CMD_MINMATCH:
+        if (type != BPT_NODE_TYPE_KEYWORD) {
+            break;
+        }
+        if (argv[0].kind != BCT_VALUE_INT || argv[0].i < 0 ||
+            argv[0].i > (int64_t)strlen(f->record.keyword.keyword)) {
+            return builder_error(b, "minmatch must be an integer from 0 to "
+                                 "the length of the keyword");
+        }
+        put_be32(f->record.keyword.minimum_match, argv[0].i);
+        return 0;
+
+    case BCT_CMD_RANGE:
+        if (type != BPT_NODE_TYPE_INTEGER && type != BPT_NODE_TYPE_DOUBLE) {
+            break;
+        }
+        return set_range(b, f, argv);
+
+    case BCT_CMD_PREFIX:
+        if (type != BPT_NODE_TYPE_ADDRESS ||
+            (bpt_be32(f->record.address.formats) & ADDRESS_FORMAT_MAC)) {
+            break;
+        }
+        put_be32(f->record.address.formats,
+                 bpt_be32(f->record.address.formats) | ADDRESS_FORMAT_PREFIX);
+        return 0;
+
+    default:
+        break;
+    }
+
+    return builder_error(b, "%s is not valid in this node",
+                         bct_command_name(ev->command));
+}
+
+static int close_frame(bct_builder_t *b)
+{
+    frame_t *f;
+    frame_t *parent;
+    uint64_t count = 0;
+    uint32_t child;
+    int retval;
+
+    if (!b->depth) {
+        return builder_error(b, "unexpected end of block");
+    }
+
+    /* Trees are finished with the file, since they may be continued */
+    f = b->stack[b->depth - 1];
+    if (f->tree) {
+        b->depth--;
+        return 0;
+    }
+
+    retval = link_children(b, f, 1, &child);
+    if (retval) {
+        return retval;
+    }
+
+    put_be32(f->record.header.child_id, child);
+    retval = builder_write(b, f->offset, &f->record, f->size);
+    if (retval) {
+        return retval;
+    }
+
+    if (b->profile) {
+        count = bct_profile_count(b->profile, frame_key(b, b->depth - 1));
+    }
+
+    parent = b->stack[b->depth - 2];
+    retval = add_child(b, parent, f, count);
+    b->depth--;
+    return retval;
+}
+
+int bct_builder_event(bct_builder_t *builder, const bct_event_t *ev)
+{
+    switch (ev->kind) {
+    case BCT_EVENT_OPEN:
+        if (ev->command == BCT_CMD_TREE) {
+            return open_tree(builder, ev);
+        }
+        return open_node(builder, ev);
+
+    case BCT_EVENT_ATTR:
+        return set_attr(builder, ev);
+
+    case BCT_EVENT_CLOSE:
+        return close_frame(builder);
+
+    default:
+        return -EINVAL;
+    }
+}
+
+/*********************************************************************
+ * Setup and indexes
+ *********************************************************************/
+int bct_builder_create(const char *output, uint32_t share_table,
+                       const bct_profile_t *profile, bct_builder_t **builder)
+{
+    bct_builder_t *b;
+    uint32_t size = 1;
+    uint32_t offset;
+
+    if (!output || !builder) {
+        return -EINVAL;
+    }
+
+    while (size < share_table && size < (1u << 31)) {
+        size <<= 1;
+    }
+
+    b = calloc(1, sizeof(*b));
+    if (!b) {
+        return -ENOMEM;
+    }
+
+    b->fd = -1;
+    b->profile = profile;
+    b->next_id = 1;
+    b->share_mask = size - 1;
+    b->output = strdup(output);
+    b->buf = malloc(BUILDER_BUFFER_SIZE);
+    b->share = calloc(size, sizeof(*b->share));
+    b->temp = malloc(strlen(output) + sizeof(".XXXXXX"));
+    if (b->temp) {
+        sprintf(b->temp, "%s.XXXXXX", output);
+    }
+
+    if (!b->output || !b->buf || !b->share || !b->temp) {
+        bct_builder_destroy(&b);
+        return -ENOMEM;
+    }
+
+    b->fd = mkstemp(b->temp);
+    if (b->fd < 0) {
+        int retval = -errno;
+
+        free(b->temp);
+        b->temp = NULL;
+        bct_builder_destroy(&b);
+        return retval;
+    }
+    fchmod(b->fd, 0644);
+
+    builder_reserve(b, sizeof(bpt_file_header_t), &offset);
+    *builder = b;
+    return 0;
+}
+
+static int finish_tree(bct_builder_t *b, uint32_t index)
+{
+    tree_t *t = &b->trees[index];
+    bpt_mode_header_t hdr;
+    uint32_t parent = 0;
+    uint32_t child;
+    uint32_t i;
+    int retval;
+
+    if (t->parent) {
+        for (i = 0; i < b->tree_count; i++) {
+            if (!strcmp(b->trees[i].name, t->parent)) {
+                break;
+            }
+        }
+
+        if (i == b->tree_count) {
+            return builder_error(b, "tree \"%s\" has undefined parent \"%s\"",
+                                 t->name, t->parent);
+        }
+        parent = i + 1;
+    }
+
+    /* Nothing follows a root in the file, so there is nothing to cut off */
+    retval = link_children(b, &t->root, 0, &child);
+    if (retval) {
+        return retval;
+    }
+
+    put_be32(t->root.record.header.child_id, child);
+    retval = builder_write(b, t->root.offset, &t->root.record, t->root.size);
+    if (retval) {
+        return retval;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    put_be16(hdr.mode_id, index + 1);
+    put_be16(hdr.parent_mode_id, parent);
+    put_be32(hdr.root_node_id, t->root.id);
+    memcpy(hdr.format_string, t->format, sizeof(hdr.format_string));
+    return builder_write(b, t->header_offset, &hdr, sizeof(hdr));
+}
+
+/*
+ * The nodes are laid out in order of NodeID, so the node table is written
+ * by reading the records back in order, skipping the mode headers.
+ */
+static int write_node_table(bct_builder_t *b, uint64_t nodes_end)
+{
+    static uint8_t chunk[SCAN_CHUNK_SIZE];
+    bpt_node_header_t hdr;
+    uint64_t chunk_start = 0;
+    uint32_t chunk_len = 0;
+    uint64_t pos = sizeof(bpt_file_header_t);
+    uint32_t tree = 0;
+    uint32_t id = 1;
+    uint8_t entry[4] = { 0 };
+    size_t len;
+    int retval;
+
+    retval = builder_append(b, entry, sizeof(entry));
+
+    while (!retval && pos < nodes_end) {
+        if (tree < b->tree_count && pos == b->trees[tree].header_offset) {
+            pos += sizeof(bpt_mode_header_t);
+            tree++;
+            continue;
+        }
+
+        if (pos < chunk_start || pos + sizeof(hdr) > chunk_start + chunk_len) {
+            len = nodes_end - pos < SCAN_CHUNK_SIZE ? nodes_end - pos :
+                                                      SCAN_CHUNK_SIZE;
+            if (len < sizeof(hdr)) {
+                return -EIO;
+            }
+
+            retval = builder_read(b, pos, chunk, len);
+            if (retval) {
+                return retval;
+            }
+            chunk_start = pos;
+            chunk_len = len;
+        }
+
+        memcpy(&hdr, chunk + (pos - chunk_start), sizeof(hdr));
+        if (bpt_be32(hdr.node_id) != id) {
+            return -EIO;
+        }
+
+        put_be32(entry, pos);
+        retval = builder_append(b, entry, sizeof(entry));
+        pos += bpt_node_size(hdr.type);
+        id++;
+    }
+
+    return retval ? retval : (id == b->next_id ? 0 : -EIO);
+}
+
+int bct_builder_finish(bct_builder_t *builder, bct_build_stats_t *stats)
+{
+    bct_builder_t *b = builder;
+    bpt_file_header_t hdr;
+    bpt_index_trailer_t trailer;
+    uint64_t nodes_end;
+    uint32_t mode_table;
+    uint32_t node_table;
+    uint8_t entry[4];
+    uint32_t i;
+    int retval = 0;
+
+    if (b->depth) {
+        return builder_error(b, "unexpected end of input");
+    }
+
+    if (!b->tree_count) {
+        return builder_error(b, "no trees are defined");
+    }
+
+    for (i = 0; !retval && i < b->tree_count; i++) {
+        retval = finish_tree(b, i);
+    }
+    if (retval) {
+        return retval;
+    }
+
+    nodes_end = b->end;
+    mode_table = b->end;
+    memset(entry, 0, sizeof(entry));
+    retval = builder_append(b, entry, sizeof(entry));
+    for (i = 0; !retval && i < b->tree_count; i++) {
+        put_be32(entry, b->trees[i].header_offset);
+        retval = builder_append(b, entry, sizeof(entry));
+    }
+
+    node_table = b->end;
+    if (!retval) {
+        retval = builder_flush(b);
+    }
+    if (!retval) {
+        retval = write_node_table(b, nodes_end);
+    }
+
+    memset(&trailer, 0, sizeof(trailer));
+    memcpy(trailer.magic, BPT_INDEX_MAGIC, sizeof(trailer.magic));
+    put_be32(trailer.mode_table, mode_table);
+    put_be32(trailer.node_table, node_table);
+    if (!retval) {
+        retval = builder_append(b, &trailer, sizeof(trailer));
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BPT_MAGIC, sizeof(BPT_MAGIC));
+    hdr.version = BPT_VERSION;
+    put_be16(hdr.max_modes, b->tree_count);
+    put_be32(hdr.max_nodes, b->next_id - 1);
+    memcpy(hdr.prompt_command, b->prompt, sizeof(hdr.prompt_command));
+    if (!retval) {
+        retval = builder_write(b, 0, &hdr, sizeof(hdr));
+    }
+
+    if (!retval) {
+        retval = builder_flush(b);
+    }
+    if (!retval && ftruncate(b->fd, b->end) < 0) {
+        retval = -errno;
+    }
+    if (!retval && close(b->fd) < 0) {
+        retval = -errno;
+    }
+    b->fd = -1;
+    if (!retval && rename(b->temp, b->output) < 0) {
+        retval = -errno;
+    }
+    if (retval) {
+        return retval;
+    }
+
+    b->finished = 1;
+    b->stats.max_nodes = b->next_id - 1;
+    b->stats.max_modes = b->tree_count;
+    b->stats.size = b->end;
+    if (stats) {
+        *stats = b->stats;
+    }
+    return 0;
+}
+
+void bct_builder_destroy(bct_builder_t **builder)
+{
+    bct_builder_t *b;
+    uint32_t i;
+
+    if (!builder || !*builder) {
+        return;
+    }
+
+    b = *builder;
+    if (b->fd >= 0) {
+        close(b->fd);
+    }
+    if (b->temp && !b->finished) {
+        unlink(b->temp);
+    }
+
+    for (i = 0; i < b->tree_count; i++) {
+        free(b->trees[i].name);
+        free(b->trees[i].parent);
+        free(b->trees[i].root.children);
+    }
+
+    for (i = 0; b->pool && i < b->stack_alloc; i++) {
+        if (b->pool[i]) {
+            free(b->pool[i]->children);
+            free(b->pool[i]);
+        }
+    }
+
+    free(b->trees);
+    free(b->stack);
+    free(b->pool);
+    free(b->share);
+    free(b->buf);
+    free(b->temp);
+    free(b->output);
+    free(b);
+    *builder = NULL;
+}
@@ -0,0 +1,313 @@
+/****************************************************************************
+ * Binary Parse Tree compiler cache
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "bct_cache.h"
+
+#define BCT_CACHE_MAGIC     "BCTC"
+#define BCT_CACHE_VERSION   1
+
+typedef struct cache_header_s {
+    char magic[4];
+    uint32_t version;
+    bct_cache_key_t key;
+
+    /* Length of the path that follows, which tells apart hash collisions */
+    uint32_t path_len;
+} cache_header_t;
+
+struct bct_cache_writer_s {
+    FILE *fp;
+    char *temp;
+    char *path;
+};
+
+/* Entries are named after a hash of the path of their source file */
+static char * cache_path(const char *dir, const char *path, const char *suffix)
+{
+    size_t len = strlen(dir) + strlen(suffix) + 18;
+    char *name = malloc(len);
+
+    if (name) {
+        snprintf(name, len, "%s/%016llx%s", dir,
+                 (unsigned long long)bct_hash(BCT_HASH_INIT, path, strlen(path)),
+                 suffix);
+    }
+    return name;
+}
+
+int bct_cache_open(const char *dir, const char *path, const bct_cache_key_t *key,
+                   FILE **reader)
+{
+    cache_header_t hdr;
+    char buf[BCT_TEXT_MAX];
+    char *name;
+    size_t len = strlen(path);
+    FILE *fp;
+
+    name = cache_path(dir, path, ".bcc");
+    if (!name) {
+        return -ENOMEM;
+    }
+
+    fp = fopen(name, "r");
+    free(name);
+    if (!fp) {
+        return errno == ENOENT ? -ENOENT : -errno;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, BCT_CACHE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != BCT_CACHE_VERSION ||
+        memcmp(&hdr.key, key, sizeof(*key)) != 0 ||
+        hdr.path_len != len ||
+        fread(buf, 1, len, fp) != len || memcmp(buf, path, len) != 0) {
+        fclose(fp);
+        return -ENOENT;
+    }
+
+    *reader = fp;
+    return 0;
+}
+
+static int read_all(FILE *fp, void *data, size_t len)
+{
+    return fread(data, 1, len, fp) == len ? 0 : -EPROTO;
+}
+
+static int read_string(FILE *fp, char *s)
+{
+    uint32_t len;
+
+    if (read_all(fp, &len, sizeof(len)) || len >= BCT_TEXT_MAX ||
+        read_all(fp, s, len)) {
+        return -EPROTO;
+    }
+
+    s[len] = '\0';
+    return 0;
+}
+
+int bct_cache_read(FILE *reader, bct_event_t *ev)
+{
+    bct_value_t *v;
+    uint8_t hdr[3];
+    uint8_t i;
+    int c;
+
+    c = getc(reader);
+    if (c == EOF) {
+        return 0;
+    }
+
+    hdr[0] = c;
+    if (read_all(reader, hdr + 1, 2) ||
+        read_all(reader, &ev->line, sizeof(ev->line)) || hdr[2] > BCT_ARGS_MAX) {
+        return -EPROTO;
+    }
+
+    ev->kind = hdr[0];
+    ev->command = hdr[1];
+    ev->argc = hdr[2];
+    for (i = 0; i < ev->argc; i++) {
+        v = &ev->argv[i];
+        if (read_all(reader, &v->kind, sizeof(v->kind)) ||
+            read_all(reader, &v->i, sizeof(v->i)) ||
+            read_all(reader, &v->d, sizeof(v->d)) ||
+            read_string(reader, v->s)) {
+            return -EPROTO;
+        }
+    }
+
+    if (ev->kind == BCT_EVENT_IMPORT) {
+        if (read_all(reader, &ev->state, sizeof(ev->state)) ||
+            read_all(reader, &ev->offset, sizeof(ev->offset)) ||
+            read_string(reader, ev->nest) || strlen(ev->nest) > BCT_NEST_MAX) {
+            return -EPROTO;
+        }
+    }
+
+    return 1;
+}
+
+int bct_cache_create(const char *dir, const char *path,
+                     const bct_cache_key_t *key, bct_cache_writer_t **writer)
+{
+    bct_cache_writer_t *w;
+    cache_header_t hdr;
+    int retval = -ENOMEM;
+    int fd;
+
+    w = calloc(1, sizeof(*w));
+    if (!w) {
+        return -ENOMEM;
+    }
+
+    w->temp = cache_path(dir, path, ".XXXXXX");
+    w->path = cache_path(dir, path, ".bcc");
+    if (!w->temp || !w->path) {
+        goto fail;
+    }
+
+    fd = mkstemp(w->temp);
+    if (fd < 0) {
+        retval = -errno;
+        free(w->temp);
+        w->temp = NULL;
+        goto fail;
+    }
+
+    w->fp = fdopen(fd, "w");
+    if (!w->fp) {
+        retval = -errno;
+        close(fd);
+        goto fail;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BCT_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = BCT_CACHE_VERSION;
+    hdr.key = *key;
+    hdr.path_len = strlen(path);
+    if (fwrite(&hdr, sizeof(hdr), 1, w->fp) != 1 ||
+        fwrite(path, 1, hdr.path_len, w->fp) != hdr.path_len) {
+        retval = -EIO;
+        goto fail;
+    }
+
+    *writer = w;
+    return 0;
+
+fail:
+    bct_cache_abort(&w);
+    return retval;
+}
+
+static void write_string(FILE *fp, const char *s)
+{
+    uint32_t len = strlen(s);
+
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(s, 1, len, fp);
+}
+
+int bct_cache_write(bct_cache_writer_t *writer, const bct_event_t *ev)
+{
+    const bct_value_t *v;
+    uint8_t hdr[3] = { ev->kind, ev->command, ev->argc };
+    FILE *fp = writer->fp;
+    uint8_t i;
+
+    /* Errors are sticky, and checked when the entry is committed */
+    fwrite(hdr, sizeof(hdr), 1, fp);
+    fwrite(&ev->line, sizeof(ev->line), 1, fp);
+    for (i = 0; i < ev->argc; i++) {
+        v = &ev->argv[i];
+        fwrite(&v->kind, sizeof(v->kind), 1, fp);
+        fwrite(&v->i, sizeof(v->i), 1, fp);
+        fwrite(&v->d, sizeof(v->d), 1, fp);
+        write_string(fp, v->s);
+    }
+
+    if (ev->kind == BCT_EVENT_IMPORT) {
+        fwrite(&ev->state, sizeof(ev->state), 1, fp);
+        fwrite(&ev->offset, sizeof(ev->offset), 1, fp);
+        write_string(fp, ev->nest);
+    }
+
+    return ferror(fp) ? -EIO : 0;
+}
+
+int bct_cache_copy(bct_cache_writer_t *writer, FILE *reader, long from,
+                   long to)
+{
+    char buf[BUFSIZ];
+    size_t len;
+
+    if (fseek(reader, from, SEEK_SET)) {
+        return -errno;
+    }
+
+    while (from < to) {
+        len = (size_t)(to - from) < sizeof(buf) ? (size_t)(to - from) :
+                                                  sizeof(buf);
+        if (fread(buf, 1, len, reader) != len ||
+            fwrite(buf, 1, len, writer->fp) != len) {
+            return -EIO;
+        }
+        from += len;
+    }
+
+    return 0;
+}
+
+int bct_cache_commit(bct_cache_writer_t **writer)
+{
+    bct_cache_writer_t *w = *writer;
+    int retval = 0;
+
+    if (ferror(w->fp)) {
+        retval = -EIO;
+    }
+    if (fclose(w->fp) && !retval) {
+        retval = -errno;
+    }
+    w->fp = NULL;
+
+    if (!retval && rename(w->temp, w->path) < 0) {
+        retval = -errno;
+    }
+
+    if (!retval) {
+        free(w->temp);
+        w->temp = NULL;
+    }
+
+    bct_cache_abort(writer);
+    return retval;
+}
+
+void bct_cache_abort(bct_cache_writer_t **writer)
+{
+    bct_cache_writer_t *w;
+
+    if (!writer || !*writer) {
+        return;
+    }
+
+    w = *writer;
+    if (w->fp) {
+        fclose(w->fp);
+    }
+    if (w->temp) {
+        unlink(w->temp);
+    }
+
+    free(w->temp);
+    free(w->path);
+    free(w);
+    *writer = NULL;
+}
@@ -0,0 +1,532 @@
+/****************************************************************************
+ * Binary Parse Tree compiler driver
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Each file is either replayed from its cache entry or parsed. A cache
+ * entry holds the events of one file only, and each import in it records
+ * the state of the definitions after the imported file. Replaying an entry
+ * compiles each import in turn, which may itself be parsed, and only if an
+ * import now resolves to another file or leaves different definitions is
+ * the rest of the importing file parsed again, starting just after the
+ * import. A change to one file thus only causes that file to be parsed.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bct_compile.h"
+#include "bct_builder.h"
+#include "bct_cache.h"
+
+typedef struct define_s {
+    char *name;
+    uint8_t kind;
+    int64_t i;
+    double d;
+    char *s;
+} define_t;
+
+typedef struct compiler_s {
+    const bct_options_t *opts;
+    bct_builder_t *builder;
+
+    /* Open addressed table of definitions */
+    define_t *defines;
+    uint32_t define_mask;
+    uint32_t define_count;
+
+    /* Hash of every definition made so far, in order */
+    uint64_t state;
+
+    /* Hash of the options that change how files are read */
+    uint64_t options;
+
+    /* Value returned by a lookup */
+    bct_value_t value;
+
+    /* Files being compiled, to catch import loops */
+    const char *files[BCT_IMPORT_MAX];
+    uint32_t depth;
+
+    uint64_t parsed;
+    uint64_t replayed;
+} compiler_t;
+
+static bct_event_t * event_alloc(void)
+{
+    return malloc(sizeof(bct_event_t));
+}
+
+/*********************************************************************
+ * Definitions
+ *********************************************************************/
+static define_t * define_slot(const compiler_t *cc, const char *name)
+{
+    uint32_t i = bct_hash(BCT_HASH_INIT, name, strlen(name)) & cc->define_mask;
+
+    while (cc->defines[i].name && strcmp(cc->defines[i].name, name)) {
+        i = (i + 1) & cc->define_mask;
+    }
+    return &cc->defines[i];
+}
+
+static const bct_value_t * define_lookup(void *context, const char *name)
+{
+    compiler_t *cc = context;
+    define_t *d = define_slot(cc, name);
+
+    if (!d->name) {
+        return NULL;
+    }
+
+    cc->value.kind = d->kind;
+    cc->value.i = d->i;
+    cc->value.d = d->d;
+    strcpy(cc->value.s, d->s);
+    return &cc->value;
+}
+
+static int define_set(compiler_t *cc, const bct_event_t *ev)
+{
+    const bct_value_t *name = &ev->argv[0];
+    const bct_value_t *value = &ev->argv[1];
+    define_t *defines = cc->defines;
+    uint32_t size = cc->define_mask + 1;
+    define_t *d;
+    char *s;
+    uint32_t i;
+
+    if ((cc->define_count + 1) * 2 > size) {
+        cc->defines = calloc(size * 2, sizeof(*defines));
+        if (!cc->defines) {
+            cc->defines = defines;
+            return -ENOMEM;
+        }
+
+        cc->define_mask = size * 2 - 1;
+        for (i = 0; i < size; i++) {
+            if (defines[i].name) {
+                *define_slot(cc, defines[i].name) = defines[i];
+            }
+        }
+        free(defines);
+    }
+
+    s = strdup(value->s);
+    if (!s) {
+        return -ENOMEM;
+    }
+
+    d = define_slot(cc, name->s);
+    if (!d->name) {
+        d->name = strdup(name->s);
+        if (!d->name) {
+            free(s);
+            return -ENOMEM;
+        }
+        cc->define_count++;
+    }
+
+    free(d->s);
+    d->s = s;
+    d->kind = value->kind;
+    d->i = value->i;
+    d->d = value->d;
+
+    /* Later files depend on every definition, including redefinitions */
+    cc->state = bct_hash(cc->state, name->s, strlen(name->s) + 1);
+    cc->state = bct_hash(cc->state, &d->kind, sizeof(d->kind));
+    cc->state = bct_hash(cc->state, &d->i, sizeof(d->i));
+    cc->state = bct_hash(cc->state, &d->d, sizeof(d->d));
+    cc->state = bct_hash(cc->state, s, strlen(s) + 1);
+    return 0;
+}
+
+/*********************************************************************
+ * Files
+ *********************************************************************/
+static int try_import(const char *dir, const char *name, char *resolved)
+{
+    char path[BCT_TEXT_MAX];
+    struct stat st;
+
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        return 0;
+    }
+
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+           realpath(path, resolved) != NULL;
+}
+
+/* Find an import relative to the importing file, then the -I directories */
+static int resolve_import(compiler_t *cc, const char *from, const char *name,
+                          char *resolved)
+{
+    char dir[BCT_TEXT_MAX];
+    uint32_t i;
+
+    if (name[0] == '/') {
+        return realpath(name, resolved) ? 0 : -ENOENT;
+    }
+
+    strcpy(dir, from);
+    if (try_import(dirname(dir), name, resolved)) {
+        return 0;
+    }
+
+    for (i = 0; i < cc->opts->include_count; i++) {
+        if (try_import(cc->opts->include_dirs[i], name, resolved)) {
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+static int compile_file(compiler_t *cc, const char *path);
+
+/* Pass an event to the builder, and report any error in the input */
+static int build_event(compiler_t *cc, const char *path, const bct_event_t *ev)
+{
+    int retval = bct_builder_event(cc->builder, ev);
+
+    if (retval == -EINVAL) {
+        fprintf(stderr, "%s:%u: %s\n", path, ev->line,
+                bct_builder_error(cc->builder));
+    } else if (retval) {
+        fprintf(stderr, "%s:%u: %s\n", path, ev->line, strerror(-retval));
+    }
+    return retval;
+}
+
+/* Compile an import, and fill in where it resolved to and what it left */
+static int import_file(compiler_t *cc, const char *path, bct_event_t *ev)
+{
+    char resolved[BCT_TEXT_MAX];
+    int retval;
+
+    if (ev->argv[0].kind != BCT_VALUE_STR) {
+        fprintf(stderr, "%s:%u: import must be given a string\n", path,
+                ev->line);
+        return -EINVAL;
+    }
+
+    retval = resolve_import(cc, path, ev->argv[0].s, resolved);
+    if (retval) {
+        fprintf(stderr, "%s:%u: cannot find import \"%s\"\n", path, ev->line,
+                ev->argv[0].s);
+        return retval;
+    }
+
+    retval = compile_file(cc, resolved);
+    if (retval) {
+        return retval;
+    }
+
+    ev->argc = 2;
+    ev->argv[1].kind = BCT_VALUE_STR;
+    strcpy(ev->argv[1].s, resolved);
+    ev->state = cc->state;
+    return 0;
+}
+
+/* Parse a file from an offset, adding its events to the cache entry */
+static int parse_file(compiler_t *cc, const char *path, const bct_event_t *from,
+                      bct_cache_writer_t *writer)
+{
+    bct_source_t src;
+    bct_event_t *ev;
+    int retval;
+
+    ev = event_alloc();
+    if (!ev) {
+        return -ENOMEM;
+    }
+
+    retval = bct_source_open(&src, path, from ? from->offset : 0,
+                             from ? from->line : 1, from ? from->nest : NULL);
+    if (retval) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-retval));
+        free(ev);
+        return retval;
+    }
+
+    src.lookup = define_lookup;
+    src.context = cc;
+    cc->parsed++;
+
+    while ((retval = bct_source_next(&src, ev)) > 0) {
+        switch (ev->kind) {
+        case BCT_EVENT_DEFINE:
+            retval = define_set(cc, ev);
+            break;
+
+        case BCT_EVENT_IMPORT:
+            retval = import_file(cc, path, ev);
+            break;
+
+        default:
+            retval = build_event(cc, path, ev);
+            break;
+        }
+
+        if (!retval && writer) {
+            retval = bct_cache_write(writer, ev);
+        }
+
+        if (retval) {
+            break;
+        }
+    }
+
+    bct_source_close(&src);
+    free(ev);
+    return retval;
+}
+
+/*
+ * Replay a cache entry, and if an import has changed what it leaves behind,
+ * parse the rest of the file and write a new entry.
+ */
+static int replay_file(compiler_t *cc, const char *path, FILE *reader,
+                       const bct_cache_key_t *key)
+{
+    bct_cache_writer_t *writer = NULL;
+    char recorded[BCT_TEXT_MAX];
+    bct_event_t *ev;
+    uint64_t state;
+    long first;
+    long start;
+    int changed = 0;
+    int retval;
+
+    ev = event_alloc();
+    if (!ev) {
+        return -ENOMEM;
+    }
+
+    first = ftell(reader);
+    for (;;) {
+        start = ftell(reader);
+        retval = bct_cache_read(reader, ev);
+        if (retval <= 0) {
+            break;
+        }
+
+        if (ev->kind == BCT_EVENT_DEFINE) {
+            retval = define_set(cc, ev);
+        } else if (ev->kind != BCT_EVENT_IMPORT) {
+            retval = build_event(cc, path, ev);
+        } else {
+            strcpy(recorded, ev->argv[1].s);
+            state = ev->state;
+            retval = import_file(cc, path, ev);
+            if (!retval && (strcmp(recorded, ev->argv[1].s) ||
+                            state != ev->state)) {
+                changed = 1;
+                break;
+            }
+        }
+
+        if (retval) {
+            break;
+        }
+    }
+
+    if (retval == -EPROTO) {
+        fprintf(stderr, "%s: cache entry is damaged, remove it from %s\n",
+                path, cc->opts->cache_dir);
+    } else if (changed) {
+        /* Keep the events up to the import, then read the rest again */
+        retval = bct_cache_create(cc->opts->cache_dir, path, key, &writer);
+        if (!retval) {
+            retval = bct_cache_copy(writer, reader, first, start);
+        }
+        if (!retval) {
+            retval = bct_cache_write(writer, ev);
+        }
+        if (!retval) {
+            retval = parse_file(cc, path, ev, writer);
+        }
+        if (!retval) {
+            retval = bct_cache_commit(&writer);
+        }
+        bct_cache_abort(&writer);
+    } else if (!retval) {
+        cc->replayed++;
+    }
+
+    free(ev);
+    return retval;
+}
+
+static int compile_file(compiler_t *cc, const char *path)
+{
+    const char *dir = cc->opts->cache_dir;
+    bct_cache_writer_t *writer = NULL;
+    bct_cache_key_t key;
+    struct stat st;
+    FILE *reader;
+    uint32_t i;
+    int retval;
+
+    for (i = 0; i < cc->depth; i++) {
+        if (strcmp(cc->files[i], path) == 0) {
+            fprintf(stderr, "%s: imports itself\n", path);
+            return -ELOOP;
+        }
+    }
+
+    if (cc->depth == BCT_IMPORT_MAX) {
+        fprintf(stderr, "%s: imports nested too deeply\n", path);
+        return -ELOOP;
+    }
+
+    if (stat(path, &st) < 0) {
+        retval = -errno;
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return retval;
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.ino = st.st_ino;
+    key.size = st.st_size;
+    key.mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    key.options = cc->options;
+    key.state = cc->state;
+
+    cc->files[cc->depth++] = path;
+    if (dir && bct_cache_open(dir, path, &key, &reader) == 0) {
+        retval = replay_file(cc, path, reader, &key);
+        fclose(reader);
+    } else {
+        /* Without a usable cache, the file is still compiled */
+        if (dir && bct_cache_create(dir, path, &key, &writer)) {
+            writer = NULL;
+        }
+
+        retval = parse_file(cc, path, NULL, writer);
+        if (!retval && writer) {
+            retval = bct_cache_commit(&writer);
+        }
+        bct_cache_abort(&writer);
+    }
+    cc->depth--;
+
+    return retval;
+}
+
+int bct_compile(const bct_options_t *opts, const char *input)
+{
+    compiler_t cc;
+    bct_profile_t *profile = NULL;
+    bct_build_stats_t stats;
+    char path[BCT_TEXT_MAX];
+    uint32_t i;
+    int retval;
+
+    if (!opts || !opts->output || !input) {
+        return -EINVAL;
+    }
+
+    memset(&cc, 0, sizeof(cc));
+    cc.opts = opts;
+    cc.state = BCT_HASH_INIT;
+    cc.define_mask = 63;
+    cc.defines = calloc(cc.define_mask + 1, sizeof(*cc.defines));
+    if (!cc.defines) {
+        return -ENOMEM;
+    }
+
+    /* Imports resolve differently with other include directories */
+    cc.options = BCT_HASH_INIT;
+    for (i = 0; i < opts->include_count; i++) {
+        cc.options = bct_hash(cc.options, opts->include_dirs[i],
+                              strlen(opts->include_dirs[i]) + 1);
+    }
+
+    if (opts->cache_dir && mkdir(opts->cache_dir, 0755) < 0 &&
+        errno != EEXIST) {
+        retval = -errno;
+        fprintf(stderr, "%s: %s\n", opts->cache_dir, strerror(errno));
+        goto out;
+    }
+
+    if (opts->profile) {
+        retval = bct_profile_load(opts->profile, &profile);
+        if (retval) {
+            fprintf(stderr, "%s: %s\n", opts->profile, retval == -EPROTO ?
+                    "not a profile" : strerror(-retval));
+            goto out;
+        }
+    }
+
+    retval = bct_builder_create(opts->output, opts->share_table ?
+                                opts->share_table : BCT_SHARE_TABLE_DEFAULT,
+                                profile, &cc.builder);
+    if (retval) {
+        fprintf(stderr, "%s: %s\n", opts->output, strerror(-retval));
+        goto out;
+    }
+
+    if (!realpath(input, path)) {
+        retval = -errno;
+        fprintf(stderr, "%s: %s\n", input, strerror(errno));
+        goto out;
+    }
+
+    retval = compile_file(&cc, path);
+    if (retval) {
+        goto out;
+    }
+
+    retval = bct_builder_finish(cc.builder, &stats);
+    if (retval) {
+        fprintf(stderr, "%s: %s\n", input, retval == -EINVAL ?
+                bct_builder_error(cc.builder) : strerror(-retval));
+        goto out;
+    }
+
+    if (opts->verbose) {
+        fprintf(stderr, "%s: %u trees, %u nodes from %llu defined "
+                "(%llu shared), %llu bytes\n", opts->output, stats.max_modes,
+                stats.max_nodes, (unsigned long long)stats.nodes_defined,
+                (unsigned long long)stats.nodes_shared,
+                (unsigned long long)stats.size);
+        fprintf(stderr, "%s: %llu files parsed, %llu replayed from the cache\n",
+                opts->output, (unsigned long long)cc.parsed,
+                (unsigned long long)cc.replayed);
+    }
+
+out:
+    bct_builder_destroy(&cc.builder);
+    bct_profile_free(&profile);
+    for (i = 0; i <= cc.define_mask; i++) {
+        free(cc.defines[i].name);
+        free(cc.defines[i].s);
+    }
+    free(cc.defines);
+    return retval;
+}
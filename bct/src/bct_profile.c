@@ -0,0 +1,178 @@
+/****************************************************************************
+ * Binary Parse Tree compiler profile reader
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bct_builder.h"
+
+typedef struct profile_entry_s {
+    uint64_t key;
+    uint64_t count;
+} profile_entry_t;
+
+/* Open addressed table of counts, with a key of zero marking a free slot */
+struct bct_profile_s {
+    profile_entry_t *entries;
+    uint32_t mask;
+    uint32_t used;
+};
+
+uint64_t bct_profile_tree_key(const char *tree)
+{
+    return bct_hash(bct_hash(BCT_HASH_INIT, tree, strlen(tree)), "\n", 1);
+}
+
+uint64_t bct_profile_node_key(uint64_t key, int first, const char *label)
+{
+    if (!first) {
+        key = bct_hash(key, " ", 1);
+    }
+    return bct_hash(key, label, strlen(label));
+}
+
+static profile_entry_t * profile_slot(const bct_profile_t *profile, uint64_t key)
+{
+    uint32_t i;
+
+    key = key ? key : 1;
+    i = (uint32_t)(key ^ (key >> 32)) & profile->mask;
+    while (profile->entries[i].key && profile->entries[i].key != key) {
+        i = (i + 1) & profile->mask;
+    }
+    return &profile->entries[i];
+}
+
+static int profile_add(bct_profile_t *profile, uint64_t key, uint64_t count)
+{
+    profile_entry_t *entries = profile->entries;
+    uint32_t size = profile->mask + 1;
+    profile_entry_t *slot;
+    uint32_t i;
+
+    if ((profile->used + 1) * 2 > size) {
+        profile->entries = calloc(size * 2, sizeof(*entries));
+        if (!profile->entries) {
+            profile->entries = entries;
+            return -ENOMEM;
+        }
+
+        profile->mask = size * 2 - 1;
+        for (i = 0; i < size; i++) {
+            if (entries[i].key) {
+                *profile_slot(profile, entries[i].key) = entries[i];
+            }
+        }
+        free(entries);
+    }
+
+    slot = profile_slot(profile, key);
+    if (!slot->key) {
+        slot->key = key ? key : 1;
+        profile->used++;
+    }
+    slot->count += count;
+    return 0;
+}
+
+int bct_profile_load(const char *path, bct_profile_t **profile)
+{
+    bct_profile_t *prof;
+    char *line = NULL;
+    size_t alloc = 0;
+    ssize_t len;
+    uint64_t tree = 0;
+    uint64_t count;
+    char *text;
+    char *end;
+    int retval = 0;
+    FILE *fp;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -errno;
+    }
+
+    prof = calloc(1, sizeof(*prof));
+    if (!prof || !(prof->entries = calloc(64, sizeof(*prof->entries)))) {
+        free(prof);
+        fclose(fp);
+        return -ENOMEM;
+    }
+    prof->mask = 63;
+
+    while (!retval && (len = getline(&line, &alloc, fp)) >= 0) {
+        if (len && line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+
+        if (strncmp(line, "tree \"", 6) == 0 && line[len - 1] == '"') {
+            line[len - 1] = '\0';
+            tree = bct_profile_tree_key(line + 6);
+            continue;
+        }
+
+        /* The command is hashed whole, as the nodes fold their labels */
+        count = strtoull(line, &end, 10);
+        if (end == line || *end != ' ' || !tree) {
+            retval = -EPROTO;
+            break;
+        }
+
+        text = end + 1;
+        retval = profile_add(prof, bct_hash(tree, text, line + len - text),
+                             count);
+    }
+
+    free(line);
+    fclose(fp);
+    if (retval) {
+        bct_profile_free(&prof);
+        return retval;
+    }
+
+    *profile = prof;
+    return 0;
+}
+
+void bct_profile_free(bct_profile_t **profile)
+{
+    if (profile && *profile) {
+        free((*profile)->entries);
+        free(*profile);
+        *profile = NULL;
+    }
+}
+
+uint64_t bct_profile_count(const bct_profile_t *profile, uint64_t key)
+{
+    if (!profile) {
+        return 0;
+    }
+
+    return profile_slot(profile, key)->count;
+}
@@ -0,0 +1,545 @@
+/****************************************************************************
+ * Binary Parse Tree compiler source reader
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bct_compile.h"
+#include "parser_value.h"
+
+enum token_type_e {
+    TOKEN_EOF = 0,
+    TOKEN_IDENT,
+    TOKEN_SYMBOL,
+    TOKEN_STRING,
+    TOKEN_NUMBER,
+    TOKEN_PUNCT,
+};
+
+typedef struct token_s {
+    int type;
+    uint32_t len;
+    char text[BCT_TEXT_MAX];
+} token_t;
+
+/* Commands, with the event they produce and the number of arguments */
+static const struct {
+    const char *name;
+    uint8_t kind;
+    uint8_t argc;
+} commands[BCT_CMD_MAX] = {
+    [BCT_CMD_TREE]      = { "tree",      BCT_EVENT_OPEN,   1 },
+    [BCT_CMD_KEYWORD]   = { "keyword",   BCT_EVENT_OPEN,   1 },
+    [BCT_CMD_INTEGER]   = { "integer",   BCT_EVENT_OPEN,   1 },
+    [BCT_CMD_NUMBER]    = { "number",    BCT_EVENT_OPEN,   1 },
+    [BCT_CMD_STRING]    = { "string",    BCT_EVENT_OPEN,   1 },
+    [BCT_CMD_IP]        = { "ip",        BCT_EVENT_OPEN,   2 },
+    [BCT_CMD_MAC]       = { "mac",       BCT_EVENT_OPEN,   1 },
+    [BCT_CMD_CONSTANT]  = { "constant",  BCT_EVENT_OPEN,   3 },
+    [BCT_CMD_ACTION]    = { "action",    BCT_EVENT_OPEN,   2 },
+    [BCT_CMD_SET]       = { "set",       BCT_EVENT_ATTR,   3 },
+    [BCT_CMD_RANGE]     = { "range",     BCT_EVENT_ATTR,   2 },
+    [BCT_CMD_PREFIX]    = { "prefix",    BCT_EVENT_ATTR,   0 },
+    [BCT_CMD_MINMATCH]  = { "minmatch",  BCT_EVENT_ATTR,   1 },
+    [BCT_CMD_HELP]      = { "help",      BCT_EVENT_ATTR,   1 },
+    [BCT_CMD_HIDDEN]    = { "hidden",    BCT_EVENT_ATTR,   0 },
+    [BCT_CMD_PRIVILEGE] = { "privilege", BCT_EVENT_ATTR,   1 },
+    [BCT_CMD_PARENT]    = { "parent",    BCT_EVENT_ATTR,   1 },
+    [BCT_CMD_PROMPT]    = { "prompt",    BCT_EVENT_ATTR,   1 },
+    [BCT_CMD_IMPORT]    = { "import",    BCT_EVENT_IMPORT, 1 },
+    [BCT_CMD_DEFINE]    = { "define",    BCT_EVENT_DEFINE, 2 },
+};
+
+const char * bct_command_name(uint8_t command)
+{
+    if (command >= BCT_CMD_MAX || !commands[command].name) {
+        return "?";
+    }
+
+    return commands[command].name;
+}
+
+static int source_error(bct_source_t *src, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "%s:%u: ", src->path, src->line);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    return -EINVAL;
+}
+
+static int src_getc(bct_source_t *src)
+{
+    int c = getc(src->fp);
+
+    if (c != EOF) {
+        src->offset++;
+        if (c == '\n') {
+            src->line++;
+        }
+    }
+    return c;
+}
+
+static void src_ungetc(bct_source_t *src, int c)
+{
+    if (c != EOF) {
+        ungetc(c, src->fp);
+        src->offset--;
+        if (c == '\n') {
+            src->line--;
+        }
+    }
+}
+
+static int is_ident_start(int c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int is_ident(int c)
+{
+    return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static int is_number(int c)
+{
+    return is_ident(c) || c == '.' || c == '+' || c == '-';
+}
+
+/* Skip whitespace and comments, and return the next character unread */
+static int skip_space(bct_source_t *src)
+{
+    int c;
+
+    for (;;) {
+        c = src_getc(src);
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = src_getc(src);
+            }
+        }
+
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            src_ungetc(src, c);
+            return c;
+        }
+    }
+}
+
+static int append(bct_source_t *src, token_t *tok, int c)
+{
+    if (tok->len + 1 >= sizeof(tok->text)) {
+        return source_error(src, "token too long");
+    }
+
+    tok->text[tok->len++] = c;
+    tok->text[tok->len] = '\0';
+    return 0;
+}
+
+static int read_string(bct_source_t *src, token_t *tok, int quote)
+{
+    int retval;
+    int c;
+
+    for (;;) {
+        c = src_getc(src);
+        if (c == EOF) {
+            return source_error(src, "unterminated string");
+        }
+
+        if (c == quote) {
+            return 0;
+        }
+
+        /* Single quoted strings only escape the quote and backslash */
+        if (c == '\\') {
+            c = src_getc(src);
+            if (quote == '"' && c == 'n') {
+                c = '\n';
+            } else if (quote == '"' && c == 't') {
+                c = '\t';
+            } else if (c != quote && c != '\\') {
+                if (c == EOF) {
+                    return source_error(src, "unterminated string");
+                }
+                if (quote == '"') {
+                    return source_error(src, "unknown escape \\%c", c);
+                }
+                retval = append(src, tok, '\\');
+                if (retval) {
+                    return retval;
+                }
+            }
+        }
+
+        retval = append(src, tok, c);
+        if (retval) {
+            return retval;
+        }
+    }
+}
+
+static int read_token(bct_source_t *src, token_t *tok)
+{
+    int retval;
+    int c;
+
+    tok->len = 0;
+    tok->text[0] = '\0';
+
+    c = skip_space(src);
+    src_getc(src);
+    if (c == EOF) {
+        tok->type = TOKEN_EOF;
+        return 0;
+    }
+
+    if (c == '"' || c == '\'') {
+        tok->type = TOKEN_STRING;
+        return read_string(src, tok, c);
+    }
+
+    if (c == '(' || c == ')' || c == '{' || c == '}' || c == ',') {
+        tok->type = TOKEN_PUNCT;
+        return append(src, tok, c);
+    }
+
+    if (c == ':' || is_ident_start(c)) {
+        tok->type = TOKEN_IDENT;
+        if (c == ':') {
+            tok->type = TOKEN_SYMBOL;
+            c = src_getc(src);
+            if (!is_ident_start(c)) {
+                return source_error(src, "expected a symbol name after ':'");
+            }
+        }
+
+        do {
+            retval = append(src, tok, c);
+            if (retval) {
+                return retval;
+            }
+            c = src_getc(src);
+        } while (is_ident(c));
+
+        src_ungetc(src, c);
+        return 0;
+    }
+
+    if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') {
+        tok->type = TOKEN_NUMBER;
+        do {
+            retval = append(src, tok, c);
+            if (retval) {
+                return retval;
+            }
+            c = src_getc(src);
+        } while (is_number(c));
+
+        src_ungetc(src, c);
+        return 0;
+    }
+
+    return source_error(src, "unexpected character '%c'", c);
+}
+
+/* Check for the start of a block, and consume it if there is one */
+static int block_start(bct_source_t *src)
+{
+    uint64_t offset;
+    uint32_t line;
+    int c;
+
+    c = skip_space(src);
+    if (c == '{') {
+        src_getc(src);
+        return '}';
+    }
+
+    if (c != 'd') {
+        return 0;
+    }
+
+    offset = src->offset;
+    line = src->line;
+    src_getc(src);
+    if (src_getc(src) == 'o' && !is_ident(c = src_getc(src))) {
+        src_ungetc(src, c);
+        return 'e';
+    }
+
+    /* This is the next statement, so go back to its start */
+    if (fseek(src->fp, offset, SEEK_SET)) {
+        return -errno;
+    }
+    src->offset = offset;
+    src->line = line;
+    return 0;
+}
+
+static int read_value(bct_source_t *src, token_t *tok, bct_value_t *value,
+                      int is_name)
+{
+    const bct_value_t *def;
+    int64_t i;
+    double d;
+    int retval;
+
+    retval = read_token(src, tok);
+    if (retval) {
+        return retval;
+    }
+
+    memset(value, 0, offsetof(bct_value_t, s));
+    value->s[0] = '\0';
+
+    switch (tok->type) {
+    case TOKEN_STRING:
+        value->kind = BCT_VALUE_STR;
+        memcpy(value->s, tok->text, tok->len + 1);
+        return 0;
+
+    case TOKEN_NUMBER:
+        if (!parser_parse_integer(tok->text, tok->len, INTEGER_FORMAT_ALL, &i)) {
+            value->kind = BCT_VALUE_INT;
+            value->i = i;
+            value->d = (double)i;
+            return 0;
+        }
+
+        if (!parser_parse_number(tok->text, tok->len, &d)) {
+            value->kind = BCT_VALUE_NUM;
+            value->d = d;
+            return 0;
+        }
+
+        return source_error(src, "invalid number '%s'", tok->text);
+
+    case TOKEN_SYMBOL:
+    case TOKEN_IDENT:
+        if (is_name) {
+            if (tok->type != TOKEN_SYMBOL) {
+                return source_error(src, "expected a symbol, found '%s'",
+                                    tok->text);
+            }
+            value->kind = BCT_VALUE_WORD;
+            memcpy(value->s, tok->text, tok->len + 1);
+            return 0;
+        }
+
+        def = src->lookup(src->context, tok->text);
+        if (def) {
+            memcpy(value, def, offsetof(bct_value_t, s));
+            strcpy(value->s, def->s);
+            return 0;
+        }
+
+        if (tok->type == TOKEN_SYMBOL) {
+            return source_error(src, "undefined symbol :%s", tok->text);
+        }
+
+        value->kind = BCT_VALUE_WORD;
+        memcpy(value->s, tok->text, tok->len + 1);
+        return 0;
+
+    case TOKEN_EOF:
+        return source_error(src, "unexpected end of file");
+
+    default:
+        return source_error(src, "unexpected '%s'", tok->text);
+    }
+}
+
+static int expect_punct(bct_source_t *src, token_t *tok, char punct)
+{
+    int retval = read_token(src, tok);
+
+    if (retval) {
+        return retval;
+    }
+
+    if (tok->type != TOKEN_PUNCT || tok->text[0] != punct) {
+        return source_error(src, "expected '%c', found '%s'", punct,
+                            tok->type == TOKEN_EOF ? "end of file" : tok->text);
+    }
+    return 0;
+}
+
+static int read_args(bct_source_t *src, token_t *tok, bct_event_t *ev)
+{
+    int paren;
+    int retval;
+    uint8_t i;
+
+    paren = skip_space(src) == '(';
+    if (paren) {
+        src_getc(src);
+    }
+
+    for (i = 0; i < ev->argc; i++) {
+        if (i) {
+            retval = expect_punct(src, tok, ',');
+            if (retval) {
+                return retval;
+            }
+        }
+
+        retval = read_value(src, tok, &ev->argv[i],
+                            ev->command == BCT_CMD_DEFINE && i == 0);
+        if (retval) {
+            return retval;
+        }
+    }
+
+    return paren ? expect_punct(src, tok, ')') : 0;
+}
+
+int bct_source_open(bct_source_t *src, const char *path, uint64_t offset,
+                    uint32_t line, const char *nest)
+{
+    src->fp = fopen(path, "r");
+    if (!src->fp) {
+        return -errno;
+    }
+
+    if (offset && fseek(src->fp, offset, SEEK_SET)) {
+        fclose(src->fp);
+        src->fp = NULL;
+        return -errno;
+    }
+
+    src->path = path;
+    src->offset = offset;
+    src->line = line ? line : 1;
+    src->depth = nest ? strlen(nest) : 0;
+    if (src->depth > BCT_NEST_MAX) {
+        fclose(src->fp);
+        src->fp = NULL;
+        return -EINVAL;
+    }
+    memcpy(src->nest, nest ? nest : "", src->depth + 1);
+    src->close_pending = 0;
+    return 0;
+}
+
+void bct_source_close(bct_source_t *src)
+{
+    if (src->fp) {
+        fclose(src->fp);
+        src->fp = NULL;
+    }
+}
+
+int bct_source_next(bct_source_t *src, bct_event_t *ev)
+{
+    static token_t tok;
+    uint8_t cmd;
+    int retval;
+    int block;
+
+    memset(ev, 0, offsetof(bct_event_t, argv));
+    if (src->close_pending) {
+        src->close_pending = 0;
+        ev->kind = BCT_EVENT_CLOSE;
+        ev->line = src->line;
+        return 1;
+    }
+
+    retval = read_token(src, &tok);
+    if (retval) {
+        return retval;
+    }
+
+    ev->line = src->line;
+    if (tok.type == TOKEN_EOF) {
+        if (src->depth) {
+            return source_error(src, "missing '%s' at end of file",
+                                src->nest[src->depth - 1] == 'e' ? "end" : "}");
+        }
+        return 0;
+    }
+
+    if ((tok.type == TOKEN_IDENT && strcmp(tok.text, "end") == 0) ||
+        (tok.type == TOKEN_PUNCT && tok.text[0] == '}')) {
+        if (!src->depth || src->nest[src->depth - 1] != tok.text[0]) {
+            return source_error(src, "unexpected '%s'", tok.text);
+        }
+        src->nest[--src->depth] = '\0';
+        ev->kind = BCT_EVENT_CLOSE;
+        return 1;
+    }
+
+    if (tok.type != TOKEN_IDENT) {
+        return source_error(src, "expected a command, found '%s'", tok.text);
+    }
+
+    for (cmd = BCT_CMD_NONE + 1; cmd < BCT_CMD_MAX; cmd++) {
+        if (strcmp(tok.text, commands[cmd].name) == 0) {
+            break;
+        }
+    }
+
+    if (cmd == BCT_CMD_MAX) {
+        return source_error(src, "unknown command '%s'", tok.text);
+    }
+
+    ev->kind = commands[cmd].kind;
+    ev->command = cmd;
+    ev->argc = commands[cmd].argc;
+    retval = read_args(src, &tok, ev);
+    if (retval) {
+        return retval;
+    }
+
+    if (ev->kind == BCT_EVENT_IMPORT) {
+        ev->offset = src->offset;
+        memcpy(ev->nest, src->nest, src->depth + 1);
+    }
+
+    if (ev->kind != BCT_EVENT_OPEN) {
+        return 1;
+    }
+
+    block = block_start(src);
+    if (block < 0) {
+        return block;
+    }
+
+    if (!block) {
+        src->close_pending = 1;
+    } else if (src->depth == BCT_NEST_MAX) {
+        return source_error(src, "blocks nested too deeply");
+    } else {
+        src->nest[src->depth++] = block;
+        src->nest[src->depth] = '\0';
+    }
+
+    return 1;
+}
@@ -0,0 +1,128 @@
+/****************************************************************************
+ * Binary Parse Tree compiler
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Compiles a tree description, as described in docs/compiler-format.md,
+ * into a BPT file. Build with:
+ *
+ *     cc -O2 -std=gnu99 -Ibct/include -Iparser/include bct/src/bctc.c \
+ *        bct/src/bct_builder.c bct/src/bct_cache.c bct/src/bct_compile.c \
+ *        bct/src/bct_profile.c bct/src/bct_source.c parser/src/parser*.c \
+ *        -o bctc
+ *
+ * Usage: bctc [-v] [-I dir]... [-P profile] [-C cachedir] [-S entries]
+ *             [-o output] input
+ *
+ *  -v  Print statistics about the output and the files read
+ *  -I  Directory to search for imports, after the importing file's own
+ *  -P  Profile to lay out the children of each node by
+ *  -C  Directory to cache parsed files in, so that only files that changed
+ *      are parsed again
+ *  -S  Entries in the table used to find identical subtrees (default 1M)
+ *  -o  Output file (default: the input with its extension replaced by .bpt)
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bct_compile.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-v] [-I dir]... [-P profile] [-C cachedir] "
+            "[-S entries] [-o output] input\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    bct_options_t opts;
+    char *output = NULL;
+    char *dot;
+    int retval;
+    int opt;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.include_dirs = calloc(argc, sizeof(*opts.include_dirs));
+    if (!opts.include_dirs) {
+        perror(argv[0]);
+        return 1;
+    }
+
+    while ((opt = getopt(argc, argv, "vI:P:C:S:o:")) != -1) {
+        switch (opt) {
+        case 'v':
+            opts.verbose = 1;
+            break;
+
+        case 'I':
+            opts.include_dirs[opts.include_count++] = optarg;
+            break;
+
+        case 'P':
+            opts.profile = optarg;
+            break;
+
+        case 'C':
+            opts.cache_dir = optarg;
+            break;
+
+        case 'S':
+            opts.share_table = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'o':
+            opts.output = optarg;
+            break;
+
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!opts.output) {
+        output = malloc(strlen(argv[optind]) + sizeof(".bpt"));
+        if (!output) {
+            perror(argv[0]);
+            return 1;
+        }
+
+        strcpy(output, argv[optind]);
+        dot = strrchr(output, '.');
+        if (dot && !strchr(dot, '/')) {
+            *dot = '\0';
+        }
+        strcat(output, ".bpt");
+        opts.output = output;
+    }
+
+    retval = bct_compile(&opts, argv[optind]);
+
+    free(output);
+    free(opts.include_dirs);
+    return retval ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+/****************************************************************************
+ * Binary Parse Tree snapshots
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "bpt_handle.h"
+
+/*
+ * A reader takes a reference to the current snapshot in three steps: it
+ * announces itself in the counter of the current phase, loads the pointer
+ * to the snapshot and increments its reference count, then withdraws the
+ * announcement. A writer replaces the pointer, then waits for the counters
+ * of both phases to drain before dropping the reference of the handle, so
+ * that any reader that loaded the old pointer is known to hold its own
+ * reference. The writer switches the phase before waiting for a counter,
+ * so that readers arriving meanwhile use the other one, and cannot delay
+ * the writer however busy the handle is.
+ */
+struct bpt_handle_s {
+    /** Current snapshot */
+    bpt_snapshot_t *current;
+
+    /** Readers in the middle of acquiring a snapshot, for each phase */
+    uint32_t acquiring[2];
+
+    /** Phase that readers announce themselves in */
+    uint32_t phase;
+
+    /** Version of the current snapshot, readable without a reference */
+    uint64_t version;
+
+    /** Serializes writers */
+    pthread_mutex_t lock;
+};
+
+static bpt_snapshot_t * snapshot_new(bpt_image_t *image)
+{
+    bpt_snapshot_t *snapshot;
+
+    snapshot = calloc(1, sizeof(*snapshot));
+    if (snapshot) {
+        snapshot->image = image;
+        snapshot->refs = 1;
+    }
+
+    return snapshot;
+}
+
+void bpt_snapshot_release(const bpt_snapshot_t *snapshot)
+{
+    bpt_snapshot_t *s = (bpt_snapshot_t *)snapshot;
+    bpt_image_t *image;
+
+    if (!s) {
+        return;
+    }
+
+    if (__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        image = (bpt_image_t *)s->image;
+        bpt_close(&image);
+        free(s);
+    }
+}
+
+int bpt_handle_open(const char *path, bpt_handle_t **handle)
+{
+    bpt_handle_t *h;
+    bpt_image_t *image;
+    int retval;
+
+    if (!path || !handle) {
+        return -EINVAL;
+    }
+
+    retval = bpt_open(path, &image);
+    if (retval) {
+        return retval;
+    }
+
+    h = calloc(1, sizeof(*h));
+    if (!h) {
+        bpt_close(&image);
+        return -ENOMEM;
+    }
+
+    h->current = snapshot_new(image);
+    if (!h->current) {
+        bpt_close(&image);
+        free(h);
+        return -ENOMEM;
+    }
+
+    h->current->version = 1;
+    h->version = 1;
+    pthread_mutex_init(&h->lock, NULL);
+    *handle = h;
+    return 0;
+}
+
+void bpt_handle_close(bpt_handle_t **handle)
+{
+    bpt_handle_t *h;
+
+    if (!handle || !*handle) {
+        return;
+    }
+
+    h = *handle;
+    bpt_snapshot_release(h->current);
+    pthread_mutex_destroy(&h->lock);
+    free(h);
+    *handle = NULL;
+}
+
+int64_t bpt_handle_publish(bpt_handle_t *handle, bpt_image_t *image)
+{
+    bpt_snapshot_t *snapshot;
+    bpt_snapshot_t *old;
+    uint32_t phase;
+    int i;
+
+    if (!handle || !image) {
+        return -EINVAL;
+    }
+
+    snapshot = snapshot_new(image);
+    if (!snapshot) {
+        return -ENOMEM;
+    }
+
+    pthread_mutex_lock(&handle->lock);
+
+    old = handle->current;
+    snapshot->version = old->version + 1;
+    __atomic_store_n(&handle->current, snapshot, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&handle->version, snapshot->version, __ATOMIC_RELAXED);
+
+    /* A reader may have loaded the phase before the last switch, so the
+     * old pointer can be held under either counter.
+     */
+    for (i = 0; i < 2; i++) {
+        phase = handle->phase;
+        __atomic_store_n(&handle->phase, phase ^ 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&handle->acquiring[phase], __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+    }
+
+    pthread_mutex_unlock(&handle->lock);
+
+    bpt_snapshot_release(old);
+    return (int64_t)snapshot->version;
+}
+
+int64_t bpt_handle_reload(bpt_handle_t *handle, const char *path)
+{
+    bpt_image_t *image;
+    int64_t retval;
+
+    if (!handle || !path) {
+        return -EINVAL;
+    }
+
+    retval = bpt_open(path, &image);
+    if (retval) {
+        return retval;
+    }
+
+    retval = bpt_handle_publish(handle, image);
+    if (retval < 0) {
+        bpt_close(&image);
+    }
+
+    return retval;
+}
+
+uint64_t bpt_handle_version(const bpt_handle_t *handle)
+{
+    return __atomic_load_n(&handle->version, __ATOMIC_RELAXED);
+}
+
+const bpt_snapshot_t * bpt_snapshot_acquire(bpt_handle_t *handle)
+{
+    bpt_snapshot_t *snapshot;
+    uint32_t phase;
+
+    phase = __atomic_load_n(&handle->phase, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&handle->acquiring[phase], 1, __ATOMIC_SEQ_CST);
+
+    snapshot = __atomic_load_n(&handle->current, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&snapshot->refs, 1, __ATOMIC_RELAXED);
+
+    __atomic_sub_fetch(&handle->acquiring[phase], 1, __ATOMIC_RELEASE);
+    return snapshot;
+}
+
+const bpt_snapshot_t * bpt_snapshot_refresh(bpt_handle_t *handle,
+                                            const bpt_snapshot_t *snapshot)
+{
+    const bpt_snapshot_t *current;
+
+    if (snapshot &&
+        snapshot == __atomic_load_n(&handle->current, __ATOMIC_ACQUIRE)) {
+        return snapshot;
+    }
+
+    current = bpt_snapshot_acquire(handle);
+    bpt_snapshot_release(snapshot);
+    return current;
+}
@@ -0,0 +1,415 @@
+/****************************************************************************
+ * Binary Parse Tree memory mapped loader
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bpt.h"
+#include "parser_node_keyword.h"
+#include "parser_value.h"
+
+/* Check that a table of count 4-byte entries at offset lies in the file */
+static int table_fits(size_t size, uint32_t offset, uint32_t count)
+{
+    uint64_t end = (uint64_t)offset + ((uint64_t)count + 1) * 4;
+
+    return offset >= sizeof(bpt_file_header_t) && end <= size;
+}
+
+static int bpt_validate(bpt_image_t *img)
+{
+    const bpt_file_header_t *hdr;
+    const bpt_index_trailer_t *trailer;
+    uint32_t mode_table;
+    uint32_t node_table;
+
+    if (img->size < sizeof(*hdr) + sizeof(*trailer)) {
+        return -EPROTO;
+    }
+
+    hdr = (const bpt_file_header_t *)img->base;
+    if (memcmp(hdr->magic, BPT_MAGIC, sizeof(hdr->magic)) != 0) {
+        return -EPROTO;
+    }
+
+    if ((hdr->version >> 4) != BPT_VERSION_MAJOR) {
+        return -ENOTSUP;
+    }
+
+    /* Version 1.0 files have no index, and would have to be scanned */
+    if ((hdr->version & 0x0F) < BPT_VERSION_MINOR) {
+        return -ENOTSUP;
+    }
+
+    trailer = (const bpt_index_trailer_t *)(img->base + img->size -
+                                            sizeof(*trailer));
+    if (memcmp(trailer->magic, BPT_INDEX_MAGIC, sizeof(trailer->magic)) != 0) {
+        return -ENOTSUP;
+    }
+
+    img->max_modes = bpt_be16(hdr->max_modes);
+    img->max_nodes = bpt_be32(hdr->max_nodes);
+    mode_table = bpt_be32(trailer->mode_table);
+    node_table = bpt_be32(trailer->node_table);
+
+    if (!table_fits(img->size, mode_table, img->max_modes) ||
+        !table_fits(img->size, node_table, img->max_nodes)) {
+        return -EPROTO;
+    }
+
+    img->mode_table = img->base + mode_table;
+    img->node_table = img->base + node_table;
+    return 0;
+}
+
+int bpt_open(const char *path, bpt_image_t **image)
+{
+    bpt_image_t *img;
+    struct stat st;
+    void *map;
+    int retval;
+    int fd;
+
+    if (!path || !image) {
+        return -EINVAL;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        retval = -errno;
+        close(fd);
+        return retval;
+    }
+
+    if (st.st_size <= 0) {
+        close(fd);
+        return -EPROTO;
+    }
+
+    /*
+     * A shared read-only mapping lets every CLI process use the same page
+     * cache pages, and nothing is read until a node is first visited.
+     */
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    retval = -errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return retval;
+    }
+
+    img = calloc(1, sizeof(*img));
+    if (!img) {
+        munmap(map, st.st_size);
+        return -ENOMEM;
+    }
+
+    img->base = map;
+    img->size = st.st_size;
+
+    retval = bpt_validate(img);
+    if (retval) {
+        munmap(map, st.st_size);
+        free(img);
+        return retval;
+    }
+
+    *image = img;
+    return 0;
+}
+
+void bpt_close(bpt_image_t **image)
+{
+    if (image && *image) {
+        munmap((void *)(*image)->base, (*image)->size);
+        free(*image);
+        *image = NULL;
+    }
+}
+
+const char * bpt_get_prompt_command(const bpt_image_t *image)
+{
+    return ((const bpt_file_header_t *)image->base)->prompt_command;
+}
+
+const bpt_mode_header_t * bpt_get_mode(const bpt_image_t *image, uint32_t mode_id)
+{
+    uint32_t offset;
+
+    if (!image || mode_id == 0 || mode_id > image->max_modes) {
+        return NULL;
+    }
+
+    offset = bpt_be32(image->mode_table + mode_id * 4);
+    if (offset == 0 || (uint64_t)offset + sizeof(bpt_mode_header_t) > image->size) {
+        return NULL;
+    }
+
+    return (const bpt_mode_header_t *)(image->base + offset);
+}
+
+const bpt_node_header_t * bpt_get_node(const bpt_image_t *image, uint32_t node_id)
+{
+    const bpt_node_header_t *node;
+    uint32_t offset;
+
+    if (!image || node_id == 0 || node_id > image->max_nodes) {
+        return NULL;
+    }
+
+    offset = bpt_be32(image->node_table + node_id * 4);
+    if (offset == 0 || (uint64_t)offset + sizeof(*node) > image->size) {
+        return NULL;
+    }
+
+    node = (const bpt_node_header_t *)(image->base + offset);
+    if ((uint64_t)offset + bpt_node_size(node->type) > image->size) {
+        return NULL;
+    }
+
+    return node;
+}
+
+static void bpt_keyword_set_value(const bpt_node_keyword_t *kw, PARSER_CTRL *ctl)
+{
+    uint32_t index = bpt_be32(kw->index);
+    uint8_t flags = kw->header.node_flags;
+    int64_t value = (int64_t)bpt_be64(kw->value);
+
+    if (!(flags & PARSER_NODE_KW_FLAG_SET_VALUE)) {
+        return;
+    }
+
+    if (flags & PARSER_NODE_KW_FLAG_SET_BIT) {
+        parser_control_set_bit(ctl, index, value);
+    } else if (flags & PARSER_NODE_KW_FLAG_SET_STRING) {
+        /* The string in the file is not necessarily terminated */
+        parser_control_set_string_span(ctl, index, kw->string,
+                                       strnlen(kw->string, STRING_LENGTH_MAX));
+    } else {
+        parser_control_set_integer(ctl, index, &value);
+    }
+}
+
+/*
+ * Rank of the node types when more than one child accepts a token, in the
+ * order the parser tries its own node types. Types that never accept a
+ * token are not ranked.
+ */
+#define BPT_RANK_NONE   0xFF
+
+static const uint8_t bpt_type_rank[BPT_NODE_TYPE_MAX] = {
+    [BPT_NODE_TYPE_ROOT]        = BPT_RANK_NONE,
+    [BPT_NODE_TYPE_KEYWORD]     = 0,
+    [BPT_NODE_TYPE_INTEGER]     = 1,
+    [BPT_NODE_TYPE_DOUBLE]      = 2,
+    [BPT_NODE_TYPE_ADDRESS]     = 3,
+    [BPT_NODE_TYPE_STRING]      = 4,
+    [BPT_NODE_TYPE_CONSTANT]    = BPT_RANK_NONE,
+    [BPT_NODE_TYPE_CONDITIONAL] = BPT_RANK_NONE,
+    [BPT_NODE_TYPE_EOL]         = BPT_RANK_NONE,
+};
+
+/*
+ * Check whether a node accepts a token, and if ctl is not NULL, save the
+ * value the node sets into it.
+ */
+static int bpt_node_accepts(const bpt_node_header_t *node, const char *text,
+                            uint32_t len, PARSER_CTRL *ctl)
+{
+    const bpt_node_keyword_t *kw;
+    const bpt_node_integer_t *inode;
+    const bpt_node_double_t *dnode;
+    const bpt_node_address_t *anode;
+    parser_address_t addr;
+    int64_t ivalue;
+    double dvalue;
+
+    switch (node->type) {
+    case BPT_NODE_TYPE_KEYWORD:
+        kw = (const bpt_node_keyword_t *)node;
+        if (!parser_keyword_string_accepts(kw->keyword,
+                                           bpt_be32(kw->minimum_match),
+                                           text, len)) {
+            return 0;
+        }
+        if (ctl) {
+            bpt_keyword_set_value(kw, ctl);
+        }
+        return 1;
+
+    case BPT_NODE_TYPE_INTEGER:
+        inode = (const bpt_node_integer_t *)node;
+        if (parser_parse_integer(text, len, bpt_be32(inode->formats), &ivalue) ||
+            ivalue < (int64_t)bpt_be64(inode->minimum) ||
+            ivalue > (int64_t)bpt_be64(inode->maximum)) {
+            return 0;
+        }
+        if (ctl) {
+            parser_control_set_integer(ctl, bpt_be32(inode->index), &ivalue);
+        }
+        return 1;
+
+    case BPT_NODE_TYPE_DOUBLE:
+        dnode = (const bpt_node_double_t *)node;
+        if (parser_parse_number(text, len, &dvalue) ||
+            !(dvalue >= bpt_be_double(dnode->minimum)) ||
+            !(dvalue <= bpt_be_double(dnode->maximum))) {
+            return 0;
+        }
+        if (ctl) {
+            parser_control_set_number(ctl, bpt_be32(dnode->index), &dvalue);
+        }
+        return 1;
+
+    case BPT_NODE_TYPE_ADDRESS:
+        anode = (const bpt_node_address_t *)node;
+        if (parser_parse_address(text, len, bpt_be32(anode->formats), &addr)) {
+            return 0;
+        }
+        if (ctl) {
+            parser_control_set_address(ctl, bpt_be32(anode->index), &addr);
+        }
+        return 1;
+
+    case BPT_NODE_TYPE_STRING:
+        if (len >= PARSER_STRING_MAX) {
+            return 0;
+        }
+        if (ctl) {
+            /* The string is referenced in the command line, not copied */
+            parser_control_set_string_span(ctl,
+                bpt_be32(((const bpt_node_string_t *)node)->index), text, len);
+        }
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+int bpt_parse(const bpt_image_t *image, uint32_t mode_id, PARSER_CTRL *ctl,
+              uint32_t *eol_id)
+{
+    const bpt_mode_header_t *mode;
+    const bpt_node_header_t *node;
+    const bpt_node_header_t *child;
+    const bpt_node_header_t *found;
+    const parser_token_t *token;
+    const char *text;
+    uint32_t matches;
+    uint32_t probes;
+    uint32_t depth;
+    uint8_t rank;
+
+    if (!image || !ctl) {
+        return -EINVAL;
+    }
+
+    mode = bpt_get_mode(image, mode_id);
+    if (!mode) {
+        return -ENOENT;
+    }
+
+    node = bpt_get_node(image, bpt_be32(mode->root_node_id));
+    if (!node) {
+        return -EPROTO;
+    }
+
+    token = parser_control_token(ctl);
+    if (!token || ctl->command_line[token->offset] == '!' ||
+        ctl->command_line[token->offset] == '#') {
+        return PARSER_RESULT_EMPTY;
+    }
+
+    /*
+     * The file is not trusted, so a chain or path that is longer than the
+     * number of nodes in the file must have run into a loop.
+     */
+    for (depth = 0; (token = parser_control_token(ctl)); depth++) {
+        if (depth > image->max_nodes) {
+            return -EPROTO;
+        }
+
+        text = &ctl->command_line[token->offset];
+        found = NULL;
+        matches = 0;
+        rank = BPT_RANK_NONE;
+        probes = 0;
+        for (child = bpt_node_child(image, node); child;
+             child = bpt_node_sibling(image, child)) {
+            if (++probes > image->max_nodes) {
+                return -EPROTO;
+            }
+
+            if (child->type >= BPT_NODE_TYPE_MAX ||
+                bpt_type_rank[child->type] > rank ||
+                !bpt_node_accepts(child, text, token->len, NULL)) {
+                continue;
+            }
+
+            if (bpt_type_rank[child->type] < rank) {
+                rank = bpt_type_rank[child->type];
+                matches = 0;
+            }
+
+            found = child;
+            matches++;
+        }
+
+        if (matches > 1) {
+            return PARSER_RESULT_AMBIGUOUS;
+        }
+
+        if (!found) {
+            return PARSER_RESULT_UNRECOGNIZED;
+        }
+
+        bpt_node_accepts(found, text, token->len, ctl);
+        parser_control_advance(ctl, 1);
+        node = found;
+    }
+
+    probes = 0;
+    for (child = bpt_node_child(image, node); child;
+         child = bpt_node_sibling(image, child)) {
+        if (++probes > image->max_nodes) {
+            return -EPROTO;
+        }
+
+        if (child->type == BPT_NODE_TYPE_EOL) {
+            if (eol_id) {
+                *eol_id = bpt_be32(child->node_id);
+            }
+            return PARSER_RESULT_OK;
+        }
+    }
+
+    return PARSER_RESULT_INCOMPLETE;
+}
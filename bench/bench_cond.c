@@ -0,0 +1,174 @@
+/****************************************************************************
+ * Conditional node interpreter benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Measures the time taken to evaluate typical conditions. Build with:
+ *
+ *     cc -O2 -std=gnu99 -Iparser/include bench/bench_cond.c \
+ *        parser/src/parser_conditional.c parser/src/parser_arena.c \
+ *        parser/src/parser_control.c parser/src/parser_simd.c -o bench_cond
+ *
+ * Add -DPARSER_COND_NO_THREADING to measure the switch based dispatch.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "parser_conditional.h"
+
+#define PARAM(type, index)  (PARSER_COND_CLASS_PARAM | (type)), (index)
+#define OP(op)              (PARSER_COND_CLASS_OPERATOR | (op))
+#define CONST_INT(v)        (PARSER_COND_CLASS_CONSTANT | PARSER_COND_TYPE_INTEGER), \
+                            0, 0, 0, 0, 0, 0, 0, (v)
+
+typedef struct {
+    const char *name;
+    const uint8_t *code;
+    size_t len;
+    int expected;
+} bench_case;
+
+/* $int[0] == 5 */
+static const uint8_t int_eq[] = {
+    PARAM(PARSER_COND_TYPE_INTEGER, 0), CONST_INT(5), OP(PARSER_COND_OP_EQ),
+};
+
+/* $int[1] >= 10 && $int[1] <= 100 */
+static const uint8_t int_range[] = {
+    PARAM(PARSER_COND_TYPE_INTEGER, 1), CONST_INT(10), OP(PARSER_COND_OP_GE),
+    PARAM(PARSER_COND_TYPE_INTEGER, 1), CONST_INT(100), OP(PARSER_COND_OP_LE),
+    OP(PARSER_COND_OP_LAND),
+};
+
+/* ($int[2] & 4) != 0 || !$int[3] */
+static const uint8_t int_flags[] = {
+    PARAM(PARSER_COND_TYPE_INTEGER, 2), CONST_INT(4), OP(PARSER_COND_OP_BAND),
+    CONST_INT(0), OP(PARSER_COND_OP_NE),
+    PARAM(PARSER_COND_TYPE_INTEGER, 3), OP(PARSER_COND_OP_LNOT),
+    OP(PARSER_COND_OP_LOR),
+};
+
+/* $num[0] * 2 > $int[1] */
+static const uint8_t mixed[] = {
+    PARAM(PARSER_COND_TYPE_NUMBER, 0), CONST_INT(2), OP(PARSER_COND_OP_MUL),
+    PARAM(PARSER_COND_TYPE_INTEGER, 1), OP(PARSER_COND_OP_GT),
+};
+
+/* $str[0] == "ethernet" */
+static const uint8_t str_eq[] = {
+    PARAM(PARSER_COND_TYPE_STRING, 0),
+    PARSER_COND_CLASS_CONSTANT | PARSER_COND_TYPE_STRING, 8,
+    'e', 't', 'h', 'e', 'r', 'n', 'e', 't',
+    OP(PARSER_COND_OP_EQ),
+};
+
+static const bench_case cases[] = {
+    { "int_eq", int_eq, sizeof(int_eq), 1 },
+    { "int_range", int_range, sizeof(int_range), 1 },
+    { "int_flags", int_flags, sizeof(int_flags), 1 },
+    { "mixed", mixed, sizeof(mixed), 1 },
+    { "str_eq", str_eq, sizeof(str_eq), 1 },
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const parser_cond_program_t *program;
+    parser_arena_t arena;
+    PARSER_CTRL *ctl;
+    unsigned long iterations = 10000000;
+    unsigned long i;
+    double start;
+    double elapsed;
+    size_t c;
+    int64_t value;
+    double number;
+    int retval;
+    int sum;
+    int failed = 0;
+
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 0);
+    }
+
+    ctl = calloc(1, sizeof(*ctl));
+    if (!ctl) {
+        return 1;
+    }
+
+    parser_control_init(ctl, "", 0);
+    value = 5;
+    parser_control_set_integer(ctl, 0, &value);
+    value = 42;
+    parser_control_set_integer(ctl, 1, &value);
+    value = 6;
+    parser_control_set_integer(ctl, 2, &value);
+    number = 21.5;
+    parser_control_set_number(ctl, 0, &number);
+    parser_control_set_string(ctl, 0, "ethernet");
+
+    parser_arena_init(&arena, 0);
+
+    printf("%-12s %8s %12s\n", "condition", "insns", "ns/eval");
+    for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        retval = parser_cond_compile(cases[c].code, cases[c].len, &arena,
+                                     &program);
+        if (retval) {
+            fprintf(stderr, "%s: compile failed (%d)\n", cases[c].name, retval);
+            failed = 1;
+            continue;
+        }
+
+        if (parser_cond_eval(program, ctl) != cases[c].expected) {
+            fprintf(stderr, "%s: unexpected result\n", cases[c].name);
+            failed = 1;
+            continue;
+        }
+
+        /* Sum the results so the evaluation is not optimized away */
+        sum = 0;
+        start = now();
+        for (i = 0; i < iterations; i++) {
+            sum += parser_cond_eval(program, ctl);
+        }
+        elapsed = now() - start;
+
+        if ((unsigned long)sum != iterations * cases[c].expected) {
+            failed = 1;
+        }
+
+        printf("%-12s %8u %12.2f\n", cases[c].name, program->count,
+               elapsed * 1e9 / iterations);
+    }
+
+    parser_arena_destroy(&arena);
+    parser_control_destroy(ctl);
+    free(ctl);
+    return failed;
+}
@@ -0,0 +1,331 @@
+/****************************************************************************
+ * Output filter benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Generates the output of a large show command, and measures the time
+ * taken to filter it with several sets of filters, three ways: searching
+ * each line for each pattern with memmem, matching each line against each
+ * filter with regexec, and scanning the output with the automaton of the
+ * output filters. Checks that all three show the same lines. Build it
+ * with -O2, -I. and -Iparser/include, along with ciscli_filter.c.
+ *
+ * Usage: bench_filter [-m megabytes]
+ *
+ *  -m  Size of the output to filter (default 256)
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <regex.h>
+#include <unistd.h>
+
+#include "ciscli_private.h"
+
+#define STAGES_MAX          4
+#define ALTERNATIVES_MAX    32
+
+typedef enum {
+    STAGE_INCLUDE,
+    STAGE_EXCLUDE,
+} stage_kind;
+
+typedef struct {
+    stage_kind kind;
+    const char *alternatives[ALTERNATIVES_MAX];
+} bench_stage;
+
+typedef struct {
+    const char *name;
+    bench_stage stages[STAGES_MAX];
+} bench_scenario;
+
+static const bench_scenario scenarios[] = {
+    { "one", {
+        { STAGE_INCLUDE, { "eth7" } },
+    } },
+    { "several", {
+        { STAGE_INCLUDE, { "eth1", "eth3", "Loopback0", "Vlan100" } },
+        { STAGE_EXCLUDE, { "shutdown", "blocked" } },
+        { STAGE_EXCLUDE, { "tag red" } },
+    } },
+    { "many", {
+        { STAGE_INCLUDE, { "metric 17,", "metric 42,", "metric 57,",
+                           "metric 63,", "metric 88,", "metric 99,",
+                           "age 3h", "age 17h1", "age 22h45m", "eth8, metric 1",
+                           "tag blue, down", "eth7, metric 12", "eth2, metric 3",
+                           "eth5, metric 5", "Vlan4000", "Vlan1234",
+                           "Tunnel12", "Loopback0", "GigabitEthernet",
+                           "TenGigabitEthernet", "Port-channel", "Null0" } },
+        { STAGE_EXCLUDE, { "shutdown" } },
+    } },
+};
+
+static const char *const tags[] = { "red", "green", "blue", "none" };
+static const char *const states[] = { "up", "down", "shutdown", "blocked" };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fill a buffer with lines of a routing table, the last ending exactly at
+ * the end of the buffer */
+static size_t generate(char *buf, size_t size)
+{
+    char line[256];
+    size_t len = 0;
+    uint32_t i = 0;
+    int n;
+
+    for (;;) {
+        n = snprintf(line, sizeof(line),
+                     "route 10.%u.%u.0/24 via 192.168.%u.%u, eth%u, "
+                     "metric %u, age %uh%um, tag %s, %s\n",
+                     (i >> 8) % 17, i % 251, (i >> 4) % 8, i % 13, i % 9,
+                     i % 100, i % 24, i % 60, tags[i % 4],
+                     states[(i / 7) % 4]);
+        if (len + n > size) {
+            return len;
+        }
+
+        memcpy(buf + len, line, n);
+        len += n;
+        i++;
+
+        if (i % 1000 == 0) {
+            n = snprintf(line, sizeof(line),
+                         "interface %s%u is %s\n",
+                         i % 3000 ? "Vlan" : "Loopback", i % 4096,
+                         states[i % 4]);
+            if (len + n <= size) {
+                memcpy(buf + len, line, n);
+                len += n;
+            }
+        }
+    }
+}
+
+/* Build the filters of a scenario as they would be typed */
+static void scenario_spec(const bench_scenario *s, char *spec, size_t size)
+{
+    const bench_stage *stage;
+    size_t len = 0;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < STAGES_MAX && s->stages[i].alternatives[0]; i++) {
+        stage = &s->stages[i];
+        len += snprintf(spec + len, size - len, "%s| %s ", i ? " " : "",
+                        stage->kind == STAGE_INCLUDE ? "include" : "exclude");
+        for (j = 0; j < ALTERNATIVES_MAX && stage->alternatives[j]; j++) {
+            len += snprintf(spec + len, size - len, "%s%s", j ? "|" : "",
+                            stage->alternatives[j]);
+        }
+    }
+}
+
+/* Search each line for each alternative of each stage */
+static uint64_t filter_naive(const bench_scenario *s, const char *buf,
+                             size_t len)
+{
+    const bench_stage *stage;
+    const char *end = buf + len;
+    const char *nl;
+    uint64_t shown = 0;
+    size_t line_len;
+    uint32_t i;
+    uint32_t j;
+    int match;
+    int show;
+
+    for (; buf < end; buf = nl + 1) {
+        nl = memchr(buf, '\n', end - buf);
+        line_len = nl - buf;
+
+        show = 1;
+        for (i = 0; show && i < STAGES_MAX && s->stages[i].alternatives[0];
+             i++) {
+            stage = &s->stages[i];
+            match = 0;
+            for (j = 0; !match && j < ALTERNATIVES_MAX &&
+                 stage->alternatives[j]; j++) {
+                match = memmem(buf, line_len, stage->alternatives[j],
+                               strlen(stage->alternatives[j])) != NULL;
+            }
+            show = stage->kind == STAGE_INCLUDE ? match : !match;
+        }
+        shown += show;
+    }
+
+    return shown;
+}
+
+/* Match each line against the regular expression of each stage */
+static uint64_t filter_regex(const bench_scenario *s, char *buf, size_t len)
+{
+    const bench_stage *stage;
+    regex_t regex[STAGES_MAX];
+    char pattern[1024];
+    char *end = buf + len;
+    char *nl;
+    uint64_t shown = 0;
+    size_t plen;
+    uint32_t count;
+    uint32_t i;
+    uint32_t j;
+    int match;
+    int show;
+
+    for (count = 0; count < STAGES_MAX && s->stages[count].alternatives[0];
+         count++) {
+        stage = &s->stages[count];
+        plen = 0;
+        for (j = 0; j < ALTERNATIVES_MAX && stage->alternatives[j]; j++) {
+            plen += snprintf(pattern + plen, sizeof(pattern) - plen, "%s%s",
+                             j ? "|" : "", stage->alternatives[j]);
+        }
+        regcomp(&regex[count], pattern, REG_EXTENDED | REG_NOSUB);
+    }
+
+    for (; buf < end; buf = nl + 1) {
+        nl = memchr(buf, '\n', end - buf);
+        *nl = '\0';
+
+        show = 1;
+        for (i = 0; show && i < count; i++) {
+            match = regexec(&regex[i], buf, 0, NULL, 0) == 0;
+            show = s->stages[i].kind == STAGE_INCLUDE ? match : !match;
+        }
+        shown += show;
+
+        *nl = '\n';
+    }
+
+    for (i = 0; i < count; i++) {
+        regfree(&regex[i]);
+    }
+
+    return shown;
+}
+
+/* Scan the output with the automaton of the output filters */
+static uint64_t filter_automaton(const bench_scenario *s, char *buf,
+                                 size_t len)
+{
+    ciscli_filter *filter;
+    char spec[1024];
+    uint64_t shown = 0;
+    size_t start = 0;
+    size_t pos = 0;
+    size_t offset;
+
+    scenario_spec(s, spec, sizeof(spec));
+    if (ciscli_filter_compile(spec, strlen(spec), &filter, &offset)) {
+        fprintf(stderr, "cannot compile filter: %s\n", spec);
+        exit(1);
+    }
+
+    while (pos < len) {
+        pos += ciscli_filter_scan(filter, buf + pos, len - pos);
+        shown += ciscli_filter_line(filter, buf + start, pos - start);
+        start = ++pos;
+    }
+
+    ciscli_filter_free(filter);
+    return shown;
+}
+
+int main(int argc, char **argv)
+{
+    const bench_scenario *s;
+    size_t size = 256;
+    size_t len;
+    uint64_t shown[3];
+    double t[3];
+    double start;
+    char spec[1024];
+    char *buf;
+    uint32_t i;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:")) != -1) {
+        switch (opt) {
+        case 'm':
+            size = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            fprintf(stderr, "usage: %s [-m megabytes]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    size <<= 20;
+    buf = malloc(size);
+    if (!buf) {
+        perror("malloc");
+        return 1;
+    }
+
+    len = generate(buf, size);
+    printf("%.0f MB of output\n\n", len / 1048576.0);
+    printf("%-8s  %9s  %9s  %9s  %10s\n", "filters", "memmem", "regexec",
+           "automaton", "lines");
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        s = &scenarios[i];
+
+        start = now();
+        shown[0] = filter_naive(s, buf, len);
+        t[0] = now() - start;
+
+        start = now();
+        shown[1] = filter_regex(s, buf, len);
+        t[1] = now() - start;
+
+        start = now();
+        shown[2] = filter_automaton(s, buf, len);
+        t[2] = now() - start;
+
+        printf("%-8s  %7.0f/s  %7.0f/s  %7.0f/s  %10llu\n", s->name,
+               len / 1048576.0 / t[0], len / 1048576.0 / t[1],
+               len / 1048576.0 / t[2], (unsigned long long)shown[2]);
+
+        if (shown[0] != shown[2] || shown[1] != shown[2]) {
+            scenario_spec(s, spec, sizeof(spec));
+            fprintf(stderr, "%s: lines shown differ, %llu %llu %llu\n",
+                    spec, (unsigned long long)shown[0],
+                    (unsigned long long)shown[1],
+                    (unsigned long long)shown[2]);
+            failed = 1;
+        }
+    }
+
+    printf("\nThroughput in MB of output per second\n");
+    free(buf);
+    return failed;
+}
@@ -0,0 +1,280 @@
+/****************************************************************************
+ * Command history benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Fills a history log from several processes appending at the same time,
+ * and checks that every line of each process is in the log, in the order
+ * it was appended. Then measures the time taken to find the most recent
+ * line with a prefix, and with a substring, through the history index and
+ * by stepping back through the lines one at a time, and checks that both
+ * find the same lines. Build it with -O2 and -Ieditline/include, along
+ * with editline/src/editline_history.c.
+ *
+ * Usage: bench_history [-n lines] [-p processes] [-f path]
+ *
+ *  -n  Number of lines appended (default 10000)
+ *  -p  Number of processes appending (default 4)
+ *  -f  Path to the log, which is removed first (default bench_history.log)
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "editline_history.h"
+
+#define QUERIES     1000
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Format the line that a process appends, which ends with its number and
+ * that of the line, so that the order can be checked */
+static int make_line(char *buf, uint32_t proc, uint32_t i)
+{
+    static const char *const templates[] = {
+        "interface GigabitEthernet%u/%u",
+        "show ip route vrf customer-%u | include 10.%u.",
+        "ip address 10.%u.%u.1 255.255.255.0",
+        "show running-config interface Vlan%u%u",
+        "no shutdown %u %u",
+    };
+    uint32_t r = (i * 2654435761u) >> 16;
+    int len;
+
+    len = sprintf(buf, templates[r % 5], r % 48, r % 251);
+    len += sprintf(buf + len, " ! %u.%u", proc, i);
+    return len;
+}
+
+static void append(const char *path, uint32_t limit, uint32_t proc, uint32_t count)
+{
+    editline_history_t *history;
+    char line[128];
+    uint32_t i;
+    int len;
+
+    if (editline_history_open(path, limit, &history) < 0) {
+        perror("editline_history_open");
+        _exit(1);
+    }
+
+    for (i = 0; i < count; i++) {
+        len = make_line(line, proc, i);
+        if (editline_history_add(history, line, len) != 1) {
+            _exit(1);
+        }
+    }
+
+    editline_history_close(&history);
+    _exit(0);
+}
+
+/* Check that the lines of each process are in order with none missing */
+static int check_order(editline_history_t *history, uint32_t procs, uint32_t per)
+{
+    editline_history_entry_t entry;
+    uint32_t *next;
+    unsigned proc;
+    unsigned i;
+    uint32_t n;
+    int errors = 0;
+    char *tail;
+
+    next = calloc(procs, sizeof(*next));
+    for (n = 0; n < editline_history_count(history); n++) {
+        editline_history_get(history, n, &entry);
+        tail = memmem(entry.line, entry.len, " ! ", 3);
+        if (!tail || sscanf(tail, " ! %u.%u", &proc, &i) != 2 ||
+            proc >= procs || i != next[proc]) {
+            errors++;
+            continue;
+        }
+        next[proc]++;
+    }
+
+    for (proc = 0; proc < procs; proc++) {
+        if (next[proc] != per) {
+            errors++;
+        }
+    }
+
+    free(next);
+    return errors;
+}
+
+/* Step back through the lines for the most recent one that matches */
+static int scan(editline_history_t *history, const char *s, uint32_t len,
+                int prefix, editline_history_entry_t *entry)
+{
+    uint32_t n = editline_history_count(history);
+
+    while (n-- > 0) {
+        editline_history_get(history, n, entry);
+        if (prefix ? entry->len >= len && memcmp(entry->line, s, len) == 0
+                   : memmem(entry->line, entry->len, s, len) != NULL) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void run(editline_history_t *history, char (*queries)[32], int prefix)
+{
+    editline_history_entry_t entry;
+    uint32_t count = editline_history_count(history);
+    uint32_t found[2][QUERIES];
+    uint32_t mismatches = 0;
+    double start;
+    double t[2];
+    uint32_t len;
+    int mode;
+    int q;
+    int r;
+
+    for (mode = 0; mode < 2; mode++) {
+        start = now();
+        for (q = 0; q < QUERIES; q++) {
+            len = strlen(queries[q]);
+            if (mode == 0) {
+                r = scan(history, queries[q], len, prefix, &entry);
+            } else if (prefix) {
+                r = editline_history_prefix(history, queries[q], len, count, &entry);
+            } else {
+                r = editline_history_search(history, queries[q], len, count, &entry);
+            }
+            found[mode][q] = r == 1 ? entry.index : UINT32_MAX;
+        }
+        t[mode] = (now() - start) / QUERIES * 1e9;
+    }
+
+    for (q = 0; q < QUERIES; q++) {
+        mismatches += found[0][q] != found[1][q];
+    }
+
+    printf("%-10s  %12.0f  %12.0f  %10u\n", prefix ? "prefix" : "substring",
+           t[0], t[1], mismatches);
+}
+
+int main(int argc, char **argv)
+{
+    static char prefixes[QUERIES][32];
+    static char needles[QUERIES][32];
+    const char *path = "bench_history.log";
+    editline_history_t *history;
+    uint32_t count = 10000;
+    uint32_t procs = 4;
+    uint32_t per;
+    uint32_t i;
+    char line[128];
+    double start;
+    int status;
+    int failed = 0;
+    int errors;
+    int opt;
+    int len;
+
+    while ((opt = getopt(argc, argv, "n:p:f:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            procs = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'f':
+            path = optarg;
+            break;
+
+        default:
+            fprintf(stderr, "usage: %s [-n lines] [-p processes] [-f path]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    if (procs == 0) {
+        procs = 1;
+    }
+
+    per = count / procs;
+    if (per == 0) {
+        per = 1;
+    }
+    count = per * procs;
+    unlink(path);
+
+    start = now();
+    for (i = 0; i < procs; i++) {
+        if (fork() == 0) {
+            append(path, count, i, per);
+        }
+    }
+
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed++;
+        }
+    }
+
+    printf("%u lines appended by %u processes in %.3fs, %u failed\n", count,
+           procs, now() - start, failed);
+
+    if (editline_history_open(path, count, &history) < 0) {
+        perror("editline_history_open");
+        return 1;
+    }
+
+    errors = check_order(history, procs, per);
+    printf("%u lines indexed, %d out of order or missing\n",
+           editline_history_count(history), errors);
+
+    /* Prefixes of lines cut at a random point, and needles that are rare
+     * or do not occur, so that most of the history is searched */
+    srand(1);
+    for (i = 0; i < QUERIES; i++) {
+        len = make_line(line, rand() % procs, rand() % per);
+        len = 8 + rand() % (len - 8);
+        memcpy(prefixes[i], line, len > 31 ? 31 : len);
+        snprintf(needles[i], sizeof(needles[i]), i & 1 ? "! %u.%u" : "Vlan%u%u.",
+                 rand() % (procs + 1), rand() % per);
+    }
+
+    printf("\n%-10s  %12s  %12s  %10s\n", "search", "scan ns", "index ns",
+           "mismatches");
+    run(history, prefixes, 1);
+    run(history, needles, 0);
+
+    editline_history_close(&history);
+    unlink(path);
+    return failed || errors;
+}
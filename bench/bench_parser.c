@@ -0,0 +1,858 @@
+/****************************************************************************
+ * Parser benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Builds synthetic parse trees through the public API, replays a corpus of
+ * commands through them, and reports the parse rate, the time per token,
+ * the number of allocations per line and the peak RSS. Build it with -O2,
+ * -I. and -Iparser/include, along with the library sources in the root
+ * directory and in parser/src, and link with -pthread.
+ *
+ * Usage: bench_parser [-j] [-n lines] [-r rounds] [-s scenario]
+ *                     [-c corpus] [-o file]
+ *
+ *  -j  Print one JSON object per result instead of a table
+ *  -n  Number of lines to generate for each scenario (default 100000)
+ *  -r  Number of times to replay the corpus (default 5)
+ *  -s  Only run the named scenario
+ *  -c  Replay the commands in a file instead of generated ones. This is
+ *      best combined with -s, since the commands must suit the tree.
+ *  -o  Write the generated corpus of the scenario to a file and exit
+ *
+ * Every scenario is replayed with the trees unfrozen, then frozen, then
+ * frozen with their identical subtrees shared, and then once more with
+ * lookahead enabled.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "ciscli.h"
+
+/*
+ * Allocations are counted by wrapping the allocator. This relies on the
+ * glibc entry points, so the count is not available elsewhere.
+ */
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCS  1
+
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void *ptr, size_t size);
+
+static unsigned long alloc_count;
+
+void * malloc(size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t nmemb, size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void * realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+/* Growable buffer of command lines */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t size;
+    size_t lines;
+    size_t tokens;
+} corpus;
+
+/* Synthetic tree, with what is needed to generate commands for it */
+typedef struct scenario_s {
+    const char *name;
+    const char *description;
+    int (*build)(ciscli *cli, uint32_t tree);
+    void (*line)(corpus *c);
+} scenario;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint32_t rng(uint32_t limit)
+{
+    /* xorshift64*, seeded identically on every run */
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 2685821657736338717ull) >> 32) % limit;
+}
+
+static void corpus_add(corpus *c, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void corpus_add(corpus *c, const char *fmt, ...)
+{
+    va_list ap;
+    size_t need;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    need = c->len + len + 1;
+    if (need > c->size) {
+        c->size = c->size ? c->size * 2 : 65536;
+        while (c->size < need) {
+            c->size *= 2;
+        }
+        c->buf = realloc(c->buf, c->size);
+        if (!c->buf) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    va_start(ap, fmt);
+    vsnprintf(&c->buf[c->len], c->size - c->len, fmt, ap);
+    va_end(ap);
+    c->len += len;
+}
+
+/* Terminate the line being generated, counting its tokens */
+static void corpus_end_line(corpus *c, size_t start)
+{
+    size_t i;
+    int in_token = 0;
+
+    for (i = start; i < c->len; i++) {
+        if (c->buf[i] != ' ' && !in_token) {
+            c->tokens++;
+        }
+        in_token = c->buf[i] != ' ';
+    }
+
+    corpus_add(c, "\n");
+    c->lines++;
+}
+
+static ciscli_node * keyword(ciscli *cli, uint32_t tree, const char *kw)
+{
+    ciscli_node *node;
+
+    node = ciscli_node_alloc(cli, tree, CISCLI_KEYWORD);
+    if (!node || ciscli_keyword_node_set_keyword(node, kw)) {
+        return NULL;
+    }
+
+    return node;
+}
+
+static int add_eol(ciscli *cli, uint32_t tree, ciscli_node *parent)
+{
+    ciscli_node *eol;
+
+    eol = ciscli_node_alloc(cli, tree, CISCLI_EOL);
+    if (!eol) {
+        return -1;
+    }
+
+    return ciscli_node_add_child(parent, eol);
+}
+
+/* Pronounceable words, so that keywords share prefixes as real ones do */
+static const char *syllables[] = {
+    "in", "ter", "face", "ro", "ute", "po", "li", "cy", "ac", "cess",
+    "list", "vl", "an", "ip", "v6", "bgp", "os", "pf", "sh", "ow",
+    "con", "fig", "ser", "vice", "log", "ging", "snmp", "ntp", "aaa", "key",
+};
+#define SYLLABLES   (sizeof(syllables) / sizeof(syllables[0]))
+
+static void make_word(uint32_t seed, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    /* Mixed radix digits of the seed select the syllables */
+    do {
+        len += snprintf(&buf[len], size - len, "%s", syllables[seed % SYLLABLES]);
+        seed /= SYLLABLES;
+    } while (seed && len < size - 8);
+}
+
+/*
+ * Wide: a single mode with many top level commands, each taking one of a
+ * handful of arguments.
+ */
+#define WIDE_COMMANDS   2000
+#define WIDE_ARGS       4
+
+static char wide_words[WIDE_COMMANDS][24];
+static const char *wide_args[WIDE_ARGS] = { "brief", "detail", "summary", "all" };
+
+static int build_wide(ciscli *cli, uint32_t tree)
+{
+    ciscli_node *root = ciscli_get_root_for_tree(cli, tree);
+    ciscli_node *cmd;
+    ciscli_node *arg;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < WIDE_COMMANDS; i++) {
+        /* Skip the low seeds, so that no word is a prefix of another */
+        make_word(i + SYLLABLES * SYLLABLES, wide_words[i], sizeof(wide_words[i]));
+        cmd = keyword(cli, tree, wide_words[i]);
+        if (!cmd || ciscli_node_add_child(root, cmd) || add_eol(cli, tree, cmd)) {
+            return -1;
+        }
+
+        for (j = 0; j < WIDE_ARGS; j++) {
+            arg = keyword(cli, tree, wide_args[j]);
+            if (!arg || ciscli_node_add_child(cmd, arg) ||
+                add_eol(cli, tree, arg)) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void line_wide(corpus *c)
+{
+    size_t start = c->len;
+    uint32_t arg = rng(WIDE_ARGS + 1);
+
+    corpus_add(c, "%s", wide_words[rng(WIDE_COMMANDS)]);
+    if (arg < WIDE_ARGS) {
+        corpus_add(c, " %s", wide_args[arg]);
+    }
+    corpus_end_line(c, start);
+}
+
+/* Deep: a narrow tree of nested commands, as in configuration modes */
+#define DEEP_LEVELS     12
+#define DEEP_BRANCHES   4
+
+static const char *deep_words[DEEP_BRANCHES] = { "alpha", "bravo", "charlie", "delta" };
+
+static int build_deep_level(ciscli *cli, uint32_t tree, ciscli_node *parent,
+                            uint32_t level)
+{
+    ciscli_node *node;
+    uint32_t i;
+
+    if (add_eol(cli, tree, parent)) {
+        return -1;
+    }
+
+    if (level == DEEP_LEVELS) {
+        return 0;
+    }
+
+    for (i = 0; i < DEEP_BRANCHES; i++) {
+        node = keyword(cli, tree, deep_words[i]);
+        if (!node || ciscli_node_add_child(parent, node)) {
+            return -1;
+        }
+
+        /* Only the first branch continues, which keeps the tree small */
+        if (i == 0) {
+            if (build_deep_level(cli, tree, node, level + 1)) {
+                return -1;
+            }
+        } else if (add_eol(cli, tree, node)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int build_deep(ciscli *cli, uint32_t tree)
+{
+    return build_deep_level(cli, tree, ciscli_get_root_for_tree(cli, tree), 0);
+}
+
+static void line_deep(corpus *c)
+{
+    size_t start = c->len;
+    uint32_t depth = 1 + rng(DEEP_LEVELS);
+    uint32_t i;
+
+    for (i = 1; i < depth; i++) {
+        corpus_add(c, "%s ", deep_words[0]);
+    }
+    corpus_add(c, "%s", deep_words[rng(DEEP_BRANCHES)]);
+    corpus_end_line(c, start);
+}
+
+/*
+ * Overlap: keywords that share long prefixes, entered in their shortest
+ * unambiguous form, with a minimum match on every keyword.
+ */
+#define OVERLAP_COMMANDS    500
+
+static char overlap_words[OVERLAP_COMMANDS][32];
+static uint32_t overlap_unique[OVERLAP_COMMANDS];
+
+static int build_overlap(ciscli *cli, uint32_t tree)
+{
+    ciscli_node *root = ciscli_get_root_for_tree(cli, tree);
+    static const char *stems[] = { "interface-", "internal-", "interval-" };
+    ciscli_node *cmd;
+    uint32_t i;
+    uint32_t j;
+    uint32_t lcp;
+
+    for (i = 0; i < OVERLAP_COMMANDS; i++) {
+        snprintf(overlap_words[i], sizeof(overlap_words[i]), "%s%03u",
+                 stems[i % 3], i / 3);
+    }
+
+    /* The shortest unambiguous prefix is one past the longest shared one */
+    for (i = 0; i < OVERLAP_COMMANDS; i++) {
+        overlap_unique[i] = 1;
+        for (j = 0; j < OVERLAP_COMMANDS; j++) {
+            if (i == j) {
+                continue;
+            }
+            for (lcp = 0; overlap_words[i][lcp] &&
+                          overlap_words[i][lcp] == overlap_words[j][lcp]; lcp++)
+                ;
+            if (lcp + 1 > overlap_unique[i]) {
+                overlap_unique[i] = lcp + 1;
+            }
+        }
+
+    }
+
+    for (i = 0; i < OVERLAP_COMMANDS; i++) {
+        cmd = keyword(cli, tree, overlap_words[i]);
+        if (!cmd || ciscli_keyword_node_set_min_match(cmd, 3) ||
+            ciscli_node_add_child(root, cmd) || add_eol(cli, tree, cmd)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void line_overlap(corpus *c)
+{
+    size_t start = c->len;
+    uint32_t i = rng(OVERLAP_COMMANDS);
+
+    corpus_add(c, "%.*s", (int)overlap_unique[i], overlap_words[i]);
+    corpus_end_line(c, start);
+}
+
+/* Mixed: keywords interleaved with integer and address arguments */
+static int build_mixed(ciscli *cli, uint32_t tree)
+{
+    ciscli_node *root = ciscli_get_root_for_tree(cli, tree);
+    ciscli_node *vlan;
+    ciscli_node *id;
+    ciscli_node *name;
+    ciscli_node *route;
+    ciscli_node *addr;
+    ciscli_node *metric;
+    ciscli_node *value;
+
+    vlan = keyword(cli, tree, "vlan");
+    id = ciscli_node_alloc(cli, tree, CISCLI_INTEGER);
+    name = keyword(cli, tree, "shutdown");
+    if (!vlan || !id || !name ||
+        ciscli_integer_node_set_range(id, 1, 4094) ||
+        ciscli_integer_node_set_index(id, 0) ||
+        ciscli_node_add_child(root, vlan) || ciscli_node_add_child(vlan, id) ||
+        add_eol(cli, tree, id) || ciscli_node_add_child(id, name) ||
+        add_eol(cli, tree, name)) {
+        return -1;
+    }
+
+    route = keyword(cli, tree, "route");
+    metric = keyword(cli, tree, "metric");
+    value = ciscli_node_alloc(cli, tree, CISCLI_INTEGER);
+    if (!route || !metric || !value ||
+        ciscli_integer_node_set_index(value, 1) ||
+        ciscli_node_add_child(root, route)) {
+        return -1;
+    }
+
+    /* Address nodes are used where the library supports them */
+    addr = ciscli_node_alloc(cli, tree, CISCLI_IPADDR);
+    if (!addr) {
+        if (errno != ENOTSUP) {
+            return -1;
+        }
+        addr = route;
+    } else if (ciscli_node_add_child(route, addr)) {
+        return -1;
+    }
+
+    if (ciscli_node_add_child(addr, metric) ||
+        ciscli_node_add_child(metric, value) || add_eol(cli, tree, value)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void line_mixed(corpus *c)
+{
+    size_t start = c->len;
+
+    if (rng(2)) {
+        corpus_add(c, "vlan %u%s", 1 + rng(4094), rng(2) ? " shutdown" : "");
+    } else {
+        corpus_add(c, "route 10.%u.%u.0 metric %u", rng(256), rng(256),
+                   rng(1000));
+    }
+    corpus_end_line(c, start);
+}
+
+/*
+ * Maze: the worst case for lookahead. The first token selects every one of
+ * a set of parallel commands, which go on to accept the same integers, so
+ * that every path stays alive and records an effect for every token, until
+ * the last token selects a single one. Without lookahead, every line is
+ * ambiguous.
+ */
+#define MAZE_PATHS      16
+#define MAZE_LEVELS     24
+
+static int build_maze(ciscli *cli, uint32_t tree)
+{
+    ciscli_node *root = ciscli_get_root_for_tree(cli, tree);
+    ciscli_node *node;
+    ciscli_node *step;
+    ciscli_node *end;
+    char word[16];
+    uint32_t i;
+    uint32_t level;
+
+    for (i = 0; i < MAZE_PATHS; i++) {
+        snprintf(word, sizeof(word), "path%02u", i);
+        node = keyword(cli, tree, word);
+        if (!node || ciscli_node_add_child(root, node)) {
+            return -1;
+        }
+
+        snprintf(word, sizeof(word), "end%02u", i);
+        for (level = 0; level < MAZE_LEVELS; level++) {
+            step = ciscli_node_alloc(cli, tree, CISCLI_INTEGER);
+            end = keyword(cli, tree, word);
+            if (!step || !end || ciscli_integer_node_set_range(step, 0, 1000) ||
+                ciscli_integer_node_set_index(step, level % 4) ||
+                ciscli_node_add_child(node, step) ||
+                ciscli_node_add_child(step, end) || add_eol(cli, tree, end)) {
+                return -1;
+            }
+            node = step;
+        }
+    }
+
+    return 0;
+}
+
+static void line_maze(corpus *c)
+{
+    size_t start = c->len;
+    uint32_t depth = 1 + rng(MAZE_LEVELS);
+    uint32_t i;
+
+    corpus_add(c, "path");
+    for (i = 0; i < depth; i++) {
+        corpus_add(c, " %u", rng(1001));
+    }
+    corpus_add(c, " end%02u", rng(MAZE_PATHS));
+    corpus_end_line(c, start);
+}
+
+/*
+ * Ranges: a VLAN command whose range is split across many integer siblings,
+ * one per block of VLANs, each leading to priorities split the same way,
+ * as a generated tree with per-range help and actions would be.
+ */
+#define RANGE_BLOCKS    64
+#define RANGE_BLOCK     64
+#define RANGE_LEVELS    3
+
+static int build_ranges_level(ciscli *cli, uint32_t tree, ciscli_node *parent,
+                              uint32_t level)
+{
+    ciscli_node *range;
+    ciscli_node *next;
+    uint32_t i;
+
+    for (i = 0; i < RANGE_BLOCKS; i++) {
+        range = ciscli_node_alloc(cli, tree, CISCLI_INTEGER);
+        if (!range ||
+            ciscli_integer_node_set_range(range, i * RANGE_BLOCK + 1,
+                                          (i + 1) * RANGE_BLOCK) ||
+            ciscli_integer_node_set_index(range, level) ||
+            ciscli_node_add_child(parent, range) ||
+            add_eol(cli, tree, range)) {
+            return -1;
+        }
+
+        /* Every range leads to the same commands, as in a generated tree */
+        if (level + 1 < RANGE_LEVELS) {
+            next = keyword(cli, tree, "priority");
+            if (!next || ciscli_node_add_child(range, next) ||
+                build_ranges_level(cli, tree, next, level + 1)) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int build_ranges(ciscli *cli, uint32_t tree)
+{
+    ciscli_node *node;
+
+    node = keyword(cli, tree, "vlan");
+    if (!node || ciscli_node_add_child(ciscli_get_root_for_tree(cli, tree), node)) {
+        return -1;
+    }
+
+    return build_ranges_level(cli, tree, node, 0);
+}
+
+static void line_ranges(corpus *c)
+{
+    size_t start = c->len;
+    uint32_t depth = 1 + rng(RANGE_LEVELS);
+    uint32_t i;
+
+    corpus_add(c, "vlan");
+    for (i = 0; i < depth; i++) {
+        corpus_add(c, "%s %u", i ? " priority" : "",
+                   1 + rng(RANGE_BLOCKS * RANGE_BLOCK));
+    }
+    corpus_end_line(c, start);
+}
+
+static const scenario scenarios[] = {
+    { "wide", "2000 top level commands", build_wide, line_wide },
+    { "deep", "12 levels of nested commands", build_deep, line_deep },
+    { "overlap", "500 keywords with long shared prefixes", build_overlap,
+      line_overlap },
+    { "mixed", "keywords with integer and address arguments", build_mixed,
+      line_mixed },
+    { "maze", "16 commands told apart by their last token", build_maze,
+      line_maze },
+    { "ranges", "integer arguments split across 64 ranges", build_ranges,
+      line_ranges },
+};
+#define SCENARIOS   (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru)) {
+        return -1;
+    }
+
+    return ru.ru_maxrss;
+}
+
+static unsigned long allocations(void)
+{
+#ifdef BENCH_COUNT_ALLOCS
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+#else
+    return 0;
+#endif
+}
+
+static int load_corpus(const char *path, corpus *c)
+{
+    FILE *fp;
+    char line[4096];
+    size_t len;
+    size_t start;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        len = strcspn(line, "\r\n");
+        start = c->len;
+        corpus_add(c, "%.*s", (int)len, line);
+        corpus_end_line(c, start);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static void report(int json, const scenario *s, const char *variant,
+                   const corpus *c, uint32_t rounds, double elapsed,
+                   unsigned long allocs, size_t failed,
+                   const ciscli_footprint *fp)
+{
+    double lines = (double)c->lines * rounds;
+    double tokens = (double)c->tokens * rounds;
+    double allocs_per_line = -1;
+
+#ifdef BENCH_COUNT_ALLOCS
+    allocs_per_line = allocs / lines;
+#else
+    (void)allocs;
+#endif
+
+    if (json) {
+        printf("{\"scenario\":\"%s\",\"variant\":\"%s\",\"lines\":%.0f,"
+               "\"tokens\":%.0f,\"failed_lines\":%zu,\"seconds\":%.6f,"
+               "\"lines_per_sec\":%.0f,\"ns_per_token\":%.2f,"
+               "\"allocs_per_line\":%.4f,\"tree_nodes\":%u,"
+               "\"tree_bytes\":%zu,\"peak_rss_kb\":%ld}\n",
+               s->name, variant, lines, tokens, failed, elapsed,
+               lines / elapsed, elapsed * 1e9 / tokens, allocs_per_line,
+               fp->nodes, fp->reserved_bytes, peak_rss_kb());
+    } else {
+        printf("%-8s %-9s %12.0f %10.2f %10.4f %8zu %8u %10ld\n",
+               s->name, variant, lines / elapsed, elapsed * 1e9 / tokens,
+               allocs_per_line, failed, fp->nodes, peak_rss_kb());
+    }
+}
+
+static const char * const variants[] = {
+    "linear", "frozen", "shared", "lookahead"
+};
+#define VARIANTS    (sizeof(variants) / sizeof(variants[0]))
+
+static int run(const scenario *s, const char *corpus_path, size_t nlines,
+               uint32_t rounds, int json)
+{
+    ciscli_footprint fp;
+    unsigned long allocs;
+    corpus c;
+    ciscli *cli;
+    uint32_t tree;
+    uint32_t round;
+    size_t failed;
+    double start;
+    double elapsed;
+    int variant;
+    int retval;
+    size_t i;
+
+    cli = ciscli_alloc();
+    if (!cli) {
+        perror("ciscli_alloc");
+        return -1;
+    }
+
+    tree = ciscli_tree_alloc(cli, s->name, CISCLI_NO_PARENT_TREE);
+    if (tree == CISCLI_NO_PARENT_TREE || s->build(cli, tree)) {
+        fprintf(stderr, "%s: failed to build tree: %s\n", s->name,
+                strerror(errno));
+        ciscli_free(&cli);
+        return -1;
+    }
+
+    memset(&c, 0, sizeof(c));
+    if (corpus_path) {
+        if (load_corpus(corpus_path, &c)) {
+            ciscli_free(&cli);
+            return -1;
+        }
+    } else {
+        for (i = 0; i < nlines; i++) {
+            s->line(&c);
+        }
+    }
+
+    for (variant = 0; variant < (int)VARIANTS; variant++) {
+        if (variant == 1 && ciscli_tree_freeze(cli, tree)) {
+            perror("ciscli_tree_freeze");
+            break;
+        }
+
+        if (variant == 2 && ciscli_tree_share(cli, tree, NULL)) {
+            perror("ciscli_tree_share");
+            break;
+        }
+
+        if (variant == 3 && ciscli_lookahead_enable(cli, 1)) {
+            perror("ciscli_lookahead_enable");
+            break;
+        }
+
+        /* Warm up, which also gets the one time allocations out of the way */
+        ciscli_execute_buffer(cli, c.buf, c.len, CISCLI_EXECUTE_VALIDATE_ONLY,
+                              NULL, NULL);
+
+        failed = 0;
+        allocs = allocations();
+        start = now();
+        for (round = 0; round < rounds; round++) {
+            retval = ciscli_execute_buffer(cli, c.buf, c.len,
+                                           CISCLI_EXECUTE_VALIDATE_ONLY,
+                                           NULL, NULL);
+            if (retval < 0) {
+                perror("ciscli_execute_buffer");
+                break;
+            }
+            failed = retval;
+        }
+        elapsed = now() - start;
+        allocs = allocations() - allocs;
+
+        ciscli_tree_footprint(cli, tree, &fp);
+        report(json, s, variants[variant], &c, rounds, elapsed, allocs,
+               failed, &fp);
+    }
+
+    free(c.buf);
+    ciscli_free(&cli);
+    return 0;
+}
+
+static int write_corpus(const scenario *s, size_t nlines, const char *path)
+{
+    corpus c;
+    ciscli *cli;
+    uint32_t tree;
+    FILE *fp;
+    size_t i;
+
+    /* The generators use the words chosen while building the tree */
+    cli = ciscli_alloc();
+    tree = ciscli_tree_alloc(cli, s->name, CISCLI_NO_PARENT_TREE);
+    if (s->build(cli, tree)) {
+        ciscli_free(&cli);
+        return -1;
+    }
+    ciscli_free(&cli);
+
+    memset(&c, 0, sizeof(c));
+    for (i = 0; i < nlines; i++) {
+        s->line(&c);
+    }
+
+    fp = fopen(path, "w");
+    if (!fp || fwrite(c.buf, 1, c.len, fp) != c.len) {
+        perror(path);
+        free(c.buf);
+        return -1;
+    }
+
+    fclose(fp);
+    free(c.buf);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = NULL;
+    const char *corpus_path = NULL;
+    const char *output = NULL;
+    size_t nlines = 100000;
+    uint32_t rounds = 5;
+    int json = 0;
+    int failed = 0;
+    int ran = 0;
+    size_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "jn:r:s:c:o:")) != -1) {
+        switch (opt) {
+        case 'j':
+            json = 1;
+            break;
+        case 'n':
+            nlines = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            only = optarg;
+            break;
+        case 'c':
+            corpus_path = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-j] [-n lines] [-r rounds] "
+                    "[-s scenario] [-c corpus] [-o file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!nlines || !rounds) {
+        fprintf(stderr, "lines and rounds must be non-zero\n");
+        return 2;
+    }
+
+    if (!json && !output) {
+        printf("%-8s %-9s %12s %10s %10s %8s %8s %10s\n", "scenario",
+               "variant", "lines/sec", "ns/token", "allocs/ln", "failed",
+               "nodes", "rss_kb");
+    }
+
+    for (i = 0; i < SCENARIOS; i++) {
+        if (only && strcmp(only, scenarios[i].name)) {
+            continue;
+        }
+
+        ran++;
+        if (output) {
+            failed |= write_corpus(&scenarios[i], nlines, output) != 0;
+            break;
+        }
+
+        failed |= run(&scenarios[i], corpus_path, nlines, rounds, json) != 0;
+    }
+
+    if (!ran) {
+        fprintf(stderr, "unknown scenario %s\n", only);
+        return 2;
+    }
+
+    return failed;
+}
@@ -0,0 +1,123 @@
+/****************************************************************************
+ * Prompt rendering benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Measures the time taken to produce the prompt before each line three
+ * ways: returning the cached prompt, rendering it again from its format
+ * each time, and running a prompt command each time, as a PromptCommand
+ * run for every line would. Build it with -O2, -I. and -Iparser/include,
+ * along with the library sources in the root directory and in parser/src.
+ *
+ * Usage: bench_prompt [-n prompts] [-c command]
+ *
+ *  -n  Number of prompts produced (default 1000000, and a thousandth of
+ *      that with the command)
+ *  -c  Prompt command (default echo)
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ciscli.h"
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Produce the prompt count times, changing the hostname before each if
+ * asked to, so that the prompt must be produced again */
+static double run(ciscli *cli, uint32_t count, int change)
+{
+    static const char *const hosts[] = { "core1.lab", "core2.lab" };
+    double start;
+    size_t total = 0;
+    size_t len;
+    uint32_t i;
+
+    start = now();
+    for (i = 0; i < count; i++) {
+        if (change) {
+            ciscli_prompt_set_hostname(cli, hosts[i & 1]);
+        }
+
+        ciscli_prompt(cli, &len);
+        total += len;
+    }
+
+    if (total == 0) {
+        fprintf(stderr, "empty prompt\n");
+        exit(1);
+    }
+
+    return (now() - start) / count * 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const char *command = "echo";
+    uint32_t count = 1000000;
+    uint32_t tree;
+    ciscli *cli;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'c':
+            command = optarg;
+            break;
+
+        default:
+            fprintf(stderr, "usage: %s [-n prompts] [-c command]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (count < 1000) {
+        count = 1000;
+    }
+
+    cli = ciscli_alloc();
+    tree = ciscli_tree_alloc(cli, "config-if", CISCLI_NO_PARENT_TREE);
+    if (!tree || ciscli_tree_set_prompt(cli, tree, "%h(%m)#") < 0) {
+        perror("ciscli_tree_set_prompt");
+        return 1;
+    }
+
+    printf("%-10s  %12s\n", "prompt", "ns/prompt");
+    printf("%-10s  %12.1f\n", "cached", run(cli, count, 0));
+    printf("%-10s  %12.1f\n", "rendered", run(cli, count, 1));
+
+    ciscli_prompt_set_command(cli, command);
+    printf("%-10s  %12.1f\n", "command", run(cli, count / 1000, 1));
+
+    ciscli_free(&cli);
+    return 0;
+}
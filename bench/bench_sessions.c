@@ -0,0 +1,487 @@
+/****************************************************************************
+ * Session benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Serves many sessions from a single epoll loop, all sharing one frozen
+ * parse tree, and drives them from a client thread over socketpairs. Each
+ * client pipelines commands whose output it can predict, along with help
+ * requests and unrecognized commands, and checks every reply. Reports the
+ * commands run per second and the memory used per session. Build it with
+ * -O2, -I. and -Iparser/include, along with the library sources in the
+ * root directory and in parser/src, and link with -pthread.
+ *
+ * Usage: bench_sessions [-s sessions] [-n commands] [-p depth]
+ *
+ *  -s  Number of sessions (default 1000)
+ *  -n  Number of commands sent by each session (default 1000)
+ *  -p  Number of commands each client sends before waiting for replies
+ *      (default 8)
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "ciscli.h"
+
+/* Every this many commands, a client asks for help in the middle */
+#define HELP_EVERY      16
+
+/* Every this many commands, a client sends one that is not recognized */
+#define BOGUS_EVERY     32
+
+#define REPLY_MAX       256
+
+typedef struct {
+    ciscli *session;
+    int fd;
+    int writable;
+} server_conn;
+
+typedef struct {
+    int fd;
+
+    /* Commands sent and replies checked */
+    uint32_t sent;
+    uint32_t checked;
+
+    /* Expected replies to the commands in flight, oldest first */
+    int64_t expect[64];
+
+    /* Partial reply line */
+    char reply[REPLY_MAX];
+    size_t reply_len;
+} client_conn;
+
+typedef struct {
+    client_conn *conns;
+    uint32_t count;
+    uint32_t commands;
+    uint32_t depth;
+    unsigned long failures;
+} client_args;
+
+static volatile int server_done;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru)) {
+        return -1;
+    }
+
+    return ru.ru_maxrss;
+}
+
+static int add_action(ciscli *cli, void *arg)
+{
+    int64_t a;
+    int64_t b;
+
+    (void)arg;
+    ciscli_get_integer(cli, 0, &a);
+    ciscli_get_integer(cli, 1, &b);
+    return ciscli_print(cli, "= %lld\n", (long long)(a + b)) < 0;
+}
+
+static ciscli_node * integer(ciscli *cli, uint32_t tree, uint32_t index)
+{
+    ciscli_node *node;
+
+    node = ciscli_node_alloc(cli, tree, CISCLI_INTEGER);
+    if (!node || ciscli_integer_node_set_index(node, index) ||
+        ciscli_integer_node_set_range(node, 0, 1000000)) {
+        return NULL;
+    }
+
+    return node;
+}
+
+/* add <a> <b>, which prints the sum */
+static int build_tree(ciscli *cli)
+{
+    ciscli_node *add;
+    ciscli_node *a;
+    ciscli_node *b;
+    ciscli_node *eol;
+    uint32_t tree;
+
+    tree = ciscli_tree_alloc(cli, "exec", CISCLI_NO_PARENT_TREE);
+    add = ciscli_node_alloc(cli, tree, CISCLI_KEYWORD);
+    a = integer(cli, tree, 0);
+    b = integer(cli, tree, 1);
+    eol = ciscli_node_alloc(cli, tree, CISCLI_EOL);
+    if (!add || !a || !b || !eol ||
+        ciscli_keyword_node_set_keyword(add, "add") ||
+        ciscli_node_add_help_text(add, "Add two integers") ||
+        ciscli_eol_node_set_action(eol, add_action, NULL) ||
+        ciscli_node_add_child(ciscli_get_root_for_tree(cli, tree), add) ||
+        ciscli_node_add_child(add, a) || ciscli_node_add_child(a, b) ||
+        ciscli_node_add_child(b, eol)) {
+        return -1;
+    }
+
+    return ciscli_tree_freeze(cli, tree);
+}
+
+static void answer_help(ciscli *session, const ciscli_event *event)
+{
+    const ciscli_completion *completion;
+    uint32_t i;
+
+    if (ciscli_complete(session, event->line, event->len, &completion)) {
+        return;
+    }
+
+    for (i = 0; i < completion->count; i++) {
+        ciscli_print(session, "  %-*s  %s\n", (int)completion->text_width,
+                     completion->candidates[i].text,
+                     completion->candidates[i].help ?
+                     completion->candidates[i].help : "");
+    }
+}
+
+/* Feed what the client sent to its session, and send back the output */
+static int server_read(int epfd, server_conn *conn)
+{
+    struct epoll_event ev;
+    ciscli_event event;
+    char buf[4096];
+    ssize_t got;
+    ssize_t held;
+    int retval;
+
+    for (;;) {
+        got = read(conn->fd, buf, sizeof(buf));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+
+        if (ciscli_feed(conn->session, buf, got)) {
+            return -1;
+        }
+
+        while ((retval = ciscli_next_event(conn->session, &event)) > 0) {
+            if (event.type == CISCLI_EVENT_HELP ||
+                event.type == CISCLI_EVENT_COMPLETE) {
+                answer_help(conn->session, &event);
+            }
+        }
+
+        if (retval < 0) {
+            return -1;
+        }
+    }
+
+    held = ciscli_flush(conn->session, conn->fd);
+    if (held < 0) {
+        return -1;
+    }
+
+    /* Wait for room to send the rest */
+    if ((held > 0) != conn->writable) {
+        conn->writable = held > 0;
+        ev.events = EPOLLIN | (conn->writable ? EPOLLOUT : 0);
+        ev.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+    }
+
+    return 0;
+}
+
+static int client_send(client_conn *conn)
+{
+    char line[64];
+    int64_t a = rand() % 1000;
+    int64_t b = rand() % 1000;
+    int len;
+
+    if (conn->sent % BOGUS_EVERY == BOGUS_EVERY - 1) {
+        len = snprintf(line, sizeof(line), "bogus %lld\n", (long long)a);
+        conn->expect[conn->sent % 64] = -1;
+    } else if (conn->sent % HELP_EVERY == HELP_EVERY - 1) {
+        /* The help request leaves the line in place */
+        len = snprintf(line, sizeof(line), "add ?%lld %lld\n", (long long)a,
+                       (long long)b);
+        conn->expect[conn->sent % 64] = a + b;
+    } else {
+        len = snprintf(line, sizeof(line), "add %lld %lld\n", (long long)a,
+                       (long long)b);
+        conn->expect[conn->sent % 64] = a + b;
+    }
+
+    if (write(conn->fd, line, len) != len) {
+        return -1;
+    }
+
+    conn->sent++;
+    return 0;
+}
+
+/* Check a reply line, returns 0 if it was expected */
+static int client_check(client_conn *conn, const char *line)
+{
+    int64_t expect;
+
+    expect = conn->expect[conn->checked % 64];
+    conn->checked++;
+
+    if (expect < 0) {
+        return strcmp(line, "% Unrecognized command") != 0;
+    }
+
+    return line[0] != '=' || strtoll(line + 2, NULL, 10) != expect;
+}
+
+static void * client_thread(void *arg)
+{
+    client_args *args = arg;
+    struct epoll_event events[64];
+    struct epoll_event ev;
+    client_conn *conn;
+    char buf[4096];
+    uint32_t active = args->count;
+    uint32_t i;
+    ssize_t got;
+    ssize_t j;
+    int epfd;
+    int n;
+
+    epfd = epoll_create1(0);
+    for (i = 0; i < args->count; i++) {
+        conn = &args->conns[i];
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev);
+
+        while (conn->sent < args->depth && conn->sent < args->commands) {
+            client_send(conn);
+        }
+    }
+
+    while (active) {
+        n = epoll_wait(epfd, events, 64, 1000);
+        if (n <= 0) {
+            if (n == 0 || errno != EINTR) {
+                fprintf(stderr, "clients stalled with %u active\n", active);
+                args->failures++;
+                break;
+            }
+            continue;
+        }
+
+        while (n--) {
+            conn = events[n].data.ptr;
+            got = read(conn->fd, buf, sizeof(buf));
+            if (got <= 0) {
+                continue;
+            }
+
+            for (j = 0; j < got; j++) {
+                if (buf[j] != '\n') {
+                    if (conn->reply_len < REPLY_MAX - 1) {
+                        conn->reply[conn->reply_len++] = buf[j];
+                    }
+                    continue;
+                }
+
+                conn->reply[conn->reply_len] = '\0';
+                conn->reply_len = 0;
+
+                /* Help lines answer the requests, but are not replies */
+                if (conn->reply[0] == ' ') {
+                    continue;
+                }
+
+                if (client_check(conn, conn->reply)) {
+                    args->failures++;
+                }
+
+                if (conn->sent < args->commands) {
+                    client_send(conn);
+                } else if (conn->checked == args->commands) {
+                    active--;
+                }
+            }
+        }
+    }
+
+    close(epfd);
+    server_done = 1;
+    return NULL;
+}
+
+static void raise_fd_limit(void)
+{
+    struct rlimit rl;
+
+    if (!getrlimit(RLIMIT_NOFILE, &rl)) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct epoll_event events[64];
+    struct epoll_event ev;
+    server_conn *servers;
+    client_args args;
+    pthread_t client;
+    ciscli *base;
+    uint32_t sessions = 1000;
+    uint32_t commands = 1000;
+    uint32_t depth = 8;
+    uint32_t i;
+    long rss_before;
+    long rss_after;
+    double start;
+    double elapsed;
+    int fds[2];
+    int epfd;
+    int opt;
+    int n;
+
+    while ((opt = getopt(argc, argv, "s:n:p:")) != -1) {
+        switch (opt) {
+        case 's':
+            sessions = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'n':
+            commands = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            depth = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            fprintf(stderr, "usage: %s [-s sessions] [-n commands] "
+                    "[-p depth]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* A reply is expected for every command in flight */
+    if (depth < 1 || depth > 64) {
+        fprintf(stderr, "%s: depth must be between 1 and 64\n", argv[0]);
+        return 2;
+    }
+
+    raise_fd_limit();
+
+    base = ciscli_alloc();
+    if (!base || build_tree(base)) {
+        perror("build_tree");
+        return 1;
+    }
+
+    servers = calloc(sessions, sizeof(*servers));
+    memset(&args, 0, sizeof(args));
+    args.conns = calloc(sessions, sizeof(*args.conns));
+    args.count = sessions;
+    args.commands = commands;
+    args.depth = depth;
+    epfd = epoll_create1(0);
+    if (!servers || !args.conns || epfd < 0) {
+        perror(argv[0]);
+        return 1;
+    }
+
+    rss_before = peak_rss_kb();
+    for (i = 0; i < sessions; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+            perror("socketpair");
+            return 1;
+        }
+
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        servers[i].fd = fds[0];
+        servers[i].session = ciscli_session_alloc(base);
+        if (!servers[i].session) {
+            perror("ciscli_session_alloc");
+            return 1;
+        }
+        args.conns[i].fd = fds[1];
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = &servers[i];
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev);
+    }
+
+    start = now();
+    pthread_create(&client, NULL, client_thread, &args);
+
+    while (!server_done) {
+        n = epoll_wait(epfd, events, 64, 100);
+        while (n-- > 0) {
+            if (server_read(epfd, events[n].data.ptr)) {
+                fprintf(stderr, "session failed: %s\n", strerror(errno));
+                args.failures++;
+            }
+        }
+    }
+
+    pthread_join(client, NULL);
+    elapsed = now() - start;
+    rss_after = peak_rss_kb();
+
+    printf("%u sessions, %u commands each, %u in flight\n", sessions,
+           commands, depth);
+    printf("%.0f commands/sec, %lu failures, %.2f KB per session\n",
+           (double)sessions * commands / elapsed, args.failures,
+           (double)(rss_after - rss_before) / sessions);
+
+    for (i = 0; i < sessions; i++) {
+        ciscli_free(&servers[i].session);
+        close(servers[i].fd);
+        close(args.conns[i].fd);
+    }
+
+    free(servers);
+    free(args.conns);
+    close(epfd);
+    ciscli_free(&base);
+    return args.failures ? 1 : 0;
+}
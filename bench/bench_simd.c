@@ -0,0 +1,290 @@
+/****************************************************************************
+ * Vectorized scanning and keyword comparison benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Checks every implementation level of the scanners and the keyword
+ * comparison against the scalar level with random inputs, then measures
+ * the time each level takes. Build with:
+ *
+ *     cc -O2 -std=gnu99 -Iparser/include bench/bench_simd.c \
+ *        parser/src/parser_simd.c parser/src/parser_node_registration.c \
+ *        -o bench_simd
+ *
+ * Usage: bench_simd [-v] [-n iterations] [-s seed]
+ *
+ *  -v  Only check the levels, without measuring them
+ *  -n  Number of random inputs to check (default 1000000)
+ *  -s  Seed for the random inputs (default 1)
+ *
+ * The strings are placed against an unmapped page, so that a scanner that
+ * reads past the page holding the end of a string crashes the check.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "parser_simd.h"
+
+/* Longest string scanned by the checks */
+#define CHECK_STRING_MAX    200
+
+/* Number of keywords a token is compared against when measuring */
+#define BENCH_CHAIN         16
+
+static const char *const bench_lines[] = {
+    "show interfaces GigabitEthernet0/1 status",
+    "interface TenGigabitEthernet1/0/48",
+    " ip address 192.168.100.1 255.255.255.0",
+    "router bgp 65001",
+    "  neighbor 10.0.0.1 remote-as 65002",
+    "show ip route vrf management-network",
+    "no shutdown",
+    "exit",
+};
+
+static const char *const bench_keywords[BENCH_CHAIN] = {
+    "access-list", "bgp", "clock", "debug", "exit", "hostname", "interface",
+    "ip", "line", "logging", "no", "router", "service", "show", "snmp-server",
+    "username",
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Random character, with spaces and null bytes common enough to matter */
+static char random_char(void)
+{
+    static const char alphabet[] = "  ab-0\t";
+    int r = rand() % 16;
+
+    if (r == 0) {
+        return '\0';
+    }
+    if (r < 8) {
+        return alphabet[r % (sizeof(alphabet) - 1)];
+    }
+    return 'a' + rand() % 26;
+}
+
+/* Random keyword made of a few letters, so that tokens often select it */
+static void random_keyword(char *keyword)
+{
+    uint32_t len = 1 + rand() % (KEYWORD_LENGTH_MAX - 1);
+    uint32_t i;
+
+    memset(keyword, 0, KEYWORD_LENGTH_MAX);
+    for (i = 0; i < len; i++) {
+        keyword[i] = "ab-"[rand() % 3];
+    }
+}
+
+/* Random token that is usually a prefix of the keyword */
+static uint32_t random_token(char *token, const char *keyword)
+{
+    uint32_t len = 1 + rand() % KEYWORD_LENGTH_MAX;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        token[i] = keyword[i] ? keyword[i] : "ab-"[rand() % 3];
+    }
+
+    if (rand() % 4 == 0) {
+        token[rand() % len] = "ab-"[rand() % 3];
+    }
+
+    return len;
+}
+
+static int check(const parser_simd_ops_t *ops, const parser_simd_ops_t *ref,
+                 char *page_end, unsigned long iterations)
+{
+    char keyword[KEYWORD_LENGTH_MAX];
+    char token[KEYWORD_LENGTH_MAX];
+    parser_kw_token_t tok;
+    unsigned long n;
+    uint32_t len;
+    uint32_t i;
+    char *s;
+
+    for (n = 0; n < iterations; n++) {
+        /* Strings either end at the guard page or somewhere before it */
+        len = rand() % CHECK_STRING_MAX;
+        s = page_end - len - (rand() % 2 ? 0 : rand() % 64);
+        for (i = 0; i < len; i++) {
+            s[i] = random_char();
+        }
+
+        if (ops->scan_token(s, len) != ref->scan_token(s, len)) {
+            printf("%s: scan_token mismatch, length %u\n", ops->name, len);
+            return -1;
+        }
+
+        if (ops->scan_spaces(s, len) != ref->scan_spaces(s, len)) {
+            printf("%s: scan_spaces mismatch, length %u\n", ops->name, len);
+            return -1;
+        }
+
+        random_keyword(keyword);
+        len = random_token(token, keyword);
+        parser_kw_token_prepare(&tok, token, len);
+        if (!ops->keyword_prefix(keyword, &tok) !=
+            !ref->keyword_prefix(keyword, &tok)) {
+            printf("%s: keyword_prefix mismatch, keyword %.32s, token %.*s\n",
+                   ops->name, keyword, (int)len, token);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void measure(const parser_simd_ops_t *ops, unsigned long rounds)
+{
+    static char keywords[BENCH_CHAIN][KEYWORD_LENGTH_MAX];
+    parser_kw_token_t tok;
+    unsigned long tokens = 0;
+    unsigned long r;
+    volatile uint32_t sink = 0;
+    const char *line;
+    uint32_t len;
+    uint32_t pos;
+    uint32_t tlen;
+    uint32_t i;
+    uint32_t k;
+    double start;
+    double scan;
+    double cmp;
+
+    for (k = 0; k < BENCH_CHAIN; k++) {
+        strncpy(keywords[k], bench_keywords[k], KEYWORD_LENGTH_MAX);
+    }
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < sizeof(bench_lines) / sizeof(bench_lines[0]); i++) {
+            line = bench_lines[i];
+            len = strlen(line);
+            pos = ops->scan_spaces(line, len);
+            while (pos < len) {
+                tlen = ops->scan_token(&line[pos], len - pos);
+                pos += tlen;
+                pos += ops->scan_spaces(&line[pos], len - pos);
+                tokens++;
+            }
+        }
+    }
+    scan = now() - start;
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < BENCH_CHAIN; i++) {
+            parser_kw_token_prepare(&tok, bench_keywords[i],
+                                    strlen(bench_keywords[i]));
+            for (k = 0; k < BENCH_CHAIN; k++) {
+                sink += ops->keyword_prefix(keywords[k], &tok);
+            }
+        }
+    }
+    cmp = now() - start;
+
+    printf("%-8s %10.2f ns/token %10.2f ns/compare\n", ops->name,
+           scan * 1e9 / tokens, cmp * 1e9 / (rounds * BENCH_CHAIN * BENCH_CHAIN));
+}
+
+int main(int argc, char **argv)
+{
+    const parser_simd_ops_t *ref = parser_simd_get(PARSER_SIMD_SCALAR);
+    const parser_simd_ops_t *ops;
+    unsigned long iterations = 1000000;
+    unsigned int seed = 1;
+    int verify_only = 0;
+    long page_size;
+    uint32_t level;
+    char *pages;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:s:")) != -1) {
+        switch (opt) {
+        case 'v':
+            verify_only = 1;
+            break;
+
+        case 'n':
+            iterations = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n iterations] [-s seed]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    page_size = sysconf(_SC_PAGESIZE);
+    pages = mmap(NULL, page_size * 2, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED || mprotect(pages + page_size, page_size,
+                                        PROT_NONE)) {
+        perror("mmap");
+        return 1;
+    }
+
+    printf("Selected level: %s\n", parser_simd->name);
+    for (level = PARSER_SIMD_SCALAR + 1; level < PARSER_SIMD_MAX; level++) {
+        ops = parser_simd_get(level);
+        if (!ops) {
+            continue;
+        }
+
+        srand(seed);
+        if (check(ops, ref, pages + page_size, iterations)) {
+            failed = 1;
+        } else {
+            printf("%s: %lu inputs match the scalar level\n", ops->name,
+                   iterations);
+        }
+    }
+
+    if (!verify_only && !failed) {
+        for (level = PARSER_SIMD_SCALAR; level < PARSER_SIMD_MAX; level++) {
+            ops = parser_simd_get(level);
+            if (ops) {
+                measure(ops, iterations);
+            }
+        }
+    }
+
+    munmap(pages, page_size * 2);
+    return failed;
+}
@@ -0,0 +1,545 @@
+/****************************************************************************
+ * Value parser benchmark
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Checks the integer, number and address parsers against strtoll, strtod,
+ * inet_pton and ether_aton with random values, and with random mutations
+ * of them, then measures the time each parser and its libc equivalent
+ * takes. Build with:
+ *
+ *     cc -O2 -std=gnu99 -Iparser/include bench/bench_values.c \
+ *        parser/src/parser_value.c -lm -o bench_values
+ *
+ * Usage: bench_values [-v] [-n values] [-r rounds] [-s seed]
+ *
+ *  -v  Only check the parsers, without measuring them
+ *  -n  Number of random values of each kind (default 100000)
+ *  -r  Number of times to parse the values when measuring (default 20)
+ *  -s  Seed for the random values (default 1)
+ *
+ * Numbers with more than 19 significant digits, or that do not scale
+ * exactly, may differ from strtod by one unit in the last place. Those
+ * are counted and reported, and any larger difference fails the check.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/ether.h>
+
+#include "parser_value.h"
+
+/* Longest value generated, with terminator */
+#define VALUE_MAX       64
+
+enum value_kind_e {
+    KIND_INTEGER,
+    KIND_NUMBER,
+    KIND_IPV4,
+    KIND_IPV6,
+    KIND_MAC,
+    KIND_MAX
+};
+
+static const char *const kind_names[KIND_MAX] = {
+    "integer", "number", "ipv4", "ipv6", "mac",
+};
+
+/* Characters that mutations draw from, for each kind of value */
+static const char *const kind_alphabet[KIND_MAX] = {
+    "0123456789abcdefxX+-",
+    "0123456789.eE+-",
+    "0123456789.",
+    "0123456789abcdefABCDEF:.",
+    "0123456789abcdef:",
+};
+
+#define INTEGER_FORMATS (INTEGER_FORMAT_DEC | INTEGER_FORMAT_HEX | \
+                         INTEGER_FORMAT_OCT)
+
+typedef struct corpus_s {
+    char (*values)[VALUE_MAX];
+    uint32_t *lens;
+    unsigned long count;
+} corpus_t;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t random64(void)
+{
+    return ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ rand();
+}
+
+/* Random value of a kind, written the way a user would type it */
+static void random_value(uint32_t kind, char *buf)
+{
+    uint8_t addr[16];
+    uint64_t v;
+    uint32_t i;
+    uint32_t start;
+    uint32_t run;
+
+    switch (kind) {
+    case KIND_INTEGER:
+        v = random64() >> (rand() % 64);
+        switch (rand() % 4) {
+        case 0:
+            snprintf(buf, VALUE_MAX, "0x%llx", (unsigned long long)v);
+            break;
+        case 1:
+            snprintf(buf, VALUE_MAX, "0%llo", (unsigned long long)v);
+            break;
+        case 2:
+            snprintf(buf, VALUE_MAX, "-%llu", (unsigned long long)v);
+            break;
+        default:
+            snprintf(buf, VALUE_MAX, "%llu", (unsigned long long)v);
+            break;
+        }
+        break;
+
+    case KIND_NUMBER:
+        switch (rand() % 4) {
+        case 0:
+            snprintf(buf, VALUE_MAX, "%d.%0*d", rand() % 100000,
+                     1 + rand() % 4, rand() % 1000);
+            break;
+        case 1:
+            snprintf(buf, VALUE_MAX, "%.*e", rand() % 25,
+                     (double)random64() * pow(10, rand() % 80 - 40));
+            break;
+        case 2:
+            snprintf(buf, VALUE_MAX, "-%.*g", 1 + rand() % 20,
+                     (double)random64() / (1 + random64()));
+            break;
+        default:
+            snprintf(buf, VALUE_MAX, "%llu.%llu",
+                     (unsigned long long)random64(),
+                     (unsigned long long)random64());
+            break;
+        }
+        break;
+
+    case KIND_IPV4:
+        v = random64();
+        inet_ntop(AF_INET, &v, buf, VALUE_MAX);
+        break;
+
+    case KIND_IPV6:
+        /* Runs of zero groups exercise the :: forms */
+        for (i = 0; i < 16; i++) {
+            addr[i] = rand() % 3 ? rand() : 0;
+        }
+        start = rand() % 8;
+        run = rand() % (9 - start);
+        memset(&addr[2 * start], 0, 2 * run);
+        inet_ntop(AF_INET6, addr, buf, VALUE_MAX);
+        break;
+
+    default:
+        for (i = 0; i < 6; i++) {
+            snprintf(&buf[3 * i], VALUE_MAX - 3 * i, "%02x:", rand() & 0xFF);
+        }
+        buf[17] = '\0';
+        break;
+    }
+}
+
+/* Replace, insert or delete a character, so that the value may break */
+static void mutate(uint32_t kind, char *buf)
+{
+    const char *alphabet = kind_alphabet[kind];
+    size_t len = strlen(buf);
+    size_t pos = rand() % (len + 1);
+
+    switch (rand() % 3) {
+    case 0:
+        if (pos < len) {
+            buf[pos] = alphabet[rand() % strlen(alphabet)];
+        }
+        break;
+
+    case 1:
+        if (len + 1 < VALUE_MAX) {
+            memmove(&buf[pos + 1], &buf[pos], len - pos + 1);
+            buf[pos] = alphabet[rand() % strlen(alphabet)];
+        }
+        break;
+
+    default:
+        if (pos < len) {
+            memmove(&buf[pos], &buf[pos + 1], len - pos);
+        }
+        break;
+    }
+}
+
+static int libc_integer(const char *s, int64_t *value)
+{
+    char *end;
+
+    /* strtoll skips leading spaces, which never reach the parser */
+    errno = 0;
+    *value = strtoll(s, &end, 0);
+    return end == s || *end || errno ? -1 : 0;
+}
+
+static int libc_number(const char *s, double *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtod(s, &end);
+    if (end == s || *end) {
+        return -1;
+    }
+
+    return errno == ERANGE ? 1 : 0;
+}
+
+static int libc_mac(const char *s, uint8_t *addr)
+{
+    struct ether_addr *ea;
+
+    /* ether_aton also takes single digit groups, which the parser does not */
+    ea = ether_aton(s);
+    if (!ea) {
+        return -1;
+    }
+
+    memcpy(addr, ea->ether_addr_octet, 6);
+    return 0;
+}
+
+/* Check whether a MAC address is written with two digits to each byte */
+static int is_canonical_mac(const char *s, const uint8_t *addr)
+{
+    char buf[VALUE_MAX];
+
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x", addr[0],
+             addr[1], addr[2], addr[3], addr[4], addr[5]);
+    return strcasecmp(s, buf) == 0;
+}
+
+/* Distance between two doubles in units in the last place */
+static uint64_t ulps(double a, double b)
+{
+    int64_t ia;
+    int64_t ib;
+
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    if ((ia < 0) != (ib < 0)) {
+        return a == b ? 0 : UINT64_MAX;
+    }
+
+    return ia > ib ? ia - ib : ib - ia;
+}
+
+/* Check one value, returning -1 on a mismatch and 1 if it was inexact */
+static int check_value(uint32_t kind, const char *s, uint32_t len)
+{
+    parser_address_t addr;
+    uint8_t expect[16];
+    int64_t i1;
+    int64_t i2;
+    double d1;
+    double d2;
+    int r1;
+    int r2;
+
+    switch (kind) {
+    case KIND_INTEGER:
+        r1 = parser_parse_integer(s, len, INTEGER_FORMATS, &i1);
+        r2 = libc_integer(s, &i2);
+        if (!r1 != !r2 || (!r1 && i1 != i2)) {
+            printf("integer mismatch: %s\n", s);
+            return -1;
+        }
+        break;
+
+    case KIND_NUMBER:
+        r1 = parser_parse_number(s, len, &d1);
+        r2 = libc_number(s, &d2);
+        if (r2 > 0) {
+            /* Values past the range of a double need not agree exactly */
+            return r1 == -EINVAL ? -1 : 0;
+        }
+        if (!r1 != !r2) {
+            printf("number mismatch: %s\n", s);
+            return -1;
+        }
+        if (!r1 && ulps(d1, d2)) {
+            if (ulps(d1, d2) > 1) {
+                printf("number mismatch: %s is %.17g, not %.17g\n", s, d1, d2);
+                return -1;
+            }
+            return 1;
+        }
+        break;
+
+    case KIND_IPV4:
+    case KIND_IPV6:
+        r1 = parser_parse_address(s, len, kind == KIND_IPV4 ?
+                                  ADDRESS_FORMAT_IPV4 : ADDRESS_FORMAT_IPV6,
+                                  &addr);
+        r2 = inet_pton(kind == KIND_IPV4 ? AF_INET : AF_INET6, s, expect) != 1;
+        if (!r1 != !r2 || (!r1 && memcmp(addr.addr, expect,
+                                         kind == KIND_IPV4 ? 4 : 16))) {
+            printf("%s mismatch: %s\n", kind_names[kind], s);
+            return -1;
+        }
+        break;
+
+    default:
+        r1 = parser_parse_address(s, len, ADDRESS_FORMAT_MAC, &addr);
+        r2 = libc_mac(s, expect);
+        if ((!r1 && (r2 || memcmp(addr.addr, expect, 6))) ||
+            (r1 && !r2 && is_canonical_mac(s, expect))) {
+            printf("mac mismatch: %s\n", s);
+            return -1;
+        }
+        break;
+    }
+
+    return 0;
+}
+
+static int check(uint32_t kind, unsigned long count)
+{
+    char buf[VALUE_MAX];
+    unsigned long inexact = 0;
+    unsigned long n;
+    uint32_t m;
+    int retval;
+
+    for (n = 0; n < count; n++) {
+        random_value(kind, buf);
+
+        /* Every other value is mutated a few times */
+        if (n & 1) {
+            for (m = 1 + rand() % 3; m; m--) {
+                mutate(kind, buf);
+            }
+        }
+
+        retval = check_value(kind, buf, strlen(buf));
+        if (retval < 0) {
+            return -1;
+        }
+        inexact += retval;
+    }
+
+    printf("%-8s %lu values match libc", kind_names[kind], count);
+    if (inexact) {
+        printf(", %lu within one ulp", inexact);
+    }
+    printf("\n");
+    return 0;
+}
+
+static int build_corpus(uint32_t kind, unsigned long count, corpus_t *corpus)
+{
+    unsigned long n;
+
+    corpus->values = malloc(count * sizeof(corpus->values[0]));
+    corpus->lens = malloc(count * sizeof(corpus->lens[0]));
+    if (!corpus->values || !corpus->lens) {
+        return -1;
+    }
+
+    for (n = 0; n < count; n++) {
+        random_value(kind, corpus->values[n]);
+        corpus->lens[n] = strlen(corpus->values[n]);
+    }
+
+    corpus->count = count;
+    return 0;
+}
+
+static double measure_parser(uint32_t kind, const corpus_t *corpus,
+                             unsigned long rounds)
+{
+    static const uint32_t formats[KIND_MAX] = {
+        [KIND_IPV4] = ADDRESS_FORMAT_IPV4,
+        [KIND_IPV6] = ADDRESS_FORMAT_IPV6,
+        [KIND_MAC] = ADDRESS_FORMAT_MAC,
+    };
+    volatile uint64_t sink = 0;
+    parser_address_t addr;
+    unsigned long r;
+    unsigned long n;
+    int64_t i;
+    double d;
+    double start;
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (n = 0; n < corpus->count; n++) {
+            switch (kind) {
+            case KIND_INTEGER:
+                parser_parse_integer(corpus->values[n], corpus->lens[n],
+                                     INTEGER_FORMATS, &i);
+                sink += i;
+                break;
+
+            case KIND_NUMBER:
+                parser_parse_number(corpus->values[n], corpus->lens[n], &d);
+                sink += d > 0;
+                break;
+
+            default:
+                parser_parse_address(corpus->values[n], corpus->lens[n],
+                                     formats[kind], &addr);
+                sink += addr.addr[0];
+                break;
+            }
+        }
+    }
+
+    return (now() - start) * 1e9 / (rounds * corpus->count);
+}
+
+static double measure_libc(uint32_t kind, const corpus_t *corpus,
+                           unsigned long rounds)
+{
+    volatile uint64_t sink = 0;
+    uint8_t addr[16];
+    unsigned long r;
+    unsigned long n;
+    int64_t i;
+    double d;
+    double start;
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (n = 0; n < corpus->count; n++) {
+            switch (kind) {
+            case KIND_INTEGER:
+                libc_integer(corpus->values[n], &i);
+                sink += i;
+                break;
+
+            case KIND_NUMBER:
+                libc_number(corpus->values[n], &d);
+                sink += d > 0;
+                break;
+
+            case KIND_MAC:
+                libc_mac(corpus->values[n], addr);
+                sink += addr[0];
+                break;
+
+            default:
+                inet_pton(kind == KIND_IPV4 ? AF_INET : AF_INET6,
+                          corpus->values[n], addr);
+                sink += addr[0];
+                break;
+            }
+        }
+    }
+
+    return (now() - start) * 1e9 / (rounds * corpus->count);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long count = 100000;
+    unsigned long rounds = 20;
+    unsigned int seed = 1;
+    int verify_only = 0;
+    corpus_t corpus;
+    double parser;
+    double libc;
+    uint32_t kind;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:s:")) != -1) {
+        switch (opt) {
+        case 'v':
+            verify_only = 1;
+            break;
+
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n values] [-r rounds] "
+                    "[-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!count || !rounds) {
+        fprintf(stderr, "%s: values and rounds must be positive\n", argv[0]);
+        return 2;
+    }
+
+    srand(seed);
+    for (kind = 0; kind < KIND_MAX; kind++) {
+        if (check(kind, count)) {
+            failed = 1;
+        }
+    }
+
+    if (verify_only || failed) {
+        return failed;
+    }
+
+    printf("%-8s %12s %12s %8s\n", "Kind", "Parser ns", "libc ns", "Speedup");
+    for (kind = 0; kind < KIND_MAX; kind++) {
+        if (build_corpus(kind, count, &corpus)) {
+            perror("malloc");
+            return 1;
+        }
+
+        parser = measure_parser(kind, &corpus, rounds);
+        libc = measure_libc(kind, &corpus, rounds);
+        printf("%-8s %12.2f %12.2f %7.2fx\n", kind_names[kind], parser, libc,
+               libc / parser);
+
+        free(corpus.values);
+        free(corpus.lens);
+    }
+
+    return 0;
+}
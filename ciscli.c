@@ -0,0 +1,363 @@
+/****************************************************************************
+ * CisCLI structure and parse tree management
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "ciscli_private.h"
+
+ciscli * ciscli_alloc(void)
+{
+    ciscli *cli;
+
+    cli = calloc(1, sizeof(*cli));
+    if (!cli) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    cli->ctl = calloc(1, sizeof(*cli->ctl));
+    if (!cli->ctl) {
+        free(cli);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    cli->in_fd = STDIN_FILENO;
+    cli->out_fd = STDOUT_FILENO;
+    cli->err_fd = STDERR_FILENO;
+
+    return cli;
+}
+
+ciscli * ciscli_session_alloc(ciscli *base)
+{
+    ciscli *cli;
+
+    if (base && base->base) {
+        base = base->base;
+    }
+
+    cli = ciscli_alloc();
+    if (!cli) {
+        return NULL;
+    }
+
+    cli->buffered = 1;
+    if (base) {
+        cli->base = base;
+        cli->current_tree = base->current_tree;
+        cli->parse_flags = base->parse_flags;
+    }
+
+    return cli;
+}
+
+void ciscli_free(ciscli **cli)
+{
+    ciscli_tree *tree;
+    uint32_t i;
+
+    if (!cli || !*cli) {
+        return;
+    }
+
+    /*
+     * Nodes are never freed individually, so there is no need to walk the
+     * trees. Releasing the arena releases every node of the tree. A
+     * session has no trees of its own.
+     */
+    for (i = 0; i < (*cli)->tree_count; i++) {
+        tree = (*cli)->trees[i];
+        parser_arena_destroy(&tree->arena);
+        parser_arena_destroy(&tree->cold_arena);
+        free(tree->prompt);
+        free(tree);
+    }
+
+    free((*cli)->trees);
+    ciscli_completion_cache_free((*cli)->completions);
+    ciscli_prompt_state_free((*cli)->prompt);
+    parser_control_destroy((*cli)->ctl);
+    free((*cli)->ctl);
+    free((*cli)->input);
+    if (!(*cli)->buffered) {
+        ciscli_flush(*cli, (*cli)->out_fd);
+    }
+    ciscli_output_free(*cli);
+    free(*cli);
+    *cli = NULL;
+}
+
+ciscli_tree * ciscli_get_tree(ciscli *cli, uint32_t tree)
+{
+    if (!cli) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cli = ciscli_tree_owner(cli);
+    if (tree == CISCLI_NO_PARENT_TREE || tree > cli->tree_count) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return cli->trees[tree - 1];
+}
+
+uint32_t ciscli_tree_alloc(ciscli *cli, const char *name, uint32_t parent)
+{
+    ciscli_tree **trees;
+    ciscli_tree *tree;
+    uint32_t count;
+
+    if (!cli || !name) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    /* Trees are added to the structure that owns them, not to a session */
+    if (cli->base) {
+        errno = EPERM;
+        return 0;
+    }
+
+    if (parent != CISCLI_NO_PARENT_TREE && !ciscli_get_tree(cli, parent)) {
+        return 0;
+    }
+
+    if (cli->tree_count == cli->tree_alloc) {
+        count = cli->tree_alloc ? cli->tree_alloc * 2 : 8;
+        trees = realloc(cli->trees, count * sizeof(*trees));
+        if (!trees) {
+            errno = ENOMEM;
+            return 0;
+        }
+        cli->trees = trees;
+        cli->tree_alloc = count;
+    }
+
+    tree = calloc(1, sizeof(*tree));
+    if (!tree) {
+        errno = ENOMEM;
+        return 0;
+    }
+
+    parser_arena_init(&tree->arena, 0);
+    parser_arena_init(&tree->cold_arena, 0);
+    tree->parent = parent;
+    tree->name = parser_arena_strdup(&tree->cold_arena, name);
+    tree->root = parser_arena_alloc(&tree->arena, sizeof(*tree->root));
+    if (tree->root) {
+        tree->root->cold = parser_arena_alloc(&tree->cold_arena,
+                                              sizeof(*tree->root->cold));
+    }
+
+    if (!tree->name || !tree->root || !tree->root->cold) {
+        parser_arena_destroy(&tree->arena);
+        parser_arena_destroy(&tree->cold_arena);
+        free(tree);
+        errno = ENOMEM;
+        return 0;
+    }
+
+    tree->root->cold->arena = &tree->cold_arena;
+    tree->root->type = PARSER_NODE_TYPE_ROOT;
+
+    cli->trees[cli->tree_count++] = tree;
+    if (cli->current_tree == CISCLI_NO_PARENT_TREE) {
+        cli->current_tree = cli->tree_count;
+    }
+
+    return cli->tree_count;
+}
+
+ciscli_node * ciscli_get_root_for_tree(ciscli *cli, uint32_t tree)
+{
+    ciscli_tree *t;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return NULL;
+    }
+
+    return (ciscli_node *)t->root;
+}
+
+int ciscli_set_current_tree(ciscli *cli, uint32_t tree)
+{
+    int retval;
+
+    if (!ciscli_get_tree(cli, tree)) {
+        return -1;
+    }
+
+    retval = ciscli_prompt_capture(cli, tree);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    cli->current_tree = tree;
+    return 0;
+}
+
+uint32_t ciscli_get_current_tree(ciscli *cli)
+{
+    if (!cli) {
+        errno = EINVAL;
+        return CISCLI_NO_PARENT_TREE;
+    }
+
+    return cli->current_tree;
+}
+
+int ciscli_lookahead_enable(ciscli *cli, int enable)
+{
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (enable) {
+        cli->parse_flags |= PARSER_CTRL_FLAG_LOOKAHEAD;
+    } else {
+        cli->parse_flags &= ~PARSER_CTRL_FLAG_LOOKAHEAD;
+    }
+
+    return 0;
+}
+
+int ciscli_tree_freeze(ciscli *cli, uint32_t tree)
+{
+    ciscli_tree *t;
+    int retval;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    retval = parser_tree_freeze(t->root, &t->arena);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ciscli_tree_overlaps(ciscli *cli, uint32_t tree, uint32_t *overlaps)
+{
+    ciscli_tree *t;
+    int retval;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    retval = parser_tree_overlaps(t->root, overlaps);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ciscli_tree_reorder(ciscli *cli, uint32_t tree)
+{
+    ciscli_tree *t;
+    int retval;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    retval = parser_tree_reorder(t->root);
+    ciscli_tree_modified();
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ciscli_tree_share(ciscli *cli, uint32_t tree, uint32_t *shared)
+{
+    ciscli_tree *t;
+    int retval;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    retval = parser_tree_share(t->root, shared);
+    ciscli_tree_modified();
+
+    /* Rebuild the dispatch tables dropped from nodes whose children moved */
+    if (!retval && parser_tree_is_frozen(t->root)) {
+        retval = parser_tree_freeze(t->root, &t->arena);
+    }
+
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ciscli_tree_footprint(ciscli *cli, uint32_t tree, ciscli_footprint *footprint)
+{
+    parser_footprint_t fp;
+    ciscli_tree *t;
+    int retval;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    if (!footprint) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    retval = parser_tree_footprint(t->root, &fp);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    footprint->nodes = fp.nodes;
+    footprint->hot_bytes = fp.hot_bytes;
+    footprint->cold_bytes = fp.cold_bytes + fp.help_bytes;
+    footprint->dispatch_bytes = fp.dispatch_bytes;
+    footprint->reserved_bytes = t->arena.reserved + t->cold_arena.reserved;
+    return 0;
+}
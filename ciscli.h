@@ -23,6 +23,9 @@
 #define CISCLI_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 __BEGIN_DECLS;
 
@@ -70,17 +73,32 @@ typedef enum {
     CISCLI_CONSTANT,
     /** Nodes that are used to get a specific range of keywords */
     CISCLI_KW_TRIE,
+    /** Nodes that terminate a command and run its action */
+    CISCLI_EOL,
     /** Nodes that can handle an arbitrary alphanumeric string */
     CISCLI_STRING,        /* Must be the penultimate entry! */
     CISCLI_NODE_TYPE_MAX, /* Must be the last entry! */
 } ciscli_node_type;
 
+/** @brief Action callback for a command
+ *
+ * This is called when the user enters a command that ends at an EOL node.
+ * The values saved by the nodes of the command can be retrieved with the
+ * parameter API.
+ *
+ * @param   cli     A pointer to the \ref ciscli structure running the command
+ * @param   arg     The argument passed to \ref ciscli_eol_node_set_action
+ *
+ * @returns 0 on success, non-zero if the command failed.
+ */
+typedef int (*ciscli_action)(ciscli *cli, void *arg);
+
 /** @brief Constant that indicates no parent tree when creating a parse tree
  *
  * Use this as the parent value when calling \ref ciscli_tree_alloc and you
  * want to create a top level parse tree
  */
-const uint32_t CISCLI_NO_PARENT_TREE = 0;
+static const uint32_t CISCLI_NO_PARENT_TREE = 0;
 
 /** @brief Allocate a CisCLI structure
  *
@@ -100,10 +118,35 @@ ciscli * ciscli_alloc(void);
  * on this pointer, it will result in leaving the associated data structures
  * hanging around and leaking memory.
  *
+ * The nodes of each parse tree are allocated from a per-tree arena, so this
+ * releases each tree in a handful of calls rather than one per node.
+ *
  * @param   cli     A pointer to a pointer to a \ref ciscli
  */
 void ciscli_free(ciscli **cli);
 
+/** @brief Allocate a session that shares the parse trees of another
+ *
+ * A process serving many users, such as a server multiplexing connections
+ * with epoll, builds its parse trees once in a \ref ciscli structure, and
+ * allocates a session for each connection. Each session has its own mode,
+ * input, output and parameters, but parses in the trees of \p base,
+ * which should be frozen first. Sessions cannot add trees, and must be
+ * freed before \p base. Since actions and statistics may touch the shared
+ * trees, all the sessions of a base should be driven from one thread.
+ *
+ * Sessions are fed input with \ref ciscli_feed rather than reading it
+ * themselves, and hold their output until it is flushed, see
+ * \ref ciscli_next_event. The current tree and the parse flags, such as
+ * lookahead and statistics, are copied from \p base.
+ *
+ * @param   base    Structure that owns the parse trees, or NULL for a
+ *                  session that owns its trees, as \ref ciscli_alloc.
+ *
+ * @returns Pointer to the session, or NULL and sets errno.
+ */
+ciscli * ciscli_session_alloc(ciscli *base);
+
 /** @brief Create a new parse tree
  *
  * CisCLI commands are grouped into individual parse trees. This function
@@ -135,6 +178,184 @@ uint32_t ciscli_tree_alloc(ciscli *cli, const char *name, uint32_t parent);
  */
 ciscli_node * ciscli_get_root_for_tree(ciscli *cli, uint32_t tree);
 
+/** @brief Freeze a parse tree for fast command dispatch
+ *
+ * This is an optional step to be taken once a parse tree has been fully
+ * built. It compiles the keyword children of every node into a sorted
+ * dispatch table, so that the parser can locate the keywords matching a
+ * token with a binary search instead of trying each sibling in turn. The
+ * outcome of a parse, including minimum match and ambiguity handling, is
+ * identical whether the tree is frozen or not.
+ *
+ * Likewise, a node with four or more integer children that accept the same
+ * formats, such as one for each range of VLANs or ports, gets a table of
+ * their ranges sorted by minimum. The token is parsed once, and the
+ * children whose range holds its value are found with a binary search,
+ * rather than each child parsing the token again. Use \ref
+ * ciscli_tree_overlaps to find ranges that overlap.
+ *
+ * Nodes may still be added to a frozen tree. Adding a child to a node
+ * drops the dispatch tables of that node, which then falls back to trying
+ * its children in turn until the tree is frozen again.
+ *
+ * The dispatch tables are sorted by what the children match, so once a
+ * node is in a table of its parent, \ref ciscli_keyword_node_set_keyword,
+ * \ref ciscli_integer_node_set_format and \ref
+ * ciscli_integer_node_set_range fail on it with EBUSY. Adding another child
+ * to the parent drops its tables, after which the node may be changed
+ * again.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_tree_freeze(ciscli *cli, uint32_t tree);
+
+/** @brief Count the integer nodes of a parse tree whose ranges overlap
+ *
+ * A value that two integer siblings both accept makes a command that uses
+ * it ambiguous, unless lookahead settles it with the rest of the command.
+ * This counts the integer nodes whose range overlaps that of a sibling
+ * with a smaller minimum, which is 0 if no two siblings overlap. Call it
+ * once the tree is built, such as just after \ref ciscli_tree_freeze,
+ * whose range tables already hold the counts.
+ *
+ * @param   cli         A pointer to a \ref ciscli structure
+ * @param   tree        Index of the parse tree
+ * @param   overlaps    Receives the number of overlapping ranges
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_tree_overlaps(ciscli *cli, uint32_t tree, uint32_t *overlaps);
+
+/** @brief Reorder a parse tree so that the most used commands come first
+ *
+ * This uses the match counts recorded while statistics are enabled, see
+ * \ref ciscli_stats_enable. The children of each node are moved so that
+ * those that accepted the most tokens are tried first, within the order of
+ * priority of the node types. Children that were never matched keep their
+ * relative order, as do conditional and EOL nodes. The outcome of every
+ * parse is identical before and after reordering, but completion and help
+ * list the candidates in the new order.
+ *
+ * The tree must not be in use by any other thread while it is reordered.
+ * Use \ref ciscli_stats_write_profile instead to apply the same ordering
+ * when compiling the tree.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_tree_reorder(ciscli *cli, uint32_t tree);
+
+/** @brief Share identical subtrees of a parse tree
+ *
+ * Generated trees often repeat the same options below many commands, such
+ * as `vrf <name>` or `detail` followed by the same action. This finds the
+ * nodes that lead to identical commands, with the same help text, values
+ * set and actions, and links every such command to a single copy, so that
+ * the parser visits fewer distinct nodes. The outcome of every parse, and
+ * the candidates offered for completion and help, are unchanged.
+ *
+ * This is meant to be run once a tree has been fully built. A shared node
+ * cannot change afterwards, since adding a child to it would add the child
+ * below every command leading to that node, so the nodes that were linked
+ * to a single copy, the copies and every node below them are marked as
+ * shared. \ref ciscli_node_add_child fails with EBUSY when the link it
+ * would change is in a shared node, and so does every setter of a node on
+ * a shared node. Nodes that are not shared may still be changed. A frozen
+ * tree is frozen again, and the tree must not be in use by any other thread
+ * while it is shared. The match counts of the copies that are no longer linked
+ * are not carried over to the copy that is kept.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree
+ * @param   shared  Receives the number of nodes that are no longer part of
+ *                  the tree. This may be NULL.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_tree_share(ciscli *cli, uint32_t tree, uint32_t *shared);
+
+/** @brief Memory used by a parse tree
+ *
+ * Nodes are split into the data that the parser visits while walking the
+ * tree, and cold data such as help text and the values set when a keyword
+ * matches. Use \ref ciscli_tree_footprint to retrieve this.
+ */
+typedef struct {
+    /** Number of nodes in the tree */
+    uint32_t nodes;
+
+    /** Bytes of node data visited while parsing */
+    size_t hot_bytes;
+
+    /** Bytes of cold node data, including help text */
+    size_t cold_bytes;
+
+    /** Bytes of keyword dispatch and integer range tables built by \ref
+     * ciscli_tree_freeze */
+    size_t dispatch_bytes;
+
+    /** Bytes of memory obtained from the system for the tree */
+    size_t reserved_bytes;
+} ciscli_footprint;
+
+/** @brief Report the memory used by a parse tree
+ *
+ * @param   cli         A pointer to a \ref ciscli structure
+ * @param   tree        Index of the parse tree
+ * @param   footprint   Pointer to the structure to fill in
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_tree_footprint(ciscli *cli, uint32_t tree, ciscli_footprint *footprint);
+
+/** @brief Select the parse tree used for input
+ *
+ * Commands are parsed in the current parse tree, falling back to its
+ * parent trees if they are not recognized. This defaults to the first tree
+ * created. Actions may call this to change mode; the change takes effect
+ * with the next command.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_set_current_tree(ciscli *cli, uint32_t tree);
+
+/** @brief Retrieve the parse tree used for input
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ *
+ * @returns Index of the current parse tree, or \ref CISCLI_NO_PARENT_TREE
+ *          if no tree has been created.
+ */
+uint32_t ciscli_get_current_tree(ciscli *cli);
+
+/** @brief Let the rest of a command settle abbreviations that match more
+ * than one node
+ *
+ * By default, a token that is accepted by more than one node, such as `in`
+ * when a mode has both `interface` and `inventory` commands, makes the
+ * command ambiguous. With lookahead enabled, the parser follows every node
+ * that accepts such a token, and the command is only ambiguous if more
+ * than one of them leads to a complete command. Commands that are not
+ * ambiguous by default parse the same way either way.
+ *
+ * The parser still reads each token once. Up to 32 alternatives are
+ * followed at a time; a command with more is reported as ambiguous.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   enable  Non-zero to enable lookahead, 0 to disable it
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_lookahead_enable(ciscli *cli, int enable);
+
 /** @name Generic I/O API
  *
  * Use these API functions to manage input, output and error streams.
@@ -144,7 +365,8 @@ ciscli_node * ciscli_get_root_for_tree(ciscli *cli, uint32_t tree);
 /** @brief Get a line of input from the user and process it
  *
  * This function works in concert with the registered commands and processes
- * user input.
+ * user input. The prompt of the current tree, if it has one, is written
+ * before the line is read; see \ref ciscli_prompt.
  *
  * @params  cli     A pointer to a \ref ciscli structure
  *
@@ -152,6 +374,361 @@ ciscli_node * ciscli_get_root_for_tree(ciscli *cli, uint32_t tree);
  */
 int ciscli_input(ciscli *cli);
 
+/** @brief Longest line that \ref ciscli_feed holds
+ *
+ * A line that grows longer before its newline arrives is dropped, and is
+ * reported as \ref CISCLI_STATUS_TOO_LONG.
+ */
+#define CISCLI_INPUT_MAX    65536
+
+/** @brief Add input to a \ref ciscli structure without blocking
+ *
+ * The input is copied, and is processed by \ref ciscli_next_event. This is
+ * meant for a session that is driven by an event loop, which reads from
+ * the connection of the session whenever it is readable.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   buf     Input, which need not hold whole lines
+ * @param   len     Number of bytes of input
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_feed(ciscli *cli, const void *buf, size_t len);
+
+/** @brief Kinds of event returned by \ref ciscli_next_event */
+typedef enum {
+    /** No event */
+    CISCLI_EVENT_NONE = 0,
+    /** A command line was entered and run */
+    CISCLI_EVENT_LINE,
+    /** TAB was entered, asking to complete the line entered so far */
+    CISCLI_EVENT_COMPLETE,
+    /** ? was entered, asking for help on the line entered so far */
+    CISCLI_EVENT_HELP,
+} ciscli_event_type;
+
+typedef enum {
+    /** The command was run successfully */
+    CISCLI_STATUS_OK = 0,
+    /** The line is blank or a comment */
+    CISCLI_STATUS_EMPTY,
+    /** The command was not recognized */
+    CISCLI_STATUS_UNRECOGNIZED,
+    /** The line ended before the command was complete */
+    CISCLI_STATUS_INCOMPLETE,
+    /** The line matches more than one command */
+    CISCLI_STATUS_AMBIGUOUS,
+    /** The command was recognized, but its action failed */
+    CISCLI_STATUS_ACTION_FAILED,
+    /** The line is too long to be parsed */
+    CISCLI_STATUS_TOO_LONG,
+    /** The command was recognized, but its output filters are not valid */
+    CISCLI_STATUS_INVALID_FILTER,
+} ciscli_status;
+
+/** @brief Result of running a single command line
+ *
+ * Results are returned in an array with one entry per input line, so the
+ * line number is implied by the position in the array.
+ */
+typedef struct {
+    /** One of \ref ciscli_status */
+    uint8_t status;
+
+    /** Reserved, set to zero */
+    uint8_t reserved[3];
+
+    /** Offset within the line at which parsing stopped */
+    uint32_t offset;
+} ciscli_result;
+
+/** Flags controlling \ref ciscli_execute_buffer */
+enum ciscli_execute_flags {
+    /** Parse the commands without running their actions */
+    CISCLI_EXECUTE_VALIDATE_ONLY = (1 << 0),
+    /** Stop at the first line that does not run successfully */
+    CISCLI_EXECUTE_STOP_ON_ERROR = (1 << 1),
+};
+
+/** @brief Event found in the input of a \ref ciscli structure */
+typedef struct {
+    /** One of \ref ciscli_event_type */
+    uint32_t type;
+
+    /** Outcome of the command, for \ref CISCLI_EVENT_LINE */
+    ciscli_result result;
+
+    /** Command line, or the part of it entered before the request, for
+     * completion and help. It is not null terminated, and remains valid
+     * until the next call to \ref ciscli_feed or \ref ciscli_next_event. */
+    const char *line;
+
+    /** Length of the line */
+    size_t len;
+} ciscli_event;
+
+/** @brief Process the input fed to a \ref ciscli structure
+ *
+ * This processes the input up to the next event. A complete line is run
+ * exactly as \ref ciscli_input would, with the output of its action and any
+ * error message held in the output buffer. A TAB or ? is removed from the
+ * input, which keeps the line entered so far, and the caller answers it,
+ * usually by writing the candidates returned by \ref ciscli_complete for
+ * the line. Call this until it returns 0, then flush the output with
+ * \ref ciscli_flush.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   event   Receives the event
+ *
+ * @returns 1 if an event was returned, 0 if more input is needed, or -1 on
+ *          failure and sets errno accordingly.
+ */
+int ciscli_next_event(ciscli *cli, ciscli_event *event);
+
+/** @brief Retrieve the output held by a session
+ *
+ * Output is held in chunks, which are described by an array of iovecs
+ * that can be passed to writev or sendmsg.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   iov     Receives the chunks of output, oldest first, which
+ *                  remain valid until output is consumed or added. This
+ *                  may be NULL.
+ * @param   iovcnt  Number of entries in \p iov, which receives the number
+ *                  of entries filled. This may be NULL if \p iov is.
+ *
+ * @returns Number of bytes of output held, which may be more than the
+ *          chunks returned hold.
+ */
+size_t ciscli_output_pending(ciscli *cli, struct iovec *iov, int *iovcnt);
+
+/** @brief Drop output that has been sent */
+void ciscli_output_consume(ciscli *cli, size_t len);
+
+/** @brief Write the output held by a session to a file descriptor
+ *
+ * This writes until all the output has been written, or until the file
+ * descriptor would block, if it is non-blocking. Each call to writev
+ * writes up to 64 chunks. An event loop should then
+ * wait for it to become writable before calling this again.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   fd      File descriptor to write to
+ *
+ * @returns Number of bytes of output still held, or -1 on failure and sets
+ *          errno accordingly.
+ */
+ssize_t ciscli_flush(ciscli *cli, int fd);
+
+/** @brief Run every command line in a buffer
+ *
+ * This runs the commands in the buffer one after the other, exactly as if
+ * they had been entered through \ref ciscli_input, but without reading or
+ * copying each line. Lines are separated by newlines, and a trailing
+ * carriage return is ignored. Errors are reported through the results
+ * rather than written to the error stream.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   buf     Buffer holding the command lines
+ * @param   len     Length of the buffer
+ * @param   flags   Combination of \ref ciscli_execute_flags
+ * @param   results If not NULL, receives an array with the result of each
+ *                  line processed. The caller must free this array.
+ * @param   count   Receives the number of lines processed, may be NULL
+ *
+ * @returns Number of lines that did not run successfully (blank lines and
+ *          comments count as successful), or -1 on failure and sets errno
+ *          accordingly.
+ */
+int ciscli_execute_buffer(ciscli *cli, const char *buf, size_t len,
+                          uint32_t flags, ciscli_result **results,
+                          size_t *count);
+
+/** @brief Run every command line in a file
+ *
+ * The file is memory mapped and passed to \ref ciscli_execute_buffer.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   path    Path to the file
+ * @param   flags   Combination of \ref ciscli_execute_flags
+ * @param   results If not NULL, receives an array with the result of each
+ *                  line processed. The caller must free this array.
+ * @param   count   Receives the number of lines processed, may be NULL
+ *
+ * @returns Number of lines that did not run successfully, or -1 on failure
+ *          and sets errno accordingly.
+ */
+int ciscli_execute_file(ciscli *cli, const char *path, uint32_t flags,
+                        ciscli_result **results, size_t *count);
+
+/** @brief Validate the command lines in a buffer on several threads
+ *
+ * This parses every line of the buffer in the current tree without running
+ * any actions, spreading the lines across a pool of worker threads. The
+ * results are returned in input order, exactly as \ref ciscli_execute_buffer
+ * would with \ref CISCLI_EXECUTE_VALIDATE_ONLY.
+ *
+ * The current tree and its parents are frozen before the workers start, and
+ * are only read by the workers, which each own a control structure. The
+ * trees of \p cli must not be modified by any other thread until this
+ * returns; see docs/thread-safety.md.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   buf     Buffer holding the command lines
+ * @param   len     Length of the buffer
+ * @param   threads Number of worker threads, or 0 to use one per online CPU
+ * @param   results If not NULL, receives an array with the result of each
+ *                  line. The caller must free this array.
+ * @param   count   Receives the number of lines, may be NULL
+ *
+ * @returns Number of lines that failed to parse, or -1 on failure and sets
+ *          errno accordingly.
+ */
+int ciscli_validate_buffer(ciscli *cli, const char *buf, size_t len,
+                           unsigned int threads, ciscli_result **results,
+                           size_t *count);
+
+/** @brief Candidate offered for completion or help */
+typedef struct {
+    /** Keyword, or a description such as "<cr>" for other node types */
+    const char *text;
+
+    /** Help text of the node, or NULL if it has none */
+    const char *help;
+} ciscli_candidate;
+
+/** @brief Candidates for the token at the end of a command line
+ *
+ * The candidates are in the order their nodes were added to the tree, with
+ * the commands of parent trees following those of the current tree.
+ */
+typedef struct {
+    /** Number of candidates */
+    uint32_t count;
+
+    /** Length of the longest prefix shared by all keyword candidates. TAB
+     * completion can extend the token to this length. */
+    uint32_t common_length;
+
+    /** Length of the longest candidate text, to align help text */
+    uint32_t text_width;
+
+    /** Array of candidates */
+    const ciscli_candidate *candidates;
+} ciscli_completion;
+
+/** @brief List the candidates for completing a command line
+ *
+ * This is used for both TAB completion and ? help. The last token of the
+ * line is completed, or if the line is empty or ends with a space, a new
+ * token is started. If the tokens before it are not recognized, there are
+ * no candidates.
+ *
+ * Results are cached by the position in the tree and the token, so
+ * repeated requests do not walk the tree or allocate memory. The cache is
+ * discarded whenever a parse tree is modified. This reuses the control
+ * structure of \p cli, so it must not be called from an action.
+ *
+ * @param   cli         A pointer to a \ref ciscli structure
+ * @param   line        Command line, need not be null terminated
+ * @param   len         Length of the command line
+ * @param   completion  Receives a pointer to the candidates, which is owned
+ *                      by \p cli and remains valid until the next call or
+ *                      until a parse tree is modified.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_complete(ciscli *cli, const char *line, size_t len,
+                    const ciscli_completion **completion);
+
+/** @brief Longest prompt, including the null terminator */
+#define CISCLI_PROMPT_MAX   256
+
+/** @brief Set the prompt format of a parse tree
+ *
+ * The format is expanded into the prompt shown while the tree is current,
+ * and may contain these directives:
+ *
+ * - `%h` the hostname, up to its first dot, and `%H` all of it
+ * - `%m` the name of the tree
+ * - `%sN` and `%iN` string and integer parameter N of the command whose
+ *   action entered the tree, such as the interface of "interface eth1"
+ * - `%%` a percent sign
+ *
+ * A format may use up to 8 parameters, each of which is shown up to 63
+ * characters long. The format of a BPT mode header can be passed as is.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree
+ * @param   format  Prompt format, or NULL for no prompt
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly. EINVAL
+ *          indicates a format that is not valid, and EPERM a session.
+ */
+int ciscli_tree_set_prompt(ciscli *cli, uint32_t tree, const char *format);
+
+/** @brief Set the hostname shown in prompts
+ *
+ * By default, the system hostname is used, which is checked for changes
+ * at most once a second.
+ *
+ * @param   cli         A pointer to a \ref ciscli structure
+ * @param   hostname    Hostname, or NULL to use the system hostname
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_prompt_set_hostname(ciscli *cli, const char *hostname);
+
+/** @brief Render prompts with an external command
+ *
+ * This is the PromptCommand of a BPT file. The command is run with the
+ * prompt format of the current tree as its only argument, and the first
+ * line of its output is the prompt. It is only run when the prompt would
+ * change, such as on a change of mode, and if it fails the prompt is
+ * rendered as if there were no command. Prompts are rendered without
+ * running a command by default.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   command Command, looked up in PATH, or NULL not to run one
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_prompt_set_command(ciscli *cli, const char *command);
+
+/** @brief Retrieve the prompt of the current tree
+ *
+ * The prompt is rendered again only when one of its inputs has changed,
+ * so this is cheap to call before every line. \ref ciscli_input writes it
+ * before reading each line; an event loop driving a session should write
+ * it after each line it runs.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   len     Receives the length of the prompt, may be NULL
+ *
+ * @returns The prompt, which is empty if the tree has no prompt format and
+ *          remains valid until the next call, or NULL on failure and sets
+ *          errno accordingly.
+ */
+const char * ciscli_prompt(ciscli *cli, size_t *len);
+
+/** @brief Set the number of lines on a page of output
+ *
+ * Once a command has printed a page of output, less one line for the
+ * prompt, the pager shows "--More--" and waits for a key on the input
+ * stream. Space shows the next page, Enter the next line, and q drops the
+ * rest of the output. The command itself waits until the key is pressed,
+ * so output is never held for more than a page. The pager is off by
+ * default, and should only be turned on when the input and output streams
+ * are a terminal. Sessions cannot page, since a session cannot wait for
+ * input in the middle of a command.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   lines   Number of lines on the terminal, or 0 not to page
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_pager_set(ciscli *cli, uint32_t lines);
+
 /* GCC attribute to indicate that this is a printf style function */
 #if __GNUC__
 #define PRINTF_ATTR __attribute__ ((format (printf, 2, 3)))
@@ -164,18 +741,34 @@ int ciscli_input(ciscli *cli);
  * This function takes a printf style format specifier and writes the formatted
  * string to the output file descriptor.
  *
+ * The output of a command is held in chunks, and written with a single
+ * writev once 64KB is held, once the oldest of it has been held for 50ms,
+ * and when the command is done, so that a command printing many lines
+ * does not make a system call for each. Output printed outside of a
+ * command, such as a prompt, is written at once. A session holds all of
+ * its output until it is flushed, see \ref ciscli_flush.
+ *
+ * If the command line ends with output filters, such as "| include
+ * pattern", only the lines they select are shown. If the pager is on, the
+ * command waits in this function at the end of each page until a key is
+ * pressed.
+ *
  * @param   cli     A pointer to a \ref ciscli structure
  * @param   fmt     A printf-style format string
  * @param   ...     Arguments for the format string
  *
  * @returns Number of characters in the formatted output, negative if failure.
+ *          Once the pager has been quit, the rest of the output of the
+ *          command is dropped, and this fails with EPIPE, so that the
+ *          command can stop early.
  */
 int ciscli_print(ciscli *cli, const char *fmt, ...) PRINTF_ATTR;
 
 /** @brief Write formatted text to the error stream
  *
  * This function takes a printf style format specifier and writes the formatted
- * string to the error file descriptor.
+ * string to the error file descriptor. Errors are not filtered, and are
+ * written at once, after any output held.
  *
  * @param   cli     A pointer to a \ref ciscli structure
  * @param   fmt     A printf-style format string
@@ -187,6 +780,125 @@ int ciscli_error(ciscli *cli, const char *fmt, ...) PRINTF_ATTR;
 
 /** @} */
 
+/** @name Statistics API
+ *
+ * Use these API functions to find the commands that are used the most, and
+ * the nodes and modes that are slow to parse. Statistics are off until
+ * enabled with \ref ciscli_stats_enable, and cost nothing while off. They
+ * can be compiled out altogether by building with PARSER_NO_STATS, in
+ * which case these functions fail with ENOTSUP.
+ */
+/** @{ */
+
+/** Number of buckets in the latency histogram of a mode */
+#define CISCLI_STATS_LATENCY_BUCKETS    32
+
+/** @brief Statistics of the lines parsed in a mode
+ *
+ * A line is counted in the mode it was entered in, even if it was
+ * recognized by a parent mode. Blank lines and comments are not counted.
+ */
+typedef struct {
+    /** Number of lines parsed */
+    uint64_t lines;
+
+    /** Number of lines that were not recognized, incomplete or ambiguous */
+    uint64_t failed;
+
+    /** Number of nodes passed over in child chains before a sibling
+     * accepted the token, over all lines */
+    uint64_t probes;
+
+    /** Largest number of nodes passed over in a single child chain */
+    uint32_t probe_depth_max;
+
+    /** Reserved, set to 0 */
+    uint32_t reserved;
+
+    /** Histogram of the time taken to parse a line. Bucket N counts the
+     * lines that took at least 2^N and less than 2^(N+1) nanoseconds,
+     * except that bucket 0 also counts lines that took less than 1ns and
+     * the last bucket also counts all longer lines. */
+    uint64_t latency[CISCLI_STATS_LATENCY_BUCKETS];
+} ciscli_mode_stats;
+
+/** @brief Statistics of a node */
+typedef struct {
+    /** Number of tokens the node accepted */
+    uint64_t matches;
+
+    /** Number of times the node was passed over because the token was
+     * accepted by a later sibling or by none. Nodes with a high count
+     * relative to their siblings slow down parsing unless the tree is
+     * frozen, and are candidates to move later in the child chain. */
+    uint64_t rejects;
+} ciscli_node_stats;
+
+/** @brief Enable or disable statistics
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   enable  Non-zero to enable statistics, 0 to disable them
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_stats_enable(ciscli *cli, int enable);
+
+/** @brief Retrieve the statistics of a mode
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree of the mode
+ * @param   stats   Pointer to the structure to fill in
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_stats_get_mode(ciscli *cli, uint32_t tree, ciscli_mode_stats *stats);
+
+/** @brief Retrieve the statistics of a node
+ *
+ * @param   node    Pointer to the \ref ciscli_node
+ * @param   stats   Pointer to the structure to fill in
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_stats_get_node(ciscli_node *node, ciscli_node_stats *stats);
+
+/** @brief Clear the statistics of every mode and node
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_stats_reset(ciscli *cli);
+
+/** @brief Write the statistics as text
+ *
+ * For each mode, this writes the line counts and the latency histogram,
+ * followed by the counts of every node that has been matched or passed
+ * over, identified by the command leading to it.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   fd      File descriptor to write to
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_stats_dump(ciscli *cli, int fd);
+
+/** @brief Write the match counts as a profile for the BPT compiler
+ *
+ * The profile lists, for each mode, the command leading to every node that
+ * accepted a token and the number of tokens it accepted. The compiler uses
+ * it to lay out the nodes of a BPT file in the order that
+ * \ref ciscli_tree_reorder would give them, see docs/compiler-format.md.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   fd      File descriptor to write to
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_stats_write_profile(ciscli *cli, int fd);
+
+/** @} */
+
 /** @name Generic Node API
  *
  * Use these API functions to manage nodes. These are generic and should work
@@ -201,12 +913,21 @@ int ciscli_error(ciscli *cli, const char *fmt, ...) PRINTF_ATTR;
  * This will return a pointer to the allocated node and you will need to use
  * this pointer to initialize the node with your required values.
  *
+ * The node is allocated from the arena of the given parse tree, and lives
+ * until the \ref ciscli structure is freed. Nodes are laid out in memory in
+ * the order they are allocated, so allocating the nodes of a command before
+ * moving on to the next one (i.e., in depth-first order) keeps each command
+ * contiguous and makes parsing more cache friendly. A node must only be
+ * added to the tree it was allocated from.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the parse tree that will hold the node
  * @param   type    Type of the node to allocate.
  *
  * @returns Pointer to the allocated node. If it fails for any reason, it
  *          returns NULL and sets errno accordingly.
  */
-ciscli_node * ciscli_node_alloc(ciscli_node_type type);
+ciscli_node * ciscli_node_alloc(ciscli *cli, uint32_t tree, ciscli_node_type type);
 
 /** @brief Add help text to a command node
  *
@@ -226,12 +947,147 @@ int ciscli_node_add_help_text(ciscli_node *node, const char *help);
  * @param   parent  Pointer to the node which is the parent
  * @param   child   Pointer to the node to add as a child
  *
- * @returns 0 on success, -1 and sets errno on failure
+ * @returns 0 on success, -1 and sets errno on failure. errno is EBUSY if
+ *          the parent, or its last child, is shared, see
+ *          \ref ciscli_tree_share.
  */
 int ciscli_node_add_child(ciscli_node *parent, ciscli_node *child);
 
 /** @} */
 
+/** @name Parameter API
+ *
+ * Use these API functions from within an action to retrieve the values saved
+ * by the nodes of the command being run.
+ */
+/** @{ */
+
+/** @brief Retrieve an integer parameter
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   index   Index of the integer
+ * @param   value   Receives the value
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_get_integer(ciscli *cli, uint32_t index, int64_t *value);
+
+/** @brief Retrieve a string parameter
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   index   Index of the string
+ * @param   value   Receives a pointer to the null terminated string, which
+ *                  remains valid until the action returns.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_get_string(ciscli *cli, uint32_t index, const char **value);
+
+/** @brief Retrieve a string parameter without copying it
+ *
+ * String parameters usually refer to the command line, and are only copied
+ * by \ref ciscli_get_string to add a null terminator. This returns the
+ * characters where they are instead.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   index   Index of the string
+ * @param   value   Receives a pointer to the characters of the string,
+ *                  which are not necessarily null terminated, and remain
+ *                  valid until the action returns.
+ * @param   len     Receives the length of the string
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_get_string_span(ciscli *cli, uint32_t index, const char **value,
+                           size_t *len);
+
+/** @brief Retrieve a floating point parameter
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   index   Index of the number
+ * @param   value   Receives the value
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_get_number(ciscli *cli, uint32_t index, double *value);
+
+/** Address families of a \ref ciscli_address */
+enum ciscli_address_family {
+    CISCLI_AF_NONE = 0, /**< No address has been saved */
+    CISCLI_AF_IPV4,     /**< IPv4 address */
+    CISCLI_AF_IPV6,     /**< IPv6 address */
+    CISCLI_AF_MAC,      /**< Ethernet MAC address */
+};
+
+/** @brief Address saved by an address node */
+typedef struct {
+    /** Address family, one of \ref ciscli_address_family */
+    uint8_t af;
+    /** Prefix length, which is the full length if none was entered */
+    uint8_t mask;
+    /** Address in network byte order */
+    uint8_t addr[16];
+} ciscli_address;
+
+/** @brief Retrieve an address parameter
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   index   Index of the address
+ * @param   value   Receives the address
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_get_address(ciscli *cli, uint32_t index, ciscli_address *value);
+
+/** @} */
+
+/** @name EOL Node API
+ *
+ * Use these API functions to manage EOL nodes, which terminate a command.
+ * A command is complete when the node that accepts its last token has an
+ * EOL node as a child.
+ */
+/** @{ */
+
+/** @brief Set the action to run for an EOL node
+ *
+ * @param   node    Pointer to the allocated \ref ciscli_node
+ * @param   action  Callback to run when the command is entered
+ * @param   arg     Opaque argument passed to the callback
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_eol_node_set_action(ciscli_node *node, ciscli_action action, void *arg);
+
+/** @} */
+
+/** @name Conditional Node API
+ *
+ * Use these API functions to manage conditional nodes, which branch the
+ * parse chain based on the parameters saved by the preceding nodes. A
+ * conditional node consumes no input; when its condition holds, its
+ * children are considered along with the children of its parent.
+ */
+/** @{ */
+
+/** @brief Set the condition of a conditional node
+ *
+ * The condition is bytecode in the format described in
+ * docs/conditional-nodes.md. It is verified and translated when it is set,
+ * so invalid bytecode is rejected here rather than when parsing. Until a
+ * condition is set, the branch of the node is never taken.
+ *
+ * @param   node    Pointer to the allocated \ref ciscli_node
+ * @param   code    Pointer to the condition bytecode
+ * @param   len     Length of the bytecode
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_conditional_node_set_condition(ciscli_node *node,
+                                          const uint8_t *code, size_t len);
+
+/** @} */
+
 /** @name Keyword Node API
  *
  * Use these API functions to manage keyword nodes, which can handle constant
@@ -242,12 +1098,15 @@ int ciscli_node_add_child(ciscli_node *parent, ciscli_node *child);
 /** @brief Set the keyword for a keyword node
  *
  * In order to use a keyword node, you must set the keyword it matches before
- * adding it to the parse tree.
+ * adding it to the parse tree. The keyword of a node that is in the
+ * dispatch table of its parent, built by \ref ciscli_tree_freeze, cannot be
+ * changed.
  *
  * @param   node    Pointer to the allocated \ref ciscli_node
  * @param   kw      Pointer to a null-terminated char string that contains the
  *                  keyword to match.
- * @returns 0 on success, -1 on failure and sets errno accordingly.
+ * @returns 0 on success, -1 on failure and sets errno accordingly. errno is
+ *          EBUSY if the node is in a dispatch table, or is shared.
  */
 int ciscli_keyword_node_set_keyword(ciscli_node *node, const char *kw);
 
@@ -312,7 +1171,7 @@ int ciscli_keyword_node_on_match_set_string(ciscli_node *node, uint32_t index, c
 /** @name Integer Node API
  *
  * Use these API functions to manage integer nodes, which can handle a range
- * of integers in decimal, hexadecimal and octal formats.
+ * of integers in decimal, hexadecimal, octal and binary formats.
  */
 /** @{ */
 
@@ -321,6 +1180,7 @@ enum ciscli_integer_format {
     CISCLI_INTEGER_DEC = (1 << 0),  /**< Accepts decimal format */
     CISCLI_INTEGER_HEX = (1 << 1),  /**< Accepts hexadecimal format */
     CISCLI_INTEGER_OCT = (1 << 2),  /**< Accepts octal format */
+    CISCLI_INTEGER_BIN = (1 << 3),  /**< Accepts binary format */
 };
 
 /** @brief Set the index into which to store the parsed integer
@@ -341,13 +1201,16 @@ int ciscli_integer_node_set_index(ciscli_node *node, uint32_t index);
  *
  * This is an optional function which specifies the formats that are parsed
  * by the node. If this function is not called on a node, then it defaults to
- * accepting all 3 formats - decimal, hexadecimal and octal.
+ * accepting decimal, hexadecimal and octal. Like the range, the formats
+ * should be set before the node is added to the tree.
  *
  * @param   node    Pointer to the allocated \ref ciscli_node
  * @param   format  Bitmask of formats accepted. Can be any combination of
  *                  the fields of \ref ciscli_integer_format.
  *
- * @returns 0 on success, -1 on failure and sets errno accordingly.
+ * @returns 0 on success, -1 on failure and sets errno accordingly. errno is
+ *          EBUSY if the node is in the range table of its parent, see
+ *          \ref ciscli_tree_freeze, or is shared.
  */
 int ciscli_integer_node_set_format(ciscli_node *node, uint32_t format);
 
@@ -361,16 +1224,95 @@ int ciscli_integer_node_set_format(ciscli_node *node, uint32_t format);
  * match the specified integer and use the corresponding set functions to
  * set it into the \ref ciscli structure.
  *
+ * The range should be set before the node is added to the tree, since the
+ * range table built for its parent when the tree is frozen keeps a copy of
+ * it.
+ *
  * @param   node    Pointer to the allocated \ref ciscli node
  * @param   min     Minimum value accepted by this node.
  * @param   max     Maximum value accepted by this node.
  *
- * @returns 0 on success, -1 on failure and sets errno accordingly.
+ * @returns 0 on success, -1 on failure and sets errno accordingly. errno is
+ *          EBUSY if the node is in the range table of its parent, see
+ *          \ref ciscli_tree_freeze, or is shared.
  */
 int ciscli_integer_node_set_range(ciscli_node *node, int64_t min, int64_t max);
 
 /** @} */
 
+/** @name Number Node API
+ *
+ * Use these API functions to manage number nodes, which can handle a range
+ * of double precision floating point numbers, such as `-1.5` or `2.5e-3`.
+ */
+/** @{ */
+
+/** @brief Set the index into which to store the parsed number
+ *
+ * @param   node    Pointer to the allocated \ref ciscli_node
+ * @param   index   Index into which to save the parsed number.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_number_node_set_index(ciscli_node *node, uint32_t index);
+
+/** @brief Set the range of numbers accepted by the node.
+ *
+ * If you do not call this function, the node accepts any finite number.
+ * \p max must not be less than \p min.
+ *
+ * @param   node    Pointer to the allocated \ref ciscli node
+ * @param   min     Minimum value accepted by this node.
+ * @param   max     Maximum value accepted by this node.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_number_node_set_range(ciscli_node *node, double min, double max);
+
+/** @} */
+
+/** @name Address Node API
+ *
+ * Use these API functions to manage the nodes allocated as
+ * \ref CISCLI_IPADDR or \ref CISCLI_MACADDR, which save a
+ * \ref ciscli_address.
+ */
+/** @{ */
+
+/** Flags to indicate the formats accepted by an address node. */
+enum ciscli_address_format {
+    CISCLI_ADDRESS_IPV4 = (1 << 0),     /**< Accepts `A.B.C.D` */
+    CISCLI_ADDRESS_IPV6 = (1 << 1),     /**< Accepts `X:X:X:X::X` */
+    CISCLI_ADDRESS_MAC = (1 << 2),      /**< Accepts `H.H.H`, `H:H:H:H:H:H` */
+    /** IP addresses must have a prefix length, as in `A.B.C.D/nn` */
+    CISCLI_ADDRESS_PREFIX = (1 << 3),
+};
+
+/** @brief Set the index into which to store the parsed address
+ *
+ * @param   node    Pointer to the allocated \ref ciscli_node
+ * @param   index   Index into which to save the parsed address.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_address_node_set_index(ciscli_node *node, uint32_t index);
+
+/** @brief Set the formats accepted by the address node
+ *
+ * IP address nodes default to accepting IPv4 and IPv6 addresses without a
+ * prefix length, and MAC address nodes default to MAC addresses.
+ *
+ * @param   node    Pointer to the allocated \ref ciscli_node
+ * @param   format  Bitmask of formats accepted. Can be any combination of
+ *                  the fields of \ref ciscli_address_format, other than
+ *                  \ref CISCLI_ADDRESS_PREFIX alone.
+ *
+ * @returns 0 on success, -1 on failure and sets errno accordingly.
+ */
+int ciscli_address_node_set_format(ciscli_node *node, uint32_t format);
+
+/** @} */
+
 /** @} */
 
 __END_DECLS;
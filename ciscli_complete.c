@@ -0,0 +1,372 @@
+/****************************************************************************
+ * CisCLI completion and help
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ciscli_private.h"
+#include "parser_node_keyword.h"
+
+/* Number of entries in the completion cache, must be a power of 2 */
+#define COMPLETION_CACHE_SIZE   64
+
+/* Maximum number of trees merged when completing at the root of a tree */
+#define COMPLETION_LINEAGE_MAX  16
+
+/* Completion results for a position in a tree and a typed prefix */
+typedef struct {
+    /* Node the candidates are children of, NULL if the entry is unused */
+    PARSER_NODE *node;
+
+    /* Value of ciscli_tree_generation when the entry was built */
+    uint32_t generation;
+
+    /* Typed prefix, which is at most a keyword long */
+    uint32_t prefix_len;
+    char prefix[KEYWORD_LENGTH_MAX];
+
+    /* Result handed out to callers */
+    ciscli_completion result;
+
+    /* Candidate array and the text it points to, in a single allocation */
+    void *storage;
+} completion_entry;
+
+struct ciscli_completion_cache_s {
+    completion_entry entries[COMPLETION_CACHE_SIZE];
+
+    /* Entry for results that cannot be cached */
+    completion_entry scratch;
+};
+
+/* Candidates collected while building an entry */
+typedef struct {
+    PARSER_NODE **nodes;
+    size_t *offsets;
+    uint32_t count;
+    uint32_t alloc;
+
+    char *text;
+    size_t text_len;
+    size_t text_size;
+
+    /* Set when merging the candidates of a parent tree */
+    int dedup;
+} completion_builder;
+
+static const ciscli_completion empty_completion;
+
+static void entry_clear(completion_entry *entry)
+{
+    free(entry->storage);
+    memset(entry, 0, sizeof(*entry));
+}
+
+void ciscli_completion_cache_free(struct ciscli_completion_cache_s *cache)
+{
+    uint32_t i;
+
+    if (!cache) {
+        return;
+    }
+
+    for (i = 0; i < COMPLETION_CACHE_SIZE; i++) {
+        free(cache->entries[i].storage);
+    }
+    free(cache->scratch.storage);
+    free(cache);
+}
+
+static uint32_t completion_hash(const PARSER_NODE *node, PARSER_CTRL *ctl,
+                                const parser_token_t *prefix)
+{
+    uintptr_t ptr = (uintptr_t)node;
+    uint32_t hash;
+    uint32_t i;
+
+    /* Carry on the FNV-1a hash of the prefix over the node pointer */
+    hash = prefix ? parser_control_token_hash(ctl, prefix)
+                  : PARSER_TOKEN_HASH_EMPTY;
+    for (i = 0; i < sizeof(ptr); i++) {
+        hash = (hash ^ ((ptr >> (i * 8)) & 0xFF)) * 16777619u;
+    }
+
+    return hash & (COMPLETION_CACHE_SIZE - 1);
+}
+
+static int collect(PARSER_NODE *node, const char *text, void *arg)
+{
+    completion_builder *b = arg;
+    size_t len = strlen(text) + 1;
+    PARSER_NODE **nodes;
+    size_t *offsets;
+    size_t size;
+    char *buf;
+    uint32_t i;
+
+    /* The same command may be offered by more than one tree */
+    for (i = 0; b->dedup && i < b->count; i++) {
+        if (!strcmp(&b->text[b->offsets[i]], text)) {
+            return 0;
+        }
+    }
+
+    if (b->count == b->alloc) {
+        b->alloc = b->alloc ? b->alloc * 2 : 16;
+        nodes = realloc(b->nodes, b->alloc * sizeof(*nodes));
+        if (!nodes) {
+            return -ENOMEM;
+        }
+        b->nodes = nodes;
+
+        offsets = realloc(b->offsets, b->alloc * sizeof(*offsets));
+        if (!offsets) {
+            return -ENOMEM;
+        }
+        b->offsets = offsets;
+    }
+
+    if (b->text_len + len > b->text_size) {
+        size = b->text_size ? b->text_size * 2 : 256;
+        while (size < b->text_len + len) {
+            size *= 2;
+        }
+        buf = realloc(b->text, size);
+        if (!buf) {
+            return -ENOMEM;
+        }
+        b->text = buf;
+        b->text_size = size;
+    }
+
+    memcpy(&b->text[b->text_len], text, len);
+    b->nodes[b->count] = node;
+    b->offsets[b->count] = b->text_len;
+    b->text_len += len;
+    b->count++;
+    return 0;
+}
+
+/* Lay the candidates and their text out in one block */
+static int entry_fill(completion_entry *entry, completion_builder *b)
+{
+    ciscli_candidate *candidates;
+    const char *first = NULL;
+    const char *text;
+    uint32_t common = 0;
+    uint32_t width = 0;
+    uint32_t len;
+    uint32_t i;
+    char *pool;
+
+    entry->storage = malloc(b->count * sizeof(*candidates) + b->text_len + 1);
+    if (!entry->storage) {
+        return -ENOMEM;
+    }
+
+    candidates = entry->storage;
+    pool = (char *)&candidates[b->count];
+    if (b->text_len) {
+        memcpy(pool, b->text, b->text_len);
+    }
+
+    for (i = 0; i < b->count; i++) {
+        text = &pool[b->offsets[i]];
+        candidates[i].text = text;
+        candidates[i].help = b->nodes[i]->cold ? b->nodes[i]->cold->help_text
+                                               : NULL;
+
+        len = strlen(text);
+        if (len > width) {
+            width = len;
+        }
+
+        /* Only keywords can be completed by inserting text */
+        if (b->nodes[i]->type != PARSER_NODE_TYPE_KEYWORD) {
+            continue;
+        }
+
+        if (!first) {
+            first = text;
+            common = len;
+        } else {
+            while (common && strncmp(first, text, common)) {
+                common--;
+            }
+        }
+    }
+
+    entry->result.count = b->count;
+    entry->result.common_length = common;
+    entry->result.text_width = width;
+    entry->result.candidates = candidates;
+    return 0;
+}
+
+static int has_conditional(const PARSER_NODE *node)
+{
+    const PARSER_NODE *child;
+
+    for (child = node->child; child; child = child->sibling) {
+        if (child->type == PARSER_NODE_TYPE_CONDITIONAL) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int ciscli_complete(ciscli *cli, const char *line, size_t len,
+                    const ciscli_completion **completion)
+{
+    PARSER_NODE *roots[COMPLETION_LINEAGE_MAX];
+    struct ciscli_completion_cache_s *cache;
+    const parser_token_t *prefix;
+    completion_entry *entry;
+    completion_builder b;
+    ciscli_tree *tree;
+    PARSER_NODE *node = NULL;
+    uint32_t nroots = 0;
+    uint32_t prefix_len;
+    uint32_t generation;
+    uint32_t start;
+    uint32_t i;
+    int cacheable;
+    int retval;
+
+    if (!cli || !completion || (!line && len) || len > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!cli->completions) {
+        cli->completions = calloc(1, sizeof(*cli->completions));
+        if (!cli->completions) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    cache = cli->completions;
+
+    /* The token being completed runs from the last space to the end */
+    start = len;
+    while (start && line[start - 1] != ' ') {
+        start--;
+    }
+    prefix_len = len - start;
+
+    /*
+     * Find the node reached by the tokens before the one being completed,
+     * in the first tree of the lineage that recognizes them.
+     */
+    tree = ciscli_get_tree(cli, cli->current_tree);
+    while (tree) {
+        parser_control_init(cli->ctl, line, start);
+        retval = parser_walk(tree->root, cli->ctl, &node);
+        if (retval == PARSER_RESULT_OK) {
+            break;
+        }
+
+        node = NULL;
+        if (retval != PARSER_RESULT_UNRECOGNIZED ||
+            tree->parent == CISCLI_NO_PARENT_TREE) {
+            break;
+        }
+        tree = ciscli_get_tree(cli, tree->parent);
+    }
+
+    if (!node) {
+        *completion = &empty_completion;
+        return 0;
+    }
+
+    /* At the start of a command, the commands of parent trees also apply */
+    roots[nroots++] = node;
+    if (node == tree->root) {
+        while (tree->parent != CISCLI_NO_PARENT_TREE &&
+               nroots < COMPLETION_LINEAGE_MAX) {
+            tree = ciscli_get_tree(cli, tree->parent);
+            roots[nroots++] = tree->root;
+        }
+    }
+
+    /* Position the control structure at the token being completed */
+    cli->ctl->command_length = len;
+    cli->ctl->total_parsed = start;
+    parser_control_tokenize(cli->ctl);
+    prefix = parser_control_token(cli->ctl);
+
+    /*
+     * The candidates below conditional nodes depend on the parameters
+     * saved so far, so they cannot be keyed by position alone.
+     */
+    cacheable = prefix_len <= KEYWORD_LENGTH_MAX;
+    for (i = 0; i < nroots && cacheable; i++) {
+        cacheable = !has_conditional(roots[i]);
+    }
+
+    generation = __atomic_load_n(&ciscli_tree_generation, __ATOMIC_RELAXED);
+    if (cacheable) {
+        entry = &cache->entries[completion_hash(node, cli->ctl, prefix)];
+        if (entry->node == node && entry->generation == generation &&
+            entry->prefix_len == prefix_len &&
+            !memcmp(entry->prefix, &line[start], prefix_len)) {
+            *completion = &entry->result;
+            return 0;
+        }
+    } else {
+        entry = &cache->scratch;
+    }
+
+    entry_clear(entry);
+
+    memset(&b, 0, sizeof(b));
+    retval = 0;
+    for (i = 0; i < nroots && !retval; i++) {
+        b.dedup = i > 0;
+        retval = parser_node_candidates(roots[i], cli->ctl, collect, &b);
+    }
+
+    if (!retval) {
+        retval = entry_fill(entry, &b);
+    }
+
+    free(b.nodes);
+    free(b.offsets);
+    free(b.text);
+
+    if (retval) {
+        entry_clear(entry);
+        errno = -retval;
+        return -1;
+    }
+
+    if (cacheable) {
+        entry->node = node;
+        entry->generation = generation;
+        entry->prefix_len = prefix_len;
+        memcpy(entry->prefix, &line[start], prefix_len);
+    }
+
+    *completion = &entry->result;
+    return 0;
+}
@@ -0,0 +1,436 @@
+/****************************************************************************
+ * CisCLI command execution
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ciscli_private.h"
+
+/* Probe counts of every tree tried for a line, for the statistics */
+typedef struct {
+    uint32_t probes;
+    uint32_t depth;
+} parse_probes;
+
+static int parse_in_tree(ciscli *cli, ciscli_tree *tree, PARSER_CTRL *ctl,
+                         const char *line, uint32_t len,
+                         parser_node_eol_t **eol, parse_probes *probes)
+{
+    int retval;
+
+    parser_control_init(ctl, line, len);
+    ctl->flags = cli->parse_flags;
+    retval = parser_parse(tree->root, ctl, eol);
+
+    probes->probes += ctl->probes;
+    if (ctl->probe_depth_max > probes->depth) {
+        probes->depth = ctl->probe_depth_max;
+    }
+
+    return retval;
+}
+
+static parser_node_eol_t * parse_line(ciscli *cli, ciscli_tree *tree,
+                                      PARSER_CTRL *ctl, const char *line,
+                                      size_t len, ciscli_result *result,
+                                      parse_probes *probes)
+{
+    parser_node_eol_t *eol = NULL;
+    uint32_t offset;
+    int retval;
+    int status;
+
+    retval = parse_in_tree(cli, tree, ctl, line, len, &eol, probes);
+    status = retval;
+    offset = ctl->total_parsed;
+
+    /*
+     * A command that is not recognized in the current tree may belong to
+     * one of its parents. If none of them recognize it either, report the
+     * error from the current tree.
+     */
+    while (retval == PARSER_RESULT_UNRECOGNIZED &&
+           tree->parent != CISCLI_NO_PARENT_TREE) {
+        tree = ciscli_get_tree(cli, tree->parent);
+        retval = parse_in_tree(cli, tree, ctl, line, len, &eol, probes);
+        if (retval != PARSER_RESULT_UNRECOGNIZED) {
+            status = retval;
+            offset = ctl->total_parsed;
+        }
+    }
+
+    result->offset = offset;
+
+    switch (status) {
+    case PARSER_RESULT_OK:
+        result->status = CISCLI_STATUS_OK;
+        return eol;
+
+    case PARSER_RESULT_EMPTY:
+        result->status = CISCLI_STATUS_EMPTY;
+        break;
+
+    case PARSER_RESULT_INCOMPLETE:
+        result->status = CISCLI_STATUS_INCOMPLETE;
+        break;
+
+    case PARSER_RESULT_AMBIGUOUS:
+        result->status = CISCLI_STATUS_AMBIGUOUS;
+        break;
+
+    default:
+        result->status = CISCLI_STATUS_UNRECOGNIZED;
+        break;
+    }
+
+    return NULL;
+}
+
+parser_node_eol_t * ciscli_parse_line(ciscli *cli, uint32_t tree_index,
+                                      PARSER_CTRL *ctl, const char *line,
+                                      size_t len, ciscli_result *result)
+{
+    parser_node_eol_t *eol;
+    parse_probes probes = { 0, 0 };
+    ciscli_tree *tree;
+    uint64_t start;
+
+    memset(result, 0, sizeof(*result));
+
+    /* Output filters are applied when the command runs */
+    len = ciscli_filter_split(line, len);
+    while (len && line[len - 1] == ' ') {
+        len--;
+    }
+
+    if (len > UINT32_MAX) {
+        result->status = CISCLI_STATUS_TOO_LONG;
+        return NULL;
+    }
+
+    tree = ciscli_get_tree(cli, tree_index);
+    if (!tree) {
+        result->status = CISCLI_STATUS_UNRECOGNIZED;
+        return NULL;
+    }
+
+    if (!(cli->parse_flags & PARSER_CTRL_FLAG_STATS)) {
+        return parse_line(cli, tree, ctl, line, len, result, &probes);
+    }
+
+    start = ciscli_stats_clock();
+    eol = parse_line(cli, tree, ctl, line, len, result, &probes);
+    ciscli_stats_record(tree, result, probes.probes, probes.depth,
+                        ciscli_stats_clock() - start);
+    return eol;
+}
+
+int ciscli_line_filter(const char *line, size_t len, ciscli_filter **filter,
+                       ciscli_result *result)
+{
+    ciscli_filter *compiled = NULL;
+    size_t offset;
+    size_t pipe;
+
+    pipe = ciscli_filter_split(line, len);
+    if (pipe < len &&
+        ciscli_filter_compile(line + pipe, len - pipe, &compiled, &offset)) {
+        result->status = CISCLI_STATUS_INVALID_FILTER;
+        result->offset = pipe + offset;
+        return -1;
+    }
+
+    if (filter) {
+        *filter = compiled;
+    } else {
+        ciscli_filter_free(compiled);
+    }
+
+    return 0;
+}
+
+void ciscli_execute_line(ciscli *cli, const char *line, size_t len,
+                         uint32_t flags, ciscli_result *result)
+{
+    parser_node_eol_t *eol;
+    ciscli_filter *filter;
+    int retval;
+
+    eol = ciscli_parse_line(cli, cli->current_tree, cli->ctl, line, len,
+                            result);
+    if (!eol || ciscli_line_filter(line, len, &filter, result)) {
+        return;
+    }
+
+    if ((flags & CISCLI_EXECUTE_VALIDATE_ONLY) || !eol->action) {
+        ciscli_filter_free(filter);
+        return;
+    }
+
+    ciscli_output_begin(cli, filter);
+    retval = ((ciscli_action)eol->action)(cli, eol->arg);
+
+    /* An action that stops because the pager was quit has not failed */
+    if (!ciscli_output_end(cli) && retval) {
+        result->status = CISCLI_STATUS_ACTION_FAILED;
+    }
+}
+
+static size_t count_lines(const char *buf, size_t len)
+{
+    const char *end = buf + len;
+    const char *nl;
+    size_t lines = 0;
+
+    while (buf < end) {
+        lines++;
+        nl = memchr(buf, '\n', end - buf);
+        if (!nl) {
+            break;
+        }
+        buf = nl + 1;
+    }
+
+    return lines;
+}
+
+int ciscli_execute_buffer(ciscli *cli, const char *buf, size_t len,
+                          uint32_t flags, ciscli_result **results,
+                          size_t *count)
+{
+    ciscli_result *res = NULL;
+    ciscli_result scratch;
+    ciscli_result *r;
+    const char *end;
+    const char *nl;
+    size_t line_len;
+    size_t lines;
+    size_t n;
+    int failed;
+
+    if (!cli || (!buf && len)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (results) {
+        /* Counting first means the result array is allocated only once */
+        lines = count_lines(buf, len);
+        res = calloc(lines ? lines : 1, sizeof(*res));
+        if (!res) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    end = buf + len;
+    failed = 0;
+    n = 0;
+    while (buf < end) {
+        nl = memchr(buf, '\n', end - buf);
+        line_len = (nl ? nl : end) - buf;
+        if (line_len && buf[line_len - 1] == '\r') {
+            line_len--;
+        }
+
+        r = res ? &res[n] : &scratch;
+        ciscli_execute_line(cli, buf, line_len, flags, r);
+        n++;
+
+        if (r->status != CISCLI_STATUS_OK && r->status != CISCLI_STATUS_EMPTY) {
+            failed++;
+            if (flags & CISCLI_EXECUTE_STOP_ON_ERROR) {
+                break;
+            }
+        }
+
+        if (!nl) {
+            break;
+        }
+        buf = nl + 1;
+    }
+
+    if (results) {
+        *results = res;
+    }
+
+    if (count) {
+        *count = n;
+    }
+
+    return failed;
+}
+
+int ciscli_execute_file(ciscli *cli, const char *path, uint32_t flags,
+                        ciscli_result **results, size_t *count)
+{
+    struct stat st;
+    void *map;
+    int retval;
+    int err;
+    int fd;
+
+    if (!cli || !path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return ciscli_execute_buffer(cli, "", 0, flags, results, count);
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    err = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = err;
+        return -1;
+    }
+
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    retval = ciscli_execute_buffer(cli, map, st.st_size, flags, results, count);
+    err = errno;
+
+    munmap(map, st.st_size);
+    errno = err;
+    return retval;
+}
+
+int ciscli_get_integer(ciscli *cli, uint32_t index, int64_t *value)
+{
+    int retval;
+
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    retval = parser_control_get_integer(cli->ctl, index, value);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ciscli_get_string(ciscli *cli, uint32_t index, const char **value)
+{
+    int retval;
+
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    retval = parser_control_get_string(cli->ctl, index, value);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ciscli_get_string_span(ciscli *cli, uint32_t index, const char **value,
+                           size_t *len)
+{
+    uint32_t span_len;
+    int retval;
+
+    if (!cli || !len) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    retval = parser_control_get_string_span(cli->ctl, index, value, &span_len);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    *len = span_len;
+    return 0;
+}
+
+int ciscli_get_number(ciscli *cli, uint32_t index, double *value)
+{
+    int retval;
+
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    retval = parser_control_get_number(cli->ctl, index, value);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* The public address is a copy of the parser address */
+_Static_assert(sizeof(ciscli_address) == sizeof(parser_address_t) &&
+               CISCLI_AF_IPV4 == AF_IPV4 && CISCLI_AF_IPV6 == AF_IPV6 &&
+               CISCLI_AF_MAC == AF_MAC, "address layouts differ");
+
+int ciscli_get_address(ciscli *cli, uint32_t index, ciscli_address *value)
+{
+    parser_address_t addr;
+    int retval;
+
+    if (!cli || !value) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    retval = parser_control_get_address(cli->ctl, index, &addr);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    value->af = addr.af;
+    value->mask = addr.mask;
+    memcpy(value->addr, addr.addr, sizeof(value->addr));
+    return 0;
+}
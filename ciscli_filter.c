@@ -0,0 +1,793 @@
+/****************************************************************************
+ * CisCLI output filters
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * A command line may end with one or more filters, each introduced by a
+ * "|" token, which select the lines of output of the command that are
+ * shown:
+ *
+ *     show running-config | begin interface | exclude shutdown | count
+ *
+ * Each filter takes the rest of the line up to the next "|" token as an
+ * extended regular expression, so a pattern may contain spaces, and may
+ * use "|" for alternation as long as it is not surrounded by spaces.
+ *
+ * Most patterns are plain text, or a few alternatives of plain text,
+ * possibly anchored. The alternatives of every such pattern of a command
+ * are compiled into a single Aho-Corasick automaton, which finds all of
+ * them in one pass over each line, one byte at a time. The patterns that
+ * need a regular expression are matched by regexec, as each line ends.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+
+#include "ciscli_private.h"
+
+/* Filters whose patterns are found by the automaton, one bit each */
+#define FILTER_BITS         64
+
+/* Anchored alternatives found by the automaton, one bit each */
+#define FILTER_ANCHORED_MAX 64
+
+/* States of the automaton, one for each byte of the alternatives */
+#define FILTER_STATES_MAX   65536
+
+/* Byte class of bytes that are not in any alternative */
+#define CLASS_OTHER         0
+
+/* Byte class of the newline, which ends the scan of a line */
+#define CLASS_NEWLINE       1
+
+/* Set on a transition into a state in which alternatives end, and on
+ * every transition on a newline */
+#define STATE_HIT           0x80000000u
+#define STATE_MASK          (~STATE_HIT)
+
+#define ANCHOR_START        (1 << 0)
+#define ANCHOR_END          (1 << 1)
+
+typedef enum {
+    FILTER_INCLUDE,
+    FILTER_EXCLUDE,
+    FILTER_BEGIN,
+    FILTER_COUNT,
+} filter_kind;
+
+static const char *filter_keyword[] = {
+    [FILTER_INCLUDE] = "include",
+    [FILTER_EXCLUDE] = "exclude",
+    [FILTER_BEGIN] = "begin",
+    [FILTER_COUNT] = "count",
+};
+
+typedef struct {
+    /** One of filter_kind */
+    uint32_t kind;
+
+    /** The pattern is matched by the regular expression */
+    int has_regex;
+
+    /** A line has matched, for begin */
+    int begun;
+
+    /** Bit of the filter in the mask of patterns found in a line, if its
+     * pattern is found by the automaton, or 0 */
+    uint64_t bit;
+
+    /** Pattern, while the filters are being compiled */
+    const char *pattern;
+
+    /** Length of the pattern */
+    size_t pattern_len;
+
+    /** Offset of the "|" token of the stage */
+    size_t offset;
+
+    /** Compiled pattern */
+    regex_t regex;
+} filter_stage;
+
+/** @brief Alternative anchored at the start or end of the line */
+typedef struct {
+    /** Length of the alternative */
+    uint32_t len;
+
+    /** Combination of ANCHOR_START and ANCHOR_END */
+    uint32_t anchors;
+
+    /** Bit of the filter it belongs to */
+    uint64_t bit;
+} filter_anchored;
+
+struct ciscli_filter_s {
+    /** Number of stages */
+    uint32_t count;
+
+    /** Number of stages matched by a regular expression */
+    uint32_t regex_count;
+
+    /** Lines counted by a final count stage */
+    uint64_t counted;
+
+    /** Transitions of the automaton, indexed by the state or'ed with the
+     * class of the byte. States are numbered in steps of the size of a
+     * row. NULL if no pattern is found by the automaton. */
+    uint32_t *delta;
+
+    /** Filter bits of the unanchored alternatives ending in each state */
+    uint64_t *out;
+
+    /** Anchored alternatives ending in each state */
+    uint64_t *anchored_out;
+
+    /** Log2 of the size of a row of transitions */
+    uint32_t shift;
+
+    /** Number of anchored alternatives */
+    uint32_t anchored_count;
+
+    /** Class of each byte */
+    uint8_t classes[256];
+
+    /** Bytes that leave the initial state, which are the first bytes of
+     * the alternatives, and the newline */
+    uint8_t starts[256];
+
+    /** Anchored alternatives */
+    filter_anchored anchored[FILTER_ANCHORED_MAX];
+
+    /** State of the automaton in the line being scanned */
+    uint32_t state;
+
+    /** Filter bits of the patterns found so far in the line */
+    uint64_t mask;
+
+    /** Number of bytes of the line scanned so far */
+    size_t line_len;
+
+    /** Stages, in the order lines pass through them */
+    filter_stage stages[];
+};
+
+/* Check whether the byte at an offset is a "|" token */
+static int is_pipe(const char *line, size_t len, size_t i)
+{
+    return line[i] == '|' && (i == 0 || line[i - 1] == ' ') &&
+           (i + 1 == len || line[i + 1] == ' ');
+}
+
+/* Find the next "|" token at or after an offset */
+static size_t find_pipe(const char *line, size_t len, size_t i)
+{
+    const char *p;
+
+    while (i < len) {
+        p = memchr(line + i, '|', len - i);
+        if (!p) {
+            break;
+        }
+
+        i = p - line;
+        if (is_pipe(line, len, i)) {
+            return i;
+        }
+        i++;
+    }
+
+    return len;
+}
+
+static size_t skip_spaces(const char *line, size_t len, size_t i)
+{
+    while (i < len && line[i] == ' ') {
+        i++;
+    }
+
+    return i;
+}
+
+size_t ciscli_filter_split(const char *line, size_t len)
+{
+    size_t i;
+
+    /* Comments are not filtered, whatever they hold */
+    i = skip_spaces(line, len, 0);
+    if (i < len && (line[i] == '!' || line[i] == '#')) {
+        return len;
+    }
+
+    return find_pipe(line, len, i);
+}
+
+void ciscli_filter_free(ciscli_filter *filter)
+{
+    uint32_t i;
+
+    if (!filter) {
+        return;
+    }
+
+    for (i = 0; i < filter->count; i++) {
+        if (filter->stages[i].has_regex) {
+            regfree(&filter->stages[i].regex);
+        }
+    }
+
+    free(filter->delta);
+    free(filter->out);
+    free(filter->anchored_out);
+    free(filter);
+}
+
+/* Look up a filter keyword, which may be abbreviated */
+static int filter_lookup(const char *token, size_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i <= FILTER_COUNT; i++) {
+        if (len && len <= strlen(filter_keyword[i]) &&
+            !memcmp(token, filter_keyword[i], len)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Decode the next alternative of a pattern made only of plain text, with
+ * the special characters escaped, and optional anchors. The alternative is
+ * decoded into buf, which must be as long as the pattern.
+ *
+ * Returns 1 if an alternative was decoded, 0 once there are no more, or -1
+ * if the pattern needs a regular expression.
+ */
+static int literal_next(const char *pattern, size_t len, size_t *pos,
+                        char *buf, uint32_t *buf_len, uint32_t *anchors)
+{
+    static const char special[] = ".[]()*+?{}|^$\\";
+    size_t i = *pos;
+    uint32_t n = 0;
+    char c;
+
+    if (i > len) {
+        return 0;
+    }
+
+    *anchors = 0;
+    if (i < len && pattern[i] == '^') {
+        *anchors |= ANCHOR_START;
+        i++;
+    }
+
+    for (; i < len && pattern[i] != '|'; i++) {
+        c = pattern[i];
+        if (c == '$' && (i + 1 == len || pattern[i + 1] == '|')) {
+            *anchors |= ANCHOR_END;
+            continue;
+        }
+
+        /* Escaped letters and digits are classes or back references */
+        if (c == '\\') {
+            if (++i == len || !pattern[i] || !strchr(special, pattern[i])) {
+                return -1;
+            }
+            c = pattern[i];
+        } else if (!c || strchr(special, c)) {
+            return -1;
+        }
+
+        buf[n++] = c;
+    }
+
+    /* An empty alternative matches every line */
+    if (!n) {
+        return -1;
+    }
+
+    *pos = i + 1;
+    *buf_len = n;
+    return 1;
+}
+
+/* Check whether a pattern can be found by the automaton, and count the
+ * states and anchored alternatives it needs */
+static int literal_check(const char *pattern, size_t len, char *buf,
+                         size_t *states, uint32_t *anchored)
+{
+    uint32_t anchors;
+    uint32_t n;
+    size_t pos = 0;
+    int retval;
+
+    *states = 0;
+    *anchored = 0;
+    while ((retval = literal_next(pattern, len, &pos, buf, &n, &anchors)) > 0) {
+        *states += n;
+        *anchored += anchors != 0;
+    }
+
+    return retval;
+}
+
+/* Add the alternatives of a pattern to the trie of the automaton */
+static void automaton_insert(ciscli_filter *f, uint32_t *states,
+                             filter_stage *stage, char *buf)
+{
+    filter_anchored *a;
+    uint32_t anchors;
+    uint32_t state;
+    uint32_t index;
+    uint32_t n;
+    uint32_t i;
+    size_t pos = 0;
+
+    while (literal_next(stage->pattern, stage->pattern_len, &pos, buf, &n,
+                        &anchors) > 0) {
+        state = 0;
+        for (i = 0; i < n; i++) {
+            index = (state << f->shift) | f->classes[(uint8_t)buf[i]];
+            if (!f->delta[index]) {
+                f->delta[index] = (*states)++;
+            }
+            state = f->delta[index];
+        }
+
+        if (!anchors) {
+            f->out[state] |= stage->bit;
+            continue;
+        }
+
+        a = &f->anchored[f->anchored_count];
+        a->len = n;
+        a->anchors = anchors;
+        a->bit = stage->bit;
+        f->anchored_out[state] |= UINT64_C(1) << f->anchored_count++;
+    }
+}
+
+/*
+ * Turn the trie into a DFA. The states are visited breadth first, so that
+ * the failure state of each state, which is the longest suffix of its text
+ * that is in the trie, has been completed before the state is. Each state
+ * then takes the transitions missing from the trie from its failure state,
+ * and the alternatives that end in it.
+ */
+static int automaton_link(ciscli_filter *f, uint32_t states)
+{
+    uint32_t *queue;
+    uint32_t *fail;
+    uint32_t row = 1u << f->shift;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t index;
+    uint32_t state;
+    uint32_t next;
+    uint32_t c;
+
+    queue = malloc(states * sizeof(*queue));
+    fail = calloc(states, sizeof(*fail));
+    if (!queue || !fail) {
+        free(queue);
+        free(fail);
+        return -ENOMEM;
+    }
+
+    for (c = 0; c < row; c++) {
+        if (f->delta[c]) {
+            queue[tail++] = f->delta[c];
+        }
+    }
+
+    while (head < tail) {
+        state = queue[head++];
+        for (c = 0; c < row; c++) {
+            index = (state << f->shift) | c;
+            next = f->delta[index];
+            if (!next) {
+                f->delta[index] = f->delta[(fail[state] << f->shift) | c];
+                continue;
+            }
+
+            fail[next] = f->delta[(fail[state] << f->shift) | c];
+            f->out[next] |= f->out[fail[next]];
+            f->anchored_out[next] |= f->anchored_out[fail[next]];
+            queue[tail++] = next;
+        }
+    }
+
+    /* Number the states by their rows, and flag the transitions that the
+     * scan must stop on */
+    for (index = 0; index < (states << f->shift); index++) {
+        next = f->delta[index];
+        if ((index & (row - 1)) == CLASS_NEWLINE) {
+            f->delta[index] = STATE_HIT;
+        } else if (f->out[next] || f->anchored_out[next]) {
+            f->delta[index] = (next << f->shift) | STATE_HIT;
+        } else {
+            f->delta[index] = next << f->shift;
+        }
+    }
+
+    for (c = 0; c < 256; c++) {
+        f->starts[c] = f->delta[f->classes[c]] != 0;
+    }
+
+    free(queue);
+    free(fail);
+    return 0;
+}
+
+/* Compile the patterns that are plain text into the automaton */
+static int automaton_compile(ciscli_filter *f, size_t pattern_max)
+{
+    filter_stage *stage;
+    uint32_t anchored_total = 0;
+    uint32_t anchored;
+    uint32_t classes = 2;
+    uint32_t states = 1;
+    uint32_t bits = 0;
+    uint32_t anchors;
+    uint32_t n;
+    uint32_t i;
+    uint32_t j;
+    size_t needed;
+    size_t pos;
+    char *buf;
+
+    buf = malloc(pattern_max + 1);
+    if (!buf) {
+        return -ENOMEM;
+    }
+
+    f->classes['\n'] = CLASS_NEWLINE;
+    for (i = 0; i < f->count; i++) {
+        stage = &f->stages[i];
+        if (!stage->pattern_len || bits == FILTER_BITS ||
+            literal_check(stage->pattern, stage->pattern_len, buf, &needed,
+                          &anchored) < 0 ||
+            states + needed > FILTER_STATES_MAX ||
+            anchored_total + anchored > FILTER_ANCHORED_MAX) {
+            continue;
+        }
+
+        stage->bit = UINT64_C(1) << bits++;
+        states += needed;
+        anchored_total += anchored;
+
+        pos = 0;
+        while (literal_next(stage->pattern, stage->pattern_len, &pos, buf, &n,
+                            &anchors) > 0) {
+            for (j = 0; j < n; j++) {
+                if (!f->classes[(uint8_t)buf[j]]) {
+                    f->classes[(uint8_t)buf[j]] = classes++;
+                }
+            }
+        }
+    }
+
+    if (!bits) {
+        free(buf);
+        return 0;
+    }
+
+    while ((1u << f->shift) < classes) {
+        f->shift++;
+    }
+
+    f->delta = calloc((size_t)states << f->shift, sizeof(*f->delta));
+    f->out = calloc(states, sizeof(*f->out));
+    f->anchored_out = calloc(states, sizeof(*f->anchored_out));
+    if (!f->delta || !f->out || !f->anchored_out) {
+        free(buf);
+        return -ENOMEM;
+    }
+
+    states = 1;
+    for (i = 0; i < f->count; i++) {
+        if (f->stages[i].bit) {
+            automaton_insert(f, &states, &f->stages[i], buf);
+        }
+    }
+
+    free(buf);
+    return automaton_link(f, states);
+}
+
+/* Parse a single stage, from the keyword up to the end of its pattern */
+static int filter_stage_parse(filter_stage *stage, const char *spec,
+                              size_t len)
+{
+    size_t word;
+    size_t i;
+    int kind;
+
+    word = 0;
+    while (word < len && spec[word] != ' ') {
+        word++;
+    }
+
+    kind = filter_lookup(spec, word);
+    if (kind < 0) {
+        return -EINVAL;
+    }
+
+    i = skip_spaces(spec, len, word);
+    while (len > i && spec[len - 1] == ' ') {
+        len--;
+    }
+
+    stage->kind = kind;
+    stage->pattern = spec + i;
+    stage->pattern_len = len - i;
+    return stage->pattern_len || kind == FILTER_COUNT ? 0 : -EINVAL;
+}
+
+/* Compile the pattern of a stage that is not found by the automaton */
+static int filter_stage_regex(filter_stage *stage)
+{
+    char *pattern;
+    int retval;
+
+    pattern = strndup(stage->pattern, stage->pattern_len);
+    if (!pattern) {
+        return -ENOMEM;
+    }
+
+    retval = regcomp(&stage->regex, pattern, REG_EXTENDED | REG_NOSUB);
+    free(pattern);
+    if (retval) {
+        return retval == REG_ESPACE ? -ENOMEM : -EINVAL;
+    }
+
+    stage->has_regex = 1;
+    return 0;
+}
+
+int ciscli_filter_compile(const char *spec, size_t len,
+                          ciscli_filter **filter, size_t *error_offset)
+{
+    filter_stage *stage;
+    ciscli_filter *f;
+    size_t pattern_max = 0;
+    size_t start;
+    size_t word;
+    size_t end;
+    uint32_t count;
+    uint32_t i;
+    int retval;
+
+    *error_offset = 0;
+
+    count = 0;
+    for (start = 0; start < len; start = find_pipe(spec, len, start + 1)) {
+        count++;
+    }
+
+    f = calloc(1, sizeof(*f) + count * sizeof(f->stages[0]));
+    if (!f) {
+        return -ENOMEM;
+    }
+
+    for (start = 0; start < len; start = end) {
+        end = find_pipe(spec, len, start + 1);
+
+        /* Nothing follows a count, since it swallows every line */
+        if (f->count && f->stages[f->count - 1].kind == FILTER_COUNT) {
+            retval = -EINVAL;
+        } else {
+            word = skip_spaces(spec, end, start + 1);
+            retval = filter_stage_parse(&f->stages[f->count], spec + word,
+                                        end - word);
+        }
+
+        if (retval) {
+            *error_offset = start;
+            ciscli_filter_free(f);
+            return retval;
+        }
+
+        f->stages[f->count].offset = start;
+        if (f->stages[f->count].pattern_len > pattern_max) {
+            pattern_max = f->stages[f->count].pattern_len;
+        }
+        f->count++;
+    }
+
+    retval = automaton_compile(f, pattern_max);
+
+    for (i = 0; !retval && i < f->count; i++) {
+        stage = &f->stages[i];
+        if (!stage->bit && stage->pattern_len) {
+            retval = filter_stage_regex(stage);
+            f->regex_count++;
+            *error_offset = stage->offset;
+        }
+    }
+
+    if (retval) {
+        ciscli_filter_free(f);
+        return retval;
+    }
+
+    *filter = f;
+    return 0;
+}
+
+/* Filter bits of the anchored alternatives in a set that match, given the
+ * offset of the end of the match in the line. Alternatives anchored at
+ * the end are only checked at the end of the line, and the others only
+ * before it. */
+static uint64_t anchored_hits(ciscli_filter *f, uint64_t set, size_t end,
+                              int at_end)
+{
+    filter_anchored *a;
+    uint64_t hits = 0;
+
+    while (set) {
+        a = &f->anchored[__builtin_ctzll(set)];
+        set &= set - 1;
+
+        if (!(a->anchors & ANCHOR_END) != !at_end ||
+            ((a->anchors & ANCHOR_START) && end != a->len)) {
+            continue;
+        }
+        hits |= a->bit;
+    }
+
+    return hits;
+}
+
+size_t ciscli_filter_scan(ciscli_filter *filter, const char *text, size_t len)
+{
+    const uint8_t *start = (const uint8_t *)text;
+    const uint8_t *end = start + len;
+    const uint8_t *p;
+    const uint32_t *delta = filter->delta;
+    const uint8_t *classes = filter->classes;
+    const uint8_t *starts = filter->starts;
+    uint32_t state = filter->state;
+    uint32_t next;
+
+    if (!delta) {
+        p = memchr(text, '\n', len);
+        len = p ? (size_t)(p - start) : len;
+        filter->line_len += len;
+        return len;
+    }
+
+    for (p = start; p < end; p++) {
+        /* Bytes that cannot start an alternative leave the automaton in
+         * its initial state, and are skipped without looking it up */
+        if (!state) {
+            while (p < end && !starts[*p]) {
+                p++;
+            }
+            if (p == end) {
+                break;
+            }
+        }
+
+        next = delta[state | classes[*p]];
+        if (!(next & STATE_HIT)) {
+            state = next;
+            continue;
+        }
+
+        if (*p == '\n') {
+            break;
+        }
+
+        state = next & STATE_MASK;
+        filter->mask |= filter->out[state >> filter->shift];
+        if (filter->anchored_out[state >> filter->shift]) {
+            filter->mask |=
+                anchored_hits(filter,
+                              filter->anchored_out[state >> filter->shift],
+                              filter->line_len + (p - start) + 1, 0);
+        }
+    }
+
+    filter->state = state;
+    filter->line_len += p - start;
+    return p - start;
+}
+
+int ciscli_filter_line(ciscli_filter *filter, char *line, size_t len)
+{
+    filter_stage *stage;
+    uint64_t mask = filter->mask;
+    uint32_t i;
+    char saved = 0;
+    int show = 1;
+    int match;
+
+    if (filter->delta && filter->anchored_out[filter->state >> filter->shift]) {
+        mask |= anchored_hits(filter,
+                              filter->anchored_out[filter->state >>
+                                                   filter->shift],
+                              len, 1);
+    }
+
+    filter->state = 0;
+    filter->mask = 0;
+    filter->line_len = 0;
+
+    if (filter->regex_count) {
+        saved = line[len];
+        line[len] = '\0';
+    }
+
+    for (i = 0; show && i < filter->count; i++) {
+        stage = &filter->stages[i];
+        if (stage->begun) {
+            continue;
+        }
+
+        if (stage->bit) {
+            match = (mask & stage->bit) != 0;
+        } else {
+            match = !stage->has_regex ||
+                    regexec(&stage->regex, line, 0, NULL, 0) == 0;
+        }
+
+        switch (stage->kind) {
+        case FILTER_INCLUDE:
+            show = match;
+            break;
+
+        case FILTER_EXCLUDE:
+            show = !match;
+            break;
+
+        case FILTER_BEGIN:
+            /* Every line from the first that matches is shown */
+            show = match;
+            stage->begun = match;
+            break;
+
+        case FILTER_COUNT:
+            filter->counted += match;
+            show = 0;
+            break;
+        }
+    }
+
+    if (filter->regex_count) {
+        line[len] = saved;
+    }
+
+    return show;
+}
+
+int ciscli_filter_finish(ciscli_filter *filter, char *buf, size_t size)
+{
+    if (!filter->count ||
+        filter->stages[filter->count - 1].kind != FILTER_COUNT) {
+        return 0;
+    }
+
+    return snprintf(buf, size, "Number of lines which match regexp = %llu\n",
+                    (unsigned long long)filter->counted);
+}
@@ -0,0 +1,859 @@
+/****************************************************************************
+ * CisCLI input and output
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "ciscli_private.h"
+
+#define INPUT_CHUNK         4096
+#define OUTPUT_CHUNK        4096
+#define OUTPUT_LINE_CHUNK   256
+
+/* Chunks kept for reuse once they have been written */
+#define OUTPUT_SPARE_MAX    4
+
+/* Chunks written by a single call to writev */
+#define OUTPUT_IOV_MAX      64
+
+/* Output of a running command is written once this much of it is held, or
+ * once the oldest of it has been held for this long */
+#define OUTPUT_FLUSH_BYTES  (64 * 1024)
+#define OUTPUT_FLUSH_NS     50000000u
+
+static const char *status_message[] = {
+    [CISCLI_STATUS_UNRECOGNIZED] = "Unrecognized command",
+    [CISCLI_STATUS_INCOMPLETE] = "Incomplete command",
+    [CISCLI_STATUS_AMBIGUOUS] = "Ambiguous command",
+    [CISCLI_STATUS_ACTION_FAILED] = "Command failed",
+    [CISCLI_STATUS_TOO_LONG] = "Command too long",
+    [CISCLI_STATUS_INVALID_FILTER] = "Invalid output filter",
+};
+
+static int output_drain(ciscli *cli);
+static int output_append(ciscli *cli, const char *data, size_t len);
+
+/* Drop the input that has been processed */
+static void input_compact(ciscli *cli)
+{
+    if (cli->input_pos) {
+        memmove(cli->input, cli->input + cli->input_pos,
+                cli->input_len - cli->input_pos);
+        cli->input_len -= cli->input_pos;
+        cli->input_scanned -= cli->input_pos;
+        cli->input_pos = 0;
+    }
+}
+
+/* Make room for at least size more bytes of input */
+static int input_reserve(ciscli *cli, size_t size)
+{
+    size_t alloc;
+    char *buf;
+
+    input_compact(cli);
+    if (cli->input_size - cli->input_len >= size) {
+        return 0;
+    }
+
+    alloc = cli->input_size ? cli->input_size * 2 : INPUT_CHUNK * 2;
+    while (alloc - cli->input_len < size) {
+        alloc *= 2;
+    }
+
+    buf = realloc(cli->input, alloc);
+    if (!buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    cli->input = buf;
+    cli->input_size = alloc;
+    return 0;
+}
+
+/* Read more input, returns the number of bytes read, 0 on EOF or -1 */
+static ssize_t input_fill(ciscli *cli)
+{
+    ssize_t got;
+
+    if (input_reserve(cli, INPUT_CHUNK)) {
+        return -1;
+    }
+
+    do {
+        got = read(cli->in_fd, cli->input + cli->input_len,
+                   cli->input_size - cli->input_len);
+    } while (got < 0 && errno == EINTR);
+
+    if (got > 0) {
+        cli->input_len += got;
+    }
+
+    return got;
+}
+
+/* Run a command line, and report its failure on the error stream */
+static void input_run(ciscli *cli, const char *line, size_t len,
+                      ciscli_result *result)
+{
+    ciscli_execute_line(cli, line, len, 0, result);
+
+    if (result->status != CISCLI_STATUS_OK &&
+        result->status != CISCLI_STATUS_EMPTY) {
+        ciscli_error(cli, "%% %s\n", status_message[result->status]);
+    }
+}
+
+int ciscli_input(ciscli *cli)
+{
+    ciscli_result result;
+    const char *prompt;
+    size_t prompt_len;
+    size_t line_len;
+    size_t used;
+    char *nl;
+    ssize_t got;
+
+    if (!cli) {
+        errno = EINVAL;
+        return 1;
+    }
+
+    prompt = ciscli_prompt(cli, &prompt_len);
+    if (prompt && prompt_len) {
+        output_append(cli, prompt, prompt_len);
+    }
+
+    /* Anything printed since the last command, such as a prompt, must be
+     * seen before waiting for input */
+    if (!cli->buffered && cli->output_held) {
+        output_drain(cli);
+    }
+
+    input_compact(cli);
+    cli->input_scanned = 0;
+
+    for (;;) {
+        nl = NULL;
+        if (cli->input_len > cli->input_scanned) {
+            nl = memchr(cli->input + cli->input_scanned, '\n',
+                        cli->input_len - cli->input_scanned);
+        }
+
+        if (nl) {
+            line_len = nl - cli->input;
+            used = line_len + 1;
+            break;
+        }
+
+        cli->input_scanned = cli->input_len;
+        got = input_fill(cli);
+        if (got <= 0) {
+            if (cli->input_len == 0) {
+                return 1;
+            }
+
+            /* Process the final line, which has no newline */
+            line_len = cli->input_len;
+            used = line_len;
+            break;
+        }
+    }
+
+    if (line_len && cli->input[line_len - 1] == '\r') {
+        line_len--;
+    }
+
+    input_run(cli, cli->input, line_len, &result);
+
+    cli->input_pos = used;
+    cli->input_scanned = used;
+    input_compact(cli);
+    return 0;
+}
+
+int ciscli_feed(ciscli *cli, const void *buf, size_t len)
+{
+    if (!cli || (!buf && len)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (input_reserve(cli, len)) {
+        return -1;
+    }
+
+    memcpy(cli->input + cli->input_len, buf, len);
+    cli->input_len += len;
+    return 0;
+}
+
+/* Find the first byte of input that ends a line or asks for candidates */
+static char * input_find_event(ciscli *cli)
+{
+    char *p = cli->input + cli->input_scanned;
+    char *end = cli->input + cli->input_len;
+
+    for (; p < end; p++) {
+        if (*p == '\n' || (!cli->input_discard && (*p == '\t' || *p == '?'))) {
+            return p;
+        }
+    }
+
+    cli->input_scanned = cli->input_len;
+    return NULL;
+}
+
+int ciscli_next_event(ciscli *cli, ciscli_event *event)
+{
+    char *line;
+    char *p;
+    size_t len;
+
+    if (!cli || !event) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(event, 0, sizeof(*event));
+
+    p = input_find_event(cli);
+    line = cli->input + cli->input_pos;
+    len = p ? (size_t)(p - line) : cli->input_len - cli->input_pos;
+
+    if (!p) {
+        /* A line that does not fit is dropped up to its newline */
+        if (cli->input_discard || len > CISCLI_INPUT_MAX) {
+            cli->input_pos = cli->input_len;
+            cli->input_scanned = cli->input_len;
+            if (!cli->input_discard) {
+                cli->input_discard = 1;
+                event->type = CISCLI_EVENT_LINE;
+                event->result.status = CISCLI_STATUS_TOO_LONG;
+                ciscli_error(cli, "%% %s\n",
+                             status_message[CISCLI_STATUS_TOO_LONG]);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (*p != '\n') {
+        /* The line is kept, so that typing can carry on after the request */
+        event->type = *p == '\t' ? CISCLI_EVENT_COMPLETE : CISCLI_EVENT_HELP;
+        memmove(p, p + 1, cli->input + cli->input_len - (p + 1));
+        cli->input_len--;
+        cli->input_scanned = p - cli->input;
+        event->line = line;
+        event->len = len;
+        return 1;
+    }
+
+    cli->input_pos = p + 1 - cli->input;
+    cli->input_scanned = cli->input_pos;
+    if (cli->input_discard) {
+        cli->input_discard = 0;
+        return ciscli_next_event(cli, event);
+    }
+
+    if (len && line[len - 1] == '\r') {
+        len--;
+    }
+
+    event->type = CISCLI_EVENT_LINE;
+    event->line = line;
+    event->len = len;
+    input_run(cli, line, len, &event->result);
+    return 1;
+}
+
+
+/* Read the clock that bounds how long output is held, in nanoseconds */
+static uint64_t output_clock(void)
+{
+    struct timespec ts;
+
+    /* Output is held for tens of milliseconds, so the cheaper clock will do */
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Start a new chunk of output, with room for at least size bytes */
+static ciscli_chunk * output_chunk(ciscli *cli, size_t size)
+{
+    ciscli_chunk *chunk;
+
+    if (size <= OUTPUT_CHUNK && cli->output_spare) {
+        chunk = cli->output_spare;
+        cli->output_spare = chunk->next;
+        cli->output_spare_count--;
+    } else {
+        if (size < OUTPUT_CHUNK) {
+            size = OUTPUT_CHUNK;
+        }
+
+        chunk = malloc(sizeof(*chunk) + size);
+        if (!chunk) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        chunk->size = size;
+    }
+
+    chunk->next = NULL;
+    chunk->start = 0;
+    chunk->len = 0;
+
+    if (cli->output_tail) {
+        cli->output_tail->next = chunk;
+    } else {
+        cli->output_head = chunk;
+    }
+    cli->output_tail = chunk;
+    return chunk;
+}
+
+/* Release a chunk that has been written, keeping it for reuse */
+static void output_chunk_release(ciscli *cli, ciscli_chunk *chunk)
+{
+    if (chunk->size == OUTPUT_CHUNK &&
+        cli->output_spare_count < OUTPUT_SPARE_MAX) {
+        chunk->next = cli->output_spare;
+        cli->output_spare = chunk;
+        cli->output_spare_count++;
+    } else {
+        free(chunk);
+    }
+}
+
+/* Account for output added to the chunks */
+static void output_added(ciscli *cli, size_t len)
+{
+    if (!cli->output_held && !cli->buffered) {
+        cli->output_since = output_clock();
+    }
+
+    cli->output_held += len;
+}
+
+/* Format text into the chunks of output */
+static int output_vformat(ciscli *cli, const char *fmt, va_list ap)
+{
+    ciscli_chunk *chunk = cli->output_tail;
+    va_list copy;
+    size_t room;
+    int len;
+
+    room = chunk ? chunk->size - chunk->len : 0;
+
+    va_copy(copy, ap);
+    len = vsnprintf(room ? chunk->data + chunk->len : NULL, room, fmt, copy);
+    va_end(copy);
+    if (len < 0) {
+        return len;
+    }
+
+    /* Text that does not fit starts a new chunk, rather than being split */
+    if ((size_t)len >= room) {
+        chunk = output_chunk(cli, len + 1);
+        if (!chunk) {
+            return -1;
+        }
+
+        vsnprintf(chunk->data, chunk->size, fmt, ap);
+    }
+
+    chunk->len += len;
+    output_added(cli, len);
+    return len;
+}
+
+/* Copy text into the chunks of output */
+static int output_append(ciscli *cli, const char *data, size_t len)
+{
+    ciscli_chunk *chunk;
+    size_t total = len;
+    size_t n;
+
+    while (len) {
+        chunk = cli->output_tail;
+        if (!chunk || chunk->len == chunk->size) {
+            chunk = output_chunk(cli, len);
+            if (!chunk) {
+                return -1;
+            }
+        }
+
+        n = chunk->size - chunk->len;
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(chunk->data + chunk->len, data, n);
+        chunk->len += n;
+        data += n;
+        len -= n;
+    }
+
+    output_added(cli, total);
+    return 0;
+}
+
+size_t ciscli_output_pending(ciscli *cli, struct iovec *iov, int *iovcnt)
+{
+    ciscli_chunk *chunk;
+    int n = 0;
+
+    if (!cli) {
+        if (iovcnt) {
+            *iovcnt = 0;
+        }
+        return 0;
+    }
+
+    if (iov && iovcnt) {
+        for (chunk = cli->output_head; chunk && n < *iovcnt;
+             chunk = chunk->next) {
+            if (chunk->start < chunk->len) {
+                iov[n].iov_base = chunk->data + chunk->start;
+                iov[n].iov_len = chunk->len - chunk->start;
+                n++;
+            }
+        }
+        *iovcnt = n;
+    }
+
+    return cli->output_held;
+}
+
+void ciscli_output_consume(ciscli *cli, size_t len)
+{
+    ciscli_chunk *chunk;
+    size_t n;
+
+    if (!cli) {
+        return;
+    }
+
+    if (len > cli->output_held) {
+        len = cli->output_held;
+    }
+    cli->output_held -= len;
+
+    while ((chunk = cli->output_head)) {
+        n = chunk->len - chunk->start;
+        if (n > len) {
+            chunk->start += len;
+            break;
+        }
+        len -= n;
+
+        /* The last chunk is emptied rather than released, for more output */
+        if (chunk == cli->output_tail) {
+            chunk->start = 0;
+            chunk->len = 0;
+            break;
+        }
+
+        cli->output_head = chunk->next;
+        output_chunk_release(cli, chunk);
+    }
+}
+
+ssize_t ciscli_flush(ciscli *cli, int fd)
+{
+    struct iovec iov[OUTPUT_IOV_MAX];
+    ssize_t wrote;
+    int count;
+
+    if (!cli || fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (cli->output_held) {
+        count = OUTPUT_IOV_MAX;
+        ciscli_output_pending(cli, iov, &count);
+
+        wrote = writev(fd, iov, count);
+        if (wrote < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+
+        ciscli_output_consume(cli, wrote);
+    }
+
+    return cli->output_held;
+}
+
+/* Write all the output held to the output stream, waiting for room if it
+ * is non-blocking */
+static int output_drain(ciscli *cli)
+{
+    struct pollfd pfd;
+    ssize_t held;
+
+    while ((held = ciscli_flush(cli, cli->out_fd)) > 0) {
+        pfd.fd = cli->out_fd;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, -1);
+    }
+
+    if (held < 0) {
+        /* Output that cannot be written is dropped, as it was unbuffered */
+        ciscli_output_consume(cli, cli->output_held);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Write the output held, unless it is worth holding on to */
+static int output_check(ciscli *cli)
+{
+    if (cli->buffered || !cli->output_held) {
+        return 0;
+    }
+
+    /* Output outside of a command, such as a prompt, is written at once */
+    if (cli->output_command && cli->output_held < OUTPUT_FLUSH_BYTES &&
+        output_clock() - cli->output_since < OUTPUT_FLUSH_NS) {
+        return 0;
+    }
+
+    return output_drain(cli);
+}
+
+int ciscli_pager_set(ciscli *cli, uint32_t lines)
+{
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* A session cannot wait for a key in the middle of a command */
+    if (cli->buffered && lines) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    cli->page_lines = lines;
+    return 0;
+}
+
+static int pager_active(ciscli *cli)
+{
+    return cli->page_lines && cli->output_command && !cli->buffered &&
+           !cli->page_off;
+}
+
+/* Number of lines on a page, leaving the last line for the prompt */
+static uint32_t pager_page(ciscli *cli)
+{
+    return cli->page_lines > 1 ? cli->page_lines - 1 : 1;
+}
+
+/* Show the output held and wait for a key, which holds up the command */
+static void pager_prompt(ciscli *cli)
+{
+    static const char prompt[] = " --More-- ";
+    static const char erase[] = "\r          \r";
+    struct termios tio;
+    ssize_t got;
+    ssize_t rest;
+    char key = 0;
+    char c;
+
+    output_append(cli, prompt, sizeof(prompt) - 1);
+    output_drain(cli);
+
+    do {
+        got = read(cli->in_fd, &key, 1);
+    } while (got < 0 && errno == EINTR);
+
+    /* A terminal that reads whole lines holds the rest of the line */
+    c = key;
+    if (got > 0 && c != '\n' && !tcgetattr(cli->in_fd, &tio) &&
+        (tio.c_lflag & ICANON)) {
+        do {
+            rest = read(cli->in_fd, &c, 1);
+        } while ((rest > 0 && c != '\n') || (rest < 0 && errno == EINTR));
+    }
+
+    output_append(cli, erase, sizeof(erase) - 1);
+
+    if (got <= 0) {
+        /* Without input, the rest of the output is shown */
+        cli->page_off = 1;
+        return;
+    }
+
+    switch (key) {
+    case 'q':
+    case 'Q':
+        cli->page_quit = 1;
+        break;
+
+    case '\r':
+    case '\n':
+        cli->page_shown = pager_page(cli) - 1;
+        break;
+
+    default:
+        cli->page_shown = 0;
+        break;
+    }
+}
+
+/* Pass a line of output through the filter and the pager. The line is
+ * followed by its newline, if it has one, or by a spare byte. */
+static int output_line(ciscli *cli, char *line, size_t len, int newline)
+{
+    if (cli->filter && !ciscli_filter_line(cli->filter, line, len)) {
+        return 0;
+    }
+
+    if (pager_active(cli)) {
+        if (cli->page_shown >= pager_page(cli)) {
+            pager_prompt(cli);
+            if (cli->page_quit) {
+                return 0;
+            }
+        }
+        cli->page_shown++;
+    }
+
+    return output_append(cli, line, len + newline);
+}
+
+/* Format text into the line buffer, and pass each complete line on */
+static int output_vfilter(ciscli *cli, const char *fmt, va_list ap)
+{
+    va_list copy;
+    size_t start;
+    size_t pos;
+    size_t end;
+    size_t size;
+    char *buf;
+    char *nl;
+    int len;
+
+    va_copy(copy, ap);
+    len = vsnprintf(cli->output_line ? cli->output_line + cli->output_line_len
+                                     : NULL,
+                    cli->output_line_size - cli->output_line_len, fmt, copy);
+    va_end(copy);
+    if (len < 0) {
+        return len;
+    }
+
+    if ((size_t)len >= cli->output_line_size - cli->output_line_len) {
+        size = cli->output_line_size ? cli->output_line_size
+                                     : OUTPUT_LINE_CHUNK;
+        while (size - cli->output_line_len <= (size_t)len) {
+            size *= 2;
+        }
+
+        buf = realloc(cli->output_line, size);
+        if (!buf) {
+            errno = ENOMEM;
+            return -1;
+        }
+        cli->output_line = buf;
+        cli->output_line_size = size;
+
+        vsnprintf(cli->output_line + cli->output_line_len,
+                  cli->output_line_size - cli->output_line_len, fmt, ap);
+    }
+
+    /* Text before the line buffered has been scanned already */
+    buf = cli->output_line;
+    start = 0;
+    pos = cli->output_line_len;
+    end = pos + len;
+    while (!cli->page_quit) {
+        if (cli->filter) {
+            pos += ciscli_filter_scan(cli->filter, buf + pos, end - pos);
+        } else {
+            nl = memchr(buf + pos, '\n', end - pos);
+            pos = nl ? (size_t)(nl - buf) : end;
+        }
+
+        if (pos == end) {
+            break;
+        }
+
+        if (output_line(cli, buf + start, pos - start, 1)) {
+            return -1;
+        }
+        start = ++pos;
+    }
+
+    /* The partial line is kept for the text that completes it */
+    memmove(buf, buf + start, end - start);
+    cli->output_line_len = end - start;
+    return len;
+}
+
+void ciscli_output_begin(ciscli *cli, ciscli_filter *filter)
+{
+    cli->filter = filter;
+    cli->output_command = 1;
+    cli->output_line_len = 0;
+    cli->page_shown = 0;
+    cli->page_quit = 0;
+    cli->page_off = 0;
+}
+
+int ciscli_output_end(ciscli *cli)
+{
+    char buf[128];
+    int quit;
+    int len;
+
+    if (cli->output_line_len && !cli->page_quit) {
+        output_line(cli, cli->output_line, cli->output_line_len, 0);
+    }
+    cli->output_line_len = 0;
+
+    if (cli->filter) {
+        len = ciscli_filter_finish(cli->filter, buf, sizeof(buf));
+        if (len > 0 && !cli->page_quit) {
+            output_append(cli, buf, len);
+        }
+
+        ciscli_filter_free(cli->filter);
+        cli->filter = NULL;
+    }
+
+    quit = cli->page_quit;
+    cli->output_command = 0;
+    cli->page_quit = 0;
+
+    if (!cli->buffered) {
+        output_drain(cli);
+    }
+
+    return quit;
+}
+
+void ciscli_output_free(ciscli *cli)
+{
+    ciscli_chunk *chunk;
+
+    while ((chunk = cli->output_head)) {
+        cli->output_head = chunk->next;
+        free(chunk);
+    }
+
+    while ((chunk = cli->output_spare)) {
+        cli->output_spare = chunk->next;
+        free(chunk);
+    }
+
+    cli->output_tail = NULL;
+    cli->output_held = 0;
+    cli->output_spare_count = 0;
+
+    ciscli_filter_free(cli->filter);
+    cli->filter = NULL;
+    free(cli->output_line);
+    cli->output_line = NULL;
+}
+
+int ciscli_print(ciscli *cli, const char *fmt, ...)
+{
+    va_list ap;
+    int retval;
+
+    if (!cli || !fmt) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* A producer that stops when printing fails stops once the pager is
+     * quit, rather than formatting output that is dropped */
+    if (cli->page_quit) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    va_start(ap, fmt);
+    if (cli->filter || pager_active(cli)) {
+        retval = output_vfilter(cli, fmt, ap);
+    } else {
+        retval = output_vformat(cli, fmt, ap);
+    }
+    va_end(ap);
+
+    if (retval >= 0 && output_check(cli)) {
+        retval = -1;
+    }
+
+    if (cli->page_quit) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    return retval;
+}
+
+int ciscli_error(ciscli *cli, const char *fmt, ...)
+{
+    va_list ap;
+    int retval;
+
+    if (!cli || !fmt) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    va_start(ap, fmt);
+    if (cli->buffered) {
+        retval = output_vformat(cli, fmt, ap);
+    } else {
+        /* Errors are not held, but must follow the output before them */
+        output_drain(cli);
+        retval = vdprintf(cli->err_fd, fmt, ap);
+    }
+    va_end(ap);
+
+    return retval;
+}
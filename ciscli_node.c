@@ -0,0 +1,505 @@
+/****************************************************************************
+ * CisCLI node API
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <float.h>
+
+#include "ciscli_private.h"
+#include "parser_control.h"
+#include "parser_node_keyword.h"
+#include "parser_node_integer.h"
+#include "parser_conditional.h"
+
+/* Parser node type for each CisCLI node type, 0 if not yet supported */
+static const uint32_t node_type[CISCLI_NODE_TYPE_MAX] = {
+    [CISCLI_KEYWORD] = PARSER_NODE_TYPE_KEYWORD,
+    [CISCLI_INTEGER] = PARSER_NODE_TYPE_INTEGER,
+    [CISCLI_FLOAT] = PARSER_NODE_TYPE_NUMBER,
+    [CISCLI_IPADDR] = PARSER_NODE_TYPE_ADDRESS,
+    [CISCLI_MACADDR] = PARSER_NODE_TYPE_ADDRESS,
+    [CISCLI_CONDITIONAL] = PARSER_NODE_TYPE_CONDITIONAL,
+    [CISCLI_EOL] = PARSER_NODE_TYPE_EOL,
+};
+
+uint32_t ciscli_tree_generation;
+
+#define NODE(node)      ((PARSER_NODE *)(node))
+#define KW_COLD(node)   ((PARSER_NODE_KEYWORD_COLD *)NODE(node)->cold)
+
+static int node_check_type(ciscli_node *node, uint32_t type)
+{
+    if (!node || NODE(node)->type != type) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* A shared node leads to more than one command, which would all change */
+static int node_check_shared(ciscli_node *node)
+{
+    if (NODE(node)->flags & PARSER_NODE_FLAG_SHARED) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    return 0;
+}
+
+ciscli_node * ciscli_node_alloc(ciscli *cli, uint32_t tree, ciscli_node_type type)
+{
+    parser_node_integer_t *inode;
+    parser_node_number_t *nnode;
+    PARSER_NODE *node;
+    ciscli_tree *t;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return NULL;
+    }
+
+    if ((uint32_t)type >= CISCLI_NODE_TYPE_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (node_type[type] == PARSER_NODE_TYPE_ROOT) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    node = parser_arena_alloc(&t->arena, parser_node_size(node_type[type]));
+    if (!node) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    node->cold = parser_arena_alloc(&t->cold_arena,
+                                    parser_node_cold_size(node_type[type]));
+    if (!node->cold) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    node->cold->arena = &t->cold_arena;
+    node->type = node_type[type];
+
+    if (node->type == PARSER_NODE_TYPE_INTEGER) {
+        inode = (parser_node_integer_t *)node;
+        inode->min_accepted = INT64_MIN;
+        inode->max_accepted = INT64_MAX;
+        inode->formats = INTEGER_FORMAT_DEC | INTEGER_FORMAT_HEX |
+                         INTEGER_FORMAT_OCT;
+    } else if (node->type == PARSER_NODE_TYPE_NUMBER) {
+        nnode = (parser_node_number_t *)node;
+        nnode->min_accepted = -DBL_MAX;
+        nnode->max_accepted = DBL_MAX;
+    } else if (type == CISCLI_IPADDR) {
+        ((parser_node_address_t *)node)->format = ADDRESS_FORMAT_IPV4 |
+                                                  ADDRESS_FORMAT_IPV6;
+    } else if (type == CISCLI_MACADDR) {
+        ((parser_node_address_t *)node)->format = ADDRESS_FORMAT_MAC;
+    }
+
+    return (ciscli_node *)node;
+}
+
+int ciscli_node_add_help_text(ciscli_node *node, const char *help)
+{
+    char *text;
+    size_t len;
+
+    if (!node || !help || !NODE(node)->cold || !NODE(node)->cold->arena) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    len = strnlen(help, HELP_TEXT_LENGTH - 1);
+
+    text = parser_arena_alloc(NODE(node)->cold->arena, len + 1);
+    if (!text) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memcpy(text, help, len);
+    NODE(node)->cold->help_text = text;
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_node_add_child(ciscli_node *parent, ciscli_node *child)
+{
+    PARSER_NODE *p = NODE(parent);
+    PARSER_NODE *c = NODE(child);
+    PARSER_NODE **link;
+    PARSER_NODE *last;
+
+    if (!p || !c || p == c || c->sibling) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Children are kept in the order they were added */
+    last = NULL;
+    for (link = &p->child; *link; link = &(*link)->sibling) {
+        if (*link == c) {
+            errno = EEXIST;
+            return -1;
+        }
+        last = *link;
+    }
+
+    /* The link changed is in the last child, or in the parent if it has
+     * none, and the nodes after a shared node are shared too */
+    if (node_check_shared(last ? (ciscli_node *)last : parent)) {
+        return -1;
+    }
+
+    /* The dispatch tables no longer describe the child chain */
+    parser_keyword_free_dispatch(p);
+    parser_integer_free_dispatch(p);
+
+    *link = c;
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_eol_node_set_action(ciscli_node *node, ciscli_action action, void *arg)
+{
+    parser_node_eol_t *enode = (parser_node_eol_t *)node;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_EOL) ||
+        node_check_shared(node)) {
+        return -1;
+    }
+
+    /* This is cast back to a ciscli_action before it is called */
+    enode->action = (parser_action_fn)action;
+    enode->arg = arg;
+    return 0;
+}
+
+int ciscli_conditional_node_set_condition(ciscli_node *node,
+                                          const uint8_t *code, size_t len)
+{
+    parser_node_conditional_t *cnode = (parser_node_conditional_t *)node;
+    const parser_cond_program_t *program;
+    int retval;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_CONDITIONAL) ||
+        !NODE(node)->cold || !NODE(node)->cold->arena) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    retval = parser_cond_compile(code, len, NODE(node)->cold->arena, &program);
+    if (retval) {
+        errno = -retval;
+        return -1;
+    }
+
+    cnode->program = program;
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_keyword_node_set_keyword(ciscli_node *node, const char *kw)
+{
+    PARSER_NODE_KEYWORD *knode = (PARSER_NODE_KEYWORD *)node;
+    size_t len;
+    size_t i;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_KEYWORD) || !kw) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    /* The dispatch table of the parent is sorted by the keyword */
+    if (NODE(node)->flags & PARSER_NODE_FLAG_DISPATCHED) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    len = strlen(kw);
+    if (len == 0 || len >= KEYWORD_LENGTH_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)kw[i]) && kw[i] != '-') {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    memset(knode->keyword, 0, sizeof(knode->keyword));
+    memcpy(knode->keyword, kw, len);
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_keyword_node_set_min_match(ciscli_node *node, int min)
+{
+    PARSER_NODE_KEYWORD *knode = (PARSER_NODE_KEYWORD *)node;
+    size_t len;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_KEYWORD) || min < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    len = strnlen(knode->keyword, KEYWORD_LENGTH_MAX);
+    if ((size_t)min > len) {
+        min = (int)len;
+    }
+
+    knode->header.type_data = min;
+    knode->header.flags |= PARSER_NODE_FLAG_KEYWORD_MIN_MATCH;
+    return 0;
+}
+
+static int keyword_set_value(ciscli_node *node, uint32_t index, uint32_t flags)
+{
+    PARSER_NODE_KEYWORD *knode = (PARSER_NODE_KEYWORD *)node;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_KEYWORD) ||
+        index >= PARSER_MAX_PARAMS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    KW_COLD(node)->index = index;
+    knode->header.node_flags &= ~(PARSER_NODE_KW_FLAG_SET_BIT |
+                                  PARSER_NODE_KW_FLAG_SET_STRING);
+    knode->header.node_flags |= PARSER_NODE_KW_FLAG_SET_VALUE | flags;
+    return 0;
+}
+
+int ciscli_keyword_node_on_match_set_integer(ciscli_node *node, uint32_t index, int64_t value)
+{
+    if (keyword_set_value(node, index, 0)) {
+        return -1;
+    }
+
+    KW_COLD(node)->value = value;
+    return 0;
+}
+
+int ciscli_keyword_node_on_match_set_bit(ciscli_node *node, uint32_t index, uint32_t bit)
+{
+    if (bit > 63) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (keyword_set_value(node, index, PARSER_NODE_KW_FLAG_SET_BIT)) {
+        return -1;
+    }
+
+    KW_COLD(node)->value = bit;
+    return 0;
+}
+
+int ciscli_keyword_node_on_match_set_string(ciscli_node *node, uint32_t index, const char *str)
+{
+    PARSER_NODE_KEYWORD_COLD *kcold;
+
+    if (!str) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (keyword_set_value(node, index, PARSER_NODE_KW_FLAG_SET_STRING)) {
+        return -1;
+    }
+
+    kcold = KW_COLD(node);
+    strncpy(kcold->string, str, STRING_LENGTH_MAX - 1);
+    kcold->string[STRING_LENGTH_MAX - 1] = '\0';
+    return 0;
+}
+
+int ciscli_integer_node_set_index(ciscli_node *node, uint32_t index)
+{
+    if (node_check_type(node, PARSER_NODE_TYPE_INTEGER) ||
+        index >= PARSER_MAX_PARAMS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    ((parser_node_integer_t *)node)->index = index;
+    return 0;
+}
+
+int ciscli_integer_node_set_format(ciscli_node *node, uint32_t format)
+{
+    const uint32_t all = CISCLI_INTEGER_DEC | CISCLI_INTEGER_HEX |
+                         CISCLI_INTEGER_OCT | CISCLI_INTEGER_BIN;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_INTEGER) ||
+        format == 0 || (format & ~all)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    /* The range table of the parent holds the formats of its nodes */
+    if (NODE(node)->flags & PARSER_NODE_FLAG_DISPATCHED) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    /* The public format flags share their values with the parser flags */
+    ((parser_node_integer_t *)node)->formats = format;
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_integer_node_set_range(ciscli_node *node, int64_t min, int64_t max)
+{
+    parser_node_integer_t *inode = (parser_node_integer_t *)node;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_INTEGER) || min > max) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    /* The range table of the parent holds a copy of the range */
+    if (NODE(node)->flags & PARSER_NODE_FLAG_DISPATCHED) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    inode->min_accepted = min;
+    inode->max_accepted = max;
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_number_node_set_index(ciscli_node *node, uint32_t index)
+{
+    if (node_check_type(node, PARSER_NODE_TYPE_NUMBER) ||
+        index >= PARSER_MAX_PARAMS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    ((parser_node_number_t *)node)->index = index;
+    return 0;
+}
+
+int ciscli_number_node_set_range(ciscli_node *node, double min, double max)
+{
+    parser_node_number_t *nnode = (parser_node_number_t *)node;
+
+    /* This also rejects NaN, which compares false with everything */
+    if (node_check_type(node, PARSER_NODE_TYPE_NUMBER) || !(min <= max)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    nnode->min_accepted = min;
+    nnode->max_accepted = max;
+    ciscli_tree_modified();
+    return 0;
+}
+
+int ciscli_address_node_set_index(ciscli_node *node, uint32_t index)
+{
+    if (node_check_type(node, PARSER_NODE_TYPE_ADDRESS) ||
+        index >= PARSER_MAX_PARAMS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    ((parser_node_address_t *)node)->index = index;
+    return 0;
+}
+
+int ciscli_address_node_set_format(ciscli_node *node, uint32_t format)
+{
+    const uint32_t all = CISCLI_ADDRESS_IPV4 | CISCLI_ADDRESS_IPV6 |
+                         CISCLI_ADDRESS_MAC | CISCLI_ADDRESS_PREFIX;
+
+    if (node_check_type(node, PARSER_NODE_TYPE_ADDRESS) ||
+        !(format & ~CISCLI_ADDRESS_PREFIX) || (format & ~all)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (node_check_shared(node)) {
+        return -1;
+    }
+
+    /* The public format flags share their values with the parser flags */
+    ((parser_node_address_t *)node)->format = format;
+    ciscli_tree_modified();
+    return 0;
+}
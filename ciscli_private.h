@@ -0,0 +1,386 @@
+/****************************************************************************
+ * CisCLI private definitions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef CISCLI_PRIVATE_H
+#define CISCLI_PRIVATE_H
+
+#include <stdint.h>
+
+#include "ciscli.h"
+#include "parser_arena.h"
+#include "parser_tree.h"
+#include "parser_control.h"
+#include "parser.h"
+
+/** @brief Compiled prompt format of a parse tree */
+typedef struct ciscli_prompt_format_s ciscli_prompt_format;
+
+/** @brief Parse tree owned by a \ref ciscli structure
+ *
+ * Every node of the tree, and the tree's dispatch tables, are allocated
+ * from the tree's arena, so the tree is released by releasing the arena.
+ * The cold data of the nodes, such as help text, is allocated from a
+ * separate arena so that it does not sit between the nodes.
+ */
+typedef struct ciscli_tree_s {
+    /** Name of the tree */
+    char *name;
+
+    /** Index of the parent tree, or CISCLI_NO_PARENT_TREE */
+    uint32_t parent;
+
+    /** Arena holding the nodes of the tree */
+    parser_arena_t arena;
+
+    /** Arena holding the cold data of the nodes */
+    parser_arena_t cold_arena;
+
+    /** Root node of the tree */
+    PARSER_NODE *root;
+
+    /** Statistics of the lines parsed starting in this tree */
+    ciscli_mode_stats stats;
+
+    /** Prompt format, or NULL if the tree has no prompt */
+    ciscli_prompt_format *prompt;
+} ciscli_tree;
+
+/** @brief Count of modifications made to the parse trees
+ *
+ * Node functions are not passed the \ref ciscli structure that owns the
+ * node, so a single count is kept for all trees. Results derived from the
+ * trees, such as cached completions, are discarded when it changes.
+ */
+extern uint32_t ciscli_tree_generation;
+
+/** @brief Record that a parse tree has been modified */
+static inline void ciscli_tree_modified(void)
+{
+    __atomic_fetch_add(&ciscli_tree_generation, 1, __ATOMIC_RELAXED);
+}
+
+struct ciscli_completion_cache_s;
+struct ciscli_prompt_state_s;
+
+/** @brief Block of output held by a \ref ciscli structure
+ *
+ * Output is written with one writev call across the chunks held. Chunks
+ * that have been written are kept for reuse, so a command that prints a
+ * lot of output cycles through the same few chunks.
+ */
+typedef struct ciscli_chunk_s {
+    /** Next chunk, holding later output */
+    struct ciscli_chunk_s *next;
+
+    /** Offset of the first byte that has not been written */
+    size_t start;
+
+    /** Number of bytes of output in the chunk */
+    size_t len;
+
+    /** Size of the data */
+    size_t size;
+
+    /** Output */
+    char data[];
+} ciscli_chunk;
+
+/** @brief Compiled output filters of a command line */
+typedef struct ciscli_filter_s ciscli_filter;
+
+struct _ciscli {
+    /** Parse trees, tree index N is stored at trees[N - 1] */
+    ciscli_tree **trees;
+
+    /** Number of parse trees */
+    uint32_t tree_count;
+
+    /** Number of entries allocated in the trees array */
+    uint32_t tree_alloc;
+
+    /** Index of the tree that commands are parsed in */
+    uint32_t current_tree;
+
+    /** Flags set in every control structure, see PARSER_CTRL_FLAG_* */
+    uint32_t parse_flags;
+
+    /** Control structure reused for every command */
+    PARSER_CTRL *ctl;
+
+    /** Completion results, allocated on first use */
+    struct ciscli_completion_cache_s *completions;
+
+    /** Rendered prompt and its inputs, allocated on first use */
+    struct ciscli_prompt_state_s *prompt;
+
+    /** Buffer holding input that has been read but not processed */
+    char *input;
+
+    /** Number of bytes in the input buffer */
+    size_t input_len;
+
+    /** Size of the input buffer */
+    size_t input_size;
+
+    /** Input file descriptor */
+    int in_fd;
+
+    /** Output file descriptor */
+    int out_fd;
+
+    /** Error file descriptor */
+    int err_fd;
+
+    /** Structure that owns the parse trees, or NULL if this one does */
+    ciscli *base;
+
+    /** Offset of the first byte of input that has not been processed */
+    size_t input_pos;
+
+    /** Offset up to which the input has been searched for the end of a
+     * line, so that input fed a byte at a time is searched once */
+    size_t input_scanned;
+
+    /** Input is being dropped up to the next newline, since the line it
+     * belongs to is too long */
+    int input_discard;
+
+    /** Output is held until it is flushed, rather than written as each
+     * command runs */
+    int buffered;
+
+    /** Chunks of output that have not been written, oldest first */
+    ciscli_chunk *output_head;
+
+    /** Chunk that output is added to */
+    ciscli_chunk *output_tail;
+
+    /** Chunks that have been written, kept for reuse */
+    ciscli_chunk *output_spare;
+
+    /** Number of chunks kept for reuse */
+    uint32_t output_spare_count;
+
+    /** A command is running, so its output may be held for a while */
+    int output_command;
+
+    /** Number of bytes of output that have not been written */
+    size_t output_held;
+
+    /** Time at which the oldest output held was added */
+    uint64_t output_since;
+
+    /** Filter for the output of the command that is running, or NULL */
+    ciscli_filter *filter;
+
+    /** Line of output being assembled for the filter and the pager */
+    char *output_line;
+
+    /** Number of bytes in the line buffer */
+    size_t output_line_len;
+
+    /** Size of the line buffer */
+    size_t output_line_size;
+
+    /** Lines per page of output, or 0 not to page */
+    uint32_t page_lines;
+
+    /** Lines shown since the pager last prompted */
+    uint32_t page_shown;
+
+    /** The pager was quit, so the rest of the output is dropped */
+    int page_quit;
+
+    /** The pager was stopped by the end of input, so the rest of the output
+     * is shown without prompting */
+    int page_off;
+};
+
+/** @brief Retrieve the structure that owns the parse trees of a session */
+static inline ciscli * ciscli_tree_owner(ciscli *cli)
+{
+    return cli->base ? cli->base : cli;
+}
+
+/** @brief Look up a parse tree by index
+ *
+ * @returns Pointer to the tree, or NULL with errno set to EINVAL.
+ */
+ciscli_tree * ciscli_get_tree(ciscli *cli, uint32_t tree);
+
+/** @brief Parse a single command line without running it
+ *
+ * The line is parsed in the given tree, falling back to its parent trees.
+ * This reads the trees and writes only to the control structure, so it
+ * may be called from several threads at once, each with its own control
+ * structure, as long as no thread modifies the trees.
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   tree    Index of the tree to parse the line in
+ * @param   ctl     Control structure that receives the parameters
+ * @param   line    Command line, need not be null terminated
+ * @param   len     Length of the command line
+ * @param   result  Receives the outcome of parsing
+ *
+ * @returns Pointer to the EOL node of the command if it was parsed
+ *          successfully, NULL otherwise.
+ */
+parser_node_eol_t * ciscli_parse_line(ciscli *cli, uint32_t tree,
+                                      PARSER_CTRL *ctl, const char *line,
+                                      size_t len, ciscli_result *result);
+
+/** @brief Check the output filters of a parsed command line
+ *
+ * The filters are stripped from the line before it is parsed, so a line
+ * that parses is only valid once its filters compile as well.
+ *
+ * @param   line    Command line, need not be null terminated
+ * @param   len     Length of the command line
+ * @param   filter  Receives the compiled filters, NULL if the line has
+ *                  none. This may be NULL to only check them.
+ * @param   result  Set to CISCLI_STATUS_INVALID_FILTER, with the offset of
+ *                  the filter that is not valid, if they do not compile
+ *
+ * @returns 0 on success, -1 if the filters do not compile
+ */
+int ciscli_line_filter(const char *line, size_t len, ciscli_filter **filter,
+                       ciscli_result *result);
+
+/** @brief Parse and run a single command line
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   line    Command line, need not be null terminated
+ * @param   len     Length of the command line
+ * @param   flags   Combination of \ref ciscli_execute_flags
+ * @param   result  Receives the outcome of the command
+ */
+void ciscli_execute_line(ciscli *cli, const char *line, size_t len,
+                         uint32_t flags, ciscli_result *result);
+
+/** @brief Read the clock used for the latency statistics, in nanoseconds */
+uint64_t ciscli_stats_clock(void);
+
+/** @brief Record the statistics of a parsed line
+ *
+ * @param   tree    Tree the line was parsed in first
+ * @param   result  Outcome of parsing the line
+ * @param   probes  Number of nodes passed over in child chains
+ * @param   depth   Largest number of nodes passed over in one chain
+ * @param   ns      Time taken to parse the line
+ */
+void ciscli_stats_record(ciscli_tree *tree, const ciscli_result *result,
+                         uint32_t probes, uint32_t depth, uint64_t ns);
+
+/** @brief Find the output filters of a command line
+ *
+ * @returns Offset of the "|" token that starts the first filter, or \p len
+ *          if the line has none.
+ */
+size_t ciscli_filter_split(const char *line, size_t len);
+
+/** @brief Compile the output filters of a command line
+ *
+ * @param   spec            Filters, starting at the first "|" token
+ * @param   len             Length of the filters
+ * @param   filter          Receives the compiled filters
+ * @param   error_offset    Receives the offset within \p spec of the "|"
+ *                          token of a filter that is not valid
+ *
+ * @returns 0 on success, -EINVAL if a filter is not valid or -ENOMEM.
+ */
+int ciscli_filter_compile(const char *spec, size_t len,
+                          ciscli_filter **filter, size_t *error_offset);
+
+/** @brief Release compiled output filters */
+void ciscli_filter_free(ciscli_filter *filter);
+
+/** @brief Scan output up to the end of a line
+ *
+ * The patterns of the filters that are plain text are found as the output
+ * is scanned, so that each byte of output is only looked at once, however
+ * many patterns there are. A line may be scanned in several parts.
+ *
+ * @param   filter  Compiled filters
+ * @param   text    Output
+ * @param   len     Length of the output
+ *
+ * @returns Offset of the first newline in \p text, or \p len if there is
+ *          none. The newline itself is not scanned.
+ */
+size_t ciscli_filter_scan(ciscli_filter *filter, const char *text, size_t len);
+
+/** @brief Decide whether a line of output is shown
+ *
+ * The whole of the line must have been passed to \ref ciscli_filter_scan
+ * first.
+ *
+ * @param   filter  Compiled filters
+ * @param   line    Line of output, which is followed by at least one byte
+ *                  that may be overwritten while it is matched
+ * @param   len     Length of the line, without its newline
+ *
+ * @returns 1 if the line is shown, 0 if it is dropped.
+ */
+int ciscli_filter_line(ciscli_filter *filter, char *line, size_t len);
+
+/** @brief Format the output of the filters once the command is done
+ *
+ * @returns Number of bytes formatted into \p buf, as snprintf, or 0 if the
+ *          filters have no output of their own.
+ */
+int ciscli_filter_finish(ciscli_filter *filter, char *buf, size_t size);
+
+/** @brief Start holding the output of a command
+ *
+ * @param   cli     A pointer to a \ref ciscli structure
+ * @param   filter  Filters for the output, which the structure takes
+ *                  ownership of, or NULL
+ */
+void ciscli_output_begin(ciscli *cli, ciscli_filter *filter);
+
+/** @brief Finish the output of a command
+ *
+ * This passes a final line without a newline through the filters, adds
+ * their own output, and writes the output unless it is held for flushing.
+ *
+ * @returns 1 if the pager was quit during the command, 0 otherwise.
+ */
+int ciscli_output_end(ciscli *cli);
+
+/** @brief Release the output held by a \ref ciscli structure */
+void ciscli_output_free(ciscli *cli);
+
+/** @brief Capture the parameters a tree's prompt shows before entering it
+ *
+ * While an action runs, the parameters of its command are held for the
+ * prompt of the tree, so that a command such as "interface eth1" can show
+ * the interface in the prompt of the mode it enters.
+ *
+ * @returns 0 on success, or -ENOMEM.
+ */
+int ciscli_prompt_capture(ciscli *cli, uint32_t tree);
+
+/** @brief Release the prompt of a \ref ciscli structure */
+void ciscli_prompt_state_free(struct ciscli_prompt_state_s *state);
+
+/** @brief Release the completion cache of a \ref ciscli structure */
+void ciscli_completion_cache_free(struct ciscli_completion_cache_s *cache);
+
+#endif /* end of include guard: CISCLI_PRIVATE_H */
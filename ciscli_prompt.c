@@ -0,0 +1,593 @@
+/****************************************************************************
+ * CisCLI prompt rendering
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ciscli_private.h"
+
+#ifndef HOST_NAME_MAX
+#define HOST_NAME_MAX       255
+#endif
+
+/* Parameters of the command that entered a mode that a format may use */
+#define PROMPT_PARAMS_MAX   8
+
+/* Longest value held for each of those parameters */
+#define PROMPT_VALUE_MAX    64
+
+/* The system hostname is checked for changes at most this often */
+#define PROMPT_HOST_CHECK_NS    1000000000u
+
+extern char **environ;
+
+typedef enum {
+    SEGMENT_TEXT,
+    SEGMENT_HOST,
+    SEGMENT_FQDN,
+    SEGMENT_MODE,
+    SEGMENT_STRING,
+    SEGMENT_INTEGER,
+} segment_kind;
+
+/* Part of a prompt format: text copied as is, or a value expanded */
+typedef struct {
+    uint8_t kind;
+
+    /* Parameter index in the control structure */
+    uint8_t index;
+
+    /* Slot holding the value of the parameter when the mode was entered */
+    uint8_t slot;
+
+    /* Text within the format string */
+    uint16_t offset;
+    uint16_t len;
+} prompt_segment;
+
+struct ciscli_prompt_format_s {
+    /* Distinguishes this format from any that was replaced before it */
+    uint32_t serial;
+
+    /* Number of segments */
+    uint32_t count;
+
+    /* Number of parameter slots used */
+    uint32_t slots;
+
+    /* The hostname is expanded */
+    int uses_host;
+
+    /* Format string as given, passed to the prompt command */
+    char *format;
+
+    prompt_segment segments[];
+};
+
+struct ciscli_prompt_state_s {
+    /* Rendered prompt */
+    char prompt[CISCLI_PROMPT_MAX];
+    size_t len;
+
+    /* Count of changes to the inputs of the prompt */
+    uint32_t generation;
+
+    /* Generation, tree and format the prompt was rendered for */
+    uint32_t rendered;
+    uint32_t tree;
+    uint32_t serial;
+
+    /* Hostname, and whether it was set rather than read from the system */
+    char host[HOST_NAME_MAX + 1];
+    int host_set;
+    int host_valid;
+    uint64_t host_checked;
+
+    /* Parameters of the command that entered the current mode, and the
+     * serial of the format they were captured for */
+    char values[PROMPT_PARAMS_MAX][PROMPT_VALUE_MAX];
+    uint32_t values_serial;
+
+    /* Command that renders the prompt, or NULL to render it here */
+    char *command;
+};
+
+static uint32_t prompt_serial;
+
+static uint64_t prompt_clock(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static struct ciscli_prompt_state_s * prompt_state(ciscli *cli)
+{
+    if (!cli->prompt) {
+        cli->prompt = calloc(1, sizeof(*cli->prompt));
+        if (cli->prompt) {
+            cli->prompt->generation = 1;
+        }
+    }
+
+    return cli->prompt;
+}
+
+/* Parse a parameter index of up to two digits */
+static int format_index(const char *format, size_t *pos)
+{
+    int index = 0;
+    int digits = 0;
+
+    while (digits < 2 && format[*pos] >= '0' && format[*pos] <= '9') {
+        index = index * 10 + (format[(*pos)++] - '0');
+        digits++;
+    }
+
+    return (digits && index < PARSER_MAX_PARAMS) ? index : -1;
+}
+
+static int format_compile(const char *format, ciscli_prompt_format **compiled)
+{
+    ciscli_prompt_format *f;
+    prompt_segment *seg;
+    size_t len;
+    size_t pos;
+    int index;
+    char c;
+
+    len = strlen(format);
+    if (len >= CISCLI_PROMPT_MAX) {
+        return -EINVAL;
+    }
+
+    /* Every character starts at most one segment */
+    f = calloc(1, sizeof(*f) + len * sizeof(f->segments[0]) + len + 1);
+    if (!f) {
+        return -ENOMEM;
+    }
+
+    f->format = (char *)&f->segments[len];
+    memcpy(f->format, format, len + 1);
+
+    for (pos = 0; pos < len; ) {
+        seg = &f->segments[f->count];
+
+        if (format[pos] != '%' || format[pos + 1] == '%') {
+            /* A %% is the text of its second % */
+            if (format[pos] == '%') {
+                pos++;
+            }
+
+            if (f->count && seg[-1].kind == SEGMENT_TEXT &&
+                seg[-1].offset + seg[-1].len == pos) {
+                seg[-1].len++;
+            } else {
+                seg->kind = SEGMENT_TEXT;
+                seg->offset = pos;
+                seg->len = 1;
+                f->count++;
+            }
+            pos++;
+            continue;
+        }
+
+        c = format[pos + 1];
+        pos += 2;
+        switch (c) {
+        case 'h':
+            seg->kind = SEGMENT_HOST;
+            f->uses_host = 1;
+            break;
+
+        case 'H':
+            seg->kind = SEGMENT_FQDN;
+            f->uses_host = 1;
+            break;
+
+        case 'm':
+            seg->kind = SEGMENT_MODE;
+            break;
+
+        case 's':
+        case 'i':
+            index = format_index(format, &pos);
+            if (index < 0 || f->slots == PROMPT_PARAMS_MAX) {
+                free(f);
+                return -EINVAL;
+            }
+
+            seg->kind = c == 's' ? SEGMENT_STRING : SEGMENT_INTEGER;
+            seg->index = index;
+            seg->slot = f->slots++;
+            break;
+
+        default:
+            free(f);
+            return -EINVAL;
+        }
+        f->count++;
+    }
+
+    f->serial = __atomic_add_fetch(&prompt_serial, 1, __ATOMIC_RELAXED);
+    *compiled = f;
+    return 0;
+}
+
+int ciscli_tree_set_prompt(ciscli *cli, uint32_t tree, const char *format)
+{
+    ciscli_prompt_format *compiled = NULL;
+    ciscli_tree *t;
+    int retval;
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    /* Trees are shared by sessions, which cannot modify them */
+    if (cli->base) {
+        errno = EPERM;
+        return -1;
+    }
+
+    if (format && *format) {
+        retval = format_compile(format, &compiled);
+        if (retval) {
+            errno = -retval;
+            return -1;
+        }
+    }
+
+    free(t->prompt);
+    t->prompt = compiled;
+    return 0;
+}
+
+int ciscli_prompt_set_hostname(ciscli *cli, const char *hostname)
+{
+    struct ciscli_prompt_state_s *state;
+
+    if (!cli || (hostname && strlen(hostname) > HOST_NAME_MAX)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    state = prompt_state(cli);
+    if (!state) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (hostname) {
+        strcpy(state->host, hostname);
+    }
+
+    /* Without a name, the system hostname is read again when next used */
+    state->host_set = hostname != NULL;
+    state->host_valid = hostname != NULL;
+    state->generation++;
+    return 0;
+}
+
+int ciscli_prompt_set_command(ciscli *cli, const char *command)
+{
+    struct ciscli_prompt_state_s *state;
+    char *copy = NULL;
+
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    state = prompt_state(cli);
+    if (command && *command) {
+        copy = strdup(command);
+    }
+
+    if (!state || (command && *command && !copy)) {
+        free(copy);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    free(state->command);
+    state->command = copy;
+    state->generation++;
+    return 0;
+}
+
+int ciscli_prompt_capture(ciscli *cli, uint32_t tree)
+{
+    struct ciscli_prompt_state_s *state;
+    const prompt_segment *seg;
+    ciscli_prompt_format *f;
+    ciscli_tree *t;
+    const char *str;
+    uint32_t len;
+    int64_t value;
+    uint32_t i;
+
+    t = ciscli_get_tree(cli, tree);
+    f = t ? t->prompt : NULL;
+    if (!f || !f->slots) {
+        return 0;
+    }
+
+    state = prompt_state(cli);
+    if (!state) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < f->count; i++) {
+        seg = &f->segments[i];
+        if (seg->kind != SEGMENT_STRING && seg->kind != SEGMENT_INTEGER) {
+            continue;
+        }
+
+        /* The control structure only holds the parameters of a command
+         * while its action runs */
+        if (!cli->output_command) {
+            state->values[seg->slot][0] = '\0';
+        } else if (seg->kind == SEGMENT_STRING) {
+            parser_control_get_string_span(cli->ctl, seg->index, &str, &len);
+            if (len >= PROMPT_VALUE_MAX) {
+                len = PROMPT_VALUE_MAX - 1;
+            }
+            memcpy(state->values[seg->slot], str, len);
+            state->values[seg->slot][len] = '\0';
+        } else {
+            parser_control_get_integer(cli->ctl, seg->index, &value);
+            snprintf(state->values[seg->slot], PROMPT_VALUE_MAX, "%lld",
+                     (long long)value);
+        }
+    }
+
+    state->values_serial = f->serial;
+    state->generation++;
+    return 0;
+}
+
+/* Read the system hostname, at most once a second */
+static void prompt_refresh_host(struct ciscli_prompt_state_s *state)
+{
+    char host[HOST_NAME_MAX + 1];
+    uint64_t now;
+
+    if (state->host_set) {
+        return;
+    }
+
+    now = prompt_clock();
+    if (state->host_valid && now - state->host_checked < PROMPT_HOST_CHECK_NS) {
+        return;
+    }
+
+    state->host_checked = now;
+    if (gethostname(host, sizeof(host)) < 0) {
+        host[0] = '\0';
+    }
+    host[HOST_NAME_MAX] = '\0';
+
+    if (!state->host_valid || strcmp(host, state->host) != 0) {
+        strcpy(state->host, host);
+        state->host_valid = 1;
+        state->generation++;
+    }
+}
+
+/* Add text to the prompt, truncating it to the size of the prompt */
+static void prompt_add(struct ciscli_prompt_state_s *state, const char *text,
+                       size_t len)
+{
+    if (len > sizeof(state->prompt) - 1 - state->len) {
+        len = sizeof(state->prompt) - 1 - state->len;
+    }
+
+    memcpy(state->prompt + state->len, text, len);
+    state->len += len;
+}
+
+static void prompt_render(struct ciscli_prompt_state_s *state,
+                          const ciscli_tree *t)
+{
+    const ciscli_prompt_format *f = t->prompt;
+    const prompt_segment *seg;
+    const char *dot;
+    uint32_t i;
+
+    state->len = 0;
+    for (i = 0; i < f->count; i++) {
+        seg = &f->segments[i];
+
+        switch (seg->kind) {
+        case SEGMENT_TEXT:
+            prompt_add(state, f->format + seg->offset, seg->len);
+            break;
+
+        case SEGMENT_HOST:
+            dot = strchr(state->host, '.');
+            prompt_add(state, state->host,
+                       dot ? (size_t)(dot - state->host) : strlen(state->host));
+            break;
+
+        case SEGMENT_FQDN:
+            prompt_add(state, state->host, strlen(state->host));
+            break;
+
+        case SEGMENT_MODE:
+            prompt_add(state, t->name, strlen(t->name));
+            break;
+
+        default:
+            /* Values captured for another mode are not shown */
+            if (state->values_serial == f->serial) {
+                prompt_add(state, state->values[seg->slot],
+                           strlen(state->values[seg->slot]));
+            }
+            break;
+        }
+    }
+
+    state->prompt[state->len] = '\0';
+}
+
+/* Render the prompt by running the prompt command with the format string
+ * as its argument, and taking the first line of its output */
+static int prompt_run_command(struct ciscli_prompt_state_s *state,
+                              const ciscli_prompt_format *f)
+{
+    posix_spawn_file_actions_t actions;
+    char discard[256];
+    char *argv[3];
+    ssize_t got;
+    size_t len = 0;
+    char *nl;
+    pid_t pid;
+    int fds[2];
+    int status;
+    int retval;
+
+    if (pipe(fds) < 0) {
+        return -errno;
+    }
+
+    argv[0] = state->command;
+    argv[1] = f->format;
+    argv[2] = NULL;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    retval = posix_spawnp(&pid, state->command, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+
+    if (retval) {
+        close(fds[0]);
+        return -retval;
+    }
+
+    /* Read to the end, so that the command is not stopped by a full pipe */
+    for (;;) {
+        got = read(fds[0], state->prompt + len, sizeof(state->prompt) - 1 - len);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+
+        len += got;
+        if (len == sizeof(state->prompt) - 1) {
+            while (read(fds[0], discard, sizeof(discard)) > 0) {
+            }
+            break;
+        }
+    }
+    close(fds[0]);
+
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    state->prompt[len] = '\0';
+    nl = memchr(state->prompt, '\n', len);
+    if (nl) {
+        *nl = '\0';
+        len = nl - state->prompt;
+    }
+    state->len = len;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+const char * ciscli_prompt(ciscli *cli, size_t *len)
+{
+    struct ciscli_prompt_state_s *state;
+    ciscli_tree *t;
+
+    if (!cli) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    t = ciscli_get_tree(cli, cli->current_tree);
+    if (!t || !t->prompt) {
+        if (len) {
+            *len = 0;
+        }
+        return "";
+    }
+
+    state = prompt_state(cli);
+    if (!state) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (t->prompt->uses_host) {
+        prompt_refresh_host(state);
+    }
+
+    if (state->rendered != state->generation ||
+        state->tree != cli->current_tree ||
+        state->serial != t->prompt->serial) {
+        /* The prompt command is only run when the prompt changes, and the
+         * prompt is rendered here if it fails */
+        if (!state->command || prompt_run_command(state, t->prompt) < 0) {
+            prompt_render(state, t);
+        }
+
+        state->rendered = state->generation;
+        state->tree = cli->current_tree;
+        state->serial = t->prompt->serial;
+    }
+
+    if (len) {
+        *len = state->len;
+    }
+    return state->prompt;
+}
+
+void ciscli_prompt_state_free(struct ciscli_prompt_state_s *state)
+{
+    if (state) {
+        free(state->command);
+        free(state);
+    }
+}
@@ -0,0 +1,356 @@
+/****************************************************************************
+ * CisCLI parse statistics
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "ciscli_private.h"
+
+/* Maximum number of nodes in a command path written by the dump */
+#define STATS_PATH_MAX  32
+
+struct stats_path_s;
+
+/* Writes the line for a node, given the command path leading to it */
+typedef void (*stats_emit_fn)(struct stats_path_s *path, PARSER_NODE *node);
+
+/* Command path leading to the node being dumped */
+typedef struct stats_path_s {
+    int fd;
+    stats_emit_fn emit;
+    uint32_t depth;
+    const char *labels[STATS_PATH_MAX];
+    char bufs[STATS_PATH_MAX][PARSER_ALT_TEXT_MAX];
+} stats_path;
+
+uint64_t ciscli_stats_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint32_t latency_bucket(uint64_t ns)
+{
+    uint32_t bucket;
+
+    if (!ns) {
+        return 0;
+    }
+
+    bucket = 63 - __builtin_clzll(ns);
+    if (bucket >= CISCLI_STATS_LATENCY_BUCKETS) {
+        bucket = CISCLI_STATS_LATENCY_BUCKETS - 1;
+    }
+
+    return bucket;
+}
+
+void ciscli_stats_record(ciscli_tree *tree, const ciscli_result *result,
+                         uint32_t probes, uint32_t depth, uint64_t ns)
+{
+    ciscli_mode_stats *stats = &tree->stats;
+    uint32_t max;
+
+    if (result->status == CISCLI_STATUS_EMPTY) {
+        return;
+    }
+
+    /* Lines may be parsed by several threads, see ciscli_validate_buffer */
+    __atomic_fetch_add(&stats->lines, 1, __ATOMIC_RELAXED);
+    if (result->status != CISCLI_STATUS_OK) {
+        __atomic_fetch_add(&stats->failed, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&stats->probes, probes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->latency[latency_bucket(ns)], 1,
+                       __ATOMIC_RELAXED);
+
+    max = __atomic_load_n(&stats->probe_depth_max, __ATOMIC_RELAXED);
+    while (depth > max &&
+           !__atomic_compare_exchange_n(&stats->probe_depth_max, &max, depth,
+                                        1, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+        /* max is reloaded by the failed exchange */
+    }
+}
+
+int ciscli_stats_enable(ciscli *cli, int enable)
+{
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#ifdef PARSER_NO_STATS
+    if (enable) {
+        errno = ENOTSUP;
+        return -1;
+    }
+#endif
+
+    if (enable) {
+        cli->parse_flags |= PARSER_CTRL_FLAG_STATS;
+    } else {
+        cli->parse_flags &= ~PARSER_CTRL_FLAG_STATS;
+    }
+
+    return 0;
+}
+
+int ciscli_stats_get_mode(ciscli *cli, uint32_t tree, ciscli_mode_stats *stats)
+{
+    ciscli_mode_stats *src;
+    ciscli_tree *t;
+    uint32_t i;
+
+    if (!stats) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    t = ciscli_get_tree(cli, tree);
+    if (!t) {
+        return -1;
+    }
+
+    src = &t->stats;
+    memset(stats, 0, sizeof(*stats));
+    stats->lines = __atomic_load_n(&src->lines, __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&src->failed, __ATOMIC_RELAXED);
+    stats->probes = __atomic_load_n(&src->probes, __ATOMIC_RELAXED);
+    stats->probe_depth_max = __atomic_load_n(&src->probe_depth_max,
+                                             __ATOMIC_RELAXED);
+    for (i = 0; i < CISCLI_STATS_LATENCY_BUCKETS; i++) {
+        stats->latency[i] = __atomic_load_n(&src->latency[i],
+                                            __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+int ciscli_stats_get_node(ciscli_node *node, ciscli_node_stats *stats)
+{
+    parser_node_cold_t *cold;
+
+    if (!node || !stats) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    cold = ((PARSER_NODE *)node)->cold;
+    if (cold) {
+        stats->matches = __atomic_load_n(&cold->matches, __ATOMIC_RELAXED);
+        stats->rejects = __atomic_load_n(&cold->rejects, __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+static int reset_node(PARSER_NODE *node, void *arg)
+{
+    (void)arg;
+
+    if (node->cold) {
+        __atomic_store_n(&node->cold->matches, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&node->cold->rejects, 0, __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+int ciscli_stats_reset(ciscli *cli)
+{
+    ciscli_tree *tree;
+    uint32_t i;
+    int retval;
+
+    if (!cli) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    cli = ciscli_tree_owner(cli);
+    for (i = 0; i < cli->tree_count; i++) {
+        tree = cli->trees[i];
+        memset(&tree->stats, 0, sizeof(tree->stats));
+
+        retval = parser_tree_walk(tree->root, reset_node, NULL);
+        if (retval) {
+            errno = -retval;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static const char * node_label(PARSER_NODE *node, char *buf, size_t size)
+{
+    const PARSER_NODE_REG *reg;
+
+    if (node->type == PARSER_NODE_TYPE_EOL) {
+        return PARSER_EOL_TEXT;
+    }
+
+    reg = parser_node_get_registration(node->type);
+    if (reg && reg->alt_text) {
+        return reg->alt_text(node, buf, size);
+    }
+
+    snprintf(buf, size, "<type %u>", node->type);
+    return buf;
+}
+
+static void write_path(stats_path *path)
+{
+    uint32_t i;
+
+    for (i = 0; i < path->depth; i++) {
+        dprintf(path->fd, "%s%s", i ? " " : "", path->labels[i]);
+    }
+    dprintf(path->fd, "\n");
+}
+
+static void dump_path(stats_path *path, PARSER_NODE *node)
+{
+    parser_node_cold_t *cold = node->cold;
+    uint64_t matches;
+    uint64_t rejects;
+
+    if (!cold) {
+        return;
+    }
+
+    matches = __atomic_load_n(&cold->matches, __ATOMIC_RELAXED);
+    rejects = __atomic_load_n(&cold->rejects, __ATOMIC_RELAXED);
+    if (!matches && !rejects) {
+        return;
+    }
+
+    dprintf(path->fd, "  %10llu %10llu  ", (unsigned long long)matches,
+            (unsigned long long)rejects);
+    write_path(path);
+}
+
+static void profile_path(stats_path *path, PARSER_NODE *node)
+{
+    uint64_t matches;
+
+    if (!node->cold) {
+        return;
+    }
+
+    matches = __atomic_load_n(&node->cold->matches, __ATOMIC_RELAXED);
+    if (matches) {
+        dprintf(path->fd, "%llu ", (unsigned long long)matches);
+        write_path(path);
+    }
+}
+
+static void walk_paths(stats_path *path, PARSER_NODE *node)
+{
+    PARSER_NODE *child;
+
+    /* Loops in the tree are cut off at the maximum path length */
+    if (path->depth == STATS_PATH_MAX) {
+        return;
+    }
+
+    for (child = node->child; child; child = child->sibling) {
+        path->labels[path->depth] = node_label(child, path->bufs[path->depth],
+                                               PARSER_ALT_TEXT_MAX);
+        path->depth++;
+        path->emit(path, child);
+        walk_paths(path, child);
+        path->depth--;
+    }
+}
+
+int ciscli_stats_dump(ciscli *cli, int fd)
+{
+    stats_path path;
+    ciscli_mode_stats stats;
+    ciscli_tree *tree;
+    uint32_t i;
+    uint32_t b;
+
+    if (!cli || fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 1; i <= ciscli_tree_owner(cli)->tree_count; i++) {
+        tree = ciscli_get_tree(cli, i);
+        ciscli_stats_get_mode(cli, i, &stats);
+
+        dprintf(fd, "Mode %s: %llu lines, %llu failed, "
+                "%llu probes, deepest probe %u\n", tree->name,
+                (unsigned long long)stats.lines,
+                (unsigned long long)stats.failed,
+                (unsigned long long)stats.probes, stats.probe_depth_max);
+
+        for (b = 0; b < CISCLI_STATS_LATENCY_BUCKETS; b++) {
+            if (stats.latency[b]) {
+                dprintf(fd, "  < %20llu ns: %llu\n",
+                        (unsigned long long)2 << b,
+                        (unsigned long long)stats.latency[b]);
+            }
+        }
+
+        dprintf(fd, "  %10s %10s  %s\n", "Matches", "Rejects", "Command");
+        path.fd = fd;
+        path.emit = dump_path;
+        path.depth = 0;
+        walk_paths(&path, tree->root);
+    }
+
+    return 0;
+}
+
+int ciscli_stats_write_profile(ciscli *cli, int fd)
+{
+    stats_path path;
+    ciscli_tree *tree;
+    uint32_t i;
+
+    if (!cli || fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    cli = ciscli_tree_owner(cli);
+    dprintf(fd, "# CisCLI parse profile\n");
+    for (i = 0; i < cli->tree_count; i++) {
+        tree = cli->trees[i];
+        dprintf(fd, "tree \"%s\"\n", tree->name);
+
+        path.fd = fd;
+        path.emit = profile_path;
+        path.depth = 0;
+        walk_paths(&path, tree->root);
+    }
+
+    return 0;
+}
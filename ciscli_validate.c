@@ -0,0 +1,258 @@
+/****************************************************************************
+ * CisCLI parallel command validation
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco-style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ciscli_private.h"
+
+/* Number of lines a worker claims at a time */
+#define VALIDATE_CHUNK          256
+
+/* Upper bound on the worker pool, regardless of what the caller asks for */
+#define VALIDATE_MAX_THREADS    64
+
+/* A line of the buffer, which is not copied */
+typedef struct {
+    const char *line;
+    size_t len;
+} validate_span;
+
+/* State shared by the workers, which only write to their own results */
+typedef struct {
+    ciscli *cli;
+    uint32_t tree;
+    const validate_span *spans;
+    ciscli_result *results;
+    size_t lines;
+
+    /* Index of the next line to be claimed, updated atomically */
+    size_t next;
+
+    /* Number of lines that failed to parse, updated atomically */
+    size_t failed;
+} validate_job;
+
+static void validate_run(validate_job *job, PARSER_CTRL *ctl)
+{
+    ciscli_result *r;
+    size_t failed = 0;
+    size_t start;
+    size_t end;
+    size_t i;
+
+    for (;;) {
+        start = __atomic_fetch_add(&job->next, VALIDATE_CHUNK,
+                                   __ATOMIC_RELAXED);
+        if (start >= job->lines) {
+            break;
+        }
+
+        end = start + VALIDATE_CHUNK;
+        if (end > job->lines) {
+            end = job->lines;
+        }
+
+        for (i = start; i < end; i++) {
+            r = &job->results[i];
+            if (ciscli_parse_line(job->cli, job->tree, ctl, job->spans[i].line,
+                                  job->spans[i].len, r)) {
+                ciscli_line_filter(job->spans[i].line, job->spans[i].len,
+                                   NULL, r);
+            }
+
+            if (r->status != CISCLI_STATUS_OK &&
+                r->status != CISCLI_STATUS_EMPTY) {
+                failed++;
+            }
+        }
+    }
+
+    __atomic_fetch_add(&job->failed, failed, __ATOMIC_RELAXED);
+}
+
+static void * validate_worker(void *arg)
+{
+    validate_job *job = arg;
+    PARSER_CTRL *ctl;
+
+    /*
+     * If this worker cannot get a control structure, the lines it would
+     * have claimed are simply left to the others.
+     */
+    ctl = calloc(1, sizeof(*ctl));
+    if (ctl) {
+        validate_run(job, ctl);
+        parser_control_destroy(ctl);
+        free(ctl);
+    }
+
+    return NULL;
+}
+
+/* Split the buffer into lines, returns the number of lines or -1 */
+static ssize_t split_lines(const char *buf, size_t len, validate_span **spans)
+{
+    const char *end = buf + len;
+    const char *p = buf;
+    const char *nl;
+    validate_span *s;
+    size_t lines = 0;
+    size_t n;
+
+    while (p < end) {
+        lines++;
+        nl = memchr(p, '\n', end - p);
+        if (!nl) {
+            break;
+        }
+        p = nl + 1;
+    }
+
+    s = malloc((lines ? lines : 1) * sizeof(*s));
+    if (!s) {
+        return -1;
+    }
+
+    for (n = 0; n < lines; n++) {
+        nl = memchr(buf, '\n', end - buf);
+        s[n].line = buf;
+        s[n].len = (nl ? nl : end) - buf;
+        if (s[n].len && buf[s[n].len - 1] == '\r') {
+            s[n].len--;
+        }
+        buf = nl ? nl + 1 : end;
+    }
+
+    *spans = s;
+    return lines;
+}
+
+/* Freeze a tree and its parents, so the workers use the dispatch tables */
+static int freeze_lineage(ciscli *cli, uint32_t tree)
+{
+    ciscli_tree *t;
+
+    while (tree != CISCLI_NO_PARENT_TREE) {
+        if (ciscli_tree_freeze(cli, tree)) {
+            return -1;
+        }
+
+        t = ciscli_get_tree(cli, tree);
+        tree = t->parent;
+    }
+
+    return 0;
+}
+
+int ciscli_validate_buffer(ciscli *cli, const char *buf, size_t len,
+                           unsigned int threads, ciscli_result **results,
+                           size_t *count)
+{
+    pthread_t workers[VALIDATE_MAX_THREADS];
+    validate_span *spans;
+    validate_job job;
+    PARSER_CTRL *ctl;
+    unsigned int started;
+    unsigned int i;
+    size_t chunks;
+    ssize_t lines;
+    long cpus;
+
+    if (!cli || (!buf && len)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (freeze_lineage(cli, cli->current_tree)) {
+        return -1;
+    }
+
+    lines = split_lines(buf ? buf : "", len, &spans);
+    if (lines < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.cli = cli;
+    job.tree = cli->current_tree;
+    job.spans = spans;
+    job.lines = lines;
+    job.results = calloc(lines ? lines : 1, sizeof(*job.results));
+    ctl = calloc(1, sizeof(*ctl));
+    if (!job.results || !ctl) {
+        free(job.results);
+        free(ctl);
+        free(spans);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (threads == 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+
+    /* There is no point in more threads than chunks of work */
+    chunks = (job.lines + VALIDATE_CHUNK - 1) / VALIDATE_CHUNK;
+    if (threads > chunks) {
+        threads = chunks ? chunks : 1;
+    }
+
+    if (threads > VALIDATE_MAX_THREADS) {
+        threads = VALIDATE_MAX_THREADS;
+    }
+
+    /* The calling thread is one of the workers */
+    started = 0;
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, validate_worker, &job)) {
+            break;
+        }
+        started++;
+    }
+
+    validate_run(&job, ctl);
+
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    parser_control_destroy(ctl);
+    free(ctl);
+    free(spans);
+
+    if (results) {
+        *results = job.results;
+    } else {
+        free(job.results);
+    }
+
+    if (count) {
+        *count = job.lines;
+    }
+
+    return job.failed;
+}
@@ -0,0 +1,159 @@
+/****************************************************************************
+ * Line editor command history
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Command history is kept in an append-only log, documented in
+ * docs/history.md, which every CLI process on the box appends to. Each
+ * process maps the log, and indexes the most recent lines in it, so that
+ * lines may be looked up by their position, by a prefix, or by a substring
+ * without reading the file.
+ *
+ * Lines are numbered from the oldest line indexed. Searches skip every
+ * occurrence of a line but the most recent, so stepping back through the
+ * results shows each distinct line once, in the order it was last used.
+ *
+ * A history handle must not be used by more than one thread at a time.
+ */
+#ifndef HDR_EDITLINE_HISTORY_H
+#define HDR_EDITLINE_HISTORY_H
+
+#include <stdint.h>
+#include <time.h>
+
+/** @brief Longest line that is kept in the history */
+#define EDITLINE_HISTORY_LINE_MAX       4095
+
+/** @brief Number of lines indexed if none is given when opening the log */
+#define EDITLINE_HISTORY_DEFAULT_LIMIT  10000
+
+/** @brief Line of the history */
+typedef struct editline_history_entry_s {
+    /** Number of the line, counting from 0 for the oldest line indexed */
+    uint32_t index;
+
+    /** Length of the line */
+    uint32_t len;
+
+    /** Line, which is not null terminated. It points into the mapped log,
+     * and is valid until the handle is next refreshed or appended to. */
+    const char *line;
+
+    /** Time the line was added */
+    time_t time;
+} editline_history_entry_t;
+
+/** @brief Handle to a history log */
+typedef struct editline_history_s editline_history_t;
+
+/** @brief Open a history log, creating it if it does not exist
+ *
+ * @param   path    Path to the log
+ * @param   limit   Number of the most recent lines to index, or 0 for
+ *                  EDITLINE_HISTORY_DEFAULT_LIMIT. The log is compacted
+ *                  to this many lines once it holds twice as many.
+ * @param   history Receives the handle
+ *
+ * @returns 0 on success, negative errno on failure. -EPROTO means the file
+ *          is not a history log, and -ENOTSUP that it was written by a
+ *          later version.
+ */
+int editline_history_open(const char *path, uint32_t limit,
+                          editline_history_t **history);
+
+/** @brief Close a history log and clear the pointer */
+void editline_history_close(editline_history_t **history);
+
+/** @brief Append a line to the history
+ *
+ * Lines appended by other processes since the handle was last refreshed
+ * are indexed first. A line that is empty, or is the same as the most
+ * recent line, is not appended.
+ *
+ * @param   history History handle
+ * @param   line    Line to append, which need not be null terminated
+ * @param   len     Length of the line
+ *
+ * @returns 1 if the line was appended, 0 if it was not, or negative errno
+ *          on failure. -E2BIG means the line is longer than
+ *          EDITLINE_HISTORY_LINE_MAX, and -EINVAL that it holds a newline.
+ */
+int editline_history_add(editline_history_t *history,
+                         const char *line, uint32_t len);
+
+/** @brief Index the lines appended by other processes
+ *
+ * This should be called before the history is shown or searched, such as
+ * when a prompt is shown. Entries returned before the call are no longer
+ * valid, and the lines may have been renumbered if another process has
+ * compacted the log.
+ *
+ * @returns Number of lines indexed, or negative errno on failure
+ */
+int editline_history_refresh(editline_history_t *history);
+
+/** @brief Get the number of lines indexed */
+uint32_t editline_history_count(const editline_history_t *history);
+
+/** @brief Get a line of the history by its number
+ *
+ * @returns 0 on success, -ENOENT if there is no such line
+ */
+int editline_history_get(const editline_history_t *history, uint32_t index,
+                         editline_history_entry_t *entry);
+
+/** @brief Find the most recent line before a line that starts with a prefix
+ *
+ * The distinct lines are sorted by their text, so the lines that start with
+ * the prefix are found with a binary search, and the one of them last used
+ * before the given line with a tree that holds the most recent use of the
+ * lines below each of its nodes, both in O(log n). A line editor finds the
+ * first match with before set to the count, and each earlier match with
+ * the index of the previous one.
+ *
+ * @param   history History handle
+ * @param   prefix  Prefix, which need not be null terminated
+ * @param   len     Length of the prefix, which may be 0 to match every line
+ * @param   before  Number of the line to search before
+ * @param   entry   Receives the line found
+ *
+ * @returns 1 if a line was found, 0 if not, negative errno on failure
+ */
+int editline_history_prefix(const editline_history_t *history,
+                            const char *prefix, uint32_t len, uint32_t before,
+                            editline_history_entry_t *entry);
+
+/** @brief Count the distinct lines that start with a prefix, in O(log n)
+ *
+ * @returns Number of distinct lines indexed that start with the prefix
+ */
+uint32_t editline_history_prefix_count(const editline_history_t *history,
+                                       const char *prefix, uint32_t len);
+
+/** @brief Find the most recent line before a line that holds a substring
+ *
+ * The mapped log is searched backwards from the given line in large
+ * blocks with memmem, rather than a line at a time, as a reverse search
+ * does. Arguments and return value are as \ref editline_history_prefix.
+ */
+int editline_history_search(const editline_history_t *history,
+                            const char *needle, uint32_t len, uint32_t before,
+                            editline_history_entry_t *entry);
+
+#endif /* !defined HDR_EDITLINE_HISTORY_H */
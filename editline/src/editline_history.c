@@ -0,0 +1,1149 @@
+/****************************************************************************
+ * Line editor command history
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * The log is a header followed by records, each of which is a line with a
+ * short header of its own. Records are appended with a single write to a
+ * file opened with O_APPEND, while holding an exclusive flock on it, so
+ * that lines appended by processes at the same time are never interleaved.
+ * Readers do not lock the log, and stop at a record whose checksum does
+ * not match, which is one that is still being written, or was torn by a
+ * process that died while writing it. The next process to append removes
+ * a torn record, since no other process can be writing while it holds the
+ * lock.
+ *
+ * The log is compacted by writing the most recent lines to a new file and
+ * renaming it over the log. Processes notice that the path now names a
+ * different file before they next append or refresh, and open it instead.
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "editline_history.h"
+
+#define HISTORY_MAGIC           "HST"
+#define HISTORY_VERSION         0x10
+
+/* Largest number of lines that may be indexed */
+#define HISTORY_LIMIT_MAX       (1u << 24)
+
+/* The mapping is grown in steps of this many bytes, so that a process
+ * appending a line at a time does not have to map the log again for each.
+ * The part of the mapping past the end of the file is never read. */
+#define HISTORY_MAP_STEP        (256 * 1024)
+
+/* Size of the blocks of the log searched with each call to memmem */
+#define HISTORY_SEARCH_BLOCK    (64 * 1024)
+
+/* Number of the most recent lines that may be left out of the sorted index,
+ * and searched one at a time. They are merged into the sorted index once
+ * there are more, so that adding a line does not move the sorted index. */
+#define HISTORY_PENDING_LINES   64
+
+/** @brief File header of a history log */
+typedef struct history_file_header_s {
+    /** HISTORY_MAGIC, null terminated */
+    char magic[4];
+
+    /** Major version in the upper 4 bits, minor version in the lower */
+    uint8_t version;
+
+    /** Reserved, written as 0 */
+    uint8_t reserved[3];
+} history_file_header_t;
+
+/** @brief Header of a line in a history log, followed by the line */
+typedef struct history_record_s {
+    /** Length of the line, big-endian */
+    uint8_t len[2];
+
+    /** Fletcher-16 checksum of the length, time and line, big-endian */
+    uint8_t check[2];
+
+    /** Time the line was added, in seconds since the epoch, big-endian */
+    uint8_t time[4];
+} history_record_t;
+
+struct editline_history_s {
+    /** Path to the log */
+    char *path;
+
+    /** Log, opened for appending */
+    int fd;
+
+    /** Device and inode of the log, to notice that it has been replaced */
+    dev_t dev;
+    ino_t ino;
+
+    /** Mapping of the log */
+    const uint8_t *map;
+    size_t map_size;
+
+    /** Size of the log when it was last mapped */
+    uint64_t file_size;
+
+    /** Offset of the end of the last record indexed */
+    uint64_t scanned;
+
+    /** Number of lines in the log before the first line indexed */
+    uint64_t skipped;
+
+    /** Offsets of the lines indexed, oldest first */
+    uint64_t *offsets;
+    uint32_t count;
+
+    /** Number of lines to keep indexed */
+    uint32_t limit;
+
+    /** Indexes of the most recent occurrence of each distinct line before
+     * the first pending line, sorted by the text of the line */
+    uint32_t *sorted;
+    uint32_t distinct;
+
+    /** Lines from this one on are pending, and not in the sorted index */
+    uint32_t merged;
+
+    /** Room to merge the pending lines into, swapped with the sorted index */
+    uint32_t *spare;
+
+    /** Tree over the sorted index, in which each node holds the largest
+     * index plus one of the lines below it, and leaf i is at leaves + i */
+    uint32_t *tree;
+    uint32_t leaves;
+};
+
+/** @brief Line and its index, sorted to build the sorted index */
+typedef struct history_sort_key_s {
+    const uint8_t *text;
+    uint32_t len;
+    uint32_t index;
+} history_sort_key_t;
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint16_t record_check(const history_record_t *rec, const uint8_t *text,
+                             uint32_t len)
+{
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(rec->len); i++) {
+        a += rec->len[i];
+        b += a;
+    }
+
+    for (i = 0; i < sizeof(rec->time); i++) {
+        a += rec->time[i];
+        b += a;
+    }
+
+    /* The sums cannot overflow before EDITLINE_HISTORY_LINE_MAX bytes */
+    for (i = 0; i < len; i++) {
+        a += text[i];
+        b += a;
+    }
+
+    return (uint16_t)((b % 255) << 8 | (a % 255));
+}
+
+/* Get the text of an indexed line */
+static const uint8_t * line_text(const editline_history_t *h, uint32_t index,
+                                 uint32_t *len)
+{
+    const history_record_t *rec;
+
+    rec = (const history_record_t *)(h->map + h->offsets[index]);
+    *len = get_be16(rec->len);
+    return (const uint8_t *)(rec + 1);
+}
+
+static void line_entry(const editline_history_t *h, uint32_t index,
+                       editline_history_entry_t *entry)
+{
+    const history_record_t *rec;
+
+    rec = (const history_record_t *)(h->map + h->offsets[index]);
+    entry->index = index;
+    entry->len = get_be16(rec->len);
+    entry->line = (const char *)(rec + 1);
+    entry->time = (time_t)get_be32(rec->time);
+}
+
+static int text_compare(const uint8_t *a, uint32_t alen,
+                        const uint8_t *b, uint32_t blen)
+{
+    int cmp;
+
+    cmp = memcmp(a, b, alen < blen ? alen : blen);
+    if (cmp) {
+        return cmp;
+    }
+
+    return (alen > blen) - (alen < blen);
+}
+
+/* Find the position of a line in the sorted index, or where it would be
+ * inserted. Returns 1 if the line is there. */
+static int sorted_find(const editline_history_t *h, const uint8_t *text,
+                       uint32_t len, uint32_t *pos)
+{
+    const uint8_t *mid_text;
+    uint32_t mid_len;
+    uint32_t lo = 0;
+    uint32_t hi = h->distinct;
+    uint32_t mid;
+    int cmp;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        mid_text = line_text(h, h->sorted[mid], &mid_len);
+        cmp = text_compare(mid_text, mid_len, text, len);
+        if (cmp == 0) {
+            *pos = mid;
+            return 1;
+        }
+
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *pos = lo;
+    return 0;
+}
+
+/* Find the range of the sorted index whose lines start with a prefix. The
+ * lines that start with it are contiguous, since they sort after the
+ * prefix and before anything greater than it. */
+static void sorted_prefix(const editline_history_t *h, const uint8_t *prefix,
+                          uint32_t len, uint32_t *first, uint32_t *last)
+{
+    const uint8_t *mid_text;
+    uint32_t mid_len;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t mid;
+    int cmp;
+
+    /* First line not less than the prefix */
+    lo = 0;
+    hi = h->distinct;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        mid_text = line_text(h, h->sorted[mid], &mid_len);
+        if (text_compare(mid_text, mid_len, prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *first = lo;
+
+    /* First line after it that does not start with the prefix */
+    hi = h->distinct;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        mid_text = line_text(h, h->sorted[mid], &mid_len);
+        cmp = mid_len < len ? 1 : memcmp(mid_text, prefix, len);
+        if (cmp == 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *last = lo;
+}
+
+static int sort_key_compare(const void *a, const void *b)
+{
+    const history_sort_key_t *ka = a;
+    const history_sort_key_t *kb = b;
+    int cmp;
+
+    cmp = text_compare(ka->text, ka->len, kb->text, kb->len);
+    if (cmp) {
+        return cmp;
+    }
+
+    /* Most recent occurrence first, so that it is the one kept */
+    return (ka->index < kb->index) - (ka->index > kb->index);
+}
+
+/* Build the tree over the sorted index, which held a number of lines
+ * before it was last changed. Only the nodes over those lines or the
+ * current ones are built, since the rest are already clear. */
+static void tree_build(editline_history_t *h, uint32_t used)
+{
+    uint32_t first = h->leaves;
+    uint32_t end;
+    uint32_t i;
+
+    if (used < h->distinct) {
+        used = h->distinct;
+    }
+
+    for (i = 0; i < used; i++) {
+        h->tree[first + i] = i < h->distinct ? h->sorted[i] + 1 : 0;
+    }
+
+    end = first + used;
+    while (first > 1) {
+        first /= 2;
+        end = (end + 1) / 2;
+        for (i = first; i < end; i++) {
+            h->tree[i] = h->tree[2 * i] > h->tree[2 * i + 1] ?
+                         h->tree[2 * i] : h->tree[2 * i + 1];
+        }
+    }
+}
+
+/* Find the largest index plus one, at most a bound, of the lines at
+ * positions first to last of the sorted index, below a node of the tree
+ * that covers positions lo to hi. A subtree is entered only if it may
+ * hold a larger index than the best found, and either straddles an end of
+ * the range or holds an index above the bound. Lines above the bound have
+ * been stepped past, so a search takes O(log n) for each of them. */
+static uint32_t tree_best(const editline_history_t *h, uint32_t node,
+                          uint32_t lo, uint32_t hi, uint32_t first,
+                          uint32_t last, uint32_t bound, uint32_t best)
+{
+    uint32_t mid;
+
+    if (hi <= first || last <= lo || h->tree[node] <= best) {
+        return best;
+    }
+
+    if (first <= lo && hi <= last && h->tree[node] <= bound) {
+        return h->tree[node];
+    }
+
+    if (hi - lo == 1) {
+        return best;
+    }
+
+    /* Whichever half is searched first may let the other be pruned */
+    mid = lo + (hi - lo) / 2;
+    best = tree_best(h, 2 * node + 1, mid, hi, first, last, bound, best);
+    return tree_best(h, 2 * node, lo, mid, first, last, bound, best);
+}
+
+static int key_equal(const history_sort_key_t *a, const history_sort_key_t *b)
+{
+    return a->len == b->len && memcmp(a->text, b->text, a->len) == 0;
+}
+
+/* Add the pending lines from a line on to the sorted index, or build it
+ * again from every line indexed if that line is the first. The pending
+ * lines are sorted, and merged with the sorted index in a single pass,
+ * copying the runs of the sorted index between them. */
+static int sorted_merge(editline_history_t *h, uint32_t from)
+{
+    history_sort_key_t *keys;
+    uint32_t *merged;
+    uint32_t used = h->distinct;
+    uint32_t count;
+    uint32_t n = 0;
+    uint32_t pos;
+    uint32_t i;
+    uint32_t j = 0;
+    int found;
+
+    /* Until the merge succeeds, the lines not in the sorted index are
+     * searched as pending lines */
+    if (from == 0) {
+        h->distinct = 0;
+        h->merged = 0;
+    }
+
+    count = h->count - from;
+    if (count == 0) {
+        h->merged = h->count;
+        tree_build(h, used);
+        return 0;
+    }
+
+    keys = malloc(count * sizeof(*keys));
+    if (!keys) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        keys[i].text = line_text(h, from + i, &keys[i].len);
+        keys[i].index = from + i;
+    }
+
+    qsort(keys, count, sizeof(*keys), sort_key_compare);
+
+    merged = h->spare;
+    for (i = 0; i < count; i++) {
+        if (i > 0 && key_equal(&keys[i], &keys[i - 1])) {
+            continue;
+        }
+
+        /* Copy the lines of the sorted index that sort before the pending
+         * line, and drop the one that it replaces as the most recent
+         * occurrence, if any */
+        found = sorted_find(h, keys[i].text, keys[i].len, &pos);
+        memcpy(merged + n, h->sorted + j, (pos - j) * sizeof(*merged));
+        n += pos - j;
+        j = pos + found;
+        merged[n++] = keys[i].index;
+    }
+
+    memcpy(merged + n, h->sorted + j, (h->distinct - j) * sizeof(*merged));
+    n += h->distinct - j;
+
+    h->spare = h->sorted;
+    h->sorted = merged;
+    h->distinct = n;
+    h->merged = h->count;
+    tree_build(h, used);
+    free(keys);
+    return 0;
+}
+
+/* Check whether a line is the most recent occurrence of its text */
+static int line_latest(const editline_history_t *h, uint32_t index)
+{
+    const uint8_t *text;
+    const uint8_t *other;
+    uint32_t other_len;
+    uint32_t len;
+    uint32_t pos;
+    uint32_t i;
+
+    text = line_text(h, index, &len);
+    for (i = index < h->merged ? h->merged : index + 1; i < h->count; i++) {
+        other = line_text(h, i, &other_len);
+        if (other_len == len && memcmp(other, text, len) == 0) {
+            return 0;
+        }
+    }
+
+    if (index >= h->merged) {
+        return 1;
+    }
+
+    return sorted_find(h, text, len, &pos) && h->sorted[pos] == index;
+}
+
+static void history_unmap(editline_history_t *h)
+{
+    if (h->map) {
+        munmap((void *)h->map, h->map_size);
+        h->map = NULL;
+        h->map_size = 0;
+    }
+}
+
+/* Map the log as far as its current size */
+static int history_map(editline_history_t *h)
+{
+    struct stat st;
+    size_t size;
+    void *map;
+
+    if (fstat(h->fd, &st) < 0) {
+        return -errno;
+    }
+
+    h->file_size = st.st_size;
+    if (h->file_size <= h->map_size) {
+        return 0;
+    }
+
+    size = (h->file_size + HISTORY_MAP_STEP - 1) & ~(uint64_t)(HISTORY_MAP_STEP - 1);
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, h->fd, 0);
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    history_unmap(h);
+    h->map = map;
+    h->map_size = size;
+    return 0;
+}
+
+/* Index the records past the last one indexed, as far as the first that is
+ * incomplete or corrupt. Returns the number of lines indexed. */
+static int history_scan(editline_history_t *h)
+{
+    const history_record_t *rec;
+    uint32_t added = 0;
+    uint32_t drop;
+    uint32_t len;
+    int rebuild = 0;
+    int retval;
+
+    retval = history_map(h);
+    if (retval) {
+        return retval;
+    }
+
+    while (h->scanned + sizeof(*rec) <= h->file_size) {
+        rec = (const history_record_t *)(h->map + h->scanned);
+        len = get_be16(rec->len);
+        if (h->scanned + sizeof(*rec) + len > h->file_size ||
+            len > EDITLINE_HISTORY_LINE_MAX ||
+            get_be16(rec->check) != record_check(rec, (const uint8_t *)(rec + 1), len)) {
+            break;
+        }
+
+        /* Drop the oldest lines once twice the limit are indexed, so that
+         * the sorted index is built again only once for each limit lines
+         * added */
+        if (h->count == 2 * h->limit) {
+            drop = h->count - h->limit;
+            memmove(h->offsets, h->offsets + drop,
+                    h->limit * sizeof(*h->offsets));
+            h->count = h->limit;
+            h->skipped += drop;
+            rebuild = 1;
+        }
+
+        h->offsets[h->count++] = h->scanned;
+        h->scanned += sizeof(*rec) + len;
+        added++;
+    }
+
+    if (rebuild) {
+        retval = sorted_merge(h, 0);
+    } else if (h->count - h->merged > HISTORY_PENDING_LINES) {
+        retval = sorted_merge(h, h->merged);
+    }
+
+    if (retval) {
+        return retval;
+    }
+
+    return added;
+}
+
+static int history_write(int fd, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    ssize_t written;
+
+    while (size > 0) {
+        written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+
+        p += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+/* Open the file at the path, creating it if need be, and index it */
+static int history_attach(editline_history_t *h)
+{
+    history_file_header_t hdr;
+    struct stat st;
+    int retval;
+    int fd;
+
+    fd = open(h->path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        retval = -errno;
+        close(fd);
+        return retval;
+    }
+
+    if (st.st_size == 0) {
+        /* Only one of the processes creating the log writes its header */
+        if (flock(fd, LOCK_EX) < 0) {
+            retval = -errno;
+            close(fd);
+            return retval;
+        }
+
+        retval = 0;
+        if (fstat(fd, &st) < 0) {
+            retval = -errno;
+        } else if (st.st_size == 0) {
+            memset(&hdr, 0, sizeof(hdr));
+            memcpy(hdr.magic, HISTORY_MAGIC, sizeof(hdr.magic));
+            hdr.version = HISTORY_VERSION;
+            retval = history_write(fd, &hdr, sizeof(hdr));
+        }
+
+        flock(fd, LOCK_UN);
+        if (retval) {
+            close(fd);
+            return retval;
+        }
+    }
+
+    if (h->fd >= 0) {
+        close(h->fd);
+    }
+    history_unmap(h);
+
+    h->fd = fd;
+    h->dev = st.st_dev;
+    h->ino = st.st_ino;
+    h->file_size = 0;
+    h->scanned = sizeof(hdr);
+    h->skipped = 0;
+    h->count = 0;
+    h->distinct = 0;
+    h->merged = 0;
+    memset(h->tree, 0, 2 * h->leaves * sizeof(*h->tree));
+
+    retval = history_map(h);
+    if (retval) {
+        return retval;
+    }
+
+    if (h->file_size < sizeof(hdr) ||
+        memcmp(h->map, HISTORY_MAGIC, sizeof(hdr.magic)) != 0) {
+        return -EPROTO;
+    }
+
+    if ((((const history_file_header_t *)h->map)->version >> 4) !=
+        (HISTORY_VERSION >> 4)) {
+        return -ENOTSUP;
+    }
+
+    return history_scan(h);
+}
+
+/* Check whether the path names a different file than the one open */
+static int history_replaced(const editline_history_t *h)
+{
+    struct stat st;
+
+    if (stat(h->path, &st) < 0) {
+        return 1;
+    }
+
+    return st.st_dev != h->dev || st.st_ino != h->ino;
+}
+
+/* Lock the file that the path names, opening it if it has been replaced */
+static int history_lock(editline_history_t *h)
+{
+    int retval;
+
+    for (;;) {
+        if (flock(h->fd, LOCK_EX) < 0) {
+            return -errno;
+        }
+
+        if (!history_replaced(h)) {
+            return 0;
+        }
+
+        flock(h->fd, LOCK_UN);
+        retval = history_attach(h);
+        if (retval < 0) {
+            return retval;
+        }
+    }
+}
+
+/* Replace the log with one holding only the lines to keep indexed. This is
+ * called with the log locked. */
+static int history_compact(editline_history_t *h)
+{
+    history_file_header_t hdr;
+    struct stat st;
+    uint64_t start;
+    char *tmp;
+    int retval;
+    int fd;
+
+    if (fstat(h->fd, &st) < 0) {
+        return -errno;
+    }
+
+    tmp = malloc(strlen(h->path) + sizeof(".XXXXXX"));
+    if (!tmp) {
+        return -ENOMEM;
+    }
+
+    strcpy(tmp, h->path);
+    strcat(tmp, ".XXXXXX");
+    fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd < 0) {
+        retval = -errno;
+        free(tmp);
+        return retval;
+    }
+
+    /* The records of the lines kept are contiguous at the end of the log */
+    start = h->offsets[h->count > h->limit ? h->count - h->limit : 0];
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, HISTORY_MAGIC, sizeof(hdr.magic));
+    hdr.version = HISTORY_VERSION;
+
+    retval = history_write(fd, &hdr, sizeof(hdr));
+    if (!retval) {
+        retval = history_write(fd, h->map + start, h->scanned - start);
+    }
+
+    /* The new log must be on disk before it replaces the old one */
+    if (!retval && (fchmod(fd, st.st_mode & 0777) < 0 || fdatasync(fd) < 0 ||
+                    rename(tmp, h->path) < 0)) {
+        retval = -errno;
+    }
+
+    close(fd);
+    if (retval) {
+        unlink(tmp);
+    }
+
+    free(tmp);
+    return retval;
+}
+
+int editline_history_open(const char *path, uint32_t limit,
+                          editline_history_t **history)
+{
+    editline_history_t *h;
+    int retval;
+
+    if (!path || !history || limit > HISTORY_LIMIT_MAX) {
+        return -EINVAL;
+    }
+
+    if (limit == 0) {
+        limit = EDITLINE_HISTORY_DEFAULT_LIMIT;
+    }
+
+    h = calloc(1, sizeof(*h));
+    if (!h) {
+        return -ENOMEM;
+    }
+
+    h->fd = -1;
+    h->limit = limit;
+    h->path = strdup(path);
+    h->offsets = malloc(2 * limit * sizeof(*h->offsets));
+    h->sorted = malloc(2 * limit * sizeof(*h->sorted));
+    h->spare = malloc(2 * limit * sizeof(*h->spare));
+    h->leaves = 1;
+    while (h->leaves < 2 * limit) {
+        h->leaves *= 2;
+    }
+    h->tree = calloc(2 * h->leaves, sizeof(*h->tree));
+    if (!h->path || !h->offsets || !h->sorted || !h->spare || !h->tree) {
+        editline_history_close(&h);
+        return -ENOMEM;
+    }
+
+    retval = history_attach(h);
+    if (retval < 0) {
+        editline_history_close(&h);
+        return retval;
+    }
+
+    *history = h;
+    return 0;
+}
+
+void editline_history_close(editline_history_t **history)
+{
+    editline_history_t *h;
+
+    if (history && *history) {
+        h = *history;
+        history_unmap(h);
+        if (h->fd >= 0) {
+            close(h->fd);
+        }
+
+        free(h->tree);
+        free(h->spare);
+        free(h->sorted);
+        free(h->offsets);
+        free(h->path);
+        free(h);
+        *history = NULL;
+    }
+}
+
+int editline_history_add(editline_history_t *h, const char *line, uint32_t len)
+{
+    uint8_t buf[sizeof(history_record_t) + EDITLINE_HISTORY_LINE_MAX];
+    history_record_t *rec = (history_record_t *)buf;
+    const uint8_t *last;
+    uint32_t last_len;
+    int retval;
+
+    if (!h || (!line && len)) {
+        return -EINVAL;
+    }
+
+    if (len > EDITLINE_HISTORY_LINE_MAX) {
+        return -E2BIG;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (memchr(line, '\n', len)) {
+        return -EINVAL;
+    }
+
+    retval = history_lock(h);
+    if (retval) {
+        return retval;
+    }
+
+    retval = history_scan(h);
+    if (retval < 0) {
+        goto unlock;
+    }
+
+    /* Nobody else can be writing, so whatever follows the last complete
+     * record was torn, and the line would be lost after it */
+    if (h->file_size > h->scanned && ftruncate(h->fd, h->scanned) < 0) {
+        retval = -errno;
+        goto unlock;
+    }
+
+    if (h->count > 0) {
+        last = line_text(h, h->count - 1, &last_len);
+        if (last_len == len && memcmp(last, line, len) == 0) {
+            retval = 0;
+            goto unlock;
+        }
+    }
+
+    put_be16(rec->len, len);
+    put_be32(rec->time, (uint32_t)time(NULL));
+    memcpy(rec + 1, line, len);
+    put_be16(rec->check, record_check(rec, (const uint8_t *)(rec + 1), len));
+
+    /* A single write, so that a reader never sees part of the record with
+     * a valid checksum */
+    retval = history_write(h->fd, buf, sizeof(*rec) + len);
+    if (retval) {
+        /* Remove what was written of the record. If that fails too, the
+         * next process to append removes it. */
+        if (ftruncate(h->fd, h->scanned) < 0) {
+            retval = -errno;
+        }
+        goto unlock;
+    }
+
+    retval = history_scan(h);
+    if (retval < 0) {
+        goto unlock;
+    }
+
+    retval = 1;
+    if (h->skipped + h->count >= 2 * (uint64_t)h->limit) {
+        /* The line has been appended, so failing to compact is not
+         * reported, and is tried again with the next line */
+        if (history_compact(h) == 0) {
+            flock(h->fd, LOCK_UN);
+            retval = history_attach(h);
+            return retval < 0 ? retval : 1;
+        }
+    }
+
+unlock:
+    flock(h->fd, LOCK_UN);
+    return retval;
+}
+
+int editline_history_refresh(editline_history_t *h)
+{
+    if (!h) {
+        return -EINVAL;
+    }
+
+    if (history_replaced(h)) {
+        return history_attach(h);
+    }
+
+    return history_scan(h);
+}
+
+uint32_t editline_history_count(const editline_history_t *h)
+{
+    return h ? h->count : 0;
+}
+
+int editline_history_get(const editline_history_t *h, uint32_t index,
+                         editline_history_entry_t *entry)
+{
+    if (!h || !entry) {
+        return -EINVAL;
+    }
+
+    if (index >= h->count) {
+        return -ENOENT;
+    }
+
+    line_entry(h, index, entry);
+    return 0;
+}
+
+static int line_starts(const editline_history_t *h, uint32_t index,
+                       const char *prefix, uint32_t len)
+{
+    const uint8_t *text;
+    uint32_t text_len;
+
+    text = line_text(h, index, &text_len);
+    return text_len >= len && memcmp(text, prefix, len) == 0;
+}
+
+int editline_history_prefix(const editline_history_t *h,
+                            const char *prefix, uint32_t len, uint32_t before,
+                            editline_history_entry_t *entry)
+{
+    uint32_t found;
+    uint32_t first;
+    uint32_t last;
+    uint32_t index;
+
+    if (!h || !entry || (!prefix && len)) {
+        return -EINVAL;
+    }
+
+    if (!prefix) {
+        prefix = "";
+    }
+
+    if (before > h->count) {
+        before = h->count;
+    }
+
+    /* Pending lines are more recent than any in the sorted index */
+    for (index = before; index-- > h->merged;) {
+        if (line_starts(h, index, prefix, len) && line_latest(h, index)) {
+            line_entry(h, index, entry);
+            return 1;
+        }
+    }
+
+    /* Take the most recent line of the range that is before the given one,
+     * unless a pending line has used it again since */
+    sorted_prefix(h, (const uint8_t *)prefix, len, &first, &last);
+    for (;;) {
+        found = tree_best(h, 1, 0, h->leaves, first, last, before, 0);
+        if (found == 0) {
+            return 0;
+        }
+
+        if (line_latest(h, found - 1)) {
+            break;
+        }
+        before = found - 1;
+    }
+
+    line_entry(h, found - 1, entry);
+    return 1;
+}
+
+uint32_t editline_history_prefix_count(const editline_history_t *h,
+                                       const char *prefix, uint32_t len)
+{
+    const uint8_t *text;
+    uint32_t text_len;
+    uint32_t first;
+    uint32_t last;
+    uint32_t index;
+    uint32_t pos;
+
+    if (!h || (!prefix && len)) {
+        return 0;
+    }
+
+    if (!prefix) {
+        prefix = "";
+    }
+
+    sorted_prefix(h, (const uint8_t *)prefix, len, &first, &last);
+
+    /* Count each pending line once, unless the sorted index has it */
+    for (index = h->merged; index < h->count; index++) {
+        if (line_starts(h, index, prefix, len) && line_latest(h, index)) {
+            text = line_text(h, index, &text_len);
+            last += !sorted_find(h, text, text_len, &pos);
+        }
+    }
+
+    return last - first;
+}
+
+/* Find the line whose record holds an offset of the log */
+static uint32_t line_at(const editline_history_t *h, uint64_t offset)
+{
+    uint32_t lo = 0;
+    uint32_t hi = h->count;
+    uint32_t mid;
+
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if (h->offsets[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/* Check whether a match found by memmem lies within the text of the most
+ * recent occurrence of a line, returning the line or UINT32_MAX */
+static uint32_t search_match(const editline_history_t *h, uint64_t offset,
+                             uint32_t len)
+{
+    uint64_t start;
+    uint32_t text_len;
+    uint32_t index;
+
+    index = line_at(h, offset);
+    line_text(h, index, &text_len);
+    start = h->offsets[index] + sizeof(history_record_t);
+    if (offset < start || offset + len > start + text_len) {
+        return UINT32_MAX;
+    }
+
+    return line_latest(h, index) ? index : UINT32_MAX;
+}
+
+int editline_history_search(const editline_history_t *h,
+                            const char *needle, uint32_t len, uint32_t before,
+                            editline_history_entry_t *entry)
+{
+    const uint8_t *block;
+    const uint8_t *hit;
+    uint64_t window;
+    uint64_t start;
+    uint64_t end;
+    uint64_t next;
+    uint32_t found;
+    uint32_t index;
+
+    if (!h || !entry || (!needle && len)) {
+        return -EINVAL;
+    }
+
+    if (len == 0) {
+        return editline_history_prefix(h, NULL, 0, before, entry);
+    }
+
+    if (before > h->count) {
+        before = h->count;
+    }
+
+    if (before == 0 || len > EDITLINE_HISTORY_LINE_MAX) {
+        return 0;
+    }
+
+    /* Search the records of the lines before the given one, a block at a
+     * time from the end, keeping the last match in each block. Blocks
+     * overlap by one byte less than the needle, so that a match is not
+     * missed by straddling two. */
+    window = h->offsets[0];
+    end = before < h->count ? h->offsets[before] : h->scanned;
+    while (end - window >= len) {
+        start = end - window > HISTORY_SEARCH_BLOCK ? end - HISTORY_SEARCH_BLOCK : window;
+        found = UINT32_MAX;
+        next = start;
+        while (next < end && end - next >= len) {
+            block = h->map + next;
+            hit = memmem(block, end - next, needle, len);
+            if (!hit) {
+                break;
+            }
+
+            next += hit - block;
+            index = search_match(h, next, len);
+            if (index == UINT32_MAX) {
+                next++;
+                continue;
+            }
+
+            /* Carry on past the rest of the line, since it has matched */
+            found = index;
+            if (index + 1 >= h->count) {
+                break;
+            }
+            next = h->offsets[index + 1];
+        }
+
+        if (found != UINT32_MAX) {
+            line_entry(h, found, entry);
+            return 1;
+        }
+
+        if (start == window) {
+            break;
+        }
+        end = start + len - 1;
+    }
+
+    return 0;
+}
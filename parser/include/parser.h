@@ -0,0 +1,112 @@
+/****************************************************************************
+ * CLI parser core
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_H
+#define HDR_PARSER_H
+
+#include <stdint.h>
+
+#include "parser_common.h"
+#include "parser_control.h"
+
+/** @brief Parse a command line against a tree
+ *
+ * The parser starts at the children of the root node, and for each token
+ * moves to the child that accepts it. If keyword nodes accept the token,
+ * they take precedence over all other node types; otherwise the node type
+ * with the highest priority wins. If more than one node of the winning
+ * type accepts the token, the command is ambiguous. Conditional children
+ * do not consume input; if no other child accepts the token, the children
+ * of the conditional nodes whose condition holds are tried in turn. Once
+ * the command line is exhausted, the current node must have an EOL child,
+ * either directly or through a conditional node whose condition holds.
+ *
+ * If the control structure has PARSER_CTRL_FLAG_LOOKAHEAD set, a token that
+ * is accepted by more than one node of the winning type does not make the
+ * command ambiguous by itself. Each of the nodes starts a path, all the
+ * paths are matched against the following tokens in a single pass, and
+ * the command is ambiguous only if more than one path completes. The
+ * parameters set by the nodes are only set for the path that completes.
+ * Paths that reach the same node are merged, which bounds the work per
+ * token by the number of distinct nodes that accept it; at most 32 paths
+ * are followed, and more make the command ambiguous. On an ambiguous
+ * command, total_parsed is the offset of the token where the paths parted.
+ *
+ * The control structure is not reset, so a single structure can be reused
+ * for many lines by calling \ref parser_control_init before each one, and
+ * the memory that a parse looking ahead needs is kept in it for the next.
+ *
+ * @param   root    Root node of the tree
+ * @param   ctl     Control structure initialized with the command line. On
+ *                  error, total_parsed is the offset of the input that could
+ *                  not be parsed.
+ * @param   eol     Receives the EOL node on success, may be NULL
+ *
+ * @returns One of \ref parser_result_e, or negative errno on failure.
+ */
+int parser_parse(PARSER_NODE *root, PARSER_CTRL *ctl, parser_node_eol_t **eol);
+
+/** @brief Parse a partial command line
+ *
+ * This walks the tree as \ref parser_parse does, but stops when the command
+ * line is exhausted, without requiring an EOL node. It is used to find the
+ * position in the tree to complete from.
+ *
+ * @param   root    Root node of the tree
+ * @param   ctl     Control structure initialized with the command line
+ * @param   node    Receives the node that accepted the last token, or the
+ *                  root if the command line holds no tokens
+ *
+ * @returns One of \ref parser_result_e, or negative errno on failure.
+ */
+int parser_walk(PARSER_NODE *root, PARSER_CTRL *ctl, PARSER_NODE **node);
+
+/** @brief Text offered for the end of a command */
+#define PARSER_EOL_TEXT     "<cr>"
+
+/** @brief Candidate callback
+ *
+ * The text is only valid for the duration of the call. Returns 0 to
+ * continue, or non-zero to stop and return that value.
+ */
+typedef int (*parser_candidate_fn)(PARSER_NODE *node, const char *text,
+                                   void *arg);
+
+/** @brief List the children of a node that could accept a token
+ *
+ * This is used for completion and help. The token is taken from the current
+ * parse position, and may be empty. Keywords are offered if the token is a
+ * prefix of the keyword, regardless of the minimum match, and other node
+ * types are offered using their display text if they accept the token, or
+ * if the token is empty. The end of the command is offered if the node has
+ * an EOL child and the token is empty. The children of conditional nodes
+ * whose condition holds are included.
+ *
+ * @param   node    Node to list the children of
+ * @param   ctl     Control structure positioned at the token
+ * @param   visit   Callback called for each candidate, in child order
+ * @param   arg     Argument to pass to the callback
+ *
+ * @returns 0, the non-zero value returned by the callback, or negative errno.
+ */
+int parser_node_candidates(PARSER_NODE *node, PARSER_CTRL *ctl,
+                           parser_candidate_fn visit, void *arg);
+
+#endif /* !defined HDR_PARSER_H */
@@ -0,0 +1,101 @@
+/****************************************************************************
+ * CLI parser arena allocator
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_ARENA_H
+#define HDR_PARSER_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** @brief Default size of an arena block */
+#define PARSER_ARENA_BLOCK_SIZE     (64 * 1024)
+
+/** @brief Alignment of every arena allocation */
+#define PARSER_ARENA_ALIGN          16
+
+/** @brief Block of arena memory */
+typedef struct parser_arena_block_s {
+    /** Next (older) block in the arena */
+    struct parser_arena_block_s *next;
+
+    /** Usable size of the block */
+    size_t size;
+
+    /** Number of bytes handed out from the block */
+    size_t used;
+} parser_arena_block_t;
+
+/** @brief Bump allocator
+ *
+ * Memory is handed out in sequence from large blocks, so objects that are
+ * allocated one after the other are adjacent in memory. Individual objects
+ * cannot be freed; the whole arena is released at once.
+ */
+typedef struct parser_arena_s {
+    /** Block currently being allocated from */
+    parser_arena_block_t *head;
+
+    /** Size of the blocks to allocate */
+    size_t block_size;
+
+    /** Number of blocks in the arena */
+    uint32_t blocks;
+
+    /** Total bytes allocated from the system, including block headers */
+    size_t reserved;
+
+    /** Total bytes handed out */
+    size_t used;
+} parser_arena_t;
+
+/** @brief Initialize an arena
+ *
+ * @param   arena       Pointer to the arena
+ * @param   block_size  Size of the blocks to allocate, 0 for the default
+ */
+void parser_arena_init(parser_arena_t *arena, size_t block_size);
+
+/** @brief Allocate zeroed memory from an arena
+ *
+ * @returns Pointer aligned to PARSER_ARENA_ALIGN, or NULL if memory could
+ *          not be allocated.
+ */
+void * parser_arena_alloc(parser_arena_t *arena, size_t size);
+
+/** @brief Duplicate a string into an arena */
+char * parser_arena_strdup(parser_arena_t *arena, const char *str);
+
+/** @brief Hand out the memory of an arena again from the start
+ *
+ * Everything allocated from the arena is released, but its memory is
+ * kept. If it took more than one block, they are replaced by a single
+ * block as large as everything handed out, so an arena that is filled
+ * and rewound over and over only goes back to the system when a fill
+ * needs more than any fill before it.
+ */
+void parser_arena_rewind(parser_arena_t *arena);
+
+/** @brief Release all memory held by an arena
+ *
+ * This frees one block at a time, and leaves the arena ready for reuse.
+ */
+void parser_arena_destroy(parser_arena_t *arena);
+
+#endif /* !defined HDR_PARSER_ARENA_H */
@@ -42,24 +42,120 @@
 #define PARSER_NODE_FLAG_NEGATABLE          0x00000100
 #define PARSER_NODE_FLAG_SET_NEGATE         0x00000200
 #define PARSER_NODE_FLAG_KEYWORD_MIN_MATCH  0x00000400
+#define PARSER_NODE_FLAG_FROZEN             0x00000800
+#define PARSER_NODE_FLAG_DISPATCH           0x00001000
+#define PARSER_NODE_FLAG_INT_DISPATCH       0x00002000
 
+/* The node is an entry of a dispatch table of its parent, which holds what
+ * the node matches, so that cannot change until the table is dropped */
+#define PARSER_NODE_FLAG_DISPATCHED         0x00004000
 
+/* The node is linked from more than one place once identical subtrees are
+ * shared, or has been replaced by such a node, so it cannot change */
+#define PARSER_NODE_FLAG_SHARED             0x00008000
+
+
+/* Node types that consume input are declared in order of priority, i.e.,
+ * if nodes of more than one type match, the node with the lower type wins.
+ */
 enum parser_node_type_e {
     PARSER_NODE_TYPE_ROOT = 0,
     PARSER_NODE_TYPE_KEYWORD,
     PARSER_NODE_TYPE_INTEGER,
+    PARSER_NODE_TYPE_NUMBER,
+    PARSER_NODE_TYPE_ADDRESS,
     PARSER_NODE_TYPE_STRING,
     PARSER_NODE_TYPE_CONSTANT,
     PARSER_NODE_TYPE_CONDITIONAL,
     PARSER_NODE_TYPE_EOL,
     PARSER_NODE_TYPE_MAX
-}
+};
+
+/** @brief Outcome of parsing a command line */
+enum parser_result_e {
+    /** The command line was parsed up to an EOL node */
+    PARSER_RESULT_OK = 0,
+    /** The command line is blank or a comment */
+    PARSER_RESULT_EMPTY,
+    /** No node accepts the input at the error position */
+    PARSER_RESULT_UNRECOGNIZED,
+    /** The command line ended before reaching an EOL node */
+    PARSER_RESULT_INCOMPLETE,
+    /** More than one node accepts the input at the error position */
+    PARSER_RESULT_AMBIGUOUS,
+};
 
 #define HELP_TEXT_LENGTH        128
 
+/** @brief Size of a cache line, which a node should fit within */
+#define PARSER_CACHE_LINE_SIZE  64
+
+struct parser_kw_dispatch_s;
+struct parser_int_dispatch_s;
+struct parser_arena_s;
+
+/** @brief Cold data common to all parser nodes
+ *
+ * Data that is not needed to walk the child and sibling links is kept out
+ * of the node itself, so that the part of the tree visited by the parser
+ * stays as small as possible. Node types with data that is only needed
+ * once the node has matched extend this structure.
+ */
+typedef struct parser_node_cold_s {
+    /** @brief Help text
+     *
+     * This field points to the null terminated help text to display when
+     * the complete or help functions are called, or is NULL if the node has
+     * no help text.
+     */
+    const char *help_text;
+
+    /** @brief Keyword dispatch table for the children of this node
+     *
+     * This is built by the freeze step when the child chain holds enough
+     * keyword nodes. It is only valid if the header flags contain
+     * PARSER_NODE_FLAG_DISPATCH.
+     * @private
+     */
+    struct parser_kw_dispatch_s *kw_dispatch;
+
+    /** @brief Integer range table for the children of this node
+     *
+     * This is built by the freeze step when the child chain holds enough
+     * integer nodes. It is only valid if the header flags contain
+     * PARSER_NODE_FLAG_INT_DISPATCH.
+     * @private
+     */
+    struct parser_int_dispatch_s *int_dispatch;
+
+    /** @brief Arena that the cold data was allocated from
+     *
+     * Data attached to the node after it was allocated, such as help text,
+     * is allocated from here so that it is released along with the node.
+     * This may be NULL, in which case such data cannot be attached.
+     * @private
+     */
+    struct parser_arena_s *arena;
+
+    /** @brief Number of tokens accepted by the node
+     *
+     * This is only counted while the parser records statistics.
+     */
+    uint64_t matches;
+
+    /** @brief Number of times the node was passed over
+     *
+     * This counts the times a token was tried against the child chain that
+     * holds this node, and was accepted by a later sibling or by none. It
+     * is only counted while the parser records statistics.
+     */
+    uint64_t rejects;
+} parser_node_cold_t;
+
 /** @brief Common header for parser nodes
  *
- * This is a common header field for all parser nodes.
+ * This is a common header field for all parser nodes. It holds only what
+ * the parser needs to walk the tree; everything else is in the cold data.
  */
 typedef struct parser_node_header_s {
     /** @brief Pointer to child node if parser accepts the current node
@@ -72,6 +168,12 @@ typedef struct parser_node_header_s {
      */
     struct parser_node_header_s *sibling;
 
+    /** @brief Pointer to the cold data of the node
+     *
+     * This may be NULL for nodes with no help text.
+     */
+    parser_node_cold_t *cold;
+
     /** @brief Flags controlling the parser behaviour
      *
      * This field stores bits to alter the parser behaviour based on the
@@ -85,21 +187,32 @@ typedef struct parser_node_header_s {
      * This field is a discriminator to distinguish the type of the node
      * managed by this header.
      */
-    uint32_t type;
+    uint8_t type;
 
-    /** @brief Help text
+    /** @brief Node specific flags
      *
-     * This field contains the help text to display when the complete or
-     * help functions are called.
+     * This field stores flags that are interpreted by the node type handler,
+     * such as the set value flags of keyword nodes.
      */
-    char help_text[HELP_TEXT_LENGTH];
+    uint8_t node_flags;
+
+    /** @brief Node specific data
+     *
+     * This field stores a small value that the node type handler needs in
+     * order to match the node, and which would otherwise push the node past
+     * a cache line. Keyword nodes keep their minimum match here.
+     */
+    uint16_t type_data;
 } parser_node_header_t;
 
 #define KEYWORD_LENGTH_MAX      32
 #define STRING_LENGTH_MAX       32
 /** @brief Layout for keyword nodes
  *
- * This node accepts a specific keyword from the user.
+ * This node accepts a specific keyword from the user. The minimum number
+ * of characters to match is stored in the type_data field of the header;
+ * unless this many characters are received from the user, this node will
+ * not be matched.
  */
 typedef struct parser_node_keyword_s {
     parser_node_header_t    header;
@@ -110,38 +223,61 @@ typedef struct parser_node_keyword_s {
      * Keywords may consist of the letters A-Z, a-z, 0-9 and hyphen.
      */
     char keyword[KEYWORD_LENGTH_MAX];
+} parser_node_keyword_t;
 
-    /** @brief Minimum characters to match
-     *
-     * This field controls the matching by the parser. Unless this many
-     * characters are received from the user, this node will not be matched.
-     */
-    uint32_t minimum_match;
+/** @brief Cold data for keyword nodes
+ *
+ * This holds the values that are only needed once the keyword has matched.
+ */
+typedef struct parser_node_keyword_cold_s {
+    parser_node_cold_t      common;
 
     /** @brief Index of value to set
      *
-     * If the header flag contains PARSER_NODE_FLAG_SET_VALUE, then this
+     * If the node flags contain PARSER_NODE_KW_FLAG_SET_VALUE, then this
      * field indicates which entry in the control structure should be updated.
      */
     uint32_t index;
 
     /** @brief Value to set
      *
-     * If the header flag contains PARSER_NODE_FLAG_SET_VALUE, then this field
+     * If the node flags contain PARSER_NODE_KW_FLAG_SET_VALUE, then this field
      * indicates the value to be programmed into the specified index. If the
-     * header flag also contains the flag PARSER_NODE_FLAG_SET_BIT, then this
-     * field indicates which bit is to be set in the index above.
+     * node flags also contain PARSER_NODE_KW_FLAG_SET_BIT, then this field
+     * indicates which bit is to be set in the index above.
      */
     int64_t value;
 
     /** @brief String to set
      *
-     * If the header flag contains PARSER_NODE_FLAG_SET_VALUE, and the index
-     * indicates a string value, then this field contains the string to be
-     * copied to the control structure at the specified index.
+     * If the node flags contain PARSER_NODE_KW_FLAG_SET_STRING, then this
+     * field contains the string to be copied to the control structure at
+     * the specified index.
      */
     char string[STRING_LENGTH_MAX];
-} parser_node_keyword_t;
+} parser_node_keyword_cold_t;
+
+/** @brief Action run when the parser reaches an EOL node
+ *
+ * The context is supplied by the caller of the parser, and arg is the
+ * argument saved in the EOL node. Returns 0 on success.
+ */
+typedef int (*parser_action_fn)(void *context, void *arg);
+
+/** @brief Layout for EOL nodes
+ *
+ * This node terminates a command, and holds the action to run when the
+ * command is entered.
+ */
+typedef struct parser_node_eol_s {
+    parser_node_header_t    header;
+
+    /** @brief Action to run */
+    parser_action_fn action;
+
+    /** @brief Argument to pass to the action */
+    void *arg;
+} parser_node_eol_t;
 
 #define INTEGER_FORMAT_DEC  (1 << 0)
 #define INTEGER_FORMAT_HEX  (1 << 1)
@@ -188,15 +324,49 @@ typedef struct parser_node_integer_s {
      * * Binary - `0[bB][01]+`
      * * Hexadecimal - `0[xX][0-9a-fA-F]+`
      * * Octal - `0[0-7]+`
+     *
+     * Any of them may be preceded by a sign. If octal is not accepted, a
+     * decimal integer may have leading zeros.
      */
     uint32_t formats;
 } parser_node_integer_t;
 
+/** @brief Layout for number nodes
+ *
+ * This node accepts a double precision floating point number from the user,
+ * in the form `[+-]?[0-9]*(\.[0-9]*)?([eE][+-]?[0-9]+)?` with at least one
+ * digit in the mantissa.
+ */
+typedef struct parser_node_number_s {
+    parser_node_header_t    header;
+
+    /** @brief Minimum accepted value */
+    double min_accepted;
+
+    /** @brief Maximum accepted value */
+    double max_accepted;
+
+    /** @brief Index of value to set
+     *
+     * This field indicates which entry in the control structure should be
+     * updated with the number from the user.
+     */
+    uint32_t index;
+} parser_node_number_t;
+
 #define AF_NONE     0
 #define AF_IPV4     1
 #define AF_IPV6     2
 #define AF_MAC      3
 
+#define ADDRESS_FORMAT_IPV4     (1 << 0)
+#define ADDRESS_FORMAT_IPV6     (1 << 1)
+#define ADDRESS_FORMAT_MAC      (1 << 2)
+/** IP addresses must be followed by a prefix length, as in `10.0.0.0/8` */
+#define ADDRESS_FORMAT_PREFIX   (1 << 3)
+#define ADDRESS_FORMAT_ALL      (ADDRESS_FORMAT_IPV4 | ADDRESS_FORMAT_IPV6 | \
+                                 ADDRESS_FORMAT_MAC | ADDRESS_FORMAT_PREFIX)
+
 /** @brief Structure to store IPv4/IPv6/MAC addresses */
 typedef struct parser_address_s {
     /** @brief Address family
@@ -208,7 +378,8 @@ typedef struct parser_address_s {
 
     /** @brief IP address mask
      *
-     * This field saves the netmask for IP addresses.
+     * This field saves the netmask for IP addresses, as a prefix length.
+     * It is the full length of the address if no prefix length was given.
      */
     uint8_t mask;
 
@@ -235,8 +406,11 @@ typedef struct parser_node_address_s {
 
     /** @brief Format accepted
      *
-     * This is a field which tells the parser which address format
-     * can be accepted.
+     * This is a bitfield which tells the parser which of the
+     * ADDRESS_FORMAT_* address formats can be accepted:
+     * * IPv4 - `A.B.C.D`, without leading zeros
+     * * IPv6 - `X:X:X:X:X:X:X:X`, as described in RFC 4291
+     * * MAC - `HHHH.HHHH.HHHH`, `HH:HH:HH:HH:HH:HH` or `HH-HH-HH-HH-HH-HH`
      */
     uint32_t format;
 } parser_node_address_t;
@@ -0,0 +1,157 @@
+/****************************************************************************
+ * CLI parser conditional node definitions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_CONDITIONAL_H
+#define HDR_PARSER_CONDITIONAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "parser_common.h"
+#include "parser_control.h"
+#include "parser_arena.h"
+
+/** @name Condition bytecode
+ *
+ * The condition of a conditional node is stored as Reverse Polish Notation
+ * bytecode, see docs/conditional-nodes.md. Each instruction starts with a
+ * byte holding the instruction class in the upper 3 bits, and the type or
+ * operator in the lower 5 bits.
+ */
+/** @{ */
+#define PARSER_COND_CLASS_SHIFT     5
+#define PARSER_COND_CLASS_MASK      0xE0
+#define PARSER_COND_CODE_MASK       0x1F
+
+#define PARSER_COND_CLASS_PARAM     0x00
+#define PARSER_COND_CLASS_OPERATOR  0x20
+#define PARSER_COND_CLASS_CONSTANT  0x40
+
+#define PARSER_COND_TYPE_INTEGER    0
+#define PARSER_COND_TYPE_NUMBER     1
+#define PARSER_COND_TYPE_ADDRESS    2
+#define PARSER_COND_TYPE_STRING     3
+
+#define PARSER_COND_OP_ADD          0
+#define PARSER_COND_OP_SUB          1
+#define PARSER_COND_OP_MUL          2
+#define PARSER_COND_OP_DIV          3
+#define PARSER_COND_OP_MOD          4
+#define PARSER_COND_OP_EQ           5
+#define PARSER_COND_OP_NE           6
+#define PARSER_COND_OP_GT           7
+#define PARSER_COND_OP_GE           8
+#define PARSER_COND_OP_LT           9
+#define PARSER_COND_OP_LE           10
+#define PARSER_COND_OP_BAND         11
+#define PARSER_COND_OP_BOR          12
+#define PARSER_COND_OP_BNOT         13
+#define PARSER_COND_OP_BXOR         14
+#define PARSER_COND_OP_LAND         15
+#define PARSER_COND_OP_LOR          16
+#define PARSER_COND_OP_LNOT         17
+/** @} */
+
+/** @brief Maximum depth of the operand stack of a condition */
+#define PARSER_COND_STACK_MAX       32
+
+/** @brief Verified instruction
+ *
+ * The bytecode is translated into these when it is loaded. The opcode is
+ * specific to the types of the operands, so evaluation never checks types.
+ */
+typedef struct parser_cond_insn_s {
+    /** @brief Type specialized opcode, private to the interpreter */
+    uint32_t opcode;
+
+    /** @brief Parameter index for the parameter opcodes */
+    uint32_t index;
+
+    /** @brief Constant for the constant opcodes */
+    union {
+        int64_t i;
+        double f;
+        const void *p;
+    } imm;
+} parser_cond_insn_t;
+
+/** @brief Verified condition, ready to be evaluated */
+typedef struct parser_cond_program_s {
+    /** @brief Number of instructions */
+    uint32_t count;
+
+    /** @brief Maximum depth of the operand stack */
+    uint32_t stack_depth;
+
+    /** @brief Instructions, the last of which ends the program */
+    parser_cond_insn_t insns[];
+} parser_cond_program_t;
+
+/** @brief Layout for conditional nodes
+ *
+ * This node does not consume any input. If its condition holds for the
+ * parameters saved so far, the children of the node are considered along
+ * with the children of its parent.
+ */
+typedef struct parser_node_conditional_s {
+    parser_node_header_t    header;
+
+    /** @brief Condition to evaluate, or NULL if the node is never taken */
+    const parser_cond_program_t *program;
+} parser_node_conditional_t;
+
+/** @brief Verify condition bytecode and translate it for evaluation
+ *
+ * This checks that the bytecode is well formed, that the operand stack
+ * neither underflows nor exceeds PARSER_COND_STACK_MAX, and that every
+ * operator is applied to operands of types it supports. The types of the
+ * operands are resolved here, so that the evaluation needs no type checks.
+ *
+ * @param   code    Bytecode of the condition
+ * @param   len     Length of the bytecode
+ * @param   arena   Arena to allocate the program and its constants from
+ * @param   program Receives the program
+ *
+ * @returns 0 on success, -EINVAL if the bytecode is invalid, -ENOMEM if
+ *          memory could not be allocated.
+ */
+int parser_cond_compile(const uint8_t *code, size_t len, parser_arena_t *arena,
+                        const parser_cond_program_t **program);
+
+/** @brief Evaluate a condition
+ *
+ * This does not allocate memory, and only reads the control structure.
+ *
+ * @param   program Program returned by \ref parser_cond_compile
+ * @param   ctl     Control structure holding the parameters
+ *
+ * @returns 1 if the condition holds, 0 if not, or -EDOM if an integer
+ *          division by zero or overflow occurred.
+ */
+int parser_cond_eval(const parser_cond_program_t *program,
+                     const PARSER_CTRL *ctl);
+
+/** @brief Check whether the branch of a conditional node is taken
+ *
+ * @returns Non-zero if the condition of the node holds.
+ */
+int parser_cond_node_taken(const PARSER_NODE *node, const PARSER_CTRL *ctl);
+
+#endif /* !defined HDR_PARSER_CONDITIONAL_H */
@@ -0,0 +1,486 @@
+/****************************************************************************
+ * CLI parser control structure
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_CONTROL_H
+#define HDR_PARSER_CONTROL_H
+
+#include <stdint.h>
+
+#include "parser_common.h"
+#include "parser_node_registration.h"
+#include "parser_simd.h"
+#include "parser_arena.h"
+
+/** @brief Number of parameters of each type in the control structure */
+#define PARSER_MAX_PARAMS       32
+
+/** @brief Maximum length of a string parameter, including the terminator */
+#define PARSER_STRING_MAX       256
+
+/** @brief Record match statistics in the nodes of the tree
+ *
+ * Unless the parser is built with PARSER_NO_STATS, setting this flag makes
+ * the parser count the tokens accepted by each node, and the number of
+ * times each node is passed over before a sibling accepts the token.
+ */
+#define PARSER_CTRL_FLAG_STATS  0x00000001
+
+/** @brief Let the rest of the command line settle tokens accepted by more
+ * than one node
+ *
+ * See \ref parser_parse. Without this flag, such a token makes the command
+ * ambiguous as soon as it is reached.
+ */
+#define PARSER_CTRL_FLAG_LOOKAHEAD  0x00000002
+
+/** @brief Number of tokens of the command line held at a time
+ *
+ * Once this many tokens have been split from a longer command line, the
+ * next one is stored at the start of the array again.
+ */
+#define PARSER_TOKENS_MAX       64
+
+/** @brief Token of the command line
+ *
+ * A token is a run of characters other than spaces, and ends at a space, a
+ * null terminator or the end of the command line.
+ */
+struct parser_token_s {
+    /** @brief Offset of the token in the command line */
+    uint32_t offset;
+
+    /** @brief Length of the token */
+    uint32_t len;
+
+    /** @brief Offset of the next token, or of the end of the command line */
+    uint32_t next;
+
+    /** @brief Hash of the token, see \ref parser_control_token_hash
+     *
+     * This is 0 until the hash is first asked for, since most tokens are
+     * never hashed.
+     */
+    uint32_t hash;
+};
+
+/** @brief Hash of an empty token */
+#define PARSER_TOKEN_HASH_EMPTY 2166136261u
+
+/** @brief The characters of a string parameter are followed by a null */
+#define PARSER_STRING_TERMINATED    0x00000001
+
+/** @brief The characters are a copy held by the effect log, which is only
+ * valid until the parse is done */
+#define PARSER_STRING_LOGGED        0x00000002
+
+/** @brief String parameter
+ *
+ * A string parameter refers to its characters where they are, usually in
+ * the command line or in the tree, rather than holding a copy.
+ */
+typedef struct parser_string_s {
+    /** @brief First character of the string */
+    const char *ptr;
+
+    /** @brief Length of the string, less than PARSER_STRING_MAX */
+    uint32_t len;
+
+    /** @brief Flags, see PARSER_STRING_TERMINATED and PARSER_STRING_LOGGED */
+    uint32_t flags;
+} parser_string_t;
+
+/** @brief Kinds of parameter, see \ref parser_effect_t */
+enum parser_effect_kind_e {
+    PARSER_EFFECT_INTEGER,
+    PARSER_EFFECT_NUMBER,
+    PARSER_EFFECT_ADDRESS,
+    PARSER_EFFECT_STRING,
+    PARSER_EFFECT_KINDS
+};
+
+/** @brief Parameter set by a node on a path that may not be taken
+ *
+ * While the parser follows more than one path through the tree, the
+ * parameters set by the nodes on each path are recorded here instead of
+ * in the control structure. The effects of a path are chained from the
+ * latest to the earliest, and paths that part share the effects recorded
+ * before they did.
+ */
+typedef struct parser_effect_s {
+    /** @brief Effect recorded before this one on the same path */
+    const struct parser_effect_s *prev;
+
+    /** @brief Kind of parameter, one of \ref parser_effect_kind_e */
+    uint32_t kind;
+
+    /** @brief Index of the parameter */
+    uint32_t index;
+
+    /** @brief Value of the parameter */
+    union {
+        int64_t integer;
+        double number;
+        parser_address_t address;
+        parser_string_t string;
+    } value;
+} parser_effect_t;
+
+/** @brief Number of effects recorded before an effect log uses its arena */
+#define PARSER_EFFECT_POOL      16
+
+/** @brief Effects recorded by the setters instead of setting parameters */
+typedef struct parser_effect_log_s {
+    /** @brief Latest effect of the path being matched
+     *
+     * The parser points this at the effects of a path before matching the
+     * next node on it, and takes it back once the node has matched.
+     */
+    const parser_effect_t *head;
+
+    /** @brief -ENOMEM once an effect could not be recorded, which is
+     * checked by the parser, since nodes need not check the setters
+     */
+    int error;
+
+    /** @brief Number of effects of the pool in use */
+    uint32_t pool_used;
+
+    /** @brief Effects recorded first, which is all of them unless paths
+     * stay apart for long
+     */
+    parser_effect_t pool[PARSER_EFFECT_POOL];
+
+    /** @brief Memory for the effects that do not fit in the pool */
+    parser_arena_t arena;
+} parser_effect_log_t;
+
+/** @brief Parser control structure
+ *
+ * The control structure holds the command line being parsed, the current
+ * position of the parser within it, and the parameters saved by the nodes
+ * matched so far.
+ */
+struct parser_control_s {
+    /** @brief Command line being parsed
+     *
+     * The command line ends at command_length characters or at the first
+     * null terminator, whichever comes first.
+     */
+    const char *command_line;
+
+    /** @brief Length of the command line */
+    uint32_t command_length;
+
+    /** @brief Number of characters consumed by the matched nodes
+     *
+     * This is the offset of the current token, or of the end of the command
+     * line once every token has been consumed.
+     */
+    uint32_t total_parsed;
+
+    /** @brief Number of tokens held in tokens */
+    uint32_t token_count;
+
+    /** @brief Index of the current token in tokens */
+    uint32_t token_index;
+
+    /** @brief Flags controlling the parse, see PARSER_CTRL_FLAG_* */
+    uint32_t flags;
+
+    /** @brief Number of nodes passed over in child chains
+     *
+     * This is only counted if flags contains PARSER_CTRL_FLAG_STATS.
+     */
+    uint32_t probes;
+
+    /** @brief Largest number of nodes passed over in a single child chain */
+    uint32_t probe_depth_max;
+
+    /** @brief Integer parameters set, one bit per index */
+    uint32_t set_integers;
+
+    /** @brief Floating point parameters set, one bit per index */
+    uint32_t set_numbers;
+
+    /** @brief Address parameters set, one bit per index */
+    uint32_t set_addresses;
+
+    /** @brief String parameters set, one bit per index */
+    uint32_t set_strings;
+
+    /** @brief Log that the setters record parameters in, or NULL to set them
+     *
+     * This is only set while a parse with PARSER_CTRL_FLAG_LOOKAHEAD is in
+     * progress.
+     */
+    parser_effect_log_t *effects;
+
+    /** @brief Tokens of the command line up to the current one
+     *
+     * Each token is split from the command line once, when the parser
+     * reaches it, so that the matchers of all the nodes tried for the token
+     * share the work. A token is not split before it is needed, since most
+     * commands that fail to parse fail early.
+     */
+    parser_token_t tokens[PARSER_TOKENS_MAX];
+
+    /*
+     * A parameter is only valid if its bit is set in the matching set_*
+     * bitmap, and reads as zero or as an empty string otherwise. This way
+     * a new command line only clears the bitmaps, rather than every
+     * parameter, since most commands set no more than a few.
+     */
+
+    /** @brief Integer parameters */
+    int64_t integers[PARSER_MAX_PARAMS];
+
+    /** @brief Floating point parameters */
+    double numbers[PARSER_MAX_PARAMS];
+
+    /** @brief Address parameters */
+    parser_address_t addresses[PARSER_MAX_PARAMS];
+
+    /** @brief String parameters */
+    parser_string_t strings[PARSER_MAX_PARAMS];
+
+    /** @brief Copies of string parameters, one slot per index
+     *
+     * Strings that are taken from the command line or the tree are
+     * referenced where they are, and only copied here when they must be
+     * null terminated. A parameter holds at most one copy at a time, in its
+     * own slot, so a copy always fits, and nothing is reset per line.
+     */
+    char string_data[PARSER_MAX_PARAMS][PARSER_STRING_MAX];
+
+    /** @brief Effect log of the parses with PARSER_CTRL_FLAG_LOOKAHEAD
+     *
+     * This is kept from one parse to the next, and its arena is rewound
+     * to a single block as large as the parse needed, rather than
+     * released, so a parse that looks ahead only allocates when it records
+     * more effects than every parse before it. It is released by
+     * \ref parser_control_destroy.
+     */
+    parser_effect_log_t effect_log;
+};
+
+_Static_assert(PARSER_MAX_PARAMS <= 32, "parameter bitmaps hold 32 bits");
+
+/** @brief Reset a control structure to parse a new command line
+ *
+ * @param   ctl     Pointer to the control structure
+ * @param   line    Command line to parse. This is not copied, and must
+ *                  remain valid until parsing is complete.
+ * @param   length  Length of the command line
+ *
+ * This clears the flags, so they must be set after this is called. It
+ * also sets total_parsed to the offset of the first token, and marks every
+ * parameter as unset. The parameters themselves are not cleared, so this
+ * takes the same time however many the previous command line set.
+ */
+void parser_control_init(PARSER_CTRL *ctl, const char *line, uint32_t length);
+
+/** @brief Release the memory held by a control structure
+ *
+ * A control structure must be zeroed when it is allocated, and this must
+ * be called before it is freed. It may be reused afterwards.
+ */
+void parser_control_destroy(PARSER_CTRL *ctl);
+
+/** @brief Restart tokenizing the command line at total_parsed
+ *
+ * This drops the tokens held, and skips any spaces at total_parsed. It is
+ * called by \ref parser_control_init, and need only be called again when
+ * command_length or total_parsed are changed by hand.
+ */
+void parser_control_tokenize(PARSER_CTRL *ctl);
+
+/** @brief Split the token at total_parsed from the command line
+ *
+ * This is called by \ref parser_control_token once every token held has
+ * been consumed.
+ *
+ * @returns Pointer to the token, or NULL at the end of the command line.
+ */
+const parser_token_t * parser_control_split_token(PARSER_CTRL *ctl);
+
+/** @brief Retrieve the current token
+ *
+ * @returns Pointer to the token, or NULL at the end of the command line.
+ */
+static inline const parser_token_t * parser_control_token(PARSER_CTRL *ctl)
+{
+    if (ctl->token_index < ctl->token_count) {
+        return &ctl->tokens[ctl->token_index];
+    }
+
+    return parser_control_split_token(ctl);
+}
+
+/** @brief FNV-1a hash of a string, which is never 0 */
+uint32_t parser_token_hash(const char *s, uint32_t len);
+
+/** @brief Retrieve the hash of a token held by a control structure
+ *
+ * The hash is computed the first time it is asked for, and kept with the
+ * token for the rest of the parse.
+ */
+static inline uint32_t parser_control_token_hash(PARSER_CTRL *ctl,
+                                                 const parser_token_t *token)
+{
+    parser_token_t *held = &ctl->tokens[token - ctl->tokens];
+
+    if (!held->hash) {
+        held->hash = parser_token_hash(&ctl->command_line[held->offset],
+                                       held->len);
+    }
+
+    return held->hash;
+}
+
+/** @brief Consume tokens
+ *
+ * This moves past the current token and the count - 1 tokens after it,
+ * along with the spaces that follow them.
+ */
+static inline void parser_control_advance(PARSER_CTRL *ctl, uint32_t count)
+{
+    const parser_token_t *token;
+
+    while (count-- && (token = parser_control_token(ctl))) {
+        ctl->total_parsed = token->next;
+        ctl->token_index++;
+    }
+}
+
+/** @name Parameter accessors
+ *
+ * All accessors return 0 on success, or -EINVAL if an argument is NULL or
+ * the index is out of range. Parameters that are not set read as zero, or
+ * as an empty string. While effects are recorded, setters may also return
+ * -ENOMEM.
+ */
+/** @{ */
+int parser_control_get_integer(PARSER_CTRL *ctl, uint32_t index, int64_t *value);
+int parser_control_set_integer(PARSER_CTRL *ctl, uint32_t index, const int64_t *value);
+int parser_control_get_number(PARSER_CTRL *ctl, uint32_t index, double *value);
+int parser_control_set_number(PARSER_CTRL *ctl, uint32_t index, const double *value);
+int parser_control_get_address(PARSER_CTRL *ctl, uint32_t index, parser_address_t *value);
+int parser_control_set_address(PARSER_CTRL *ctl, uint32_t index, const parser_address_t *value);
+
+/** @brief Set a bit in an integer parameter
+ *
+ * The bit is set in the value of the parameter, or in zero if it is not
+ * set yet.
+ */
+int parser_control_set_bit(PARSER_CTRL *ctl, uint32_t index, uint32_t bit);
+
+/** @brief Retrieve a string parameter as a null terminated string
+ *
+ * A string that is referenced where it is without a terminator is copied
+ * into the slot of the parameter the first time this is called for it.
+ *
+ * @returns 0 on success, -EINVAL on invalid arguments
+ */
+int parser_control_get_string(PARSER_CTRL *ctl, uint32_t index, const char **value);
+
+/** @brief Set a string parameter to a copy of a null terminated string
+ *
+ * The string is truncated to PARSER_STRING_MAX - 1 characters. It is
+ * copied into the slot of the parameter, or while a parse with lookahead
+ * is recording effects, into memory of the effect log, since the paths
+ * being followed may each set the parameter. The copy is moved into the
+ * slot once the effect is applied for good.
+ *
+ * @returns 0 on success, -EINVAL, or -ENOMEM if an effect could not be
+ *          recorded.
+ */
+int parser_control_set_string(PARSER_CTRL *ctl, uint32_t index, const char *value);
+
+/** @brief Set a string parameter to a null terminated string, without a copy
+ *
+ * The string must remain valid for as long as the parameters are read,
+ * which holds for strings in the tree. It is truncated to
+ * PARSER_STRING_MAX - 1 characters.
+ */
+int parser_control_set_string_ref(PARSER_CTRL *ctl, uint32_t index, const char *value);
+
+/** @brief Set a string parameter to a span of characters, without a copy
+ *
+ * The characters must remain valid for as long as the parameters are read,
+ * which holds for the command line. The span is truncated to
+ * PARSER_STRING_MAX - 1 characters.
+ */
+int parser_control_set_string_span(PARSER_CTRL *ctl, uint32_t index,
+                                   const char *ptr, uint32_t len);
+
+/** @brief Retrieve a string parameter without a copy
+ *
+ * The characters are not necessarily followed by a null terminator.
+ */
+int parser_control_get_string_span(PARSER_CTRL *ctl, uint32_t index,
+                                   const char **ptr, uint32_t *len);
+
+/** @brief Retrieve an address parameter without a copy
+ *
+ * The address remains valid until the control structure is initialized
+ * again.
+ */
+int parser_control_get_address_ref(PARSER_CTRL *ctl, uint32_t index,
+                                   const parser_address_t **value);
+/** @} */
+
+/** @brief Parameters replaced by \ref parser_control_apply */
+typedef struct parser_control_saved_s {
+    /** @brief Bitmaps of the parameters set, before the effects applied */
+    uint32_t set[PARSER_EFFECT_KINDS];
+
+    /** @brief Parameters replaced, one bitmap per kind */
+    uint32_t replaced[PARSER_EFFECT_KINDS];
+
+    /** @brief Previous values of the parameters replaced */
+    int64_t integers[PARSER_MAX_PARAMS];
+    double numbers[PARSER_MAX_PARAMS];
+    parser_address_t addresses[PARSER_MAX_PARAMS];
+    parser_string_t strings[PARSER_MAX_PARAMS];
+} parser_control_saved_t;
+
+/** @brief Set the parameters recorded by a chain of effects
+ *
+ * The latest effect on each parameter wins. Only one effect per parameter
+ * is applied, so this takes time in the length of the chain, however many
+ * parameters it sets.
+ *
+ * @param   ctl     Control structure to set the parameters in
+ * @param   effects Latest effect of the chain, may be NULL
+ * @param   saved   Receives what is needed to undo this with
+ *                  \ref parser_control_restore, may be NULL. If this is
+ *                  NULL, the effects are applied for good, and strings
+ *                  copied into the effect log are copied into the slots of
+ *                  their parameters, since the log is rewound once the
+ *                  parse is done.
+ */
+void parser_control_apply(PARSER_CTRL *ctl, const parser_effect_t *effects,
+                          parser_control_saved_t *saved);
+
+/** @brief Undo \ref parser_control_apply */
+void parser_control_restore(PARSER_CTRL *ctl,
+                            const parser_control_saved_t *saved);
+
+#endif /* !defined HDR_PARSER_CONTROL_H */
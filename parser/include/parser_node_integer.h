@@ -0,0 +1,147 @@
+/****************************************************************************
+ * CLI parser integer node definitions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_NODE_INTEGER_H
+#define HDR_PARSER_NODE_INTEGER_H
+
+#include <stdint.h>
+
+#include "parser_common.h"
+#include "parser_node_registration.h"
+#include "parser_arena.h"
+
+/** @brief Minimum number of integer nodes in a chain to build a range table
+ *
+ * A token is parsed again by each integer node it is tried against, so the
+ * table pays for itself sooner than a keyword table does.
+ */
+#define PARSER_INT_DISPATCH_THRESHOLD       4
+
+/** @brief Range table was allocated from an arena and must not be freed */
+#define PARSER_INT_DISPATCH_FLAG_ARENA      0x00000001
+
+/** @brief Range of an integer node in a \ref parser_int_dispatch_t */
+typedef struct parser_int_range_s {
+    /** Minimum accepted value of the node */
+    int64_t min;
+
+    /** Maximum accepted value of the node */
+    int64_t max;
+
+    /** Largest maximum of this range and every range before it */
+    int64_t reach;
+
+    /** Integer node */
+    parser_node_integer_t *node;
+} parser_int_range_t;
+
+/** @brief Integer range table
+ *
+ * The freeze step builds one of these for every node whose child chain
+ * holds at least PARSER_INT_DISPATCH_THRESHOLD integer nodes, all of which
+ * accept the same formats. The ranges of the children are sorted by their
+ * minimum, so a token is parsed once, and the ranges that hold its value
+ * are located with a binary search.
+ */
+typedef struct parser_int_dispatch_s {
+    /** Number of integer nodes in the table */
+    uint32_t count;
+
+    /** Range table flags */
+    uint32_t flags;
+
+    /** Formats accepted by every node in the table */
+    uint32_t formats;
+
+    /** Number of ranges that overlap an earlier range in the table, which
+     * is the number of ranges less the number of groups of ranges that
+     * overlap */
+    uint32_t overlaps;
+
+    /** Ranges sorted by minimum */
+    parser_int_range_t entries[];
+} parser_int_dispatch_t;
+
+/** @brief Get the range table of a node, or NULL if it has none */
+static inline parser_int_dispatch_t * parser_node_int_dispatch(const PARSER_NODE *node)
+{
+    if (!(node->flags & PARSER_NODE_FLAG_INT_DISPATCH)) {
+        return NULL;
+    }
+
+    return node->cold->int_dispatch;
+}
+
+/** @brief Find the integer nodes of a range table that accept a token
+ *
+ * The token is parsed once, in the formats of the table.
+ *
+ * @param   dispatch    Range table
+ * @param   token       Pointer to the token, need not be null terminated
+ * @param   len         Length of the token
+ * @param   value       Receives the value of the token
+ * @param   match       Array that receives the matching nodes, may be NULL
+ *                      if max is 0
+ * @param   max         Stop searching after this many matches
+ *
+ * @returns Number of matching integer nodes, at most max. A return value
+ *          greater than 1 means the token is ambiguous.
+ */
+uint32_t parser_integer_lookup(const parser_int_dispatch_t *dispatch,
+                               const char *token, uint32_t len,
+                               int64_t *value, parser_node_integer_t **match,
+                               uint32_t max);
+
+/** @brief Count the integer children of a node whose ranges overlap
+ *
+ * A value in the overlap of two ranges is accepted by both nodes, so a
+ * command using it is ambiguous unless lookahead settles it. The count
+ * kept in the range table is used if the node has one.
+ *
+ * @returns Number of integer children whose range overlaps that of a
+ *          child sorted before it by minimum, which is the number of
+ *          integer children less the number of groups of ranges that
+ *          overlap.
+ */
+uint32_t parser_integer_overlaps(const PARSER_NODE *parent);
+
+/** @brief Build the range table for the integer children of a node
+ *
+ * @param   parent  Node whose children are to be dispatched
+ * @param   arena   Arena to allocate the table from, or NULL to allocate
+ *                  it from the heap
+ *
+ * The table is referenced from the cold data of the parent, so a node that
+ * has no cold data never gets a table.
+ *
+ * @returns 0 on success (including when the chain is too short for a table
+ *          to be worthwhile, or its nodes accept different formats),
+ *          -ENOMEM on allocation failure.
+ */
+int parser_integer_build_dispatch(PARSER_NODE *parent, parser_arena_t *arena);
+
+/** @brief Release the range table of a node
+ *
+ * The node falls back to trying its integer children in turn until a new
+ * table is built. This must be called before the child chain is modified.
+ */
+void parser_integer_free_dispatch(PARSER_NODE *parent);
+
+#endif /* !defined HDR_PARSER_NODE_INTEGER_H */
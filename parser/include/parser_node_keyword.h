@@ -0,0 +1,190 @@
+/****************************************************************************
+ * CLI parser keyword node definitions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_NODE_KEYWORD_H
+#define HDR_PARSER_NODE_KEYWORD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "parser_common.h"
+#include "parser_node_registration.h"
+#include "parser_arena.h"
+#include "parser_simd.h"
+
+typedef parser_node_keyword_t PARSER_NODE_KEYWORD;
+typedef parser_node_keyword_cold_t PARSER_NODE_KEYWORD_COLD;
+
+/** @brief Keyword node flags
+ *
+ * These are stored in the node_flags field of the header.
+ */
+#define PARSER_NODE_KW_FLAG_SET_VALUE       0x00000001
+#define PARSER_NODE_KW_FLAG_SET_BIT         0x00000002
+#define PARSER_NODE_KW_FLAG_SET_STRING      0x00000004
+
+/** @brief Minimum number of keywords in a chain to build a dispatch table
+ *
+ * Shorter chains are faster to walk than to search.
+ */
+#define PARSER_KW_DISPATCH_THRESHOLD        8
+
+/** @brief Dispatch table was allocated from an arena and must not be freed */
+#define PARSER_KW_DISPATCH_FLAG_ARENA       0x00000001
+
+/** @brief Keyword dispatch table
+ *
+ * The freeze step builds one of these for every node whose child chain
+ * holds at least PARSER_KW_DISPATCH_THRESHOLD keyword nodes. The keyword
+ * children are sorted by keyword, so all keywords that begin with a given
+ * token form a contiguous run that can be located with a binary search.
+ */
+typedef struct parser_kw_dispatch_s {
+    /** Number of keyword nodes in the table */
+    uint32_t count;
+
+    /** Dispatch table flags */
+    uint32_t flags;
+
+    /** Keyword nodes sorted by keyword */
+    PARSER_NODE_KEYWORD *entries[];
+} parser_kw_dispatch_t;
+
+/** @brief Minimum number of characters to match a keyword node */
+static inline uint32_t parser_keyword_minimum_match(const PARSER_NODE_KEYWORD *knode)
+{
+    return knode->header.type_data;
+}
+
+/** @brief Get the keyword dispatch table of a node, or NULL if it has none */
+static inline parser_kw_dispatch_t * parser_node_dispatch(const PARSER_NODE *node)
+{
+    if (!(node->flags & PARSER_NODE_FLAG_DISPATCH)) {
+        return NULL;
+    }
+
+    return node->cold->kw_dispatch;
+}
+
+/** @brief Check whether a token selects a keyword
+ *
+ * A token selects the keyword if it is a non-empty prefix of the keyword
+ * and is at least minimum_match characters long. This is the single
+ * definition of a keyword match, shared by the in-memory keyword nodes and
+ * the keyword records of a mapped BPT file.
+ *
+ * @param   keyword         Keyword of up to KEYWORD_LENGTH_MAX characters,
+ *                          null terminated if shorter
+ * @param   minimum_match   Minimum number of characters to match
+ * @param   token           Pointer to the token, need not be null terminated
+ * @param   len             Length of the token
+ *
+ * @returns Non-zero if the token selects the keyword, 0 otherwise.
+ */
+static inline int parser_keyword_string_accepts(const char *keyword,
+                                                uint32_t minimum_match,
+                                                const char *token,
+                                                uint32_t len)
+{
+    if (len == 0 || len > KEYWORD_LENGTH_MAX || len < minimum_match) {
+        return 0;
+    }
+
+    /*
+     * The token never contains a null terminator, so this fails if the
+     * keyword is shorter than the token.
+     */
+    return strncmp(keyword, token, len) == 0;
+}
+
+/** @brief Check whether a token selects a keyword node
+ *
+ * This applies \ref parser_keyword_string_accepts to the node, and is used
+ * by both the node match callback and the dispatch table.
+ *
+ * @param   knode   Pointer to the keyword node
+ * @param   token   Pointer to the token, need not be null terminated
+ * @param   len     Length of the token
+ *
+ * @returns Non-zero if the token selects the keyword, 0 otherwise.
+ */
+int parser_keyword_accepts(const PARSER_NODE_KEYWORD *knode,
+                           const char *token, uint32_t len);
+
+/** @brief Check whether a prepared token selects a keyword node
+ *
+ * This gives the same answer as \ref parser_keyword_accepts, but compares
+ * the whole keyword at once, and lets a token be prepared once for a whole
+ * chain of keywords.
+ *
+ * @param   knode   Pointer to the keyword node
+ * @param   token   Token prepared with \ref parser_kw_token_prepare
+ *
+ * @returns Non-zero if the token selects the keyword, 0 otherwise.
+ */
+static inline int parser_keyword_token_accepts(const PARSER_NODE_KEYWORD *knode,
+                                               const parser_kw_token_t *token)
+{
+    return token->len >= parser_keyword_minimum_match(knode) &&
+           parser_keyword_prefix(knode->keyword, token);
+}
+
+/** @brief Find the keyword children of a node that accept a token
+ *
+ * This uses the dispatch table of the parent if it has been frozen, and
+ * walks the child chain otherwise. Both give the same answer; the order in
+ * which the matches are returned is unspecified.
+ *
+ * @param   parent  Node whose children are searched
+ * @param   token   Pointer to the token, need not be null terminated
+ * @param   len     Length of the token
+ * @param   match   Array that receives the matching nodes, may be NULL
+ *                  if max is 0
+ * @param   max     Stop searching after this many matches
+ *
+ * @returns Number of matching keyword nodes, at most max. A return value
+ *          greater than 1 means the token is ambiguous.
+ */
+uint32_t parser_keyword_lookup(const PARSER_NODE *parent,
+                               const char *token, uint32_t len,
+                               PARSER_NODE_KEYWORD **match, uint32_t max);
+
+/** @brief Build the keyword dispatch table for the children of a node
+ *
+ * @param   parent  Node whose children are to be dispatched
+ * @param   arena   Arena to allocate the table from, or NULL to allocate
+ *                  it from the heap
+ *
+ * The table is referenced from the cold data of the parent, so a node that
+ * has no cold data never gets a table.
+ *
+ * @returns 0 on success (including when the chain is too short for a table
+ *          to be worthwhile), -ENOMEM on allocation failure.
+ */
+int parser_keyword_build_dispatch(PARSER_NODE *parent, parser_arena_t *arena);
+
+/** @brief Release the keyword dispatch table of a node
+ *
+ * The node falls back to walking its child chain until a new table is
+ * built. This must be called before the child chain is modified.
+ */
+void parser_keyword_free_dispatch(PARSER_NODE *parent);
+
+#endif /* !defined HDR_PARSER_NODE_KEYWORD_H */
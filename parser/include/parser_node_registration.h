@@ -0,0 +1,118 @@
+/****************************************************************************
+ * CLI parser node registration
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_NODE_REGISTRATION_H
+#define HDR_PARSER_NODE_REGISTRATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "parser_common.h"
+
+/** @brief Generic parser node
+ *
+ * All node types begin with the common header, so the parser core passes
+ * nodes around as a pointer to the header and each node type handler casts
+ * it to its own layout.
+ */
+typedef parser_node_header_t PARSER_NODE;
+
+/** @brief Parser control structure, see parser_control.h */
+typedef struct parser_control_s PARSER_CTRL;
+
+/** @brief Node traversal callback
+ *
+ * Returns the next node to visit, or NULL if there is none.
+ */
+typedef PARSER_NODE * (*parser_node_get_fn)(PARSER_NODE *node, PARSER_CTRL *ctl);
+
+/** @brief Token of the command line, see parser_control.h */
+typedef struct parser_token_s parser_token_t;
+
+/** @brief Node match callback
+ *
+ * The token is the current token of the control structure, already split
+ * from the command line. Returns the number of tokens consumed if the node
+ * accepts the input starting at the token, 0 if it rejects it, or a
+ * negative errno value on failure.
+ */
+typedef int32_t (*parser_node_match_fn)(PARSER_NODE *node, PARSER_CTRL *ctl,
+                                        const parser_token_t *token);
+
+/** @brief Maximum length of the display text of a node, with terminator */
+#define PARSER_ALT_TEXT_MAX     64
+
+/** @brief Node display callback
+ *
+ * Returns a null terminated string describing the node for completion and
+ * help. This never allocates memory: the string is either held by the node
+ * itself, or formatted into buf, which holds size bytes. The string remains
+ * valid until the node is modified or buf is reused.
+ */
+typedef const char * (*parser_node_alt_text_fn)(PARSER_NODE *node, char *buf,
+                                                size_t size);
+
+/** @brief Node type handler registration
+ *
+ * Each node type registers one of these with the parser core at startup.
+ */
+typedef struct parser_node_reg_s {
+    /** Returns the child of the node. DEFAULT follows the header pointer. */
+    parser_node_get_fn      get_child;
+
+    /** Returns the sibling of the node. DEFAULT follows the header pointer. */
+    parser_node_get_fn      get_sibling;
+
+    /** Matches the node against the command line */
+    parser_node_match_fn    match;
+
+    /** Returns the display text for the node */
+    parser_node_alt_text_fn alt_text;
+} PARSER_NODE_REG;
+
+/** @brief Use the default handler for a registration callback */
+#define DEFAULT     NULL
+
+/** @brief Mark a node type setup function to run at library load */
+#define SETUP_FUNCTION  __attribute__((constructor))
+
+/** @brief Register a node type handler
+ *
+ * @param   type    Node type, one of \ref parser_node_type_e
+ * @param   reg     Pointer to the registration, must remain valid
+ *
+ * @returns 0 on success, -EINVAL if the type is out of range, -EEXIST if
+ *          the type is already registered.
+ */
+int parser_node_register_type(uint32_t type, const PARSER_NODE_REG *reg);
+
+/** @brief Retrieve the handler registered for a node type
+ *
+ * @returns Pointer to the registration, or NULL if none is registered.
+ */
+const PARSER_NODE_REG * parser_node_get_registration(uint32_t type);
+
+/** @brief Retrieve the child of a node, honouring the type handler */
+PARSER_NODE * parser_node_get_child(PARSER_NODE *node, PARSER_CTRL *ctl);
+
+/** @brief Retrieve the sibling of a node, honouring the type handler */
+PARSER_NODE * parser_node_get_sibling(PARSER_NODE *node, PARSER_CTRL *ctl);
+
+#endif /* !defined HDR_PARSER_NODE_REGISTRATION_H */
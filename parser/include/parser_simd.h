@@ -0,0 +1,149 @@
+/****************************************************************************
+ * CLI parser vectorized scanning and keyword comparison
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_SIMD_H
+#define HDR_PARSER_SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "parser_common.h"
+
+/** @brief Implementation levels
+ *
+ * The best level supported by the processor is selected when the library
+ * is loaded. Build with PARSER_NO_SIMD to only build the scalar level.
+ */
+enum parser_simd_level_e {
+    PARSER_SIMD_SCALAR = 0,
+    PARSER_SIMD_SSE2,
+    PARSER_SIMD_AVX2,
+    PARSER_SIMD_MAX
+};
+
+/** @brief Token prepared for comparison against keywords
+ *
+ * The token is copied into a buffer as long as a keyword and padded with
+ * zeros, so that it can be compared against any number of keywords without
+ * reading past the end of the command line.
+ */
+typedef struct parser_kw_token_s {
+    /** @brief Token text, padded with zeros */
+    char text[KEYWORD_LENGTH_MAX] __attribute__((aligned(KEYWORD_LENGTH_MAX)));
+
+    /** @brief Bit N is set if byte N of the text belongs to the token */
+    uint32_t mask;
+
+    /** @brief Length of the token */
+    uint32_t len;
+} parser_kw_token_t;
+
+/** @brief Scanning and comparison functions of an implementation level */
+typedef struct parser_simd_ops_s {
+    /** @brief Name of the level */
+    const char *name;
+
+    /** @brief Length of the token at the start of a string
+     *
+     * A token ends at a space or a null terminator. At most len bytes are
+     * examined.
+     */
+    uint32_t (*scan_token)(const char *s, uint32_t len);
+
+    /** @brief Number of spaces at the start of a string, at most len */
+    uint32_t (*scan_spaces)(const char *s, uint32_t len);
+
+    /** @brief Check whether a prepared token is a prefix of a keyword
+     *
+     * The keyword must be a full KEYWORD_LENGTH_MAX byte array, padded with
+     * zeros, as held by keyword nodes.
+     */
+    int (*keyword_prefix)(const char *keyword, const parser_kw_token_t *token);
+} parser_simd_ops_t;
+
+/** @brief Functions of the selected level
+ * @private
+ */
+extern const parser_simd_ops_t *parser_simd;
+
+/** @brief Retrieve the functions of an implementation level
+ *
+ * @returns Pointer to the functions, or NULL if the level was not built in
+ *          or is not supported by the processor.
+ */
+const parser_simd_ops_t * parser_simd_get(uint32_t level);
+
+/** @brief Select the implementation level used by the parser
+ *
+ * This is only needed to compare the levels, since the best one is already
+ * selected. It must not be called while any thread parses.
+ *
+ * @returns 0 on success, -ENOTSUP if the level is not available.
+ */
+int parser_simd_select(uint32_t level);
+
+/** @brief Prepare a token for comparison against keywords
+ *
+ * @param   token   Receives the prepared token
+ * @param   s       Pointer to the token, which contains no null bytes
+ * @param   len     Length of the token
+ *
+ * @returns Non-zero if the token was prepared, 0 if it is empty or longer
+ *          than any keyword, in which case it selects no keyword.
+ */
+static inline int parser_kw_token_prepare(parser_kw_token_t *token,
+                                          const char *s, uint32_t len)
+{
+    if (len == 0 || len > KEYWORD_LENGTH_MAX) {
+        return 0;
+    }
+
+    memset(token->text, 0, sizeof(token->text));
+    memcpy(token->text, s, len);
+    token->mask = len == KEYWORD_LENGTH_MAX ? 0xFFFFFFFFu : (1u << len) - 1;
+    token->len = len;
+    return 1;
+}
+
+/** @brief Length of the token at the start of a string, see scan_token */
+static inline uint32_t parser_scan_token(const char *s, uint32_t len)
+{
+    return parser_simd->scan_token(s, len);
+}
+
+/** @brief Number of spaces at the start of a string, see scan_spaces */
+static inline uint32_t parser_scan_spaces(const char *s, uint32_t len)
+{
+    /* Tokens are mostly separated by single spaces */
+    if (len < 2 || s[1] != ' ') {
+        return len && s[0] == ' ';
+    }
+
+    return parser_simd->scan_spaces(s, len);
+}
+
+/** @brief Check whether a prepared token is a prefix of a keyword array */
+static inline int parser_keyword_prefix(const char *keyword,
+                                        const parser_kw_token_t *token)
+{
+    return parser_simd->keyword_prefix(keyword, token);
+}
+
+#endif /* !defined HDR_PARSER_SIMD_H */
@@ -0,0 +1,163 @@
+/****************************************************************************
+ * CLI parser tree operations
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#ifndef HDR_PARSER_TREE_H
+#define HDR_PARSER_TREE_H
+
+#include <stdint.h>
+
+#include "parser_node_registration.h"
+#include "parser_arena.h"
+
+/** @brief Tree walk callback
+ *
+ * Return 0 to continue the walk, or any other value to stop it. The value
+ * is passed back to the caller of \ref parser_tree_walk.
+ */
+typedef int (*parser_tree_visit_fn)(PARSER_NODE *node, void *arg);
+
+/** @brief Visit every node reachable from a root node
+ *
+ * Nodes are visited depth first, child before sibling. A node that can be
+ * reached along more than one path is only visited once.
+ *
+ * @param   root    Root node of the tree
+ * @param   visit   Callback invoked for each node
+ * @param   arg     Opaque argument passed to the callback
+ *
+ * @returns 0 if every node was visited, the non-zero value returned by the
+ *          callback if it stopped the walk, or -ENOMEM.
+ */
+int parser_tree_walk(PARSER_NODE *root, parser_tree_visit_fn visit, void *arg);
+
+/** @brief Memory used by a tree */
+typedef struct parser_footprint_s {
+    /** Number of distinct nodes in the tree */
+    uint32_t nodes;
+
+    /** Bytes of node data visited while walking the tree */
+    size_t hot_bytes;
+
+    /** Bytes of cold node data, excluding help text */
+    size_t cold_bytes;
+
+    /** Bytes of help text */
+    size_t help_bytes;
+
+    /** Bytes of keyword dispatch tables */
+    size_t dispatch_bytes;
+} parser_footprint_t;
+
+/** @brief Size of the node layout for a node type */
+size_t parser_node_size(uint32_t type);
+
+/** @brief Size of the cold data layout for a node type */
+size_t parser_node_cold_size(uint32_t type);
+
+/** @brief Measure the memory used by a tree
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int parser_tree_footprint(PARSER_NODE *root, parser_footprint_t *footprint);
+
+/** @brief Freeze a tree for fast dispatch
+ *
+ * This builds the keyword dispatch tables and integer range tables for
+ * every node in the tree that does not already have them. A node whose
+ * child chain is modified must drop its tables first with \ref
+ * parser_keyword_free_dispatch and \ref parser_integer_free_dispatch, and
+ * freezing the tree again will rebuild them.
+ *
+ * @param   root    Root node of the tree
+ * @param   arena   Arena to allocate the tables from, or NULL to allocate
+ *                  them from the heap. Tables allocated from an arena are
+ *                  released along with it, and need not be thawed.
+ *
+ * @returns 0 on success, negative errno on failure. On failure the tree
+ *          is left thawed.
+ */
+int parser_tree_freeze(PARSER_NODE *root, parser_arena_t *arena);
+
+/** @brief Release the dispatch tables built by \ref parser_tree_freeze */
+void parser_tree_thaw(PARSER_NODE *root);
+
+/** @brief Count the integer nodes of a tree whose ranges overlap a sibling's
+ *
+ * This adds up \ref parser_integer_overlaps for every node in the tree.
+ *
+ * @param   root        Root node of the tree
+ * @param   overlaps    Receives the number of overlapping ranges
+ *
+ * @returns 0 on success, negative errno on failure.
+ */
+int parser_tree_overlaps(PARSER_NODE *root, uint32_t *overlaps);
+
+/** @brief Reorder the children of every node by the number of matches
+ *
+ * The children of each node are grouped by type in order of priority, and
+ * children of a type that consumes input are sorted so that those that
+ * accepted the most tokens come first. Children with equal counts, and
+ * conditional and EOL nodes, keep their relative order. Since the parser
+ * tries node types in order of priority and reports a token accepted by
+ * two nodes of a type as ambiguous, the outcome of a parse is unchanged.
+ *
+ * Child chains that are shared with another node are left as they are.
+ * Dispatch tables do not depend on the order of the children, and are
+ * kept.
+ *
+ * @param   root    Root node of the tree
+ *
+ * @returns 0 on success, negative errno on failure. On failure the tree
+ *          may have been partly reordered.
+ */
+int parser_tree_reorder(PARSER_NODE *root);
+
+/** @brief Share identical subtrees of a tree
+ *
+ * Nodes with the same type, flags, help text, type data and set values,
+ * whose children and later siblings are also identical, lead to exactly
+ * the same commands. Every link to such a node is replaced by a link to
+ * the first one found, turning the tree into a DAG, so that the parser
+ * walks fewer distinct nodes. The outcome of every parse is unchanged.
+ *
+ * The nodes that are no longer linked stay allocated until the tree is
+ * released. The dispatch tables of nodes whose children were replaced are
+ * dropped, and are rebuilt by freezing the tree again. Nodes that lie on a
+ * cycle are kept, though their children may still be shared. A shared node
+ * must not be modified afterwards, since that would change every command
+ * leading to it, so the nodes that replaced others, the nodes reached from
+ * them and the nodes replaced are given PARSER_NODE_FLAG_SHARED.
+ *
+ * @param   root    Root node of the tree
+ * @param   shared  Receives the number of nodes that are no longer linked.
+ *                  This may be NULL.
+ *
+ * @returns 0 on success, negative errno on failure. On failure the tree
+ *          may have been partly shared, but still parses the same way.
+ */
+int parser_tree_share(PARSER_NODE *root, uint32_t *shared);
+
+/** @brief Check whether a tree is frozen */
+static inline int parser_tree_is_frozen(const PARSER_NODE *root)
+{
+    return root && (root->flags & PARSER_NODE_FLAG_FROZEN);
+}
+
+#endif /* !defined HDR_PARSER_TREE_H */
@@ -0,0 +1,78 @@
+/****************************************************************************
+ * CLI parser value parsers
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file
+ *
+ * Parsers for the values accepted by integer, number and address nodes.
+ * They take a token as a pointer and a length, so that it need not be
+ * null terminated, and never allocate memory or depend on the locale.
+ */
+#ifndef HDR_PARSER_VALUE_H
+#define HDR_PARSER_VALUE_H
+
+#include <stdint.h>
+
+#include "parser_common.h"
+
+/** @brief Parse an integer
+ *
+ * @param   s       Pointer to the token
+ * @param   len     Length of the token
+ * @param   formats Bitmask of the INTEGER_FORMAT_* formats accepted, see
+ *                  \ref parser_node_integer_t
+ * @param   value   Receives the integer
+ *
+ * @returns 0 on success, -EINVAL if the token is not an integer in one of
+ *          the formats, -ERANGE if it does not fit in 64 signed bits.
+ */
+int parser_parse_integer(const char *s, uint32_t len, uint32_t formats,
+                         int64_t *value);
+
+/** @brief Parse a floating point number
+ *
+ * The result is correctly rounded if the number has at most 19 significant
+ * digits, and its value is an integer below 2^53 scaled by a power of ten
+ * up to 10^22, which covers what is typed at a command line. Otherwise, it
+ * may be off by one unit in the last place.
+ *
+ * @param   s       Pointer to the token
+ * @param   len     Length of the token
+ * @param   value   Receives the number
+ *
+ * @returns 0 on success, -EINVAL if the token is not a number in the form
+ *          described by \ref parser_node_number_t, -ERANGE if it overflows
+ *          or underflows a double.
+ */
+int parser_parse_number(const char *s, uint32_t len, double *value);
+
+/** @brief Parse an address
+ *
+ * @param   s       Pointer to the token
+ * @param   len     Length of the token
+ * @param   formats Bitmask of the ADDRESS_FORMAT_* formats accepted, see
+ *                  \ref parser_node_address_t
+ * @param   addr    Receives the address
+ *
+ * @returns 0 on success, -EINVAL if the token is not an address in one of
+ *          the formats.
+ */
+int parser_parse_address(const char *s, uint32_t len, uint32_t formats,
+                         parser_address_t *addr);
+
+#endif /* !defined HDR_PARSER_VALUE_H */
@@ -0,0 +1,742 @@
+/****************************************************************************
+ * CLI parser core
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "parser.h"
+#include "parser_node_keyword.h"
+#include "parser_node_integer.h"
+#include "parser_conditional.h"
+
+/* Maximum nesting of conditional nodes, which guards against cycles */
+#define PARSER_COND_DEPTH_MAX   16
+
+static int32_t match_node(PARSER_NODE *node, PARSER_CTRL *ctl,
+                          const parser_token_t *token)
+{
+    const PARSER_NODE_REG *reg;
+
+    reg = parser_node_get_registration(node->type);
+    if (!reg || !reg->match) {
+        return 0;
+    }
+
+    return reg->match(node, ctl, token);
+}
+
+/*
+ * Match the token against the non-keyword children of a node. The node
+ * types are tried in order of priority, so that a node of a lower priority
+ * type never gets to save a value when a higher priority type wins.
+ */
+static int match_typed(PARSER_NODE *parent, PARSER_CTRL *ctl,
+                       const parser_token_t *token, PARSER_NODE **found,
+                       int32_t *consumed)
+{
+    parser_node_integer_t *integers[2];
+    parser_int_dispatch_t *ranges;
+    PARSER_NODE *child;
+    uint32_t type;
+    uint32_t next;
+    uint32_t matches;
+    int64_t value;
+    int32_t retval;
+
+    *found = NULL;
+    type = PARSER_NODE_TYPE_KEYWORD + 1;
+
+    /* Integers are the first type tried, and with a range table the token
+     * is parsed once for all of them */
+    ranges = parser_node_int_dispatch(parent);
+    if (ranges) {
+        matches = parser_integer_lookup(ranges,
+                                        &ctl->command_line[token->offset],
+                                        token->len, &value, integers, 2);
+        if (matches > 1) {
+            return PARSER_RESULT_AMBIGUOUS;
+        }
+
+        if (matches == 1) {
+            parser_control_set_integer(ctl, integers[0]->index, &value);
+            *found = &integers[0]->header;
+            *consumed = 1;
+            return PARSER_RESULT_OK;
+        }
+
+        type = PARSER_NODE_TYPE_INTEGER + 1;
+    }
+
+    while (type < PARSER_NODE_TYPE_MAX) {
+        next = PARSER_NODE_TYPE_MAX;
+        matches = 0;
+
+        for (child = parent->child; child; child = child->sibling) {
+            if (child->type > type && child->type < next) {
+                next = child->type;
+            }
+
+            if (child->type != type) {
+                continue;
+            }
+
+            retval = match_node(child, ctl, token);
+            if (retval < 0) {
+                return retval;
+            }
+
+            if (retval > 0) {
+                if (matches++) {
+                    return PARSER_RESULT_AMBIGUOUS;
+                }
+                *found = child;
+                *consumed = retval;
+            }
+        }
+
+        if (matches) {
+            return PARSER_RESULT_OK;
+        }
+
+        type = next;
+    }
+
+    return PARSER_RESULT_UNRECOGNIZED;
+}
+
+/*
+ * Match the token against the children of a node. Keywords have the
+ * highest priority, so they are tried first. The branches of conditional
+ * children that are taken are only tried if no other child accepts the
+ * token.
+ */
+static int match_children(PARSER_NODE *node, PARSER_CTRL *ctl,
+                          const parser_token_t *token, PARSER_NODE **found,
+                          int32_t *consumed, uint32_t depth)
+{
+    PARSER_NODE_KEYWORD *keywords[2];
+    PARSER_NODE *child;
+    uint32_t matches;
+    int retval;
+
+    matches = parser_keyword_lookup(node, &ctl->command_line[token->offset],
+                                    token->len, keywords, 2);
+    if (matches > 1) {
+        return PARSER_RESULT_AMBIGUOUS;
+    }
+
+    if (matches == 1) {
+        *found = &keywords[0]->header;
+        *consumed = match_node(*found, ctl, token);
+        if (*consumed < 0) {
+            return *consumed;
+        }
+        return PARSER_RESULT_OK;
+    }
+
+    retval = match_typed(node, ctl, token, found, consumed);
+    if (retval != PARSER_RESULT_UNRECOGNIZED || depth >= PARSER_COND_DEPTH_MAX) {
+        return retval;
+    }
+
+    for (child = node->child; child; child = child->sibling) {
+        if (child->type != PARSER_NODE_TYPE_CONDITIONAL ||
+            !parser_cond_node_taken(child, ctl)) {
+            continue;
+        }
+
+        retval = match_children(child, ctl, token, found, consumed,
+                                depth + 1);
+        if (retval != PARSER_RESULT_UNRECOGNIZED) {
+            return retval;
+        }
+    }
+
+    return PARSER_RESULT_UNRECOGNIZED;
+}
+
+static parser_node_eol_t * find_eol(PARSER_NODE *node, PARSER_CTRL *ctl,
+                                    uint32_t depth)
+{
+    parser_node_eol_t *eol;
+    PARSER_NODE *child;
+
+    for (child = node->child; child; child = child->sibling) {
+        if (child->type == PARSER_NODE_TYPE_EOL) {
+            return (parser_node_eol_t *)child;
+        }
+    }
+
+    if (depth >= PARSER_COND_DEPTH_MAX) {
+        return NULL;
+    }
+
+    for (child = node->child; child; child = child->sibling) {
+        if (child->type == PARSER_NODE_TYPE_CONDITIONAL &&
+            parser_cond_node_taken(child, ctl)) {
+            eol = find_eol(child, ctl, depth + 1);
+            if (eol) {
+                return eol;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+#ifndef PARSER_NO_STATS
+/*
+ * Record the outcome of matching a token against the children of a node.
+ * The children before the one that accepted the token, or all of them if
+ * none did, count as passed over, since a walk of the sibling chain tries
+ * them first. These are the counts that matter for ordering siblings,
+ * regardless of whether a dispatch table was used.
+ */
+static void record_stats(PARSER_NODE *node, PARSER_NODE *found,
+                         PARSER_CTRL *ctl)
+{
+    PARSER_NODE *child;
+    uint32_t depth = 0;
+
+    for (child = node->child; child && child != found; child = child->sibling) {
+        if (child->type == PARSER_NODE_TYPE_EOL ||
+            child->type == PARSER_NODE_TYPE_CONDITIONAL) {
+            continue;
+        }
+
+        depth++;
+        if (child->cold) {
+            __atomic_fetch_add(&child->cold->rejects, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (found && found->cold) {
+        __atomic_fetch_add(&found->cold->matches, 1, __ATOMIC_RELAXED);
+    }
+
+    ctl->probes += depth;
+    if (depth > ctl->probe_depth_max) {
+        ctl->probe_depth_max = depth;
+    }
+}
+#endif
+
+int parser_walk(PARSER_NODE *root, PARSER_CTRL *ctl, PARSER_NODE **node)
+{
+    const parser_token_t *token;
+    PARSER_NODE *found;
+    int32_t consumed;
+    int retval;
+
+    if (!root || !ctl || !node) {
+        return -EINVAL;
+    }
+
+    *node = root;
+    while ((token = parser_control_token(ctl))) {
+        retval = match_children(*node, ctl, token, &found, &consumed, 0);
+
+#ifndef PARSER_NO_STATS
+        if ((ctl->flags & PARSER_CTRL_FLAG_STATS) &&
+            (retval == PARSER_RESULT_OK ||
+             retval == PARSER_RESULT_UNRECOGNIZED)) {
+            record_stats(*node, retval == PARSER_RESULT_OK ? found : NULL, ctl);
+        }
+#endif
+
+        if (retval != PARSER_RESULT_OK) {
+            return retval;
+        }
+
+        parser_control_advance(ctl, consumed);
+        *node = found;
+    }
+
+    return PARSER_RESULT_OK;
+}
+
+/*
+ * Lookahead parse. Every node that accepts a token is followed, rather than
+ * only one, so the parser keeps a set of paths through the tree, all of
+ * which have accepted the same tokens. Each token is matched once against
+ * the children of the last node of every path, and paths that reach the
+ * same node are merged, so no token is matched twice along the same path
+ * and there are never more paths than PARSER_LOOKAHEAD_PATHS_MAX.
+ *
+ * The parameters set by the nodes are recorded as effects of the path
+ * rather than set, and only the effects of the path that is taken are set.
+ * Whenever a single path is left, its effects are set straight away, so a
+ * command without ambiguous tokens records no more than one token's worth
+ * of effects at a time. The conditions of conditional nodes are evaluated
+ * with the effects of the path applied, and the control structure is put
+ * back afterwards.
+ */
+#define PARSER_LOOKAHEAD_PATHS_MAX  32
+
+/* Paths that reached the same node, any of which could complete */
+#define PARSER_PATH_FLAG_MERGED     0x00000001
+
+typedef struct {
+    /* Node that accepted the last token */
+    PARSER_NODE *node;
+
+    /* Latest effect of the path, or NULL if all have been set */
+    const parser_effect_t *effects;
+
+    /* Tokens still to be consumed by the node */
+    uint32_t wait;
+
+    /* PARSER_PATH_FLAG_* */
+    uint32_t flags;
+} parser_path_t;
+
+typedef struct {
+    PARSER_CTRL *ctl;
+
+    /* Path being extended */
+    const parser_path_t *path;
+
+    /* The effects of the path are applied to the control structure */
+    int applied;
+    parser_control_saved_t saved;
+
+    /* Paths after the token */
+    parser_path_t *next;
+    uint32_t count;
+
+    /* Last node that accepted the token, for the statistics */
+    PARSER_NODE *found;
+} parser_lookahead_t;
+
+static void path_apply(parser_lookahead_t *la)
+{
+    if (!la->applied && la->path->effects) {
+        parser_control_apply(la->ctl, la->path->effects, &la->saved);
+        la->applied = 1;
+    }
+}
+
+static void path_restore(parser_lookahead_t *la)
+{
+    if (la->applied) {
+        parser_control_restore(la->ctl, &la->saved);
+        la->applied = 0;
+    }
+}
+
+static int path_add(parser_lookahead_t *la, PARSER_NODE *node,
+                    const parser_effect_t *effects, uint32_t wait,
+                    uint32_t flags)
+{
+    parser_path_t *path;
+    uint32_t i;
+
+    /* Past this point the paths are the same, whatever they set */
+    for (i = 0; i < la->count; i++) {
+        if (la->next[i].node == node && la->next[i].wait == wait) {
+            la->next[i].flags |= PARSER_PATH_FLAG_MERGED;
+            return 0;
+        }
+    }
+
+    if (la->count == PARSER_LOOKAHEAD_PATHS_MAX) {
+        return -E2BIG;
+    }
+
+    path = &la->next[la->count++];
+    path->node = node;
+    path->effects = effects;
+    path->wait = wait;
+    path->flags = flags;
+    return 0;
+}
+
+static int path_match(parser_lookahead_t *la, PARSER_NODE *node,
+                      const parser_token_t *token)
+{
+    parser_effect_log_t *log = la->ctl->effects;
+    int32_t consumed;
+    int retval;
+
+    log->head = la->path->effects;
+    consumed = match_node(node, la->ctl, token);
+    if (consumed <= 0 || log->error) {
+        return log->error ? log->error : consumed;
+    }
+
+    la->found = node;
+    retval = path_add(la, node, log->head, consumed - 1, la->path->flags);
+    return retval ? retval : 1;
+}
+
+/*
+ * Match the token against the children of the last node of a path, with
+ * the same order of priority as match_children, and add a path for every
+ * child of the winning type that accepts it. Returns the number of
+ * children that accepted the token, or negative errno.
+ */
+static int path_children(parser_lookahead_t *la, PARSER_NODE *node,
+                         const parser_token_t *token, uint32_t depth)
+{
+    PARSER_NODE_KEYWORD *keywords[PARSER_LOOKAHEAD_PATHS_MAX + 1];
+    parser_node_integer_t *integers[PARSER_LOOKAHEAD_PATHS_MAX + 1];
+    parser_int_dispatch_t *ranges;
+    PARSER_NODE *child;
+    uint32_t matches;
+    uint32_t type;
+    uint32_t next;
+    uint32_t i;
+    int64_t value;
+    int retval;
+
+    matches = parser_keyword_lookup(node,
+                                    &la->ctl->command_line[token->offset],
+                                    token->len, keywords,
+                                    PARSER_LOOKAHEAD_PATHS_MAX + 1);
+    for (i = 0; i < matches; i++) {
+        retval = path_match(la, &keywords[i]->header, token);
+        if (retval < 0) {
+            return retval;
+        }
+    }
+
+    if (matches) {
+        return matches;
+    }
+
+    type = PARSER_NODE_TYPE_KEYWORD + 1;
+
+    /* Only the integer children that hold the value of the token match */
+    ranges = parser_node_int_dispatch(node);
+    if (ranges) {
+        matches = parser_integer_lookup(ranges,
+                                        &la->ctl->command_line[token->offset],
+                                        token->len, &value, integers,
+                                        PARSER_LOOKAHEAD_PATHS_MAX + 1);
+        for (i = 0; i < matches; i++) {
+            retval = path_match(la, &integers[i]->header, token);
+            if (retval < 0) {
+                return retval;
+            }
+        }
+
+        if (matches) {
+            return matches;
+        }
+
+        type = PARSER_NODE_TYPE_INTEGER + 1;
+    }
+
+    while (type < PARSER_NODE_TYPE_MAX) {
+        next = PARSER_NODE_TYPE_MAX;
+
+        for (child = node->child; child; child = child->sibling) {
+            if (child->type > type && child->type < next) {
+                next = child->type;
+            }
+
+            if (child->type != type) {
+                continue;
+            }
+
+            retval = path_match(la, child, token);
+            if (retval < 0) {
+                return retval;
+            }
+            matches += retval;
+        }
+
+        if (matches) {
+            return matches;
+        }
+
+        type = next;
+    }
+
+    if (depth >= PARSER_COND_DEPTH_MAX) {
+        return 0;
+    }
+
+    for (child = node->child; child; child = child->sibling) {
+        if (child->type != PARSER_NODE_TYPE_CONDITIONAL) {
+            continue;
+        }
+
+        path_apply(la);
+        if (!parser_cond_node_taken(child, la->ctl)) {
+            continue;
+        }
+
+        retval = path_children(la, child, token, depth + 1);
+        if (retval) {
+            return retval;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_lookahead(PARSER_NODE *root, PARSER_CTRL *ctl,
+                           parser_node_eol_t **eol)
+{
+    parser_path_t paths[2][PARSER_LOOKAHEAD_PATHS_MAX];
+    const parser_path_t *taken = NULL;
+    const parser_token_t *token;
+    parser_effect_log_t *log = &ctl->effect_log;
+    parser_lookahead_t la;
+    parser_path_t *path;
+    parser_node_eol_t *end;
+    parser_node_eol_t *taken_end = NULL;
+    uint32_t count;
+    uint32_t parted = ctl->total_parsed;
+    uint32_t complete;
+    uint32_t i;
+    int retval = PARSER_RESULT_OK;
+
+    /* The log is kept in the control structure, so that its arena is only
+     * allocated by the first parse that looks ahead */
+    if (!log->arena.block_size) {
+        parser_arena_init(&log->arena, 4096);
+    }
+    log->head = NULL;
+    log->error = 0;
+    log->pool_used = 0;
+    ctl->effects = log;
+
+    la.ctl = ctl;
+    la.applied = 0;
+    path = paths[0];
+    path->node = root;
+    path->effects = NULL;
+    path->wait = 0;
+    path->flags = 0;
+    count = 1;
+
+    while ((token = parser_control_token(ctl))) {
+        /* An ambiguous command is reported where the paths first parted */
+        if (count == 1 && !(path[0].flags & PARSER_PATH_FLAG_MERGED)) {
+            parted = token->offset;
+        }
+
+        la.next = paths[path == paths[0]];
+        la.count = 0;
+
+        for (i = 0; i < count; i++) {
+            la.path = &path[i];
+
+            /* A node that consumes several tokens skips the ones after the
+             * first
+             */
+            if (path[i].wait) {
+                retval = path_add(&la, path[i].node, path[i].effects,
+                                  path[i].wait - 1, path[i].flags);
+                if (retval) {
+                    break;
+                }
+                continue;
+            }
+
+            la.found = NULL;
+            retval = path_children(&la, path[i].node, token, 0);
+            path_restore(&la);
+
+#ifndef PARSER_NO_STATS
+            if ((ctl->flags & PARSER_CTRL_FLAG_STATS) && retval >= 0) {
+                record_stats(path[i].node, la.found, ctl);
+            }
+#endif
+
+            if (retval < 0) {
+                break;
+            }
+        }
+
+        if (retval < 0) {
+            if (retval == -E2BIG) {
+                ctl->total_parsed = parted;
+                retval = PARSER_RESULT_AMBIGUOUS;
+            }
+            goto out;
+        }
+
+        if (!la.count) {
+            retval = PARSER_RESULT_UNRECOGNIZED;
+            goto out;
+        }
+
+        /* The paths have come back together, so their effects are known */
+        if (la.count == 1) {
+            parser_control_apply(ctl, la.next[0].effects, NULL);
+            la.next[0].effects = NULL;
+            log->pool_used = 0;
+        }
+
+        retval = PARSER_RESULT_OK;
+        parser_control_advance(ctl, 1);
+        path = la.next;
+        count = la.count;
+    }
+
+    complete = 0;
+    for (i = 0; i < count; i++) {
+        la.path = &path[i];
+        path_apply(&la);
+        end = find_eol(path[i].node, ctl, 0);
+        path_restore(&la);
+
+        if (end) {
+            complete += (path[i].flags & PARSER_PATH_FLAG_MERGED) ? 2 : 1;
+            taken = &path[i];
+            taken_end = end;
+        }
+    }
+
+    if (!complete) {
+        retval = PARSER_RESULT_INCOMPLETE;
+    } else if (complete > 1) {
+        ctl->total_parsed = parted;
+        retval = PARSER_RESULT_AMBIGUOUS;
+    } else {
+        parser_control_apply(ctl, taken->effects, NULL);
+        if (eol) {
+            *eol = taken_end;
+        }
+    }
+
+out:
+    ctl->effects = NULL;
+    parser_arena_rewind(&log->arena);
+    return retval;
+}
+
+int parser_parse(PARSER_NODE *root, PARSER_CTRL *ctl, parser_node_eol_t **eol)
+{
+    const parser_token_t *token;
+    PARSER_NODE *node;
+    parser_node_eol_t *end;
+    int retval;
+
+    if (!root || !ctl) {
+        return -EINVAL;
+    }
+
+    token = parser_control_token(ctl);
+    if (!token || ctl->command_line[token->offset] == '!' ||
+        ctl->command_line[token->offset] == '#') {
+        return PARSER_RESULT_EMPTY;
+    }
+
+    if (ctl->flags & PARSER_CTRL_FLAG_LOOKAHEAD) {
+        return parse_lookahead(root, ctl, eol);
+    }
+
+    retval = parser_walk(root, ctl, &node);
+    if (retval != PARSER_RESULT_OK) {
+        return retval;
+    }
+
+    end = find_eol(node, ctl, 0);
+    if (!end) {
+        return PARSER_RESULT_INCOMPLETE;
+    }
+
+    if (eol) {
+        *eol = end;
+    }
+
+    return PARSER_RESULT_OK;
+}
+
+static int candidates(PARSER_NODE *node, PARSER_CTRL *ctl,
+                      const parser_token_t *token, parser_candidate_fn visit,
+                      void *arg, uint32_t depth)
+{
+    const PARSER_NODE_REG *reg;
+    const char *prefix;
+    const char *text;
+    char buf[PARSER_ALT_TEXT_MAX];
+    PARSER_NODE *child;
+    uint32_t len;
+    int retval;
+
+    prefix = &ctl->command_line[ctl->total_parsed];
+    len = token ? token->len : 0;
+
+    for (child = node->child; child; child = child->sibling) {
+        text = NULL;
+
+        switch (child->type) {
+        case PARSER_NODE_TYPE_KEYWORD:
+            /* Offer every keyword that the token is a prefix of */
+            if (len <= KEYWORD_LENGTH_MAX &&
+                strncmp(((PARSER_NODE_KEYWORD *)child)->keyword, prefix,
+                        len) == 0) {
+                text = ((PARSER_NODE_KEYWORD *)child)->keyword;
+            }
+            break;
+
+        case PARSER_NODE_TYPE_EOL:
+            if (len == 0) {
+                text = PARSER_EOL_TEXT;
+            }
+            break;
+
+        case PARSER_NODE_TYPE_CONDITIONAL:
+            if (depth < PARSER_COND_DEPTH_MAX &&
+                parser_cond_node_taken(child, ctl)) {
+                retval = candidates(child, ctl, token, visit, arg, depth + 1);
+                if (retval) {
+                    return retval;
+                }
+            }
+            break;
+
+        default:
+            /* Other nodes are offered if they would accept the token */
+            reg = parser_node_get_registration(child->type);
+            if (!reg || !reg->alt_text ||
+                (len && (!reg->match || reg->match(child, ctl, token) <= 0))) {
+                break;
+            }
+            text = reg->alt_text(child, buf, sizeof(buf));
+            break;
+        }
+
+        if (text) {
+            retval = visit(child, text, arg);
+            if (retval) {
+                return retval;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int parser_node_candidates(PARSER_NODE *node, PARSER_CTRL *ctl,
+                           parser_candidate_fn visit, void *arg)
+{
+    if (!node || !ctl || !visit) {
+        return -EINVAL;
+    }
+
+    return candidates(node, ctl, parser_control_token(ctl), visit, arg, 0);
+}
@@ -0,0 +1,147 @@
+/****************************************************************************
+ * CLI parser arena allocator
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser_arena.h"
+
+/* Size of the block header, rounded up so the data is aligned */
+#define BLOCK_HEADER_SIZE   ((sizeof(parser_arena_block_t) + PARSER_ARENA_ALIGN - 1) & \
+                             ~(size_t)(PARSER_ARENA_ALIGN - 1))
+
+#define BLOCK_DATA(block)   ((uint8_t *)(block) + BLOCK_HEADER_SIZE)
+
+void parser_arena_init(parser_arena_t *arena, size_t block_size)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->block_size = block_size ? block_size : PARSER_ARENA_BLOCK_SIZE;
+}
+
+static parser_arena_block_t * arena_new_block(parser_arena_t *arena, size_t size)
+{
+    parser_arena_block_t *block;
+
+    if (size < arena->block_size) {
+        size = arena->block_size;
+    }
+
+    block = malloc(BLOCK_HEADER_SIZE + size);
+    if (!block) {
+        return NULL;
+    }
+
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+
+    arena->head = block;
+    arena->blocks++;
+    arena->reserved += BLOCK_HEADER_SIZE + size;
+    return block;
+}
+
+void * parser_arena_alloc(parser_arena_t *arena, size_t size)
+{
+    parser_arena_block_t *block;
+    void *ptr;
+
+    if (!arena) {
+        return NULL;
+    }
+
+    size = (size + PARSER_ARENA_ALIGN - 1) & ~(size_t)(PARSER_ARENA_ALIGN - 1);
+
+    block = arena->head;
+    if (!block || block->size - block->used < size) {
+        block = arena_new_block(arena, size);
+        if (!block) {
+            return NULL;
+        }
+    }
+
+    ptr = BLOCK_DATA(block) + block->used;
+    block->used += size;
+    arena->used += size;
+
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+char * parser_arena_strdup(parser_arena_t *arena, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy;
+
+    copy = parser_arena_alloc(arena, len);
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+
+    return copy;
+}
+
+void parser_arena_rewind(parser_arena_t *arena)
+{
+    parser_arena_block_t *block;
+    size_t used;
+
+    if (!arena || !arena->head) {
+        return;
+    }
+
+    if (!arena->head->next) {
+        arena->head->used = 0;
+        arena->used = 0;
+        return;
+    }
+
+    /* Replace the blocks with one that holds everything handed out, so
+     * that filling the arena the same way again fits in it */
+    used = arena->used;
+    while ((block = arena->head) != NULL) {
+        arena->head = block->next;
+        free(block);
+    }
+
+    arena->blocks = 0;
+    arena->reserved = 0;
+    arena->used = 0;
+    arena_new_block(arena, used);
+}
+
+void parser_arena_destroy(parser_arena_t *arena)
+{
+    parser_arena_block_t *block;
+    size_t block_size;
+
+    if (!arena) {
+        return;
+    }
+
+    while ((block = arena->head) != NULL) {
+        arena->head = block->next;
+        free(block);
+    }
+
+    block_size = arena->block_size;
+    parser_arena_init(arena, block_size);
+}
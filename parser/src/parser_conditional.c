@@ -0,0 +1,808 @@
+/****************************************************************************
+ * CLI parser conditional node handler
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "parser_conditional.h"
+
+/* Use computed goto for the dispatch loop where the compiler supports it */
+#if defined(__GNUC__) && !defined(PARSER_COND_NO_THREADING)
+#define PARSER_COND_THREADED 1
+#endif
+
+/*
+ * Type specialized opcodes. The arithmetic, comparison and zero test groups
+ * are in the same order as the bytecode operators, so that the opcode can be
+ * found by offsetting from the first entry of the group.
+ */
+enum cond_opcode_e {
+    OP_END = 0,
+
+    OP_PUSH_I_PARAM,
+    OP_PUSH_F_PARAM,
+    OP_PUSH_A_PARAM,
+    OP_PUSH_S_PARAM,
+    OP_PUSH_I,
+    OP_PUSH_F,
+    OP_PUSH_P,
+
+    /* Conversions of the top of stack, or the entry below it */
+    OP_I2F_TOP,
+    OP_I2F_NEXT,
+    OP_F2B_TOP,
+    OP_F2B_NEXT,
+
+    OP_ADD_I,
+    OP_SUB_I,
+    OP_MUL_I,
+    OP_DIV_I,
+    OP_MOD_I,
+
+    OP_ADD_F,
+    OP_SUB_F,
+    OP_MUL_F,
+    OP_DIV_F,
+
+    OP_EQ_I,
+    OP_NE_I,
+    OP_GT_I,
+    OP_GE_I,
+    OP_LT_I,
+    OP_LE_I,
+
+    OP_EQ_F,
+    OP_NE_F,
+    OP_GT_F,
+    OP_GE_F,
+    OP_LT_F,
+    OP_LE_F,
+
+    /* Three way comparisons, followed by a test of the result against 0 */
+    OP_CMP_A,
+    OP_CMP_S,
+    OP_EQ_Z,
+    OP_NE_Z,
+    OP_GT_Z,
+    OP_GE_Z,
+    OP_LT_Z,
+    OP_LE_Z,
+
+    OP_BAND,
+    OP_BOR,
+    OP_BXOR,
+    OP_BNOT,
+
+    OP_LAND,
+    OP_LOR,
+    OP_LNOT,
+
+    OP_MAX
+};
+
+/* Operand stack entry, the type of which is known from the opcode */
+typedef union {
+    int64_t i;
+    double f;
+    const void *p;
+} cond_value;
+
+/* Translation state, out is NULL while verifying */
+typedef struct {
+    parser_arena_t *arena;
+    parser_cond_insn_t *out;
+    uint32_t count;
+    uint32_t depth;
+    uint32_t max_depth;
+    uint8_t types[PARSER_COND_STACK_MAX];
+} cond_translator;
+
+static uint64_t cond_be64(const uint8_t *p)
+{
+    uint64_t value = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        value = (value << 8) | p[i];
+    }
+
+    return value;
+}
+
+static parser_cond_insn_t * cond_emit(cond_translator *t, uint32_t opcode)
+{
+    parser_cond_insn_t *insn = NULL;
+
+    if (t->out) {
+        insn = &t->out[t->count];
+        insn->opcode = opcode;
+    }
+
+    t->count++;
+    return insn;
+}
+
+static int cond_push(cond_translator *t, uint8_t type)
+{
+    if (t->depth >= PARSER_COND_STACK_MAX) {
+        return -EINVAL;
+    }
+
+    t->types[t->depth++] = type;
+    if (t->depth > t->max_depth) {
+        t->max_depth = t->depth;
+    }
+
+    return 0;
+}
+
+static int cond_is_numeric(uint8_t type)
+{
+    return type == PARSER_COND_TYPE_INTEGER || type == PARSER_COND_TYPE_NUMBER;
+}
+
+static int cond_param(cond_translator *t, uint8_t type, uint8_t index)
+{
+    parser_cond_insn_t *insn;
+    static const uint32_t opcodes[] = {
+        [PARSER_COND_TYPE_INTEGER] = OP_PUSH_I_PARAM,
+        [PARSER_COND_TYPE_NUMBER] = OP_PUSH_F_PARAM,
+        [PARSER_COND_TYPE_ADDRESS] = OP_PUSH_A_PARAM,
+        [PARSER_COND_TYPE_STRING] = OP_PUSH_S_PARAM,
+    };
+
+    if (type > PARSER_COND_TYPE_STRING || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    insn = cond_emit(t, opcodes[type]);
+    if (insn) {
+        insn->index = index;
+    }
+
+    return cond_push(t, type);
+}
+
+/* Translate a constant, returns the number of bytes used or negative errno */
+static int cond_constant(cond_translator *t, uint8_t type, const uint8_t *p,
+                         size_t avail)
+{
+    parser_cond_insn_t *insn;
+    parser_address_t *addr;
+    uint64_t bits;
+    parser_string_t *str;
+    int used;
+
+    switch (type) {
+    case PARSER_COND_TYPE_INTEGER:
+        used = 8;
+        if (avail < 8) {
+            return -EINVAL;
+        }
+        insn = cond_emit(t, OP_PUSH_I);
+        if (insn) {
+            insn->imm.i = (int64_t)cond_be64(p);
+        }
+        break;
+
+    case PARSER_COND_TYPE_NUMBER:
+        used = 8;
+        if (avail < 8) {
+            return -EINVAL;
+        }
+        insn = cond_emit(t, OP_PUSH_F);
+        if (insn) {
+            bits = cond_be64(p);
+            memcpy(&insn->imm.f, &bits, sizeof(insn->imm.f));
+        }
+        break;
+
+    case PARSER_COND_TYPE_ADDRESS:
+        /* Address family, mask and 16 address bytes */
+        used = 2 + sizeof(addr->addr);
+        if (avail < (size_t)used) {
+            return -EINVAL;
+        }
+        insn = cond_emit(t, OP_PUSH_P);
+        if (insn) {
+            addr = parser_arena_alloc(t->arena, sizeof(*addr));
+            if (!addr) {
+                return -ENOMEM;
+            }
+            addr->af = p[0];
+            addr->mask = p[1];
+            memcpy(addr->addr, &p[2], sizeof(addr->addr));
+            insn->imm.p = addr;
+        }
+        break;
+
+    case PARSER_COND_TYPE_STRING:
+        /* Length byte, followed by the string without a terminator */
+        if (avail < 1 || avail - 1 < p[0]) {
+            return -EINVAL;
+        }
+        used = 1 + p[0];
+        insn = cond_emit(t, OP_PUSH_P);
+        if (insn) {
+            /* Held the same way as string parameters, to compare alike */
+            str = parser_arena_alloc(t->arena, sizeof(*str) + p[0] + 1);
+            if (!str) {
+                return -ENOMEM;
+            }
+            memcpy(str + 1, &p[1], p[0]);
+            str->ptr = (const char *)(str + 1);
+            str->len = p[0];
+            str->flags = PARSER_STRING_TERMINATED;
+            insn->imm.p = str;
+        }
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    if (cond_push(t, type)) {
+        return -EINVAL;
+    }
+
+    return used;
+}
+
+static int cond_operator(cond_translator *t, uint8_t op)
+{
+    uint8_t *a;
+    uint8_t b;
+
+    /* Unary operators work on the top of stack in place */
+    if (op == PARSER_COND_OP_BNOT || op == PARSER_COND_OP_LNOT) {
+        if (t->depth < 1) {
+            return -EINVAL;
+        }
+
+        a = &t->types[t->depth - 1];
+        if (op == PARSER_COND_OP_BNOT) {
+            if (*a != PARSER_COND_TYPE_INTEGER) {
+                return -EINVAL;
+            }
+            cond_emit(t, OP_BNOT);
+        } else {
+            if (!cond_is_numeric(*a)) {
+                return -EINVAL;
+            }
+            if (*a == PARSER_COND_TYPE_NUMBER) {
+                cond_emit(t, OP_F2B_TOP);
+            }
+            cond_emit(t, OP_LNOT);
+        }
+
+        *a = PARSER_COND_TYPE_INTEGER;
+        return 0;
+    }
+
+    if (op > PARSER_COND_OP_LNOT || t->depth < 2) {
+        return -EINVAL;
+    }
+
+    /* The result replaces the left operand */
+    a = &t->types[t->depth - 2];
+    b = t->types[t->depth - 1];
+    t->depth--;
+
+    switch (op) {
+    case PARSER_COND_OP_ADD:
+    case PARSER_COND_OP_SUB:
+    case PARSER_COND_OP_MUL:
+    case PARSER_COND_OP_DIV:
+    case PARSER_COND_OP_MOD:
+        if (!cond_is_numeric(*a) || !cond_is_numeric(b)) {
+            return -EINVAL;
+        }
+
+        if (*a == PARSER_COND_TYPE_INTEGER && b == PARSER_COND_TYPE_INTEGER) {
+            cond_emit(t, OP_ADD_I + (op - PARSER_COND_OP_ADD));
+            break;
+        }
+
+        /* Mixed operands are promoted to floating point */
+        if (op == PARSER_COND_OP_MOD) {
+            return -EINVAL;
+        }
+        if (*a == PARSER_COND_TYPE_INTEGER) {
+            cond_emit(t, OP_I2F_NEXT);
+        }
+        if (b == PARSER_COND_TYPE_INTEGER) {
+            cond_emit(t, OP_I2F_TOP);
+        }
+        cond_emit(t, OP_ADD_F + (op - PARSER_COND_OP_ADD));
+        *a = PARSER_COND_TYPE_NUMBER;
+        break;
+
+    case PARSER_COND_OP_EQ:
+    case PARSER_COND_OP_NE:
+    case PARSER_COND_OP_GT:
+    case PARSER_COND_OP_GE:
+    case PARSER_COND_OP_LT:
+    case PARSER_COND_OP_LE:
+        if (cond_is_numeric(*a) && cond_is_numeric(b)) {
+            if (*a == PARSER_COND_TYPE_INTEGER &&
+                b == PARSER_COND_TYPE_INTEGER) {
+                cond_emit(t, OP_EQ_I + (op - PARSER_COND_OP_EQ));
+            } else {
+                if (*a == PARSER_COND_TYPE_INTEGER) {
+                    cond_emit(t, OP_I2F_NEXT);
+                }
+                if (b == PARSER_COND_TYPE_INTEGER) {
+                    cond_emit(t, OP_I2F_TOP);
+                }
+                cond_emit(t, OP_EQ_F + (op - PARSER_COND_OP_EQ));
+            }
+        } else if (*a == b && b == PARSER_COND_TYPE_ADDRESS) {
+            cond_emit(t, OP_CMP_A);
+            cond_emit(t, OP_EQ_Z + (op - PARSER_COND_OP_EQ));
+        } else if (*a == b && b == PARSER_COND_TYPE_STRING) {
+            cond_emit(t, OP_CMP_S);
+            cond_emit(t, OP_EQ_Z + (op - PARSER_COND_OP_EQ));
+        } else {
+            return -EINVAL;
+        }
+        *a = PARSER_COND_TYPE_INTEGER;
+        break;
+
+    case PARSER_COND_OP_BAND:
+    case PARSER_COND_OP_BOR:
+    case PARSER_COND_OP_BXOR:
+        if (*a != PARSER_COND_TYPE_INTEGER || b != PARSER_COND_TYPE_INTEGER) {
+            return -EINVAL;
+        }
+        cond_emit(t, op == PARSER_COND_OP_BAND ? OP_BAND :
+                     op == PARSER_COND_OP_BOR ? OP_BOR : OP_BXOR);
+        break;
+
+    case PARSER_COND_OP_LAND:
+    case PARSER_COND_OP_LOR:
+        if (!cond_is_numeric(*a) || !cond_is_numeric(b)) {
+            return -EINVAL;
+        }
+        if (*a == PARSER_COND_TYPE_NUMBER) {
+            cond_emit(t, OP_F2B_NEXT);
+        }
+        if (b == PARSER_COND_TYPE_NUMBER) {
+            cond_emit(t, OP_F2B_TOP);
+        }
+        cond_emit(t, op == PARSER_COND_OP_LAND ? OP_LAND : OP_LOR);
+        *a = PARSER_COND_TYPE_INTEGER;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static int cond_translate(cond_translator *t, const uint8_t *code, size_t len)
+{
+    size_t pos = 0;
+    uint8_t insn;
+    uint8_t op;
+    int retval;
+
+    t->count = 0;
+    t->depth = 0;
+    t->max_depth = 0;
+
+    while (pos < len) {
+        insn = code[pos++];
+        op = insn & PARSER_COND_CODE_MASK;
+
+        switch (insn & PARSER_COND_CLASS_MASK) {
+        case PARSER_COND_CLASS_PARAM:
+            if (pos >= len) {
+                return -EINVAL;
+            }
+            retval = cond_param(t, op, code[pos++]);
+            break;
+
+        case PARSER_COND_CLASS_CONSTANT:
+            retval = cond_constant(t, op, &code[pos], len - pos);
+            if (retval > 0) {
+                pos += retval;
+                retval = 0;
+            }
+            break;
+
+        case PARSER_COND_CLASS_OPERATOR:
+            retval = cond_operator(t, op);
+            break;
+
+        default:
+            retval = -EINVAL;
+            break;
+        }
+
+        if (retval) {
+            return retval;
+        }
+    }
+
+    /* The program must leave exactly one value that can be tested */
+    if (t->depth != 1 || !cond_is_numeric(t->types[0])) {
+        return -EINVAL;
+    }
+
+    if (t->types[0] == PARSER_COND_TYPE_NUMBER) {
+        cond_emit(t, OP_F2B_TOP);
+    }
+    cond_emit(t, OP_END);
+
+    return 0;
+}
+
+int parser_cond_compile(const uint8_t *code, size_t len, parser_arena_t *arena,
+                        const parser_cond_program_t **program)
+{
+    parser_cond_program_t *prog;
+    cond_translator t;
+    int retval;
+
+    if (!code || !arena || !program) {
+        return -EINVAL;
+    }
+
+    /* Verify first, so the program is allocated at its exact size */
+    memset(&t, 0, sizeof(t));
+    retval = cond_translate(&t, code, len);
+    if (retval) {
+        return retval;
+    }
+
+    prog = parser_arena_alloc(arena, sizeof(*prog) +
+                                     t.count * sizeof(prog->insns[0]));
+    if (!prog) {
+        return -ENOMEM;
+    }
+
+    t.arena = arena;
+    t.out = prog->insns;
+    retval = cond_translate(&t, code, len);
+    if (retval) {
+        return retval;
+    }
+
+    prog->count = t.count;
+    prog->stack_depth = t.max_depth;
+    *program = prog;
+    return 0;
+}
+
+static int64_t cond_compare_address(const parser_address_t *a,
+                                    const parser_address_t *b)
+{
+    int retval;
+
+    if (a->af != b->af) {
+        return a->af < b->af ? -1 : 1;
+    }
+
+    retval = memcmp(a->addr, b->addr, sizeof(a->addr));
+    if (retval) {
+        return retval < 0 ? -1 : 1;
+    }
+
+    if (a->mask != b->mask) {
+        return a->mask < b->mask ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static int64_t cond_compare_string(const parser_string_t *a,
+                                   const parser_string_t *b)
+{
+    int retval;
+
+    retval = memcmp(a->ptr, b->ptr, a->len < b->len ? a->len : b->len);
+    if (!retval && a->len != b->len) {
+        return a->len < b->len ? -1 : 1;
+    }
+
+    return retval < 0 ? -1 : retval > 0;
+}
+
+/* Values of parameters that are not set */
+static const parser_address_t cond_empty_address;
+static const parser_string_t cond_empty_string = { "", 0, PARSER_STRING_TERMINATED };
+
+/* Whether a parameter is set, as 0 or 1 */
+#define PARAM_SET(bitmap, index)    (((bitmap) >> (index)) & 1)
+
+int parser_cond_eval(const parser_cond_program_t *program,
+                     const PARSER_CTRL *ctl)
+{
+    const parser_cond_insn_t *ip = program->insns;
+    cond_value stack[PARSER_COND_STACK_MAX];
+    cond_value *sp = stack - 1;
+
+#ifdef PARSER_COND_THREADED
+    static const void *const labels[OP_MAX] = {
+        [OP_END] = &&L_OP_END,
+        [OP_PUSH_I_PARAM] = &&L_OP_PUSH_I_PARAM,
+        [OP_PUSH_F_PARAM] = &&L_OP_PUSH_F_PARAM,
+        [OP_PUSH_A_PARAM] = &&L_OP_PUSH_A_PARAM,
+        [OP_PUSH_S_PARAM] = &&L_OP_PUSH_S_PARAM,
+        [OP_PUSH_I] = &&L_OP_PUSH_I,
+        [OP_PUSH_F] = &&L_OP_PUSH_F,
+        [OP_PUSH_P] = &&L_OP_PUSH_P,
+        [OP_I2F_TOP] = &&L_OP_I2F_TOP,
+        [OP_I2F_NEXT] = &&L_OP_I2F_NEXT,
+        [OP_F2B_TOP] = &&L_OP_F2B_TOP,
+        [OP_F2B_NEXT] = &&L_OP_F2B_NEXT,
+        [OP_ADD_I] = &&L_OP_ADD_I,
+        [OP_SUB_I] = &&L_OP_SUB_I,
+        [OP_MUL_I] = &&L_OP_MUL_I,
+        [OP_DIV_I] = &&L_OP_DIV_I,
+        [OP_MOD_I] = &&L_OP_MOD_I,
+        [OP_ADD_F] = &&L_OP_ADD_F,
+        [OP_SUB_F] = &&L_OP_SUB_F,
+        [OP_MUL_F] = &&L_OP_MUL_F,
+        [OP_DIV_F] = &&L_OP_DIV_F,
+        [OP_EQ_I] = &&L_OP_EQ_I,
+        [OP_NE_I] = &&L_OP_NE_I,
+        [OP_GT_I] = &&L_OP_GT_I,
+        [OP_GE_I] = &&L_OP_GE_I,
+        [OP_LT_I] = &&L_OP_LT_I,
+        [OP_LE_I] = &&L_OP_LE_I,
+        [OP_EQ_F] = &&L_OP_EQ_F,
+        [OP_NE_F] = &&L_OP_NE_F,
+        [OP_GT_F] = &&L_OP_GT_F,
+        [OP_GE_F] = &&L_OP_GE_F,
+        [OP_LT_F] = &&L_OP_LT_F,
+        [OP_LE_F] = &&L_OP_LE_F,
+        [OP_CMP_A] = &&L_OP_CMP_A,
+        [OP_CMP_S] = &&L_OP_CMP_S,
+        [OP_EQ_Z] = &&L_OP_EQ_Z,
+        [OP_NE_Z] = &&L_OP_NE_Z,
+        [OP_GT_Z] = &&L_OP_GT_Z,
+        [OP_GE_Z] = &&L_OP_GE_Z,
+        [OP_LT_Z] = &&L_OP_LT_Z,
+        [OP_LE_Z] = &&L_OP_LE_Z,
+        [OP_BAND] = &&L_OP_BAND,
+        [OP_BOR] = &&L_OP_BOR,
+        [OP_BXOR] = &&L_OP_BXOR,
+        [OP_BNOT] = &&L_OP_BNOT,
+        [OP_LAND] = &&L_OP_LAND,
+        [OP_LOR] = &&L_OP_LOR,
+        [OP_LNOT] = &&L_OP_LNOT,
+    };
+
+#define TARGET(op)  L_##op:
+#define NEXT()      do { ip++; goto *labels[ip->opcode]; } while (0)
+
+    goto *labels[ip->opcode];
+#else
+#define TARGET(op)  case op:
+#define NEXT()      do { ip++; goto dispatch; } while (0)
+
+dispatch:
+    switch (ip->opcode) {
+#endif
+
+/* Replace the top two entries with the result of a binary operator */
+#define BINARY(field, expr) do { sp[-1].field = (expr); sp--; NEXT(); } while (0)
+
+    TARGET(OP_END)
+        return sp->i != 0;
+
+    TARGET(OP_PUSH_I_PARAM)
+        (++sp)->i = ctl->integers[ip->index] &
+                    -(int64_t)PARAM_SET(ctl->set_integers, ip->index);
+        NEXT();
+
+    TARGET(OP_PUSH_F_PARAM)
+        (++sp)->f = PARAM_SET(ctl->set_numbers, ip->index) ?
+                    ctl->numbers[ip->index] : 0;
+        NEXT();
+
+    TARGET(OP_PUSH_A_PARAM)
+        (++sp)->p = PARAM_SET(ctl->set_addresses, ip->index) ?
+                    &ctl->addresses[ip->index] : &cond_empty_address;
+        NEXT();
+
+    TARGET(OP_PUSH_S_PARAM)
+        (++sp)->p = PARAM_SET(ctl->set_strings, ip->index) ?
+                    &ctl->strings[ip->index] : &cond_empty_string;
+        NEXT();
+
+    TARGET(OP_PUSH_I)
+        (++sp)->i = ip->imm.i;
+        NEXT();
+
+    TARGET(OP_PUSH_F)
+        (++sp)->f = ip->imm.f;
+        NEXT();
+
+    TARGET(OP_PUSH_P)
+        (++sp)->p = ip->imm.p;
+        NEXT();
+
+    TARGET(OP_I2F_TOP)
+        sp->f = (double)sp->i;
+        NEXT();
+
+    TARGET(OP_I2F_NEXT)
+        sp[-1].f = (double)sp[-1].i;
+        NEXT();
+
+    TARGET(OP_F2B_TOP)
+        sp->i = sp->f != 0.0;
+        NEXT();
+
+    TARGET(OP_F2B_NEXT)
+        sp[-1].i = sp[-1].f != 0.0;
+        NEXT();
+
+    /* Integer arithmetic wraps around rather than overflowing */
+    TARGET(OP_ADD_I)
+        BINARY(i, (int64_t)((uint64_t)sp[-1].i + (uint64_t)sp->i));
+
+    TARGET(OP_SUB_I)
+        BINARY(i, (int64_t)((uint64_t)sp[-1].i - (uint64_t)sp->i));
+
+    TARGET(OP_MUL_I)
+        BINARY(i, (int64_t)((uint64_t)sp[-1].i * (uint64_t)sp->i));
+
+    TARGET(OP_DIV_I)
+        if (sp->i == 0 || (sp->i == -1 && sp[-1].i == INT64_MIN)) {
+            return -EDOM;
+        }
+        BINARY(i, sp[-1].i / sp->i);
+
+    TARGET(OP_MOD_I)
+        if (sp->i == 0 || (sp->i == -1 && sp[-1].i == INT64_MIN)) {
+            return -EDOM;
+        }
+        BINARY(i, sp[-1].i % sp->i);
+
+    TARGET(OP_ADD_F)
+        BINARY(f, sp[-1].f + sp->f);
+
+    TARGET(OP_SUB_F)
+        BINARY(f, sp[-1].f - sp->f);
+
+    TARGET(OP_MUL_F)
+        BINARY(f, sp[-1].f * sp->f);
+
+    TARGET(OP_DIV_F)
+        BINARY(f, sp[-1].f / sp->f);
+
+    TARGET(OP_EQ_I)
+        BINARY(i, sp[-1].i == sp->i);
+
+    TARGET(OP_NE_I)
+        BINARY(i, sp[-1].i != sp->i);
+
+    TARGET(OP_GT_I)
+        BINARY(i, sp[-1].i > sp->i);
+
+    TARGET(OP_GE_I)
+        BINARY(i, sp[-1].i >= sp->i);
+
+    TARGET(OP_LT_I)
+        BINARY(i, sp[-1].i < sp->i);
+
+    TARGET(OP_LE_I)
+        BINARY(i, sp[-1].i <= sp->i);
+
+    TARGET(OP_EQ_F)
+        BINARY(i, sp[-1].f == sp->f);
+
+    TARGET(OP_NE_F)
+        BINARY(i, sp[-1].f != sp->f);
+
+    TARGET(OP_GT_F)
+        BINARY(i, sp[-1].f > sp->f);
+
+    TARGET(OP_GE_F)
+        BINARY(i, sp[-1].f >= sp->f);
+
+    TARGET(OP_LT_F)
+        BINARY(i, sp[-1].f < sp->f);
+
+    TARGET(OP_LE_F)
+        BINARY(i, sp[-1].f <= sp->f);
+
+    TARGET(OP_CMP_A)
+        BINARY(i, cond_compare_address(sp[-1].p, sp->p));
+
+    TARGET(OP_CMP_S)
+        BINARY(i, cond_compare_string(sp[-1].p, sp->p));
+
+    TARGET(OP_EQ_Z)
+        sp->i = sp->i == 0;
+        NEXT();
+
+    TARGET(OP_NE_Z)
+        sp->i = sp->i != 0;
+        NEXT();
+
+    TARGET(OP_GT_Z)
+        sp->i = sp->i > 0;
+        NEXT();
+
+    TARGET(OP_GE_Z)
+        sp->i = sp->i >= 0;
+        NEXT();
+
+    TARGET(OP_LT_Z)
+        sp->i = sp->i < 0;
+        NEXT();
+
+    TARGET(OP_LE_Z)
+        sp->i = sp->i <= 0;
+        NEXT();
+
+    TARGET(OP_BAND)
+        BINARY(i, sp[-1].i & sp->i);
+
+    TARGET(OP_BOR)
+        BINARY(i, sp[-1].i | sp->i);
+
+    TARGET(OP_BXOR)
+        BINARY(i, sp[-1].i ^ sp->i);
+
+    TARGET(OP_BNOT)
+        sp->i = ~sp->i;
+        NEXT();
+
+    TARGET(OP_LAND)
+        BINARY(i, sp[-1].i && sp->i);
+
+    TARGET(OP_LOR)
+        BINARY(i, sp[-1].i || sp->i);
+
+    TARGET(OP_LNOT)
+        sp->i = !sp->i;
+        NEXT();
+
+#ifndef PARSER_COND_THREADED
+    default:
+        break;
+    }
+
+    return -EINVAL;
+#endif
+
+#undef BINARY
+#undef NEXT
+#undef TARGET
+}
+
+int parser_cond_node_taken(const PARSER_NODE *node, const PARSER_CTRL *ctl)
+{
+    const parser_node_conditional_t *cnode;
+
+    cnode = (const parser_node_conditional_t *)node;
+    if (!cnode->program) {
+        return 0;
+    }
+
+    return parser_cond_eval(cnode->program, ctl) > 0;
+}
@@ -0,0 +1,519 @@
+/****************************************************************************
+ * CLI parser control structure functions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "parser_control.h"
+
+/* Address read from parameters that are not set */
+static const parser_address_t empty_address;
+
+void parser_control_init(PARSER_CTRL *ctl, const char *line, uint32_t length)
+{
+    /*
+     * Tokens are only read once they are split, and parameters once their
+     * bit is set, so only the fields before them need to be cleared.
+     */
+    memset(ctl, 0, offsetof(PARSER_CTRL, tokens));
+    ctl->command_line = line;
+    ctl->command_length = length;
+    parser_control_tokenize(ctl);
+}
+
+void parser_control_destroy(PARSER_CTRL *ctl)
+{
+    parser_arena_destroy(&ctl->effect_log.arena);
+}
+
+uint32_t parser_token_hash(const char *s, uint32_t len)
+{
+    uint32_t hash = PARSER_TOKEN_HASH_EMPTY;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)s[i]) * 16777619u;
+    }
+
+    /* 0 marks a token that has not been hashed yet */
+    return hash ? hash : 1;
+}
+
+void parser_control_tokenize(PARSER_CTRL *ctl)
+{
+    uint32_t pos = ctl->total_parsed;
+
+    if (pos < ctl->command_length) {
+        pos += parser_scan_spaces(&ctl->command_line[pos],
+                                  ctl->command_length - pos);
+    }
+
+    ctl->total_parsed = pos;
+    ctl->token_count = 0;
+    ctl->token_index = 0;
+}
+
+const parser_token_t * parser_control_split_token(PARSER_CTRL *ctl)
+{
+    const char *line = ctl->command_line;
+    uint32_t length = ctl->command_length;
+    uint32_t pos = ctl->total_parsed;
+    parser_token_t *token;
+
+    if (pos >= length || line[pos] == '\0') {
+        return NULL;
+    }
+
+    /* Every token held has been consumed, so the oldest can be reused */
+    if (ctl->token_count == PARSER_TOKENS_MAX) {
+        ctl->token_count = 0;
+        ctl->token_index = 0;
+    }
+
+    token = &ctl->tokens[ctl->token_count++];
+    token->offset = pos;
+    token->len = parser_scan_token(&line[pos], length - pos);
+    token->hash = 0;
+
+    pos += token->len;
+    token->next = pos + parser_scan_spaces(&line[pos], length - pos);
+    return token;
+}
+
+#define PARAM_BIT(index)    ((uint32_t)1 << (index))
+
+/* Record an effect on the path being matched, instead of setting it */
+static parser_effect_t * control_effect(PARSER_CTRL *ctl, uint32_t kind,
+                                        uint32_t index)
+{
+    parser_effect_log_t *log = ctl->effects;
+    parser_effect_t *effect;
+
+    if (log->pool_used < PARSER_EFFECT_POOL) {
+        effect = &log->pool[log->pool_used++];
+    } else {
+        effect = parser_arena_alloc(&log->arena, sizeof(*effect));
+        if (!effect) {
+            log->error = -ENOMEM;
+            return NULL;
+        }
+    }
+
+    effect->prev = log->head;
+    effect->kind = kind;
+    effect->index = index;
+    log->head = effect;
+    return effect;
+}
+
+int parser_control_get_integer(PARSER_CTRL *ctl, uint32_t index, int64_t *value)
+{
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    *value = (ctl->set_integers & PARAM_BIT(index)) ? ctl->integers[index] : 0;
+    return 0;
+}
+
+int parser_control_set_integer(PARSER_CTRL *ctl, uint32_t index, const int64_t *value)
+{
+    parser_effect_t *effect;
+
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    if (ctl->effects) {
+        effect = control_effect(ctl, PARSER_EFFECT_INTEGER, index);
+        if (!effect) {
+            return -ENOMEM;
+        }
+        effect->value.integer = *value;
+        return 0;
+    }
+
+    ctl->integers[index] = *value;
+    ctl->set_integers |= PARAM_BIT(index);
+    return 0;
+}
+
+int parser_control_set_bit(PARSER_CTRL *ctl, uint32_t index, uint32_t bit)
+{
+    const parser_effect_t *effect;
+    int64_t value;
+
+    if (!ctl || index >= PARSER_MAX_PARAMS || bit >= 64) {
+        return -EINVAL;
+    }
+
+    parser_control_get_integer(ctl, index, &value);
+
+    /* A value recorded on the path being matched is newer than the one set */
+    if (ctl->effects) {
+        for (effect = ctl->effects->head; effect; effect = effect->prev) {
+            if (effect->kind == PARSER_EFFECT_INTEGER && effect->index == index) {
+                value = effect->value.integer;
+                break;
+            }
+        }
+    }
+
+    value |= (int64_t)1 << bit;
+    return parser_control_set_integer(ctl, index, &value);
+}
+
+int parser_control_get_number(PARSER_CTRL *ctl, uint32_t index, double *value)
+{
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    *value = (ctl->set_numbers & PARAM_BIT(index)) ? ctl->numbers[index] : 0;
+    return 0;
+}
+
+int parser_control_set_number(PARSER_CTRL *ctl, uint32_t index, const double *value)
+{
+    parser_effect_t *effect;
+
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    if (ctl->effects) {
+        effect = control_effect(ctl, PARSER_EFFECT_NUMBER, index);
+        if (!effect) {
+            return -ENOMEM;
+        }
+        effect->value.number = *value;
+        return 0;
+    }
+
+    ctl->numbers[index] = *value;
+    ctl->set_numbers |= PARAM_BIT(index);
+    return 0;
+}
+
+int parser_control_get_address_ref(PARSER_CTRL *ctl, uint32_t index,
+                                   const parser_address_t **value)
+{
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    *value = (ctl->set_addresses & PARAM_BIT(index)) ?
+             &ctl->addresses[index] : &empty_address;
+    return 0;
+}
+
+int parser_control_get_address(PARSER_CTRL *ctl, uint32_t index, parser_address_t *value)
+{
+    const parser_address_t *addr;
+    int retval;
+
+    if (!value) {
+        return -EINVAL;
+    }
+
+    retval = parser_control_get_address_ref(ctl, index, &addr);
+    if (!retval) {
+        *value = *addr;
+    }
+
+    return retval;
+}
+
+int parser_control_set_address(PARSER_CTRL *ctl, uint32_t index, const parser_address_t *value)
+{
+    parser_effect_t *effect;
+
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    if (ctl->effects) {
+        effect = control_effect(ctl, PARSER_EFFECT_ADDRESS, index);
+        if (!effect) {
+            return -ENOMEM;
+        }
+        effect->value.address = *value;
+        return 0;
+    }
+
+    ctl->addresses[index] = *value;
+    ctl->set_addresses |= PARAM_BIT(index);
+    return 0;
+}
+
+static int control_set_string(PARSER_CTRL *ctl, uint32_t index,
+                              const char *ptr, uint32_t len, uint32_t flags)
+{
+    parser_string_t *str;
+    parser_effect_t *effect;
+
+    if (ctl->effects) {
+        effect = control_effect(ctl, PARSER_EFFECT_STRING, index);
+        if (!effect) {
+            return -ENOMEM;
+        }
+        str = &effect->value.string;
+    } else {
+        str = &ctl->strings[index];
+        ctl->set_strings |= PARAM_BIT(index);
+    }
+
+    str->ptr = ptr;
+    str->len = len;
+    str->flags = flags;
+    return 0;
+}
+
+/* Copy characters into the slot of a parameter, followed by a terminator.
+ * The characters may already be in the slot, as when a parameter is set
+ * from the string read back from it. */
+static char * control_copy_string(PARSER_CTRL *ctl, uint32_t index,
+                                  const char *ptr, uint32_t len)
+{
+    char *copy = ctl->string_data[index];
+
+    memmove(copy, ptr, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+int parser_control_get_string_span(PARSER_CTRL *ctl, uint32_t index,
+                                   const char **ptr, uint32_t *len)
+{
+    if (!ctl || !ptr || !len || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    if (ctl->set_strings & PARAM_BIT(index)) {
+        *ptr = ctl->strings[index].ptr;
+        *len = ctl->strings[index].len;
+    } else {
+        *ptr = "";
+        *len = 0;
+    }
+
+    return 0;
+}
+
+int parser_control_get_string(PARSER_CTRL *ctl, uint32_t index, const char **value)
+{
+    parser_string_t *str;
+    char *copy;
+
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    if (!(ctl->set_strings & PARAM_BIT(index))) {
+        *value = "";
+        return 0;
+    }
+
+    str = &ctl->strings[index];
+    if (!(str->flags & PARSER_STRING_TERMINATED)) {
+        copy = control_copy_string(ctl, index, str->ptr, str->len);
+        str->ptr = copy;
+        str->flags |= PARSER_STRING_TERMINATED;
+    }
+
+    *value = str->ptr;
+    return 0;
+}
+
+int parser_control_set_string(PARSER_CTRL *ctl, uint32_t index, const char *value)
+{
+    char *copy;
+    uint32_t len;
+
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    len = strnlen(value, PARSER_STRING_MAX - 1);
+    if (ctl->effects) {
+        /* The slot holds the value of the parameter, not of a path */
+        copy = parser_arena_alloc(&ctl->effects->arena, len + 1);
+        if (!copy) {
+            ctl->effects->error = -ENOMEM;
+            return -ENOMEM;
+        }
+
+        memcpy(copy, value, len);
+        copy[len] = '\0';
+        return control_set_string(ctl, index, copy, len,
+                                  PARSER_STRING_TERMINATED |
+                                  PARSER_STRING_LOGGED);
+    }
+
+    copy = control_copy_string(ctl, index, value, len);
+    return control_set_string(ctl, index, copy, len, PARSER_STRING_TERMINATED);
+}
+
+int parser_control_set_string_ref(PARSER_CTRL *ctl, uint32_t index, const char *value)
+{
+    uint32_t len;
+
+    if (!ctl || !value || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    /* A truncated string is not terminated where it ends */
+    len = strnlen(value, PARSER_STRING_MAX);
+    if (len < PARSER_STRING_MAX) {
+        return control_set_string(ctl, index, value, len,
+                                  PARSER_STRING_TERMINATED);
+    }
+
+    return control_set_string(ctl, index, value, PARSER_STRING_MAX - 1, 0);
+}
+
+int parser_control_set_string_span(PARSER_CTRL *ctl, uint32_t index,
+                                   const char *ptr, uint32_t len)
+{
+    if (!ctl || !ptr || index >= PARSER_MAX_PARAMS) {
+        return -EINVAL;
+    }
+
+    if (len > PARSER_STRING_MAX - 1) {
+        len = PARSER_STRING_MAX - 1;
+    }
+
+    return control_set_string(ctl, index, ptr, len, 0);
+}
+
+void parser_control_apply(PARSER_CTRL *ctl, const parser_effect_t *effects,
+                          parser_control_saved_t *saved)
+{
+    uint32_t *set[PARSER_EFFECT_KINDS] = {
+        &ctl->set_integers, &ctl->set_numbers, &ctl->set_addresses,
+        &ctl->set_strings,
+    };
+    uint32_t applied[PARSER_EFFECT_KINDS] = { 0 };
+    uint32_t index;
+    uint32_t kind;
+    int keep;
+
+    if (saved) {
+        for (kind = 0; kind < PARSER_EFFECT_KINDS; kind++) {
+            saved->set[kind] = *set[kind];
+        }
+    }
+
+    /* The chain runs from the latest effect, which wins */
+    for (; effects; effects = effects->prev) {
+        kind = effects->kind;
+        index = effects->index;
+        if (applied[kind] & PARAM_BIT(index)) {
+            continue;
+        }
+
+        /* Only the parameters that were set need their values back */
+        keep = saved && (*set[kind] & PARAM_BIT(index));
+        applied[kind] |= PARAM_BIT(index);
+        *set[kind] |= PARAM_BIT(index);
+
+        switch (kind) {
+        case PARSER_EFFECT_INTEGER:
+            if (keep) {
+                saved->integers[index] = ctl->integers[index];
+            }
+            ctl->integers[index] = effects->value.integer;
+            break;
+
+        case PARSER_EFFECT_NUMBER:
+            if (keep) {
+                saved->numbers[index] = ctl->numbers[index];
+            }
+            ctl->numbers[index] = effects->value.number;
+            break;
+
+        case PARSER_EFFECT_ADDRESS:
+            if (keep) {
+                saved->addresses[index] = ctl->addresses[index];
+            }
+            ctl->addresses[index] = effects->value.address;
+            break;
+
+        case PARSER_EFFECT_STRING:
+            if (keep) {
+                saved->strings[index] = ctl->strings[index];
+            }
+            ctl->strings[index] = effects->value.string;
+            if (!saved && (ctl->strings[index].flags & PARSER_STRING_LOGGED)) {
+                ctl->strings[index].ptr =
+                    control_copy_string(ctl, index, ctl->strings[index].ptr,
+                                        ctl->strings[index].len);
+                ctl->strings[index].flags = PARSER_STRING_TERMINATED;
+            }
+            break;
+        }
+    }
+
+    if (saved) {
+        memcpy(saved->replaced, applied, sizeof(applied));
+    }
+}
+
+void parser_control_restore(PARSER_CTRL *ctl,
+                            const parser_control_saved_t *saved)
+{
+    uint32_t replaced;
+    uint32_t index;
+
+    replaced = saved->replaced[PARSER_EFFECT_INTEGER] &
+               saved->set[PARSER_EFFECT_INTEGER];
+    for (; replaced; replaced &= replaced - 1) {
+        index = __builtin_ctz(replaced);
+        ctl->integers[index] = saved->integers[index];
+    }
+
+    replaced = saved->replaced[PARSER_EFFECT_NUMBER] &
+               saved->set[PARSER_EFFECT_NUMBER];
+    for (; replaced; replaced &= replaced - 1) {
+        index = __builtin_ctz(replaced);
+        ctl->numbers[index] = saved->numbers[index];
+    }
+
+    replaced = saved->replaced[PARSER_EFFECT_ADDRESS] &
+               saved->set[PARSER_EFFECT_ADDRESS];
+    for (; replaced; replaced &= replaced - 1) {
+        index = __builtin_ctz(replaced);
+        ctl->addresses[index] = saved->addresses[index];
+    }
+
+    replaced = saved->replaced[PARSER_EFFECT_STRING] &
+               saved->set[PARSER_EFFECT_STRING];
+    for (; replaced; replaced &= replaced - 1) {
+        index = __builtin_ctz(replaced);
+        ctl->strings[index] = saved->strings[index];
+    }
+
+    ctl->set_integers = saved->set[PARSER_EFFECT_INTEGER];
+    ctl->set_numbers = saved->set[PARSER_EFFECT_NUMBER];
+    ctl->set_addresses = saved->set[PARSER_EFFECT_ADDRESS];
+    ctl->set_strings = saved->set[PARSER_EFFECT_STRING];
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+ * CLI parser address node functions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "parser_node_registration.h"
+#include "parser_control.h"
+#include "parser_value.h"
+
+/* The parts of an address node visited while parsing fit in a cache line */
+_Static_assert(sizeof(parser_node_address_t) <= PARSER_CACHE_LINE_SIZE,
+               "address node does not fit in a cache line");
+
+static int32_t match_address(PARSER_NODE *node, PARSER_CTRL *ctl,
+                             const parser_token_t *token)
+{
+    parser_node_address_t *anode = (parser_node_address_t *)node;
+    parser_address_t value;
+
+    if (!anode || !ctl || !token) {
+        return -EINVAL;
+    }
+
+    if (parser_parse_address(&ctl->command_line[token->offset], token->len,
+                             anode->format, &value)) {
+        return 0;
+    }
+
+    parser_control_set_address(ctl, anode->index, &value);
+    return 1;
+}
+
+static const char * disp_address(PARSER_NODE *node, char *buf, size_t size)
+{
+    parser_node_address_t *anode = (parser_node_address_t *)node;
+    const char *prefix;
+    size_t used = 0;
+
+    prefix = (anode->format & ADDRESS_FORMAT_PREFIX) ? "/nn" : "";
+    buf[0] = '\0';
+
+    /* Each format is shown the way Cisco devices show it */
+    if (anode->format & ADDRESS_FORMAT_IPV4) {
+        used += snprintf(buf + used, size - used, "A.B.C.D%s", prefix);
+    }
+    if ((anode->format & ADDRESS_FORMAT_IPV6) && used < size) {
+        used += snprintf(buf + used, size - used, "%sX:X:X:X::X%s",
+                         used ? "|" : "", prefix);
+    }
+    if ((anode->format & ADDRESS_FORMAT_MAC) && used < size) {
+        snprintf(buf + used, size - used, "%sH.H.H", used ? "|" : "");
+    }
+
+    return buf;
+}
+
+static const PARSER_NODE_REG registration = {
+    .get_child = DEFAULT,
+    .get_sibling = DEFAULT,
+    .match = match_address,
+    .alt_text = disp_address,
+};
+
+SETUP_FUNCTION
+void init_address_node(void)
+{
+    parser_node_register_type(PARSER_NODE_TYPE_ADDRESS, &registration);
+}
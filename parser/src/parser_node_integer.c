@@ -0,0 +1,301 @@
+/****************************************************************************
+ * CLI parser integer node functions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "parser_node_integer.h"
+#include "parser_node_registration.h"
+#include "parser_control.h"
+#include "parser_value.h"
+
+/* The parts of an integer node visited while parsing fit in a cache line */
+_Static_assert(sizeof(parser_node_integer_t) <= PARSER_CACHE_LINE_SIZE,
+               "integer node does not fit in a cache line");
+
+static int range_compare(const void *a, const void *b)
+{
+    const parser_int_range_t *ra = a;
+    const parser_int_range_t *rb = b;
+
+    if (ra->min != rb->min) {
+        return ra->min < rb->min ? -1 : 1;
+    }
+
+    return (ra->max > rb->max) - (ra->max < rb->max);
+}
+
+uint32_t parser_integer_lookup(const parser_int_dispatch_t *dispatch,
+                               const char *token, uint32_t len,
+                               int64_t *value, parser_node_integer_t **match,
+                               uint32_t max)
+{
+    const parser_int_range_t *range;
+    uint32_t found;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t mid;
+
+    if (parser_parse_integer(token, len, dispatch->formats, value)) {
+        return 0;
+    }
+
+    /* Locate the first range that starts after the value */
+    lo = 0;
+    hi = dispatch->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (dispatch->entries[mid].min <= *value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /*
+     * Every range that holds the value starts at or before it. Walking
+     * back, once no earlier range reaches the value, none can hold it, so
+     * ranges that do not overlap are done after a single step.
+     */
+    found = 0;
+    while (lo-- > 0 && found < max) {
+        range = &dispatch->entries[lo];
+        if (range->reach < *value) {
+            break;
+        }
+
+        if (range->max >= *value) {
+            match[found++] = range->node;
+        }
+    }
+
+    return found;
+}
+
+uint32_t parser_integer_overlaps(const PARSER_NODE *parent)
+{
+    const parser_int_dispatch_t *dispatch;
+    const parser_node_integer_t *a;
+    const parser_node_integer_t *b;
+    const PARSER_NODE *node;
+    const PARSER_NODE *other;
+    uint32_t overlaps = 0;
+    int before;
+
+    if (!parent) {
+        return 0;
+    }
+
+    dispatch = parser_node_int_dispatch(parent);
+    if (dispatch) {
+        return dispatch->overlaps;
+    }
+
+    /*
+     * Chains without a table are usually short, so every pair is compared.
+     * A range is counted if a range that sorts before it, as the table
+     * would sort them, reaches its minimum, which counts the same ranges
+     * as the table does.
+     */
+    for (node = parent->child; node; node = node->sibling) {
+        if (node->type != PARSER_NODE_TYPE_INTEGER) {
+            continue;
+        }
+
+        b = (const parser_node_integer_t *)node;
+        before = 1;
+        for (other = parent->child; other; other = other->sibling) {
+            if (other == node) {
+                before = 0;
+                continue;
+            }
+
+            a = (const parser_node_integer_t *)other;
+            if (other->type != PARSER_NODE_TYPE_INTEGER ||
+                a->max_accepted < b->min_accepted) {
+                continue;
+            }
+
+            if (a->min_accepted < b->min_accepted ||
+                (a->min_accepted == b->min_accepted &&
+                 (a->max_accepted < b->max_accepted ||
+                  (a->max_accepted == b->max_accepted && before)))) {
+                overlaps++;
+                break;
+            }
+        }
+    }
+
+    return overlaps;
+}
+
+int parser_integer_build_dispatch(PARSER_NODE *parent, parser_arena_t *arena)
+{
+    parser_int_dispatch_t *dispatch;
+    parser_int_range_t *range;
+    parser_node_integer_t *inode;
+    PARSER_NODE *node;
+    uint32_t formats = 0;
+    uint32_t count;
+    uint32_t i;
+    size_t size;
+
+    if (!parent) {
+        return -EINVAL;
+    }
+
+    parser_integer_free_dispatch(parent);
+
+    if (!parent->cold) {
+        return 0;
+    }
+
+    /* A token can only be parsed once for nodes that read it the same way */
+    count = 0;
+    for (node = parent->child; node; node = node->sibling) {
+        if (node->type != PARSER_NODE_TYPE_INTEGER) {
+            continue;
+        }
+
+        inode = (parser_node_integer_t *)node;
+        if (count++ && inode->formats != formats) {
+            return 0;
+        }
+        formats = inode->formats;
+    }
+
+    if (count < PARSER_INT_DISPATCH_THRESHOLD) {
+        return 0;
+    }
+
+    size = sizeof(*dispatch) + count * sizeof(dispatch->entries[0]);
+    if (arena) {
+        dispatch = parser_arena_alloc(arena, size);
+    } else {
+        dispatch = malloc(size);
+    }
+
+    if (!dispatch) {
+        return -ENOMEM;
+    }
+
+    dispatch->flags = arena ? PARSER_INT_DISPATCH_FLAG_ARENA : 0;
+    dispatch->formats = formats;
+    dispatch->overlaps = 0;
+    dispatch->count = 0;
+    for (node = parent->child; node; node = node->sibling) {
+        if (node->type == PARSER_NODE_TYPE_INTEGER) {
+            inode = (parser_node_integer_t *)node;
+            range = &dispatch->entries[dispatch->count++];
+            range->min = inode->min_accepted;
+            range->max = inode->max_accepted;
+            range->node = inode;
+            node->flags |= PARSER_NODE_FLAG_DISPATCHED;
+        }
+    }
+
+    qsort(dispatch->entries, dispatch->count, sizeof(dispatch->entries[0]),
+          range_compare);
+
+    for (i = 0; i < dispatch->count; i++) {
+        range = &dispatch->entries[i];
+        range->reach = range->max;
+        if (i) {
+            if (range->min <= range[-1].reach) {
+                dispatch->overlaps++;
+            }
+            if (range[-1].reach > range->reach) {
+                range->reach = range[-1].reach;
+            }
+        }
+    }
+
+    parent->cold->int_dispatch = dispatch;
+    parent->flags |= PARSER_NODE_FLAG_INT_DISPATCH;
+    return 0;
+}
+
+void parser_integer_free_dispatch(PARSER_NODE *parent)
+{
+    parser_int_dispatch_t *dispatch;
+    uint32_t i;
+
+    if (!parent) {
+        return;
+    }
+
+    dispatch = parser_node_int_dispatch(parent);
+    if (dispatch) {
+        for (i = 0; i < dispatch->count; i++) {
+            dispatch->entries[i].node->header.flags &= ~PARSER_NODE_FLAG_DISPATCHED;
+        }
+
+        if (!(dispatch->flags & PARSER_INT_DISPATCH_FLAG_ARENA)) {
+            free(dispatch);
+        }
+        parent->cold->int_dispatch = NULL;
+        parent->flags &= ~PARSER_NODE_FLAG_INT_DISPATCH;
+    }
+}
+
+static int32_t match_integer(PARSER_NODE *node, PARSER_CTRL *ctl,
+                             const parser_token_t *token)
+{
+    parser_node_integer_t *inode = (parser_node_integer_t *)node;
+    int64_t value;
+
+    if (!inode || !ctl || !token) {
+        return -EINVAL;
+    }
+
+    /* The parsed value is exact, so the range check cannot be fooled */
+    if (parser_parse_integer(&ctl->command_line[token->offset], token->len,
+                             inode->formats, &value) ||
+        value < inode->min_accepted || value > inode->max_accepted) {
+        return 0;
+    }
+
+    parser_control_set_integer(ctl, inode->index, &value);
+    return 1;
+}
+
+static const char * disp_integer(PARSER_NODE *node, char *buf, size_t size)
+{
+    parser_node_integer_t *inode = (parser_node_integer_t *)node;
+
+    snprintf(buf, size, "<%lld-%lld>", (long long)inode->min_accepted,
+             (long long)inode->max_accepted);
+    return buf;
+}
+
+static const PARSER_NODE_REG registration = {
+    .get_child = DEFAULT,
+    .get_sibling = DEFAULT,
+    .match = match_integer,
+    .alt_text = disp_integer,
+};
+
+SETUP_FUNCTION
+void init_integer_node(void)
+{
+    parser_node_register_type(PARSER_NODE_TYPE_INTEGER, &registration);
+}
@@ -29,94 +29,231 @@
 
 #define UNUSED __attribute__((unused))
 
-static int32_t match_keyword(PARSER_NODE *node, PARSER_CTRL *ctl)
+/* The parts of a keyword node visited while parsing fit in a cache line */
+_Static_assert(sizeof(PARSER_NODE_KEYWORD) <= PARSER_CACHE_LINE_SIZE,
+               "keyword node does not fit in a cache line");
+
+static int keyword_compare(const void *a, const void *b)
 {
-    PARSER_NODE_KEYWORD *knode = (PARSER_NODE_KEYWORD *)node;
-    int32_t match;
-    int32_t i;
-    uint32_t index;
-    int64_t value;
-    uint32_t retval;
-    char *cmdptr;
+    const PARSER_NODE_KEYWORD *ka = *(PARSER_NODE_KEYWORD * const *)a;
+    const PARSER_NODE_KEYWORD *kb = *(PARSER_NODE_KEYWORD * const *)b;
 
-    if (!knode || !ctl) {
-        return -EINVAL;
+    return strncmp(ka->keyword, kb->keyword, KEYWORD_LENGTH_MAX);
+}
+
+int parser_keyword_accepts(const PARSER_NODE_KEYWORD *knode,
+                           const char *token, uint32_t len)
+{
+    return parser_keyword_string_accepts(knode->keyword,
+                                         parser_keyword_minimum_match(knode),
+                                         token, len);
+}
+
+static uint32_t dispatch_lookup(const parser_kw_dispatch_t *dispatch,
+                                const char *token, uint32_t len,
+                                PARSER_NODE_KEYWORD **match, uint32_t max)
+{
+    PARSER_NODE_KEYWORD *knode;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t mid;
+    uint32_t found;
+
+    /* Locate the first keyword that does not sort before the token */
+    lo = 0;
+    hi = dispatch->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (strncmp(dispatch->entries[mid]->keyword, token, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 
-    cmdptr = &ctl->command_line[ctl->total_parsed];
-
-    for (i = 0, match = 0; i < KEYWORD_LENGTH_MAX; i++) {
-        if (knode->keyword[i] == cmdptr[i] && knode->keyword[i] != '\0') {
-            /* Matched so far */
-            match++;
-        //} else if (knode->keyword[i] == '\0' && cmdptr[i] == ' ') {
-            /*
-             * We've reached the end of the keyword and the command pointer
-             * points to whitespace or the end of line. Nothing more to match.
-             */
-            //break;
-        } else if (cmdptr[i] == ' ' || cmdptr == '\0') {
-            /* We've reached the end of the command, nothing more to match */
+    /* Every keyword that begins with the token follows in sequence */
+    for (found = 0; lo < dispatch->count && found < max; lo++) {
+        knode = dispatch->entries[lo];
+        if (strncmp(knode->keyword, token, len) != 0) {
             break;
-        } else {
-            /* Mismatch */
-            return 0;
+        }
+
+        if (len >= parser_keyword_minimum_match(knode)) {
+            match[found++] = knode;
         }
     }
 
-    if (match < knode->minimum_match) {
-        /* We have not satisfied the minimum match requirement */
+    return found;
+}
+
+uint32_t parser_keyword_lookup(const PARSER_NODE *parent,
+                               const char *token, uint32_t len,
+                               PARSER_NODE_KEYWORD **match, uint32_t max)
+{
+    parser_kw_dispatch_t *dispatch;
+    parser_kw_token_t tok;
+    PARSER_NODE *node;
+    uint32_t found;
+    int prepared;
+
+    if (!parent || !token || len == 0 || len > KEYWORD_LENGTH_MAX) {
         return 0;
     }
 
+    dispatch = parser_node_dispatch(parent);
+    if (dispatch) {
+        return dispatch_lookup(dispatch, token, len, match, max);
+    }
+
     /*
-     * Knock off any trailing spaces so the next node can start without
-     * having to strip it off.
+     * Most keywords are told apart by their first letter. The rest are
+     * compared whole against the token, which is prepared once for them.
      */
-    while (cmdptr[i] == ' ') {
-        i++;
+    prepared = 0;
+    found = 0;
+    for (node = parent->child; node && found < max; node = node->sibling) {
+        if (node->type != PARSER_NODE_TYPE_KEYWORD ||
+            ((PARSER_NODE_KEYWORD *)node)->keyword[0] != token[0]) {
+            continue;
+        }
+
+        if (!prepared) {
+            prepared = parser_kw_token_prepare(&tok, token, len);
+        }
+
+        if (parser_keyword_token_accepts((PARSER_NODE_KEYWORD *)node, &tok)) {
+            match[found++] = (PARSER_NODE_KEYWORD *)node;
+        }
+    }
+
+    return found;
+}
+
+int parser_keyword_build_dispatch(PARSER_NODE *parent, parser_arena_t *arena)
+{
+    parser_kw_dispatch_t *dispatch;
+    PARSER_NODE *node;
+    uint32_t count;
+    size_t size;
+
+    if (!parent) {
+        return -EINVAL;
+    }
+
+    parser_keyword_free_dispatch(parent);
+
+    if (!parent->cold) {
+        return 0;
+    }
+
+    count = 0;
+    for (node = parent->child; node; node = node->sibling) {
+        if (node->type == PARSER_NODE_TYPE_KEYWORD) {
+            count++;
+        }
+    }
+
+    if (count < PARSER_KW_DISPATCH_THRESHOLD) {
+        return 0;
+    }
+
+    size = sizeof(*dispatch) + count * sizeof(dispatch->entries[0]);
+    if (arena) {
+        dispatch = parser_arena_alloc(arena, size);
+    } else {
+        dispatch = malloc(size);
+    }
+
+    if (!dispatch) {
+        return -ENOMEM;
+    }
+
+    dispatch->flags = arena ? PARSER_KW_DISPATCH_FLAG_ARENA : 0;
+    dispatch->count = 0;
+    for (node = parent->child; node; node = node->sibling) {
+        if (node->type == PARSER_NODE_TYPE_KEYWORD) {
+            dispatch->entries[dispatch->count++] = (PARSER_NODE_KEYWORD *)node;
+            node->flags |= PARSER_NODE_FLAG_DISPATCHED;
+        }
+    }
+
+    qsort(dispatch->entries, dispatch->count, sizeof(dispatch->entries[0]),
+          keyword_compare);
+
+    parent->cold->kw_dispatch = dispatch;
+    parent->flags |= PARSER_NODE_FLAG_DISPATCH;
+    return 0;
+}
+
+void parser_keyword_free_dispatch(PARSER_NODE *parent)
+{
+    parser_kw_dispatch_t *dispatch;
+    uint32_t i;
+
+    if (!parent) {
+        return;
+    }
+
+    dispatch = parser_node_dispatch(parent);
+    if (dispatch) {
+        for (i = 0; i < dispatch->count; i++) {
+            dispatch->entries[i]->header.flags &= ~PARSER_NODE_FLAG_DISPATCHED;
+        }
+
+        if (!(dispatch->flags & PARSER_KW_DISPATCH_FLAG_ARENA)) {
+            free(dispatch);
+        }
+        parent->cold->kw_dispatch = NULL;
+        parent->flags &= ~PARSER_NODE_FLAG_DISPATCH;
+    }
+}
+
+static int32_t match_keyword(PARSER_NODE *node, PARSER_CTRL *ctl,
+                             const parser_token_t *token)
+{
+    PARSER_NODE_KEYWORD *knode = (PARSER_NODE_KEYWORD *)node;
+    PARSER_NODE_KEYWORD_COLD *kcold;
+    uint32_t index;
+
+    if (!knode || !ctl || !token) {
+        return -EINVAL;
+    }
+
+    if (!parser_keyword_accepts(knode, &ctl->command_line[token->offset],
+                                token->len)) {
+        return 0;
     }
-    match = i;
 
     if (knode->header.node_flags & PARSER_NODE_KW_FLAG_SET_VALUE) {
+        /* The values to set are only needed now, so they are in cold data */
+        kcold = (PARSER_NODE_KEYWORD_COLD *)knode->header.cold;
+        if (!kcold) {
+            return -EINVAL;
+        }
+
         /* Get the index to set from the node */
-        index = knode->index;
+        index = kcold->index;
 
         if (knode->header.node_flags & PARSER_NODE_KW_FLAG_SET_BIT) {
             /* Set bit in integer at specified index */
-            retval = parser_control_get_integer(ctl, index, &value);
-            if (!retval) {
-                value |= ((int64_t)1) << (knode->value);
-                parser_control_set_integer(ctl, index, &value);
-            }
+            parser_control_set_bit(ctl, index, kcold->value);
         } else if (knode->header.node_flags & PARSER_NODE_KW_FLAG_SET_STRING) {
             /* Set string in specified index */
-            parser_control_set_string(ctl, index, &knode->string[0]);
+            parser_control_set_string_ref(ctl, index, &kcold->string[0]);
         } else {
             /* Set integer value in the specified index */
-            parser_control_set_integer(ctl, index, &knode->value);
+            parser_control_set_integer(ctl, index, &kcold->value);
         }
     }
 
-    return match;
+    return 1;
 }
 
-static char * disp_keyword(PARSER_NODE *node, PARSER_CTRL *ctl UNUSED)
+static const char * disp_keyword(PARSER_NODE *node, char *buf UNUSED,
+                                 size_t size UNUSED)
 {
-    PARSER_NODE_KEYWORD *knode = (PARSER_NODE_KEYWORD *)node;
-    char *disp;
-
-    disp = malloc(KEYWORD_LENGTH_MAX);
-
-    if (disp) {
-        if (!knode) {
-            strcpy(disp,"NULL");
-        } else {
-            strncpy(disp, knode->keyword, KEYWORD_LENGTH_MAX);
-        }
-    }
-
-    return disp;
+    /* Keywords are always null terminated, so the node holds the text */
+    return ((PARSER_NODE_KEYWORD *)node)->keyword;
 }
 
 static const PARSER_NODE_REG registration = {
@@ -0,0 +1,77 @@
+/****************************************************************************
+ * CLI parser number node functions
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <float.h>
+
+#include "parser_node_registration.h"
+#include "parser_control.h"
+#include "parser_value.h"
+
+/* The parts of a number node visited while parsing fit in a cache line */
+_Static_assert(sizeof(parser_node_number_t) <= PARSER_CACHE_LINE_SIZE,
+               "number node does not fit in a cache line");
+
+static int32_t match_number(PARSER_NODE *node, PARSER_CTRL *ctl,
+                            const parser_token_t *token)
+{
+    parser_node_number_t *nnode = (parser_node_number_t *)node;
+    double value;
+
+    if (!nnode || !ctl || !token) {
+        return -EINVAL;
+    }
+
+    if (parser_parse_number(&ctl->command_line[token->offset], token->len,
+                            &value) ||
+        value < nnode->min_accepted || value > nnode->max_accepted) {
+        return 0;
+    }
+
+    parser_control_set_number(ctl, nnode->index, &value);
+    return 1;
+}
+
+static const char * disp_number(PARSER_NODE *node, char *buf, size_t size)
+{
+    parser_node_number_t *nnode = (parser_node_number_t *)node;
+
+    if (nnode->min_accepted == -DBL_MAX && nnode->max_accepted == DBL_MAX) {
+        return "<number>";
+    }
+
+    snprintf(buf, size, "<%g-%g>", nnode->min_accepted, nnode->max_accepted);
+    return buf;
+}
+
+static const PARSER_NODE_REG registration = {
+    .get_child = DEFAULT,
+    .get_sibling = DEFAULT,
+    .match = match_number,
+    .alt_text = disp_number,
+};
+
+SETUP_FUNCTION
+void init_number_node(void)
+{
+    parser_node_register_type(PARSER_NODE_TYPE_NUMBER, &registration);
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+ * CLI parser node registration
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "parser_node_registration.h"
+
+static const PARSER_NODE_REG *registrations[PARSER_NODE_TYPE_MAX];
+
+int parser_node_register_type(uint32_t type, const PARSER_NODE_REG *reg)
+{
+    if (type >= PARSER_NODE_TYPE_MAX || !reg) {
+        return -EINVAL;
+    }
+
+    if (registrations[type]) {
+        return -EEXIST;
+    }
+
+    registrations[type] = reg;
+    return 0;
+}
+
+const PARSER_NODE_REG * parser_node_get_registration(uint32_t type)
+{
+    if (type >= PARSER_NODE_TYPE_MAX) {
+        return NULL;
+    }
+
+    return registrations[type];
+}
+
+PARSER_NODE * parser_node_get_child(PARSER_NODE *node, PARSER_CTRL *ctl)
+{
+    const PARSER_NODE_REG *reg;
+
+    if (!node) {
+        return NULL;
+    }
+
+    reg = parser_node_get_registration(node->type);
+    if (reg && reg->get_child) {
+        return reg->get_child(node, ctl);
+    }
+
+    return node->child;
+}
+
+PARSER_NODE * parser_node_get_sibling(PARSER_NODE *node, PARSER_CTRL *ctl)
+{
+    const PARSER_NODE_REG *reg;
+
+    if (!node) {
+        return NULL;
+    }
+
+    reg = parser_node_get_registration(node->type);
+    if (reg && reg->get_sibling) {
+        return reg->get_sibling(node, ctl);
+    }
+
+    return node->sibling;
+}
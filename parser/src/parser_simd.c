@@ -0,0 +1,242 @@
+/****************************************************************************
+ * CLI parser vectorized scanning and keyword comparison
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "parser_simd.h"
+#include "parser_node_registration.h"
+
+#if !defined(PARSER_NO_SIMD) && defined(__SSE2__)
+#define PARSER_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* The token masks hold one bit per byte of a keyword */
+_Static_assert(KEYWORD_LENGTH_MAX == 32, "token mask does not fit a keyword");
+
+static uint32_t scan_token_scalar(const char *s, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len && s[i] != ' ' && s[i] != '\0'; i++) {
+    }
+
+    return i;
+}
+
+static uint32_t scan_spaces_scalar(const char *s, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len && s[i] == ' '; i++) {
+    }
+
+    return i;
+}
+
+static int keyword_prefix_scalar(const char *keyword,
+                                 const parser_kw_token_t *token)
+{
+    return strncmp(keyword, token->text, token->len) == 0;
+}
+
+static const parser_simd_ops_t scalar_ops = {
+    .name = "scalar",
+    .scan_token = scan_token_scalar,
+    .scan_spaces = scan_spaces_scalar,
+    .keyword_prefix = keyword_prefix_scalar,
+};
+
+#ifdef PARSER_SIMD_X86
+/*
+ * The scanners load whole aligned vectors, which may extend past the end of
+ * the string. An aligned load never crosses a page, so it cannot fault, and
+ * the bytes past the end are masked off. The sanitizers do not know this.
+ */
+#define OVERREAD    __attribute__((no_sanitize_address, no_sanitize_thread))
+
+/*
+ * Scan a string one aligned vector at a time. STOP(v) returns the movemask
+ * of the bytes of v that end the run, and the result is the offset of the
+ * first such byte, or len if there is none.
+ */
+#define SCAN_ALIGNED(vec, width, load, STOP)                                \
+    do {                                                                    \
+        uintptr_t misalign = (uintptr_t)s & ((width) - 1);                  \
+        uint32_t off = 0;                                                   \
+        uint32_t chunk = (width) - misalign;                                \
+        uint32_t pos;                                                       \
+        uint32_t mask;                                                      \
+        vec v;                                                              \
+                                                                            \
+        if (!len) {                                                         \
+            return 0;                                                       \
+        }                                                                   \
+                                                                            \
+        v = load((const vec *)(s - misalign));                              \
+        mask = (uint32_t)STOP(v) >> misalign;                               \
+        for (;;) {                                                          \
+            if (mask) {                                                     \
+                pos = off + __builtin_ctz(mask);                            \
+                return pos < len ? pos : len;                               \
+            }                                                               \
+                                                                            \
+            off += chunk;                                                   \
+            if (off >= len) {                                               \
+                return len;                                                 \
+            }                                                               \
+                                                                            \
+            v = load((const vec *)(s + off));                               \
+            mask = (uint32_t)STOP(v);                                       \
+            chunk = (width);                                                \
+        }                                                                   \
+    } while (0)
+
+#define SSE2_TOKEN_END(v)                                                   \
+    _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),   \
+                                   _mm_cmpeq_epi8(v, _mm_setzero_si128())))
+
+#define SSE2_NOT_SPACE(v)                                                   \
+    (~_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' '))) & 0xFFFF)
+
+OVERREAD
+static uint32_t scan_token_sse2(const char *s, uint32_t len)
+{
+    SCAN_ALIGNED(__m128i, 16, _mm_load_si128, SSE2_TOKEN_END);
+}
+
+OVERREAD
+static uint32_t scan_spaces_sse2(const char *s, uint32_t len)
+{
+    SCAN_ALIGNED(__m128i, 16, _mm_load_si128, SSE2_NOT_SPACE);
+}
+
+static int keyword_prefix_sse2(const char *keyword,
+                               const parser_kw_token_t *token)
+{
+    const __m128i *tok = (const __m128i *)token->text;
+    uint32_t lo;
+    uint32_t hi;
+
+    lo = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)keyword), tok[0]));
+    hi = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(keyword + 16)), tok[1]));
+
+    return ((lo | (hi << 16)) & token->mask) == token->mask;
+}
+
+static const parser_simd_ops_t sse2_ops = {
+    .name = "sse2",
+    .scan_token = scan_token_sse2,
+    .scan_spaces = scan_spaces_sse2,
+    .keyword_prefix = keyword_prefix_sse2,
+};
+
+#define AVX2_TOKEN_END(v)                                                   \
+    _mm256_movemask_epi8(_mm256_or_si256(                                   \
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),                \
+                _mm256_cmpeq_epi8(v, _mm256_setzero_si256())))
+
+#define AVX2_NOT_SPACE(v)                                                   \
+    (~_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))))
+
+OVERREAD __attribute__((target("avx2")))
+static uint32_t scan_token_avx2(const char *s, uint32_t len)
+{
+    SCAN_ALIGNED(__m256i, 32, _mm256_load_si256, AVX2_TOKEN_END);
+}
+
+OVERREAD __attribute__((target("avx2")))
+static uint32_t scan_spaces_avx2(const char *s, uint32_t len)
+{
+    SCAN_ALIGNED(__m256i, 32, _mm256_load_si256, AVX2_NOT_SPACE);
+}
+
+__attribute__((target("avx2")))
+static int keyword_prefix_avx2(const char *keyword,
+                               const parser_kw_token_t *token)
+{
+    uint32_t eq;
+
+    /* The whole keyword is compared in one go */
+    eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)keyword),
+                _mm256_load_si256((const __m256i *)token->text)));
+
+    return (eq & token->mask) == token->mask;
+}
+
+static const parser_simd_ops_t avx2_ops = {
+    .name = "avx2",
+    .scan_token = scan_token_avx2,
+    .scan_spaces = scan_spaces_avx2,
+    .keyword_prefix = keyword_prefix_avx2,
+};
+#endif
+
+const parser_simd_ops_t *parser_simd = &scalar_ops;
+
+const parser_simd_ops_t * parser_simd_get(uint32_t level)
+{
+    switch (level) {
+    case PARSER_SIMD_SCALAR:
+        return &scalar_ops;
+
+#ifdef PARSER_SIMD_X86
+    case PARSER_SIMD_SSE2:
+        return &sse2_ops;
+
+    case PARSER_SIMD_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &avx2_ops : NULL;
+#endif
+
+    default:
+        return NULL;
+    }
+}
+
+int parser_simd_select(uint32_t level)
+{
+    const parser_simd_ops_t *ops;
+
+    ops = parser_simd_get(level);
+    if (!ops) {
+        return -ENOTSUP;
+    }
+
+    parser_simd = ops;
+    return 0;
+}
+
+SETUP_FUNCTION
+void init_parser_simd(void)
+{
+    uint32_t level;
+
+    for (level = PARSER_SIMD_MAX; level-- > PARSER_SIMD_SCALAR; ) {
+        if (!parser_simd_select(level)) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,1052 @@
+/****************************************************************************
+ * CLI parser tree operations
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "parser_tree.h"
+#include "parser_control.h"
+#include "parser_node_keyword.h"
+#include "parser_node_integer.h"
+#include "parser_conditional.h"
+
+/*
+ * Set of visited nodes. This is an open addressed hash table of node
+ * pointers, which is enough to handle trees where nodes are shared.
+ */
+struct visited_set {
+    PARSER_NODE **slots;
+    size_t size;
+    size_t used;
+};
+
+static size_t visited_hash(const PARSER_NODE *node, size_t size)
+{
+    uintptr_t p = (uintptr_t)node;
+
+    p ^= p >> 17;
+    p *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+    return (size_t)(p >> 7) & (size - 1);
+}
+
+static int visited_grow(struct visited_set *set)
+{
+    PARSER_NODE **old = set->slots;
+    size_t old_size = set->size;
+    size_t i;
+    size_t h;
+
+    set->size = old_size ? old_size * 2 : 256;
+    set->slots = calloc(set->size, sizeof(*set->slots));
+    if (!set->slots) {
+        set->slots = old;
+        set->size = old_size;
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i]) {
+            h = visited_hash(old[i], set->size);
+            while (set->slots[h]) {
+                h = (h + 1) & (set->size - 1);
+            }
+            set->slots[h] = old[i];
+        }
+    }
+
+    free(old);
+    return 0;
+}
+
+static int visited_contains(const struct visited_set *set,
+                            const PARSER_NODE *node)
+{
+    size_t h;
+
+    if (!set->size) {
+        return 0;
+    }
+
+    h = visited_hash(node, set->size);
+    while (set->slots[h]) {
+        if (set->slots[h] == node) {
+            return 1;
+        }
+        h = (h + 1) & (set->size - 1);
+    }
+
+    return 0;
+}
+
+/* Returns 1 if the node was added, 0 if already present, or -ENOMEM */
+static int visited_add(struct visited_set *set, PARSER_NODE *node)
+{
+    size_t h;
+
+    if ((set->used + 1) * 2 > set->size && visited_grow(set)) {
+        return -ENOMEM;
+    }
+
+    h = visited_hash(node, set->size);
+    while (set->slots[h]) {
+        if (set->slots[h] == node) {
+            return 0;
+        }
+        h = (h + 1) & (set->size - 1);
+    }
+
+    set->slots[h] = node;
+    set->used++;
+    return 1;
+}
+
+int parser_tree_walk(PARSER_NODE *root, parser_tree_visit_fn visit, void *arg)
+{
+    struct visited_set set = { NULL, 0, 0 };
+    PARSER_NODE **stack = NULL;
+    PARSER_NODE **tmp;
+    PARSER_NODE *node;
+    size_t depth = 0;
+    size_t max_depth = 0;
+    int retval = 0;
+    int added;
+
+    if (!root || !visit) {
+        return -EINVAL;
+    }
+
+    node = root;
+    while (node || depth) {
+        if (!node) {
+            node = stack[--depth];
+            continue;
+        }
+
+        added = visited_add(&set, node);
+        if (added < 0) {
+            retval = added;
+            break;
+        }
+
+        if (!added) {
+            /* Already visited along another path, so is the rest of the chain */
+            node = NULL;
+            continue;
+        }
+
+        retval = visit(node, arg);
+        if (retval) {
+            break;
+        }
+
+        /* Come back for the sibling once the children are done */
+        if (node->sibling) {
+            if (depth == max_depth) {
+                max_depth = max_depth ? max_depth * 2 : 64;
+                tmp = realloc(stack, max_depth * sizeof(*stack));
+                if (!tmp) {
+                    retval = -ENOMEM;
+                    break;
+                }
+                stack = tmp;
+            }
+            stack[depth++] = node->sibling;
+        }
+
+        node = node->child;
+    }
+
+    free(stack);
+    free(set.slots);
+    return retval;
+}
+
+size_t parser_node_size(uint32_t type)
+{
+    switch (type) {
+    case PARSER_NODE_TYPE_KEYWORD:
+        return sizeof(parser_node_keyword_t);
+
+    case PARSER_NODE_TYPE_INTEGER:
+        return sizeof(parser_node_integer_t);
+
+    case PARSER_NODE_TYPE_NUMBER:
+        return sizeof(parser_node_number_t);
+
+    case PARSER_NODE_TYPE_ADDRESS:
+        return sizeof(parser_node_address_t);
+
+    case PARSER_NODE_TYPE_CONDITIONAL:
+        return sizeof(parser_node_conditional_t);
+
+    case PARSER_NODE_TYPE_EOL:
+        return sizeof(parser_node_eol_t);
+
+    default:
+        return sizeof(parser_node_header_t);
+    }
+}
+
+size_t parser_node_cold_size(uint32_t type)
+{
+    switch (type) {
+    case PARSER_NODE_TYPE_KEYWORD:
+        return sizeof(parser_node_keyword_cold_t);
+
+    default:
+        return sizeof(parser_node_cold_t);
+    }
+}
+
+static int footprint_node(PARSER_NODE *node, void *arg)
+{
+    parser_footprint_t *footprint = arg;
+    parser_kw_dispatch_t *dispatch;
+    parser_int_dispatch_t *ranges;
+
+    footprint->nodes++;
+    footprint->hot_bytes += parser_node_size(node->type);
+
+    if (node->cold) {
+        footprint->cold_bytes += parser_node_cold_size(node->type);
+        if (node->cold->help_text) {
+            footprint->help_bytes += strlen(node->cold->help_text) + 1;
+        }
+    }
+
+    dispatch = parser_node_dispatch(node);
+    if (dispatch) {
+        footprint->dispatch_bytes += sizeof(*dispatch) +
+                                     dispatch->count * sizeof(dispatch->entries[0]);
+    }
+
+    ranges = parser_node_int_dispatch(node);
+    if (ranges) {
+        footprint->dispatch_bytes += sizeof(*ranges) +
+                                     ranges->count * sizeof(ranges->entries[0]);
+    }
+
+    return 0;
+}
+
+int parser_tree_footprint(PARSER_NODE *root, parser_footprint_t *footprint)
+{
+    if (!footprint) {
+        return -EINVAL;
+    }
+
+    memset(footprint, 0, sizeof(*footprint));
+    return parser_tree_walk(root, footprint_node, footprint);
+}
+
+static int freeze_node(PARSER_NODE *node, void *arg)
+{
+    int retval;
+
+    if (!(node->flags & PARSER_NODE_FLAG_DISPATCH)) {
+        retval = parser_keyword_build_dispatch(node, arg);
+        if (retval) {
+            return retval;
+        }
+    }
+
+    if (!(node->flags & PARSER_NODE_FLAG_INT_DISPATCH)) {
+        return parser_integer_build_dispatch(node, arg);
+    }
+
+    return 0;
+}
+
+static int thaw_node(PARSER_NODE *node, void *arg)
+{
+    (void)arg;
+    parser_keyword_free_dispatch(node);
+    parser_integer_free_dispatch(node);
+    return 0;
+}
+
+int parser_tree_freeze(PARSER_NODE *root, parser_arena_t *arena)
+{
+    int retval;
+
+    if (!root) {
+        return -EINVAL;
+    }
+
+    retval = parser_tree_walk(root, freeze_node, arena);
+    if (retval) {
+        parser_tree_walk(root, thaw_node, NULL);
+        return retval;
+    }
+
+    root->flags |= PARSER_NODE_FLAG_FROZEN;
+    return 0;
+}
+
+void parser_tree_thaw(PARSER_NODE *root)
+{
+    if (!root) {
+        return;
+    }
+
+    parser_tree_walk(root, thaw_node, NULL);
+    root->flags &= ~PARSER_NODE_FLAG_FROZEN;
+}
+
+static int overlaps_node(PARSER_NODE *node, void *arg)
+{
+    *(uint32_t *)arg += parser_integer_overlaps(node);
+    return 0;
+}
+
+int parser_tree_overlaps(PARSER_NODE *root, uint32_t *overlaps)
+{
+    if (!overlaps) {
+        return -EINVAL;
+    }
+
+    *overlaps = 0;
+    return parser_tree_walk(root, overlaps_node, overlaps);
+}
+
+/* A child and its position in the chain, which breaks ties in the sort */
+struct reorder_entry {
+    PARSER_NODE *node;
+    uint64_t matches;
+    uint32_t position;
+};
+
+/* Nodes referenced once, and nodes referenced more than once, and room to
+ * sort the longest child chain seen so far */
+struct reorder_state {
+    struct visited_set linked;
+    struct visited_set shared;
+    struct reorder_entry *entries;
+    size_t entries_size;
+};
+
+static int mark_link(struct reorder_state *state, PARSER_NODE *node)
+{
+    int added;
+
+    if (!node) {
+        return 0;
+    }
+
+    added = visited_add(&state->linked, node);
+    if (added == 0) {
+        added = visited_add(&state->shared, node);
+    }
+
+    return added < 0 ? added : 0;
+}
+
+static int count_links(PARSER_NODE *node, void *arg)
+{
+    struct reorder_state *state = arg;
+    int retval;
+
+    retval = mark_link(state, node->child);
+    if (!retval) {
+        retval = mark_link(state, node->sibling);
+    }
+
+    return retval;
+}
+
+static uint64_t node_matches(const PARSER_NODE *node)
+{
+    /* Nodes that do not consume input keep their relative order */
+    if (node->type > PARSER_NODE_TYPE_CONSTANT || !node->cold) {
+        return 0;
+    }
+
+    return __atomic_load_n(&node->cold->matches, __ATOMIC_RELAXED);
+}
+
+/* Order children by type, then most matches first, then as they were */
+static int reorder_compare(const void *pa, const void *pb)
+{
+    const struct reorder_entry *a = pa;
+    const struct reorder_entry *b = pb;
+
+    if (a->node->type != b->node->type) {
+        return a->node->type < b->node->type ? -1 : 1;
+    }
+
+    if (a->matches != b->matches) {
+        return a->matches > b->matches ? -1 : 1;
+    }
+
+    return (a->position > b->position) - (a->position < b->position);
+}
+
+static int reorder_node(PARSER_NODE *node, void *arg)
+{
+    struct reorder_state *state = arg;
+    struct reorder_entry *entries;
+    PARSER_NODE *child;
+    size_t count = 0;
+    size_t size;
+    size_t i;
+
+    /*
+     * Relinking a chain that is also reached through another node would
+     * reorder, or cut short, the children of that node too.
+     */
+    for (child = node->child; child; child = child->sibling) {
+        if (visited_contains(&state->shared, child)) {
+            return 0;
+        }
+        count++;
+    }
+
+    if (count < 2) {
+        return 0;
+    }
+
+    if (count > state->entries_size) {
+        size = state->entries_size ? state->entries_size : 64;
+        while (size < count) {
+            size *= 2;
+        }
+
+        entries = realloc(state->entries, size * sizeof(*entries));
+        if (!entries) {
+            return -ENOMEM;
+        }
+        state->entries = entries;
+        state->entries_size = size;
+    }
+
+    entries = state->entries;
+    for (child = node->child, i = 0; child; child = child->sibling, i++) {
+        entries[i].node = child;
+        entries[i].matches = node_matches(child);
+        entries[i].position = i;
+    }
+
+    qsort(entries, count, sizeof(*entries), reorder_compare);
+
+    for (i = 0; i + 1 < count; i++) {
+        entries[i].node->sibling = entries[i + 1].node;
+    }
+    entries[count - 1].node->sibling = NULL;
+    node->child = entries[0].node;
+    return 0;
+}
+
+int parser_tree_reorder(PARSER_NODE *root)
+{
+    struct reorder_state state;
+    int retval;
+
+    if (!root) {
+        return -EINVAL;
+    }
+
+    memset(&state, 0, sizeof(state));
+    retval = parser_tree_walk(root, count_links, &state);
+    if (!retval) {
+        retval = parser_tree_walk(root, reorder_node, &state);
+    }
+
+    free(state.linked.slots);
+    free(state.shared.slots);
+    free(state.entries);
+    return retval;
+}
+
+/*
+ * Sharing identical subtrees. Every node is given a canonical node, which
+ * is the first node found with the same contents, the same canonical child
+ * and the same canonical sibling. A node leads to exactly the same nodes as
+ * its canonical node, so it can be replaced by it wherever it is linked.
+ * Nodes are visited children first, so that the links of a node are
+ * already canonical by the time it is compared.
+ */
+enum share_node_state {
+    SHARE_NEW = 0,
+    SHARE_OPEN,
+    SHARE_DONE,
+};
+
+struct share_info {
+    PARSER_NODE *node;
+    PARSER_NODE *canon;
+    uint32_t hash;
+    uint8_t state;
+
+    /* Reached again while still open, so it lies on a cycle */
+    uint8_t pinned;
+
+    /* The sibling links from this node to the end of its chain changed */
+    uint8_t tail_changed;
+};
+
+struct share_canon {
+    PARSER_NODE *node;
+    uint32_t hash;
+};
+
+struct share_frame {
+    PARSER_NODE *node;
+    uint32_t stage;
+};
+
+struct share_state {
+    struct share_info *info;
+    size_t info_size;
+    size_t info_used;
+
+    struct share_canon *canon;
+    size_t canon_size;
+    size_t canon_used;
+
+    uint32_t shared;
+};
+
+static int share_grow(struct share_state *state)
+{
+    struct share_info *old = state->info;
+    size_t old_size = state->info_size;
+    size_t i;
+    size_t h;
+
+    state->info_size = old_size ? old_size * 2 : 256;
+    state->info = calloc(state->info_size, sizeof(*state->info));
+    if (!state->info) {
+        state->info = old;
+        state->info_size = old_size;
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i].node) {
+            h = visited_hash(old[i].node, state->info_size);
+            while (state->info[h].node) {
+                h = (h + 1) & (state->info_size - 1);
+            }
+            state->info[h] = old[i];
+        }
+    }
+
+    free(old);
+    return 0;
+}
+
+/*
+ * Find the information kept for a node, adding it if create is set. The
+ * pointer is only valid until the next node is added.
+ */
+static struct share_info * share_lookup(struct share_state *state,
+                                        PARSER_NODE *node, int create)
+{
+    size_t h;
+
+    if (create && (state->info_used + 1) * 2 > state->info_size &&
+        share_grow(state)) {
+        return NULL;
+    }
+
+    h = visited_hash(node, state->info_size);
+    while (state->info[h].node) {
+        if (state->info[h].node == node) {
+            return &state->info[h];
+        }
+        h = (h + 1) & (state->info_size - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    state->info[h].node = node;
+    state->info_used++;
+    return &state->info[h];
+}
+
+/* Canonical node for a link, which is the node itself while it is open */
+static PARSER_NODE * share_link(struct share_state *state, PARSER_NODE *node)
+{
+    struct share_info *info;
+
+    if (!node) {
+        return NULL;
+    }
+
+    info = share_lookup(state, node, 0);
+    return info->state == SHARE_DONE ? info->canon : node;
+}
+
+/* Whether the chain starting at a node no longer holds the same nodes */
+static int share_tail_changed(struct share_state *state, PARSER_NODE *node)
+{
+    struct share_info *info;
+
+    if (!node) {
+        return 0;
+    }
+
+    info = share_lookup(state, node, 0);
+    return info->state != SHARE_DONE || info->tail_changed;
+}
+
+static uint32_t share_mix(uint32_t hash, uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+
+    return (hash ^ (uint32_t)value ^ (uint32_t)(value >> 32)) * 16777619U;
+}
+
+static uint64_t share_double_bits(double d)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+/* Flags that describe the state of the node rather than what it matches */
+#define SHARE_FLAGS_IGNORED (PARSER_NODE_FLAG_FROZEN | PARSER_NODE_FLAG_DISPATCH | \
+                             PARSER_NODE_FLAG_INT_DISPATCH | \
+                             PARSER_NODE_FLAG_DISPATCHED | \
+                             PARSER_NODE_FLAG_SHARED)
+
+static uint32_t share_hash(const PARSER_NODE *node)
+{
+    const parser_node_integer_t *inode;
+    const parser_node_number_t *nnode;
+    const parser_node_address_t *anode;
+    const parser_node_eol_t *enode;
+    const PARSER_NODE_KEYWORD *knode;
+    const PARSER_NODE_KEYWORD_COLD *kcold;
+    uint32_t hash = 2166136261U;
+
+    hash = share_mix(hash, (uintptr_t)node->child);
+    hash = share_mix(hash, (uintptr_t)node->sibling);
+    hash = share_mix(hash, ((uint64_t)node->type << 40) |
+                           ((uint64_t)node->node_flags << 32) |
+                           (node->flags & ~SHARE_FLAGS_IGNORED));
+    hash = share_mix(hash, node->type_data);
+
+    if (node->cold && node->cold->help_text) {
+        hash = share_mix(hash, parser_token_hash(node->cold->help_text,
+                                                 strlen(node->cold->help_text)));
+    }
+
+    switch (node->type) {
+    case PARSER_NODE_TYPE_KEYWORD:
+        knode = (const PARSER_NODE_KEYWORD *)node;
+        hash = share_mix(hash, parser_token_hash(knode->keyword,
+                                                 strnlen(knode->keyword,
+                                                         KEYWORD_LENGTH_MAX)));
+        kcold = (const PARSER_NODE_KEYWORD_COLD *)node->cold;
+        if (kcold) {
+            hash = share_mix(hash, kcold->index);
+            hash = share_mix(hash, (uint64_t)kcold->value);
+        }
+        break;
+
+    case PARSER_NODE_TYPE_INTEGER:
+        inode = (const parser_node_integer_t *)node;
+        hash = share_mix(hash, (uint64_t)inode->min_accepted);
+        hash = share_mix(hash, (uint64_t)inode->max_accepted);
+        hash = share_mix(hash, ((uint64_t)inode->index << 32) | inode->formats);
+        break;
+
+    case PARSER_NODE_TYPE_NUMBER:
+        nnode = (const parser_node_number_t *)node;
+        hash = share_mix(hash, share_double_bits(nnode->min_accepted));
+        hash = share_mix(hash, share_double_bits(nnode->max_accepted));
+        hash = share_mix(hash, nnode->index);
+        break;
+
+    case PARSER_NODE_TYPE_ADDRESS:
+        anode = (const parser_node_address_t *)node;
+        hash = share_mix(hash, ((uint64_t)anode->index << 32) | anode->format);
+        break;
+
+    case PARSER_NODE_TYPE_CONDITIONAL:
+        hash = share_mix(hash, (uintptr_t)
+                         ((const parser_node_conditional_t *)node)->program);
+        break;
+
+    case PARSER_NODE_TYPE_EOL:
+        enode = (const parser_node_eol_t *)node;
+        hash = share_mix(hash, (uintptr_t)enode->action);
+        hash = share_mix(hash, (uintptr_t)enode->arg);
+        break;
+
+    default:
+        break;
+    }
+
+    return hash;
+}
+
+static int share_equal(const PARSER_NODE *a, const PARSER_NODE *b)
+{
+    const parser_node_integer_t *ia;
+    const parser_node_integer_t *ib;
+    const parser_node_number_t *na;
+    const parser_node_number_t *nb;
+    const parser_node_address_t *aa;
+    const parser_node_address_t *ab;
+    const parser_node_eol_t *ea;
+    const parser_node_eol_t *eb;
+    const PARSER_NODE_KEYWORD_COLD *ka;
+    const PARSER_NODE_KEYWORD_COLD *kb;
+    const char *help_a;
+    const char *help_b;
+
+    if (a->child != b->child || a->sibling != b->sibling ||
+        a->type != b->type || a->node_flags != b->node_flags ||
+        a->type_data != b->type_data ||
+        ((a->flags ^ b->flags) & ~SHARE_FLAGS_IGNORED)) {
+        return 0;
+    }
+
+    /* Nodes without cold data are only equal to each other */
+    if (!a->cold != !b->cold) {
+        return 0;
+    }
+
+    if (a->cold) {
+        help_a = a->cold->help_text;
+        help_b = b->cold->help_text;
+        if ((help_a || help_b) &&
+            (!help_a || !help_b || strcmp(help_a, help_b))) {
+            return 0;
+        }
+    }
+
+    switch (a->type) {
+    case PARSER_NODE_TYPE_KEYWORD:
+        if (strncmp(((const PARSER_NODE_KEYWORD *)a)->keyword,
+                    ((const PARSER_NODE_KEYWORD *)b)->keyword,
+                    KEYWORD_LENGTH_MAX)) {
+            return 0;
+        }
+
+        ka = (const PARSER_NODE_KEYWORD_COLD *)a->cold;
+        kb = (const PARSER_NODE_KEYWORD_COLD *)b->cold;
+        return !ka || (ka->index == kb->index && ka->value == kb->value &&
+                       !strncmp(ka->string, kb->string, STRING_LENGTH_MAX));
+
+    case PARSER_NODE_TYPE_INTEGER:
+        ia = (const parser_node_integer_t *)a;
+        ib = (const parser_node_integer_t *)b;
+        return ia->min_accepted == ib->min_accepted &&
+               ia->max_accepted == ib->max_accepted &&
+               ia->index == ib->index && ia->formats == ib->formats;
+
+    case PARSER_NODE_TYPE_NUMBER:
+        na = (const parser_node_number_t *)a;
+        nb = (const parser_node_number_t *)b;
+        return share_double_bits(na->min_accepted) ==
+               share_double_bits(nb->min_accepted) &&
+               share_double_bits(na->max_accepted) ==
+               share_double_bits(nb->max_accepted) &&
+               na->index == nb->index;
+
+    case PARSER_NODE_TYPE_ADDRESS:
+        aa = (const parser_node_address_t *)a;
+        ab = (const parser_node_address_t *)b;
+        return aa->index == ab->index && aa->format == ab->format;
+
+    case PARSER_NODE_TYPE_CONDITIONAL:
+        return ((const parser_node_conditional_t *)a)->program ==
+               ((const parser_node_conditional_t *)b)->program;
+
+    case PARSER_NODE_TYPE_EOL:
+        ea = (const parser_node_eol_t *)a;
+        eb = (const parser_node_eol_t *)b;
+        return ea->action == eb->action && ea->arg == eb->arg;
+
+    case PARSER_NODE_TYPE_STRING:
+    case PARSER_NODE_TYPE_CONSTANT:
+        /* These hold nothing beyond the header */
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static int share_canon_grow(struct share_state *state)
+{
+    struct share_canon *old = state->canon;
+    size_t old_size = state->canon_size;
+    size_t i;
+    size_t h;
+
+    state->canon_size = old_size ? old_size * 2 : 256;
+    state->canon = calloc(state->canon_size, sizeof(*state->canon));
+    if (!state->canon) {
+        state->canon = old;
+        state->canon_size = old_size;
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i].node) {
+            h = old[i].hash & (state->canon_size - 1);
+            while (state->canon[h].node) {
+                h = (h + 1) & (state->canon_size - 1);
+            }
+            state->canon[h] = old[i];
+        }
+    }
+
+    free(old);
+    return 0;
+}
+
+/* Find the canonical node equal to a node, which becomes its own if none */
+static int share_find(struct share_state *state, PARSER_NODE *node,
+                      PARSER_NODE **canon)
+{
+    uint32_t hash = share_hash(node);
+    size_t h;
+
+    if ((state->canon_used + 1) * 2 > state->canon_size &&
+        share_canon_grow(state)) {
+        return -ENOMEM;
+    }
+
+    h = hash & (state->canon_size - 1);
+    while (state->canon[h].node) {
+        if (state->canon[h].hash == hash &&
+            share_equal(state->canon[h].node, node)) {
+            *canon = state->canon[h].node;
+            return 0;
+        }
+        h = (h + 1) & (state->canon_size - 1);
+    }
+
+    state->canon[h].node = node;
+    state->canon[h].hash = hash;
+    state->canon_used++;
+    *canon = node;
+    return 0;
+}
+
+/* Called once the child chain and the sibling chain of a node are done */
+static int share_node(struct share_state *state, PARSER_NODE *node)
+{
+    struct share_info *info;
+    PARSER_NODE *child;
+    PARSER_NODE *sibling;
+    PARSER_NODE *canon;
+    int tail_changed = 0;
+    int stale = 0;
+    int retval;
+
+    child = share_link(state, node->child);
+    sibling = share_link(state, node->sibling);
+
+    if (child != node->child) {
+        node->child = child;
+        stale = 1;
+    } else if (share_tail_changed(state, child)) {
+        stale = 1;
+    }
+
+    if (sibling != node->sibling) {
+        node->sibling = sibling;
+        tail_changed = 1;
+    } else {
+        tail_changed = share_tail_changed(state, sibling);
+    }
+
+    /* The dispatch tables would still point at the children replaced */
+    if (stale) {
+        parser_keyword_free_dispatch(node);
+        parser_integer_free_dispatch(node);
+    }
+
+    info = share_lookup(state, node, 0);
+    info->state = SHARE_DONE;
+    info->tail_changed = tail_changed;
+    if (info->pinned) {
+        info->canon = node;
+        return 0;
+    }
+
+    retval = share_find(state, node, &canon);
+    if (retval) {
+        return retval;
+    }
+
+    info->canon = canon;
+    if (canon != node) {
+        state->shared++;
+    }
+
+    return 0;
+}
+
+/*
+ * Mark a node, and every node reached from it. This is done for the nodes
+ * that were replaced and the nodes that replaced them, since everything
+ * below the latter is now reached from more than one place. Marked nodes
+ * are skipped, since the nodes below them are already marked.
+ */
+static int share_mark(PARSER_NODE *node, struct share_frame **stack,
+                      size_t *max_depth)
+{
+    struct share_frame *tmp;
+    size_t depth = 0;
+
+    for (;;) {
+        if (node && !(node->flags & PARSER_NODE_FLAG_SHARED)) {
+            node->flags |= PARSER_NODE_FLAG_SHARED;
+            if (depth == *max_depth) {
+                *max_depth = *max_depth ? *max_depth * 2 : 64;
+                tmp = realloc(*stack, *max_depth * sizeof(**stack));
+                if (!tmp) {
+                    return -ENOMEM;
+                }
+                *stack = tmp;
+            }
+            (*stack)[depth++].node = node;
+            node = node->child;
+            continue;
+        }
+
+        if (!depth) {
+            return 0;
+        }
+
+        node = (*stack)[--depth].node->sibling;
+    }
+}
+
+int parser_tree_share(PARSER_NODE *root, uint32_t *shared)
+{
+    struct share_state state;
+    struct share_frame *stack = NULL;
+    struct share_frame *tmp;
+    struct share_info *info;
+    PARSER_NODE *next;
+    size_t depth = 0;
+    size_t max_depth = 0;
+    size_t i;
+    int retval = 0;
+
+    if (!root) {
+        return -EINVAL;
+    }
+
+    memset(&state, 0, sizeof(state));
+
+    /* The root is referenced from outside the tree, and must stay */
+    info = share_lookup(&state, root, 1);
+    if (!info) {
+        return -ENOMEM;
+    }
+    info->state = SHARE_OPEN;
+    info->pinned = 1;
+    next = root;
+
+    for (;;) {
+        if (next) {
+            if (depth == max_depth) {
+                max_depth = max_depth ? max_depth * 2 : 64;
+                tmp = realloc(stack, max_depth * sizeof(*stack));
+                if (!tmp) {
+                    retval = -ENOMEM;
+                    break;
+                }
+                stack = tmp;
+            }
+            stack[depth].node = next;
+            stack[depth].stage = 0;
+            depth++;
+        }
+
+        if (!depth) {
+            break;
+        }
+
+        next = NULL;
+        switch (stack[depth - 1].stage++) {
+        case 0:
+            next = stack[depth - 1].node->child;
+            break;
+
+        case 1:
+            next = stack[depth - 1].node->sibling;
+            break;
+
+        default:
+            retval = share_node(&state, stack[--depth].node);
+            break;
+        }
+
+        if (retval) {
+            break;
+        }
+
+        if (next) {
+            info = share_lookup(&state, next, 1);
+            if (!info) {
+                retval = -ENOMEM;
+                break;
+            }
+
+            if (info->state == SHARE_NEW) {
+                info->state = SHARE_OPEN;
+            } else {
+                /* Links back to an open node close a cycle */
+                if (info->state == SHARE_OPEN) {
+                    info->pinned = 1;
+                }
+                next = NULL;
+            }
+        }
+    }
+
+    /* Even a partly shared tree must not be modified where it was shared */
+    for (i = 0; i < state.info_size; i++) {
+        info = &state.info[i];
+        if (info->node && info->state == SHARE_DONE &&
+            info->canon != info->node) {
+            if ((share_mark(info->node, &stack, &max_depth) ||
+                 share_mark(info->canon, &stack, &max_depth)) && !retval) {
+                retval = -ENOMEM;
+            }
+        }
+    }
+
+    if (!retval && shared) {
+        *shared = state.shared;
+    }
+
+    free(stack);
+    free(state.info);
+    free(state.canon);
+    return retval;
+}
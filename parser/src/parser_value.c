@@ -0,0 +1,544 @@
+/****************************************************************************
+ * CLI parser value parsers
+ ****************************************************************************
+ * CisCLI makes it easy to generate Cisco router style CLIs
+ * Copyright (C) 2013 Nirenjan Krishnan <nirenjan@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ ***************************************************************************/
+/** @file */
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+
+#include "parser_value.h"
+
+/* Number of decimal digits that always fit in 64 bits */
+#define DEC_DIGITS_SAFE     19
+
+/* Number of decimal digits that always fit in the mantissa of a double */
+#define DEC_DIGITS_EXACT    15
+
+/* Largest decimal exponent that is worth scaling by, beyond which every
+ * non-zero mantissa overflows or underflows a double */
+#define DEC_EXPONENT_MAX    400
+
+/* Value of each hexadecimal digit plus one, or 0 for any other character */
+static const uint8_t hex_digit[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+/* Powers of ten that are exactly representable as a double */
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define POW10_EXACT_MAX     22
+
+/* Powers of ten by powers of two, for scaling by any decimal exponent */
+static const long double pow10_binary[] = {
+    1e1L, 1e2L, 1e4L, 1e8L, 1e16L, 1e32L, 1e64L, 1e128L, 1e256L,
+};
+
+/* Value of the decimal digit c, or a value above 9 if c is not one */
+static inline uint32_t dec_digit(char c)
+{
+    return (uint32_t)(uint8_t)c - '0';
+}
+
+int parser_parse_integer(const char *s, uint32_t len, uint32_t formats,
+                         int64_t *value)
+{
+    uint64_t magnitude = 0;
+    uint32_t accepted;
+    uint32_t base;
+    uint32_t safe;
+    uint32_t i = 0;
+    uint32_t d;
+    int overflow = 0;
+    int negative = 0;
+
+    if (!s || !value) {
+        return -EINVAL;
+    }
+
+    if (len && (s[0] == '-' || s[0] == '+')) {
+        negative = s[0] == '-';
+        i = 1;
+    }
+
+    if (i == len) {
+        return -EINVAL;
+    }
+
+    /* Work out the base from the prefix, and the formats that spell it */
+    base = 10;
+    accepted = INTEGER_FORMAT_DEC;
+    if (s[i] == '0' && len - i > 1) {
+        switch (s[i + 1] | 0x20) {
+        case 'x':
+            base = 16;
+            accepted = INTEGER_FORMAT_HEX;
+            i += 2;
+            break;
+
+        case 'b':
+            base = 2;
+            accepted = INTEGER_FORMAT_BIN;
+            i += 2;
+            break;
+
+        default:
+            if (formats & INTEGER_FORMAT_OCT) {
+                base = 8;
+                accepted = INTEGER_FORMAT_OCT;
+                i++;
+            }
+            break;
+        }
+    } else if (s[i] == '0') {
+        /* A lone zero is as much octal as it is decimal */
+        accepted = INTEGER_FORMAT_DEC | INTEGER_FORMAT_OCT;
+    }
+
+    if (!(formats & accepted) || i == len) {
+        return -EINVAL;
+    }
+
+    if (base == 10) {
+        /* The leading digits cannot overflow, so they are not checked */
+        safe = len - i > DEC_DIGITS_SAFE ? i + DEC_DIGITS_SAFE : len;
+        for (; i < safe; i++) {
+            d = dec_digit(s[i]);
+            if (d > 9) {
+                return -EINVAL;
+            }
+            magnitude = magnitude * 10 + d;
+        }
+
+        for (; i < len; i++) {
+            d = dec_digit(s[i]);
+            if (d > 9) {
+                return -EINVAL;
+            }
+            overflow |= __builtin_mul_overflow(magnitude, 10, &magnitude);
+            overflow |= __builtin_add_overflow(magnitude, d, &magnitude);
+        }
+    } else {
+        for (; i < len; i++) {
+            d = hex_digit[(uint8_t)s[i]] - 1;
+            if (d >= base) {
+                return -EINVAL;
+            }
+            overflow |= __builtin_mul_overflow(magnitude, base, &magnitude);
+            overflow |= __builtin_add_overflow(magnitude, d, &magnitude);
+        }
+    }
+
+    /* The magnitude of INT64_MIN is one more than INT64_MAX */
+    if (overflow || magnitude > (uint64_t)INT64_MAX + negative) {
+        return -ERANGE;
+    }
+
+    if (negative) {
+        *value = magnitude > (uint64_t)INT64_MAX ? INT64_MIN :
+                 -(int64_t)magnitude;
+    } else {
+        *value = (int64_t)magnitude;
+    }
+
+    return 0;
+}
+
+/* Scale a mantissa by a power of ten, which may round twice */
+static double scale_slow(uint64_t mantissa, int32_t exp10)
+{
+    long double scale = 1.0L;
+    uint32_t n = exp10 < 0 ? -exp10 : exp10;
+    uint32_t bit;
+
+    for (bit = 0; n; bit++, n >>= 1) {
+        if (n & 1) {
+            scale *= pow10_binary[bit];
+        }
+    }
+
+    return exp10 < 0 ? (double)(mantissa / scale) :
+                       (double)(mantissa * scale);
+}
+
+int parser_parse_number(const char *s, uint32_t len, double *value)
+{
+    uint64_t mantissa = 0;
+    uint64_t shifted;
+    uint32_t significant = 0;
+    uint32_t digits = 0;
+    uint32_t exponent = 0;
+    uint32_t i = 0;
+    uint32_t d;
+    int32_t exp10 = 0;
+    int truncated = 0;
+    int negative = 0;
+    int exp_negative = 0;
+    double result;
+
+    if (!s || !value) {
+        return -EINVAL;
+    }
+
+    if (len && (s[0] == '-' || s[0] == '+')) {
+        negative = s[0] == '-';
+        i = 1;
+    }
+
+    /*
+     * The first 19 significant digits are gathered into the mantissa, and
+     * the decimal exponent is adjusted for the digits after the point and
+     * for the digits that do not fit.
+     */
+    for (; i < len && (d = dec_digit(s[i])) <= 9; i++, digits++) {
+        if (significant < DEC_DIGITS_SAFE) {
+            mantissa = mantissa * 10 + d;
+            significant += mantissa != 0;
+        } else {
+            exp10++;
+            truncated |= d != 0;
+        }
+    }
+
+    if (i < len && s[i] == '.') {
+        for (i++; i < len && (d = dec_digit(s[i])) <= 9; i++, digits++) {
+            if (significant < DEC_DIGITS_SAFE) {
+                mantissa = mantissa * 10 + d;
+                significant += mantissa != 0;
+                exp10--;
+            } else {
+                truncated |= d != 0;
+            }
+        }
+    }
+
+    if (!digits) {
+        return -EINVAL;
+    }
+
+    if (i < len && (s[i] | 0x20) == 'e') {
+        i++;
+        if (i < len && (s[i] == '-' || s[i] == '+')) {
+            exp_negative = s[i] == '-';
+            i++;
+        }
+
+        if (i == len) {
+            return -EINVAL;
+        }
+
+        for (; i < len && (d = dec_digit(s[i])) <= 9; i++) {
+            /* Huge exponents saturate rather than wrap */
+            if (exponent < 10 * DEC_EXPONENT_MAX) {
+                exponent = exponent * 10 + d;
+            }
+        }
+    }
+
+    if (i != len) {
+        return -EINVAL;
+    }
+
+    exp10 += exp_negative ? -(int32_t)exponent : (int32_t)exponent;
+
+    if (!mantissa) {
+        result = 0.0;
+    } else if (exp10 > DEC_EXPONENT_MAX || exp10 < -DEC_EXPONENT_MAX) {
+        return -ERANGE;
+    } else if (!truncated && mantissa <= (1ull << 53) &&
+               exp10 >= -POW10_EXACT_MAX && exp10 <= POW10_EXACT_MAX) {
+        /* Both operands are exact, so the result is correctly rounded */
+        result = (double)mantissa;
+        result = exp10 < 0 ? result / pow10_exact[-exp10] :
+                             result * pow10_exact[exp10];
+    } else if (!truncated && exp10 > POW10_EXACT_MAX &&
+               exp10 - POW10_EXACT_MAX <= DEC_DIGITS_EXACT &&
+               !__builtin_mul_overflow(mantissa,
+                        (uint64_t)pow10_exact[exp10 - POW10_EXACT_MAX],
+                        &shifted) &&
+               shifted <= (1ull << 53)) {
+        /* Digits such as 1e30 move into the mantissa while it stays exact */
+        result = (double)shifted * pow10_exact[POW10_EXACT_MAX];
+    } else {
+        result = scale_slow(mantissa, exp10);
+    }
+
+    if (result > DBL_MAX || (mantissa && result == 0.0)) {
+        return -ERANGE;
+    }
+
+    *value = negative ? -result : result;
+    return 0;
+}
+
+/* Parse a dotted quad that makes up the whole of s */
+static int parse_ipv4(const char *s, uint32_t len, uint8_t *addr)
+{
+    uint32_t octet;
+    uint32_t i = 0;
+    uint32_t n;
+    uint32_t d;
+
+    /* Each octet has one to three digits, so it is read digit by digit */
+    for (n = 0; n < 4; n++) {
+        if (n && (i == len || s[i++] != '.')) {
+            return -EINVAL;
+        }
+
+        if (i == len || (octet = dec_digit(s[i])) > 9) {
+            return -EINVAL;
+        }
+        i++;
+
+        if (i < len && (d = dec_digit(s[i])) <= 9) {
+            /* Leading zeros are rejected, since some read them as octal */
+            if (!octet) {
+                return -EINVAL;
+            }
+            octet = octet * 10 + d;
+            i++;
+
+            if (i < len && (d = dec_digit(s[i])) <= 9) {
+                octet = octet * 10 + d;
+                i++;
+                if (octet > 255) {
+                    return -EINVAL;
+                }
+            }
+        }
+
+        addr[n] = octet;
+    }
+
+    return i == len ? 0 : -EINVAL;
+}
+
+/* Parse an IPv6 address that makes up the whole of s */
+static int parse_ipv6(const char *s, uint32_t len, uint8_t *addr)
+{
+    uint16_t groups[8];
+    uint8_t quad[4];
+    uint32_t count = 0;
+    uint32_t start;
+    uint32_t group;
+    uint32_t digits;
+    uint32_t tail;
+    uint32_t i = 0;
+    uint32_t j;
+    uint32_t v;
+    int32_t gap = -1;
+
+    if (len >= 2 && s[0] == ':' && s[1] == ':') {
+        gap = 0;
+        i = 2;
+    }
+
+    while (i < len) {
+        start = i;
+        group = 0;
+        for (digits = 0; digits < 4 && i < len &&
+             (v = hex_digit[(uint8_t)s[i]]); digits++, i++) {
+            group = (group << 4) | (v - 1);
+        }
+
+        if (!digits) {
+            return -EINVAL;
+        }
+
+        if (i < len && s[i] == '.') {
+            /* A dotted quad may stand in for the last two groups */
+            if (count > 6 || parse_ipv4(&s[start], len - start, quad)) {
+                return -EINVAL;
+            }
+            groups[count++] = (quad[0] << 8) | quad[1];
+            groups[count++] = (quad[2] << 8) | quad[3];
+            break;
+        }
+
+        if (count == 8) {
+            return -EINVAL;
+        }
+        groups[count++] = group;
+
+        if (i == len) {
+            break;
+        }
+
+        /* This also rejects groups of more than four digits */
+        if (s[i] != ':' || ++i == len) {
+            return -EINVAL;
+        }
+
+        if (s[i] == ':') {
+            if (gap >= 0) {
+                return -EINVAL;
+            }
+            gap = count;
+            i++;
+        }
+    }
+
+    /* The gap stands for at least one group of zeros */
+    if (gap < 0 ? count != 8 : count > 7) {
+        return -EINVAL;
+    }
+
+    tail = gap < 0 ? 0 : count - gap;
+    memset(addr, 0, 16);
+    for (j = 0; j < count - tail; j++) {
+        addr[2 * j] = groups[j] >> 8;
+        addr[2 * j + 1] = groups[j] & 0xFF;
+    }
+    for (j = 0; j < tail; j++) {
+        addr[16 - 2 * tail + 2 * j] = groups[gap + j] >> 8;
+        addr[16 - 2 * tail + 2 * j + 1] = groups[gap + j] & 0xFF;
+    }
+
+    return 0;
+}
+
+/* Parse a MAC address that makes up the whole of s */
+static int parse_mac(const char *s, uint32_t len, uint8_t *addr)
+{
+    uint32_t invalid = 0;
+    uint32_t v[4];
+    uint32_t i;
+    uint32_t k;
+    char sep;
+
+    if (len == 14) {
+        /* HHHH.HHHH.HHHH, as shown by Cisco devices */
+        for (i = 0; i < 3; i++) {
+            for (k = 0; k < 4; k++) {
+                v[k] = hex_digit[(uint8_t)s[5 * i + k]];
+                invalid |= !v[k];
+            }
+            addr[2 * i] = ((v[0] - 1) << 4) | (v[1] - 1);
+            addr[2 * i + 1] = ((v[2] - 1) << 4) | (v[3] - 1);
+        }
+
+        invalid |= s[4] != '.' || s[9] != '.';
+    } else if (len == 17) {
+        /* HH:HH:HH:HH:HH:HH, or the same with hyphens */
+        sep = s[2];
+        invalid |= sep != ':' && sep != '-';
+        for (i = 0; i < 6; i++) {
+            v[0] = hex_digit[(uint8_t)s[3 * i]];
+            v[1] = hex_digit[(uint8_t)s[3 * i + 1]];
+            invalid |= !v[0] || !v[1];
+            invalid |= i < 5 && s[3 * i + 2] != sep;
+            addr[i] = ((v[0] - 1) << 4) | (v[1] - 1);
+        }
+    } else {
+        return -EINVAL;
+    }
+
+    return invalid ? -EINVAL : 0;
+}
+
+/* Parse a prefix length from 0 to max, without leading zeros */
+static int parse_prefix(const char *s, uint32_t len, uint32_t max,
+                        uint8_t *prefix)
+{
+    uint32_t value = 0;
+    uint32_t i;
+    uint32_t d;
+
+    if (len == 0 || len > 3 || (len > 1 && s[0] == '0')) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < len; i++) {
+        d = dec_digit(s[i]);
+        if (d > 9) {
+            return -EINVAL;
+        }
+        value = value * 10 + d;
+    }
+
+    if (value > max) {
+        return -EINVAL;
+    }
+
+    *prefix = value;
+    return 0;
+}
+
+int parser_parse_address(const char *s, uint32_t len, uint32_t formats,
+                         parser_address_t *addr)
+{
+    parser_address_t result;
+    const char *slash;
+    uint32_t alen;
+    uint32_t plen;
+
+    if (!s || !addr) {
+        return -EINVAL;
+    }
+
+    memset(&result, 0, sizeof(result));
+
+    /* Without a prefix length, a slash is rejected by the address parsers */
+    slash = NULL;
+    if (formats & ADDRESS_FORMAT_PREFIX) {
+        slash = memchr(s, '/', len);
+    }
+    alen = slash ? (uint32_t)(slash - s) : len;
+    plen = slash ? len - alen - 1 : 0;
+
+    if (!slash) {
+        if ((formats & ADDRESS_FORMAT_MAC) && !parse_mac(s, len, result.addr)) {
+            result.af = AF_MAC;
+            result.mask = 48;
+            *addr = result;
+            return 0;
+        }
+
+        /* The IP addresses must have a prefix length */
+        if (formats & ADDRESS_FORMAT_PREFIX) {
+            return -EINVAL;
+        }
+    }
+
+    result.mask = 32;
+    if ((formats & ADDRESS_FORMAT_IPV4) &&
+        !parse_ipv4(s, alen, result.addr) &&
+        (!slash || !parse_prefix(slash + 1, plen, 32, &result.mask))) {
+        result.af = AF_IPV4;
+        *addr = result;
+        return 0;
+    }
+
+    result.mask = 128;
+    if ((formats & ADDRESS_FORMAT_IPV6) &&
+        !parse_ipv6(s, alen, result.addr) &&
+        (!slash || !parse_prefix(slash + 1, plen, 128, &result.mask))) {
+        result.af = AF_IPV6;
+        *addr = result;
+        return 0;
+    }
+
+    return -EINVAL;
+}